@@ -5,6 +5,7 @@
 
 const GLib = imports.gi.GLib;
 const Gio = imports.gi.Gio;
+const Mainloop = imports.mainloop;
 const ShellJS = imports.gi.ShellJS;
 
 const Config = imports.misc.config;
@@ -20,6 +21,19 @@ var userExtensionsDir = null;
 // Maps uuid -> metadata object
 const extensions = {};
 
+// Bump this when the format of the index changes
+const INDEX_VERSION = 2;
+
+// The metadata of the extensions found by scanExtensionsAsync(), saved
+// under the user cache dir so that it doesn't need to be read from the
+// extension directories again as long as their modification time
+// and that of their metadata.json stay the same. Maps extension
+// path -> { mtime, metadata, hasPrefs }
+let _index = null;
+let _indexFile = null;
+let _indexChanged = false;
+let _indexSaveId = 0;
+
 function getCurrentExtension() {
     let stack = (new Error()).stack;
 
@@ -89,9 +103,7 @@ function isOutOfDate(extension) {
     return false;
 }
 
-function createExtensionObject(uuid, dir, type) {
-    let info;
-
+function _loadMetadata(dir) {
     let metadataFile = dir.get_child('metadata.json');
     if (!metadataFile.query_exists(null)) {
         throw new Error('Missing metadata.json');
@@ -110,6 +122,67 @@ function createExtensionObject(uuid, dir, type) {
         throw new Error('Failed to parse metadata.json: ' + e);
     }
 
+    return meta;
+}
+
+function _getModificationTime(info) {
+    return info.get_attribute_uint64(Gio.FILE_ATTRIBUTE_TIME_MODIFIED) + '.' +
+           info.get_attribute_uint32(Gio.FILE_ATTRIBUTE_TIME_MODIFIED_USEC);
+}
+
+// Editing metadata.json in place doesn't change the modification time
+// of the directory, so the index is keyed on both
+function _getIndexKey(dir, info) {
+    let metadataTime;
+    try {
+        let attributes = [Gio.FILE_ATTRIBUTE_TIME_MODIFIED,
+                          Gio.FILE_ATTRIBUTE_TIME_MODIFIED_USEC].join(',');
+        let metadataInfo = dir.get_child('metadata.json').query_info(attributes,
+                                                                     Gio.FileQueryInfoFlags.NONE,
+                                                                     null);
+        metadataTime = _getModificationTime(metadataInfo);
+    } catch (e) {
+        // Missing; _loadMetadata() will report it
+        metadataTime = '';
+    }
+
+    return _getModificationTime(info) + ':' + metadataTime;
+}
+
+// @info is the GFileInfo of the extension directory as passed by
+// scanExtensionsAsync(); when given, the metadata is taken from the
+// index if neither the directory nor its metadata.json have been
+// modified since it was indexed
+function createExtensionObject(uuid, dir, type, info) {
+    let path = dir.get_path();
+    let entry = null;
+    let meta, hasPrefs;
+
+    if (info && _index) {
+        let mtime = _getIndexKey(dir, info);
+
+        entry = _index.extensions[path];
+        if (!entry || entry.mtime != mtime) {
+            entry = { mtime: mtime };
+            _index.extensions[path] = entry;
+            _indexChanged = true;
+        }
+        entry.seen = true;
+    }
+
+    if (entry && entry.metadata) {
+        meta = entry.metadata;
+        hasPrefs = entry.hasPrefs;
+    } else {
+        meta = _loadMetadata(dir);
+        hasPrefs = dir.get_child('prefs.js').query_exists(null);
+
+        if (entry) {
+            entry.metadata = meta;
+            entry.hasPrefs = hasPrefs;
+        }
+    }
+
     let requiredProperties = ['uuid', 'name', 'description', 'shell-version'];
     for (let i = 0; i < requiredProperties.length; i++) {
         let prop = requiredProperties[i];
@@ -133,9 +206,9 @@ function createExtensionObject(uuid, dir, type) {
     extension.uuid = meta.uuid;
     extension.type = type;
     extension.dir = dir;
-    extension.path = dir.get_path();
+    extension.path = path;
     extension.error = '';
-    extension.hasPrefs = dir.get_child('prefs.js').query_exists(null);
+    extension.hasPrefs = hasPrefs;
 
     extensions[uuid] = extension;
 
@@ -192,3 +265,179 @@ function scanExtensions(callback) {
             scanExtensionsInDirectory(callback, dir, ExtensionType.SYSTEM);
     }
 }
+
+function _getExtensionsDirs() {
+    let dirs = [{ dir: userExtensionsDir, type: ExtensionType.PER_USER }];
+
+    let systemDataDirs = GLib.get_system_data_dirs();
+    for (let i = 0; i < systemDataDirs.length; i++) {
+        let dirPath = GLib.build_filenamev([systemDataDirs[i], 'gnome-shell', 'extensions']);
+        dirs.push({ dir: Gio.file_new_for_path(dirPath), type: ExtensionType.SYSTEM });
+    }
+
+    return dirs;
+}
+
+// Calls @callback with the GFileInfos of the subdirectories of @dir,
+// or with an empty list if it can't be listed
+function _listExtensionsInDirectoryAsync(dir, callback) {
+    let attributes = [Gio.FILE_ATTRIBUTE_STANDARD_NAME,
+                      Gio.FILE_ATTRIBUTE_STANDARD_TYPE,
+                      Gio.FILE_ATTRIBUTE_TIME_MODIFIED,
+                      Gio.FILE_ATTRIBUTE_TIME_MODIFIED_USEC].join(',');
+    let infos = [];
+
+    dir.enumerate_children_async(attributes, Gio.FileQueryInfoFlags.NONE,
+                                 GLib.PRIORITY_LOW, null, function(obj, res) {
+        let enumerator;
+        try {
+            enumerator = obj.enumerate_children_finish(res);
+        } catch (e) {
+            // Most system data dirs don't have an extensions directory
+            callback([]);
+            return;
+        }
+
+        function onNextFilesComplete(obj, res) {
+            let files;
+            try {
+                files = obj.next_files_finish(res);
+            } catch (e) {
+                global.logError('' + e);
+                files = [];
+            }
+
+            if (files.length) {
+                for (let i = 0; i < files.length; i++)
+                    if (files[i].get_file_type() == Gio.FileType.DIRECTORY)
+                        infos.push(files[i]);
+                enumerator.next_files_async(100, GLib.PRIORITY_LOW, null, onNextFilesComplete);
+            } else {
+                enumerator.close(null);
+                callback(infos);
+            }
+        }
+        enumerator.next_files_async(100, GLib.PRIORITY_LOW, null, onNextFilesComplete);
+    });
+}
+
+function _loadIndexAsync(callback) {
+    let cacheDir = Gio.file_new_for_path(GLib.build_filenamev([GLib.get_user_cache_dir(), 'gnome-shell']));
+    _indexFile = cacheDir.get_child('extensions-index.json');
+
+    _indexFile.load_contents_async(null, function(obj, res) {
+        try {
+            let [success, contents, tag] = obj.load_contents_finish(res);
+            _index = JSON.parse(contents);
+        } catch (e) {
+            // Missing or unreadable; it's rebuilt below
+        }
+
+        if (!_index || _index.version != INDEX_VERSION || !_index.extensions) {
+            _index = { version: INDEX_VERSION, extensions: {} };
+            _indexChanged = true;
+        }
+
+        callback();
+    });
+}
+
+/**
+ * scanExtensionsAsync:
+ * @callback: called as callback(uuid, dir, type, info) for each
+ *   extension directory found
+ * @finishedCallback: called once all directories have been scanned
+ *
+ * Like scanExtensions(), but lists the extension directories without
+ * blocking. Passing @info on to createExtensionObject() lets it use
+ * the metadata index instead of reading metadata.json; call saveIndex()
+ * once the extensions have been created.
+ */
+function scanExtensionsAsync(callback, finishedCallback) {
+    let dirs = _getExtensionsDirs();
+
+    let found = {};
+
+    // The directories are scanned one after the other, so that user
+    // extensions are found before system extensions with the same uuid,
+    // as with scanExtensions()
+    function scanNextDir() {
+        let next = dirs.shift();
+        if (!next) {
+            finishedCallback();
+            return;
+        }
+
+        _listExtensionsInDirectoryAsync(next.dir, function(infos) {
+            for (let i = 0; i < infos.length; i++) {
+                let uuid = infos[i].get_name();
+                let dir = next.dir.get_child(uuid);
+
+                // Shadowed by an extension found earlier; it isn't
+                // loaded, but keep its index entry for when it is
+                if (found[uuid]) {
+                    let entry = _index.extensions[dir.get_path()];
+                    if (entry)
+                        entry.seen = true;
+                    continue;
+                }
+
+                found[uuid] = true;
+                callback(uuid, dir, next.type, infos[i]);
+            }
+            scanNextDir();
+        });
+    }
+
+    if (_index)
+        scanNextDir();
+    else
+        _loadIndexAsync(scanNextDir);
+}
+
+/**
+ * saveIndex:
+ *
+ * Writes the metadata index if it changed, dropping the extensions
+ * that weren't seen since the last save
+ */
+function saveIndex() {
+    if (!_index)
+        return;
+
+    for (let path in _index.extensions) {
+        let entry = _index.extensions[path];
+        if (entry.seen)
+            delete entry.seen;
+        else {
+            delete _index.extensions[path];
+            _indexChanged = true;
+        }
+    }
+
+    if (_indexChanged)
+        _writeIndex();
+}
+
+function _writeIndex() {
+    // Written from an idle, so that it doesn't hold up the caller and
+    // several saves in a row result in a single write
+    if (_indexSaveId)
+        return;
+
+    _indexSaveId = Mainloop.idle_add(function() {
+        _indexSaveId = 0;
+        _indexChanged = false;
+
+        try {
+            let dir = _indexFile.get_parent();
+            if (!dir.query_exists(null))
+                dir.make_directory_with_parents(null);
+            GLib.file_set_contents(_indexFile.get_path(), JSON.stringify(_index));
+        } catch (e) {
+            global.logError('Failed to save the extension index: ' + e);
+        }
+
+        return false;
+    }, GLib.PRIORITY_LOW);
+}
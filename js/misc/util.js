@@ -7,45 +7,37 @@ const Shell = imports.gi.Shell;
 
 const Main = imports.ui.main;
 
-// http://daringfireball.net/2010/07/improved_regex_for_matching_urls
-const _balancedParens = '\\((?:[^\\s()<>]+|(?:\\(?:[^\\s()<>]+\\)))*\\)';
-const _leadingJunk = '[\\s`(\\[{\'\\"<\u00AB\u201C\u2018]';
-const _notTrailingJunk = '[^\\s`!()\\[\\]{};:\'\\".,<>?\u00AB\u00BB\u201C\u201D\u2018\u2019]';
-
-const _urlRegexp = new RegExp(
-    '(^|' + _leadingJunk + ')' +
-    '(' +
-        '(?:' +
-            '[a-z][\\w-]+://' +                   // scheme://
-            '|' +
-            'www\\d{0,3}[.]' +                    // www.
-            '|' +
-            '[a-z0-9.\\-]+[.][a-z]{2,4}/' +       // foo.xx/
-        ')' +
-        '(?:' +                                   // one or more:
-            '[^\\s()<>]+' +                       // run of non-space non-()
-            '|' +                                 // or
-            _balancedParens +                     // balanced parens
-        ')+' +
-        '(?:' +                                   // end with:
-            _balancedParens +                     // balanced parens
-            '|' +                                 // or
-            _notTrailingJunk +                    // last non-junk char
-        ')' +
-    ')', 'gi');
+// findUrls() results for recently seen strings; notifications and chat
+// messages tend to be scanned more than once
+const URL_CACHE_SIZE = 100;
+let _urlCache = {};
+let _urlCacheSize = 0;
 
 // findUrls:
 // @str: string to find URLs in
 //
 // Searches @str for URLs and returns an array of objects with %url
 // properties showing the matched URL string, and %pos properties indicating
-// the position within @str where the URL was found.
+// the position within @str where the URL was found. The matches are
+// sorted by position and don't overlap.
 //
 // Return value: the list of match objects, as described above
 function findUrls(str) {
-    let res = [], match;
-    while ((match = _urlRegexp.exec(str)))
-        res.push({ url: match[2], pos: match.index + match[1].length });
+    if (_urlCache.hasOwnProperty(str))
+        return _urlCache[str];
+
+    let offsets = Shell.util_find_urls(str) || [];
+    let res = [];
+    for (let i = 0; i < offsets.length; i += 2)
+        res.push({ url: str.substring(offsets[i], offsets[i + 1]), pos: offsets[i] });
+
+    if (_urlCacheSize >= URL_CACHE_SIZE) {
+        _urlCache = {};
+        _urlCacheSize = 0;
+    }
+    _urlCache[str] = res;
+    _urlCacheSize++;
+
     return res;
 }
 
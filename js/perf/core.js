@@ -50,7 +50,13 @@ let METRICS = {
       units: "us" },
     applicationsShowTimeSubsequent:
     { description: "Time to switch to applications view, second time",
-      units: "us"}
+      units: "us"},
+    startupTime:
+    { description: "Time to set up the user interface at startup",
+      units: "us" },
+    deferredStartupTime:
+    { description: "Time until the subsystems deferred at startup are set up",
+      units: "us" }
 };
 
 let WINDOW_CONFIGS = [
@@ -132,6 +138,19 @@ let firstOverviewUsedSize;
 let haveSwapComplete = false;
 let applicationsShowStart;
 let applicationsShowCount = 0;
+let startupStart;
+
+function startup_start(time) {
+    startupStart = time;
+}
+
+function startup_done(time) {
+    METRICS.startupTime.value = time - startupStart;
+}
+
+function startup_deferredDone(time) {
+    METRICS.deferredStartupTime.value = time - startupStart;
+}
 
 function script_overviewShowStart(time) {
     showingOverview = true;
@@ -0,0 +1,144 @@
+// -*- mode: js; js-indent-level: 4; indent-tabs-mode: nil -*-
+
+const Lang = imports.lang;
+const St = imports.gi.St;
+
+const Main = imports.ui.main;
+const MessageTray = imports.ui.messageTray;
+const Scripting = imports.ui.scripting;
+
+// This performance script measures how the message tray copes with the
+// number of sources and notifications piling up over a long session
+// with chat and build bot notifications: how much memory they use and
+// how long it takes to lay out the summary and a notification stack.
+
+let METRICS = {
+    addNotificationsTime:
+    { description: "Time to add 100 sources with 50 notifications each",
+      units: "us" },
+    usedByNotifications:
+    { description: "Malloc'ed bytes used by 100 sources with 50 notifications each",
+      units: "B" },
+    summaryShowTime:
+    { description: "Time to show the summary with 100 sources",
+      units: "us" },
+    stackShowTime:
+    { description: "Time to show the notification stack of a source with 50 notifications",
+      units: "us" }
+};
+
+const N_SOURCES = 100;
+const N_NOTIFICATIONS = 50;
+
+const PerfSource = new Lang.Class({
+    Name: 'PerfSource',
+    Extends: MessageTray.Source,
+
+    _init: function(title) {
+        this.parent(title);
+
+        this._setSummaryIcon(this.createNotificationIcon());
+    },
+
+    createNotificationIcon: function() {
+        return new St.Icon({ icon_name: 'dialog-information',
+                             icon_type: St.IconType.SYMBOLIC,
+                             icon_size: this.ICON_SIZE });
+    }
+});
+
+function _addSources() {
+    let sources = [];
+
+    for (let i = 0; i < N_SOURCES; i++) {
+        let source = new PerfSource('Source ' + i);
+        Main.messageTray.add(source);
+
+        for (let j = 0; j < N_NOTIFICATIONS; j++) {
+            let notification = new MessageTray.Notification(source,
+                                                             'Build ' + j + ' finished',
+                                                             'All tests passed for build ' + j);
+            source.pushNotification(notification);
+        }
+
+        sources.push(source);
+    }
+
+    return sources;
+}
+
+function run() {
+    Scripting.defineScriptEvent("notificationsStart", "Starting to add sources and notifications");
+    Scripting.defineScriptEvent("notificationsDone", "Done adding sources and notifications");
+    Scripting.defineScriptEvent("summaryShowStart", "Starting to show the summary");
+    Scripting.defineScriptEvent("summaryShowDone", "Done showing the summary");
+    Scripting.defineScriptEvent("stackShowStart", "Starting to show a notification stack");
+    Scripting.defineScriptEvent("stackShowDone", "Done showing a notification stack");
+
+    yield Scripting.sleep(1000);
+    yield Scripting.waitLeisure();
+
+    global.gc();
+    Scripting.collectStatistics();
+    Scripting.scriptEvent('notificationsStart');
+    let sources = _addSources();
+    yield Scripting.waitLeisure();
+    global.gc();
+    Scripting.collectStatistics();
+    Scripting.scriptEvent('notificationsDone');
+
+    Scripting.scriptEvent('summaryShowStart');
+    Main.messageTray.toggle();
+    yield Scripting.waitLeisure();
+    Scripting.scriptEvent('summaryShowDone');
+
+    let summaryItem = Main.messageTray._summaryItems[0];
+    Scripting.scriptEvent('stackShowStart');
+    Main.messageTray._onSummaryItemClicked(summaryItem, 1);
+    yield Scripting.waitLeisure();
+    Scripting.scriptEvent('stackShowDone');
+
+    Main.messageTray.toggle();
+    yield Scripting.waitLeisure();
+
+    for (let i = 0; i < sources.length; i++)
+        sources[i].destroy();
+
+    yield Scripting.sleep(1000);
+}
+
+let mallocUsedSize = 0;
+let notificationsStartUsedSize;
+let notificationsStart;
+let summaryShowStart;
+let stackShowStart;
+
+function script_notificationsStart(time) {
+    notificationsStart = time;
+    notificationsStartUsedSize = mallocUsedSize;
+}
+
+function script_notificationsDone(time) {
+    METRICS.addNotificationsTime.value = time - notificationsStart;
+    METRICS.usedByNotifications.value = mallocUsedSize - notificationsStartUsedSize;
+}
+
+function script_summaryShowStart(time) {
+    summaryShowStart = time;
+}
+
+function script_summaryShowDone(time) {
+    METRICS.summaryShowTime.value = time - summaryShowStart;
+}
+
+function script_stackShowStart(time) {
+    stackShowStart = time;
+}
+
+function script_stackShowDone(time) {
+    METRICS.stackShowTime.value = time - stackShowStart;
+}
+
+function malloc_usedSize(time, bytes) {
+    mallocUsedSize = bytes;
+}
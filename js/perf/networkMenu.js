@@ -0,0 +1,121 @@
+// -*- mode: js; js-indent-level: 4; indent-tabs-mode: nil -*-
+
+const Clutter = imports.gi.Clutter;
+const St = imports.gi.St;
+
+const Main = imports.ui.main;
+const Network = imports.ui.status.network;
+const PopupMenu = imports.ui.popupMenu;
+const Scripting = imports.ui.scripting;
+
+// This performance script measures how long it takes to lay out a
+// network menu with lots of access points, as found in a crowded
+// conference hall. The access points are fake, so this works without
+// any wireless device; the menu items are the real ones.
+//
+// Only the public menu item API is used, so that the script runs
+// unchanged against the JS layout of PopupBaseMenuItem from before
+// StMenuLayout, for comparing the two with gnome-shell --perf=networkMenu.
+
+let METRICS = {
+    menuOpenTime:
+    { description: "Time to open a network menu with 100 access points",
+      units: "us" },
+    menuAllocateTime:
+    { description: "Time to size and allocate a network menu with 100 access points",
+      units: "us" }
+};
+
+const N_ACCESS_POINTS = 100;
+const N_ALLOCATIONS = 20;
+
+function _createAccessPoint(i) {
+    return { strength: (i * 37) % 100,
+             mode: 0,
+             _secType: i % 3 ? Network.NMAccessPointSecurity.WPA2_PSK
+                             : Network.NMAccessPointSecurity.NONE,
+             connect: function() { return 0; },
+             disconnect: function() { } };
+}
+
+function _createMenu() {
+    let menu = new PopupMenu.PopupMenu(Main.panel.actor, 0.0, St.Side.TOP);
+    Main.uiGroup.add_actor(menu.actor);
+    menu.actor.hide();
+
+    for (let i = 0; i < N_ACCESS_POINTS; i++) {
+        let item = new Network.NMNetworkMenuItem([_createAccessPoint(i)],
+                                                 'Access Point ' + i);
+        if (i % 10 == 0)
+            item.setShowDot(true);
+        menu.addMenuItem(item);
+    }
+
+    return menu;
+}
+
+function _allocateMenu(menu) {
+    let items = menu._getMenuItems();
+    let box = new Clutter.ActorBox();
+
+    for (let i = 0; i < N_ALLOCATIONS; i++) {
+        // Make every item compute its size again
+        for (let j = 0; j < items.length; j++)
+            items[j].actor.queue_relayout();
+
+        let [minWidth, natWidth] = menu.actor.get_preferred_width(-1);
+        let [minHeight, natHeight] = menu.actor.get_preferred_height(natWidth);
+        box.x1 = 0;
+        box.y1 = 0;
+        box.x2 = natWidth;
+        box.y2 = natHeight;
+        menu.actor.allocate(box, 0);
+    }
+
+    menu.actor.queue_relayout();
+}
+
+function run() {
+    Scripting.defineScriptEvent("menuOpenStart", "Starting to open the network menu");
+    Scripting.defineScriptEvent("menuOpenDone", "Done opening the network menu");
+    Scripting.defineScriptEvent("menuAllocateStart", "Starting to allocate the network menu");
+    Scripting.defineScriptEvent("menuAllocateDone", "Done allocating the network menu");
+
+    yield Scripting.sleep(1000);
+    yield Scripting.waitLeisure();
+
+    let menu = _createMenu();
+
+    Scripting.scriptEvent('menuOpenStart');
+    menu.open(false);
+    yield Scripting.waitLeisure();
+    Scripting.scriptEvent('menuOpenDone');
+
+    Scripting.scriptEvent('menuAllocateStart');
+    _allocateMenu(menu);
+    Scripting.scriptEvent('menuAllocateDone');
+
+    menu.close(false);
+    menu.destroy();
+
+    yield Scripting.sleep(1000);
+}
+
+let menuOpenStart;
+let menuAllocateStart;
+
+function script_menuOpenStart(time) {
+    menuOpenStart = time;
+}
+
+function script_menuOpenDone(time) {
+    METRICS.menuOpenTime.value = time - menuOpenStart;
+}
+
+function script_menuAllocateStart(time) {
+    menuAllocateStart = time;
+}
+
+function script_menuAllocateDone(time) {
+    METRICS.menuAllocateTime.value = (time - menuAllocateStart) / N_ALLOCATIONS;
+}
@@ -0,0 +1,96 @@
+// -*- mode: js; js-indent-level: 4; indent-tabs-mode: nil -*-
+
+const Gio = imports.gi.Gio;
+const GLib = imports.gi.GLib;
+
+const Scripting = imports.ui.scripting;
+
+// This performance script measures how quickly the notification daemon
+// handles a flood of notifications carrying image data, as sent by chat
+// clients with an avatar for every message. The notifications go through
+// the session bus just like those from other applications.
+
+let METRICS = {
+    notificationsTime:
+    { description: "Time to send 1000 notifications with image data and get replies",
+      units: "us" }
+};
+
+const N_NOTIFICATIONS = 1000;
+const IMAGE_SIZE = 256;
+
+function _createImageData() {
+    let rowStride = IMAGE_SIZE * 4;
+    let data = [];
+
+    for (let y = 0; y < IMAGE_SIZE; y++) {
+        for (let x = 0; x < IMAGE_SIZE; x++)
+            data.push(x, y, (x + y) % 256, 255);
+    }
+
+    return GLib.Variant.new('(iiibiiay)', [IMAGE_SIZE, IMAGE_SIZE, rowStride,
+                                           true, 8, 4, data]);
+}
+
+// Sends all the notifications at once and returns something to yield
+// on until all of them have been replied to
+function _sendNotifications(imageData, ids) {
+    let cb;
+
+    for (let i = 0; i < N_NOTIFICATIONS; i++) {
+        let params = GLib.Variant.new('(susssasa{sv}i)',
+                                      ['Performance Test', 0, '',
+                                       'Message ' + i, 'Hello', [],
+                                       { 'image-data': imageData }, -1]);
+        Gio.DBus.session.call('org.freedesktop.Notifications',
+                              '/org/freedesktop/Notifications',
+                              'org.freedesktop.Notifications',
+                              'Notify', params, null,
+                              Gio.DBusCallFlags.NONE, -1, null,
+                              function(connection, result) {
+                                  let [id] = connection.call_finish(result).deep_unpack();
+                                  ids.push(id);
+                                  if (ids.length == N_NOTIFICATIONS && cb)
+                                      cb();
+                              });
+    }
+
+    return function(callback) {
+        cb = callback;
+    };
+}
+
+function run() {
+    Scripting.defineScriptEvent("notificationsStart", "Starting to send notifications");
+    Scripting.defineScriptEvent("notificationsDone", "All notifications were replied to");
+
+    let imageData = _createImageData();
+    let ids = [];
+
+    yield Scripting.sleep(1000);
+    yield Scripting.waitLeisure();
+
+    Scripting.scriptEvent('notificationsStart');
+    yield _sendNotifications(imageData, ids);
+    yield Scripting.waitLeisure();
+    Scripting.scriptEvent('notificationsDone');
+
+    for (let i = 0; i < ids.length; i++)
+        Gio.DBus.session.call('org.freedesktop.Notifications',
+                              '/org/freedesktop/Notifications',
+                              'org.freedesktop.Notifications',
+                              'CloseNotification', GLib.Variant.new('(u)', [ids[i]]), null,
+                              Gio.DBusCallFlags.NONE, -1, null, null);
+
+    yield Scripting.sleep(1000);
+}
+
+let notificationsStart;
+
+function script_notificationsStart(time) {
+    notificationsStart = time;
+}
+
+function script_notificationsDone(time) {
+    METRICS.notificationsTime.value = time - notificationsStart;
+}
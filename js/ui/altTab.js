@@ -990,7 +990,7 @@ const AppSwitcher = new Lang.Class({
 
     _enterItem: function(index) {
         let [x, y, mask] = global.get_pointer();
-        let pickedActor = global.stage.get_actor_at_pos(Clutter.PickMode.ALL, x, y);
+        let pickedActor = Shell.hit_test_actor_at_pos(global.stage, Clutter.PickMode.ALL, x, y);
         if (this._items[index].contains(pickedActor))
             this._itemEntered(index);
     },
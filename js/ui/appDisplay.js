@@ -38,11 +38,15 @@ const AlphabeticalView = new Lang.Class({
     Name: 'AlphabeticalView',
 
     _init: function() {
-        this._grid = new IconGrid.IconGrid({ xAlign: St.Align.START });
+        // Icons are only created for the applications scrolled into
+        // view, and reused for others as the view is scrolled
+        this._grid = new IconGrid.IconGrid({ xAlign: St.Align.START,
+                                             createItem: Lang.bind(this, this._createAppIcon),
+                                             updateItem: Lang.bind(this, this._updateAppIcon) });
         this._appSystem = Shell.AppSystem.get_default();
 
         this._pendingAppLaterId = 0;
-        this._appIcons = {}; // desktop file id
+        this._apps = [];
 
         let box = new St.BoxLayout({ vertical: true });
         box.add(this._grid.actor, { y_align: St.Align.START, expand: true });
@@ -53,6 +57,7 @@ const AlphabeticalView = new Lang.Class({
                                          style_class: 'vfade' });
         this.actor.add_actor(box);
         this.actor.set_policy(Gtk.PolicyType.NEVER, Gtk.PolicyType.AUTOMATIC);
+        this._grid.setScrollView(this.actor);
         this.actor.connect('notify::mapped', Lang.bind(this,
             function() {
                 if (!this.actor.mapped)
@@ -67,19 +72,15 @@ const AlphabeticalView = new Lang.Class({
             }));
     },
 
-    _removeAll: function() {
-        this._grid.removeAll();
-        this._appIcons = {};
-    },
-
-    _addApp: function(app) {
-        var id = app.get_id();
+    _createAppIcon: function(app) {
         let appIcon = new AppWellIcon(app);
-
-        this._grid.addItem(appIcon.actor);
         appIcon.actor.connect('key-focus-in', Lang.bind(this, this._ensureIconVisible));
 
-        this._appIcons[id] = appIcon;
+        return appIcon.actor;
+    },
+
+    _updateAppIcon: function(actor, app) {
+        actor._delegate.setApp(app);
     },
 
     _ensureIconVisible: function(icon) {
@@ -110,31 +111,21 @@ const AlphabeticalView = new Lang.Class({
 
     setVisibleApps: function(apps) {
         if (apps == null) { // null implies "all"
-            for (var id in this._appIcons) {
-                var icon = this._appIcons[id];
-                icon.actor.visible = true;
-            }
+            this._grid.setItems(this._apps);
         } else {
-            // Set everything to not-visible, then set to visible what we should see
-            for (var id in this._appIcons) {
-                var icon = this._appIcons[id];
-                icon.actor.visible = false;
-            }
-            for (var i = 0; i < apps.length; i++) {
-                var app = apps[i];
-                var id = app.get_id();
-                var icon = this._appIcons[id];
-                icon.actor.visible = true;
-            }
+            // Keep the order of the full list
+            let visible = {};
+            for (let i = 0; i < apps.length; i++)
+                visible[apps[i].get_id()] = true;
+            this._grid.setItems(this._apps.filter(function(app) {
+                return visible[app.get_id()];
+            }));
         }
     },
 
     setAppList: function(apps) {
-        this._removeAll();
-        for (var i = 0; i < apps.length; i++) {
-            var app = apps[i];
-            this._addApp(app);
-         }
+        this._apps = apps;
+        this._grid.setItems(apps);
     }
 });
 
@@ -409,6 +400,11 @@ const AppSearchProvider = new Lang.Class({
         let app = resultMeta['id'];
         let icon = new AppWellIcon(app);
         return icon.actor;
+    },
+
+    updateResultActor: function (actor, resultMeta, terms) {
+        // The icon only depends on the result's id
+        return true;
     }
 });
 
@@ -460,6 +456,11 @@ const SettingsSearchProvider = new Lang.Class({
         let app = resultMeta['id'];
         let icon = new AppWellIcon(app);
         return icon.actor;
+    },
+
+    updateResultActor: function (actor, resultMeta, terms) {
+        // The icon only depends on the result's id
+        return true;
     }
 });
 
@@ -477,6 +478,15 @@ const AppIcon = new Lang.Class({
 
     createIcon: function(iconSize) {
         return this.app.create_icon_texture(iconSize);
+    },
+
+    setApp: function(app) {
+        this.app = app;
+        if (this.label)
+            this.label.text = app.get_name();
+        // Otherwise the icon is created once the style is known
+        if (this.icon)
+            this._createIconTexture(this.iconSize);
     }
 });
 
@@ -539,6 +549,34 @@ const AppWellIcon = new Lang.Class({
         this._removeMenuTimeout();
     },
 
+    // setApp:
+    // @app: a #ShellApp
+    //
+    // Makes the icon show @app instead, so that views with many
+    // applications can reuse icons rather than create new ones
+    setApp: function(app) {
+        if (app == this.app)
+            return;
+
+        this._removeMenuTimeout();
+        if (this._menu)
+            this._menu.close();
+
+        if (this._stateChangedId > 0)
+            this.app.disconnect(this._stateChangedId);
+        this.app = app;
+        this.icon.setApp(app);
+        this._stateChangedId = this.app.connect('notify::state',
+                                                Lang.bind(this,
+                                                          this._onStateChanged));
+        this._onStateChanged();
+    },
+
+    // Called by virtualized icon grids, see IconGrid.setItems()
+    setPriority: function(priority) {
+        this.icon.setPriority(priority);
+    },
+
     _removeMenuTimeout: function() {
         if (this._menuTimeoutId > 0) {
             Mainloop.source_remove(this._menuTimeoutId);
@@ -181,6 +181,11 @@ const ContactSearchProvider = new Lang.Class({
         return contact.actor;
     },
 
+    updateResultActor: function(actor, resultMeta, terms) {
+        // The contact only depends on the result's id
+        return true;
+    },
+
     createResultContainerActor: function() {
         let grid = new IconGrid.IconGrid({ rowLimit: MAX_SEARCH_RESULTS_ROWS,
                                              xAlign: St.Align.START });
@@ -103,7 +103,7 @@ const DateMenuButton = new Lang.Class({
         item = this.menu.addSettingsAction(_("Date and Time Settings"), 'gnome-datetime-panel.desktop');
         if (item) {
             let separator = new PopupMenu.PopupSeparatorMenuItem();
-            separator.setColumnWidths(1);
+            separator.setColumnWidths([]);
             vbox.add(separator.actor, {y_align: St.Align.END, expand: true, y_fill: false});
 
             item.actor.can_focus = false;
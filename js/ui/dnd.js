@@ -348,8 +348,9 @@ const _Draggable = new Lang.Class({
             this._dragActor.set_position(stageX + this._dragOffsetX,
                                          stageY + this._dragOffsetY);
 
-            let target = this._dragActor.get_stage().get_actor_at_pos(Clutter.PickMode.ALL,
-                                                                      stageX, stageY);
+            let target = Shell.hit_test_actor_at_pos(this._dragActor.get_stage(),
+                                                     Clutter.PickMode.ALL,
+                                                     stageX, stageY);
 
             // We call observers only once per motion with the innermost
             // target actor. If necessary, the observer can walk the
@@ -397,8 +398,9 @@ const _Draggable = new Lang.Class({
 
     _dragActorDropped: function(event) {
         let [dropX, dropY] = event.get_coords();
-        let target = this._dragActor.get_stage().get_actor_at_pos(Clutter.PickMode.ALL,
-                                                                  dropX, dropY);
+        let target = Shell.hit_test_actor_at_pos(this._dragActor.get_stage(),
+                                                 Clutter.PickMode.ALL,
+                                                 dropX, dropY);
 
         // We call observers only once per motion with the innermost
         // target actor. If necessary, the observer can walk the
@@ -81,6 +81,12 @@ function init() {
             St.set_slow_down_factor(factor);
     }
 
+    // For comparing frame rates with and without cached renderings
+    if (GLib.getenv('GNOME_SHELL_DISABLE_CACHE_EFFECTS'))
+        St.cache_effect_set_enabled(false);
+    if (GLib.getenv('GNOME_SHELL_DEBUG_CACHE_EFFECTS'))
+        St.cache_effect_set_debug(true);
+
     // OK, now things are initialized enough that we can import shell JS
     const Format = imports.misc.format;
     const Tweener = imports.ui.tweener;
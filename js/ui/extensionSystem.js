@@ -1,6 +1,7 @@
 // -*- mode: js; js-indent-level: 4; indent-tabs-mode: nil -*-
 
 const Lang = imports.lang;
+const Mainloop = imports.mainloop;
 const Signals = imports.signals;
 
 const Clutter = imports.gi.Clutter;
@@ -58,6 +59,13 @@ var enabledExtensions;
 // Contains the order that extensions were enabled in.
 const extensionOrder = [];
 
+// Extensions found by loadExtensions() that are still to be loaded.
+// They are loaded one per idle callback, so that the shell doesn't
+// wait for all of them before becoming interactive.
+let _pendingExtensions = [];
+let _loadExtensionsId = 0;
+let _scanFinished = false;
+
 // We don't really have a class to add signals on. So, create
 // a simple dummy object, add the signal methods, and export those
 // publically.
@@ -244,7 +252,7 @@ function logExtensionError(uuid, message, state) {
                                                state: state });
 }
 
-function loadExtension(dir, type, enabled) {
+function loadExtension(dir, type, enabled, info) {
     let uuid = dir.get_basename();
     let extension;
 
@@ -254,7 +262,7 @@ function loadExtension(dir, type, enabled) {
     }
 
     try {
-        extension = ExtensionUtils.createExtensionObject(uuid, dir, type);
+        extension = ExtensionUtils.createExtensionObject(uuid, dir, type, info);
     } catch(e) {
         logExtensionError(uuid, e.message);
         return;
@@ -379,10 +387,40 @@ function init() {
     enabledExtensions = global.settings.get_strv(ENABLED_EXTENSIONS_KEY);
 }
 
-function loadExtensions() {
-    ExtensionUtils.scanExtensions(function(uuid, dir, type) {
+function _queueLoadExtensions() {
+    if (_loadExtensionsId == 0)
+        _loadExtensionsId = Mainloop.idle_add(_loadNextExtension);
+}
+
+function _loadNextExtension() {
+    let pending = _pendingExtensions.shift();
+
+    if (pending) {
+        let uuid = pending.dir.get_basename();
         let enabled = enabledExtensions.indexOf(uuid) != -1;
-        loadExtension(dir, type, enabled);
+        let perfLog = Shell.PerfLog.get_default();
+
+        perfLog.event_s('extensions.loadStart', uuid);
+        loadExtension(pending.dir, pending.type, enabled, pending.info);
+        perfLog.event_s('extensions.loadDone', uuid);
+    }
+
+    if (_pendingExtensions.length > 0)
+        return true;
+
+    _loadExtensionsId = 0;
+    if (_scanFinished)
+        ExtensionUtils.saveIndex();
+    return false;
+}
+
+function loadExtensions() {
+    ExtensionUtils.scanExtensionsAsync(function(uuid, dir, type, info) {
+        _pendingExtensions.push({ dir: dir, type: type, info: info });
+        _queueLoadExtensions();
+    }, function() {
+        _scanFinished = true;
+        _queueLoadExtensions();
     });
 }
 
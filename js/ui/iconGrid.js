@@ -1,6 +1,7 @@
 // -*- mode: js; js-indent-level: 4; indent-tabs-mode: nil -*-
 
 const Clutter = imports.gi.Clutter;
+const Meta = imports.gi.Meta;
 const Shell = imports.gi.Shell;
 const St = imports.gi.St;
 
@@ -9,6 +10,11 @@ const Params = imports.misc.params;
 
 const ICON_SIZE = 48;
 
+// Rows of items created above and below the visible part of a
+// virtualized grid, so that scrolling a little or moving the
+// keyboard focus to the next row finds its items already there
+const VIRTUAL_PREFETCH_ROWS = 2;
+
 
 const BaseIcon = new Lang.Class({
     Name: 'BaseIcon',
@@ -52,6 +58,7 @@ const BaseIcon = new Lang.Class({
         this._setSizeManually = params.setSizeManually;
 
         this.icon = null;
+        this._priority = St.TextureCachePriority.VISIBLE;
     },
 
     _allocate: function(actor, box, flags) {
@@ -120,11 +127,27 @@ const BaseIcon = new Lang.Class({
         this._createIconTexture(size);
     },
 
+    // setPriority:
+    // @priority: a #StTextureCachePriority
+    //
+    // Sets how urgently the icon is needed, if it is still being
+    // loaded by the texture cache
+    setPriority: function(priority) {
+        if (priority == this._priority)
+            return;
+
+        this._priority = priority;
+        if (this.icon)
+            St.TextureCache.get_default().set_priority(this.icon, priority);
+    },
+
     _createIconTexture: function(size) {
         if (this.icon)
             this.icon.destroy();
         this.iconSize = size;
         this.icon = this.createIcon(this.iconSize);
+        if (this._priority != St.TextureCachePriority.VISIBLE)
+            St.TextureCache.get_default().set_priority(this.icon, this._priority);
 
         this._iconBin.child = this.icon;
 
@@ -156,11 +179,24 @@ const IconGrid = new Lang.Class({
     _init: function(params) {
         params = Params.parse(params, { rowLimit: null,
                                         columnLimit: null,
-                                        xAlign: St.Align.MIDDLE });
+                                        xAlign: St.Align.MIDDLE,
+                                        createItem: null,
+                                        updateItem: null });
         this._rowLimit = params.rowLimit;
         this._colLimit = params.columnLimit;
         this._xAlign = params.xAlign;
 
+        // Virtualized mode, see setItems()
+        this._createItem = params.createItem;
+        this._updateItem = params.updateItem;
+        this._items = [];
+        this._itemActors = {};
+        this._firstItem = this._lastItem = -1;
+        this._firstVisibleItem = this._lastVisibleItem = -1;
+        this._nColumns = 0;
+        this._scrollView = null;
+        this._virtualUpdateQueued = false;
+
         this.actor = new St.BoxLayout({ style_class: 'icon-grid',
                                         vertical: true });
         // Pulled from CSS, but hardcode some defaults here
@@ -176,10 +212,10 @@ const IconGrid = new Lang.Class({
     },
 
     _getPreferredWidth: function (grid, forHeight, alloc) {
-        let children = this._grid.get_children();
-        let nColumns = this._colLimit ? Math.min(this._colLimit,
-                                                 children.length)
-                                      : children.length;
+        let nItems = this._createItem ? this._items.length
+                                      : this._grid.get_children().length;
+        let nColumns = this._colLimit ? Math.min(this._colLimit, nItems)
+                                      : nItems;
         let totalSpacing = Math.max(0, nColumns - 1) * this._spacing;
         // Kind of a lie, but not really an issue right now.  If
         // we wanted to support some sort of hidden/overflow that would
@@ -197,11 +233,16 @@ const IconGrid = new Lang.Class({
     },
 
     _getPreferredHeight: function (grid, forWidth, alloc) {
-        let children = this._getVisibleChildren();
+        let nItems = this._createItem ? this._items.length
+                                      : this._getVisibleChildren().length;
         let [nColumns, usedWidth] = this._computeLayout(forWidth);
+        // Known before the allocation, so that the items can be
+        // created in time for it
+        if (this._createItem && forWidth >= 0)
+            this._nColumns = nColumns;
         let nRows;
         if (nColumns > 0)
-            nRows = Math.ceil(children.length / nColumns);
+            nRows = Math.ceil(nItems / nColumns);
         else
             nRows = 0;
         if (this._rowLimit)
@@ -213,7 +254,6 @@ const IconGrid = new Lang.Class({
     },
 
     _allocate: function (grid, box, flags) {
-        let children = this._getVisibleChildren();
         let availWidth = box.x2 - box.x1;
         let availHeight = box.y2 - box.y1;
 
@@ -231,35 +271,21 @@ const IconGrid = new Lang.Class({
                 leftPadding = availWidth - usedWidth;
         }
 
+        if (this._createItem) {
+            this._allocateItems(box, leftPadding, nColumns, flags);
+            return;
+        }
+
+        let children = this._getVisibleChildren();
         let x = box.x1 + leftPadding;
         let y = box.y1;
         let columnIndex = 0;
         let rowIndex = 0;
         for (let i = 0; i < children.length; i++) {
-            let [childMinWidth, childMinHeight, childNaturalWidth, childNaturalHeight]
-                = children[i].get_preferred_size();
-
-            /* Center the item in its allocation horizontally */
-            let width = Math.min(this._hItemSize, childNaturalWidth);
-            let childXSpacing = Math.max(0, width - childNaturalWidth) / 2;
-            let height = Math.min(this._vItemSize, childNaturalHeight);
-            let childYSpacing = Math.max(0, height - childNaturalHeight) / 2;
-
-            let childBox = new Clutter.ActorBox();
-            if (Clutter.get_default_text_direction() == Clutter.TextDirection.RTL) {
-                let _x = box.x2 - (x + width);
-                childBox.x1 = Math.floor(_x - childXSpacing);
-            } else {
-                childBox.x1 = Math.floor(x + childXSpacing);
-            }
-            childBox.y1 = Math.floor(y + childYSpacing);
-            childBox.x2 = childBox.x1 + width;
-            childBox.y2 = childBox.y1 + height;
-
             if (this._rowLimit && rowIndex >= this._rowLimit) {
                 this._grid.set_skip_paint(children[i], true);
             } else {
-                children[i].allocate(childBox, flags);
+                this._allocateChild(children[i], box, x, y, flags);
                 this._grid.set_skip_paint(children[i], false);
             }
 
@@ -278,6 +304,197 @@ const IconGrid = new Lang.Class({
         }
     },
 
+    _allocateChild: function(child, box, x, y, flags) {
+        let [childMinWidth, childMinHeight, childNaturalWidth, childNaturalHeight]
+            = child.get_preferred_size();
+
+        /* Center the item in its allocation horizontally */
+        let width = Math.min(this._hItemSize, childNaturalWidth);
+        let childXSpacing = Math.max(0, width - childNaturalWidth) / 2;
+        let height = Math.min(this._vItemSize, childNaturalHeight);
+        let childYSpacing = Math.max(0, height - childNaturalHeight) / 2;
+
+        let childBox = new Clutter.ActorBox();
+        if (Clutter.get_default_text_direction() == Clutter.TextDirection.RTL) {
+            let _x = box.x2 - (x + width);
+            childBox.x1 = Math.floor(_x - childXSpacing);
+        } else {
+            childBox.x1 = Math.floor(x + childXSpacing);
+        }
+        childBox.y1 = Math.floor(y + childYSpacing);
+        childBox.x2 = childBox.x1 + width;
+        childBox.y2 = childBox.y1 + height;
+
+        child.allocate(childBox, flags);
+    },
+
+    // In virtualized mode only the items that have actors get
+    // allocated, at the position given by their index
+    _allocateItems: function(box, leftPadding, nColumns, flags) {
+        this._nColumns = nColumns;
+        if (nColumns == 0)
+            return;
+
+        for (let index in this._itemActors) {
+            let column = index % nColumns;
+            let row = Math.floor(index / nColumns);
+            let x = box.x1 + leftPadding + column * (this._hItemSize + this._spacing);
+            let y = box.y1 + row * (this._vItemSize + this._spacing);
+
+            this._allocateChild(this._itemActors[index].actor, box, x, y, flags);
+        }
+
+        let [first, last, firstVisible, lastVisible] = this._getVisibleRange();
+        if (first != this._firstItem || last != this._lastItem ||
+            firstVisible != this._firstVisibleItem || lastVisible != this._lastVisibleItem)
+            this._queueUpdateItems();
+    },
+
+    // setItems:
+    // @items: the items to show in the grid
+    //
+    // Only for grids created with the createItem parameter: the layout
+    // is computed from the number of @items, and createItem(item) is
+    // only called for the items in or near the visible part of the
+    // scroll view passed to setScrollView(). Actors of items scrolled
+    // out of view are destroyed, or passed to updateItem(actor, item)
+    // to show another item instead if that parameter was given.
+    setItems: function(items) {
+        this._items = items;
+        this._firstItem = this._lastItem = -1;
+        this._grid.queue_relayout();
+        this._queueUpdateItems();
+    },
+
+    setScrollView: function(scrollView) {
+        this._scrollView = scrollView;
+
+        let adjustment = scrollView.vscroll.adjustment;
+        adjustment.connect('notify::value', Lang.bind(this, this._queueUpdateItems));
+        adjustment.connect('changed', Lang.bind(this, this._queueUpdateItems));
+    },
+
+    // Returns the indices of the first and past the last item that
+    // should have actors, followed by those of the items actually
+    // on screen
+    _getVisibleRange: function() {
+        // Before the first layout, assume that the grid is as wide as
+        // the stage, so that the first frame shows the items at the
+        // top rather than nothing; the allocation corrects the range
+        let nColumns = this._nColumns || this._computeLayout(global.stage.width)[0];
+        if (nColumns == 0)
+            return [0, 0, 0, 0];
+
+        let nRows = Math.ceil(this._items.length / nColumns);
+        if (this._rowLimit)
+            nRows = Math.min(nRows, this._rowLimit);
+
+        let firstRow = 0;
+        let lastRow = nRows;
+        let firstVisibleRow = 0;
+        let lastVisibleRow = nRows;
+        if (this._scrollView) {
+            let adjustment = this._scrollView.vscroll.adjustment;
+            let scrolledActor = this._scrollView.get_child();
+            let offset = 0;
+            for (let actor = this._grid; actor && actor != scrolledActor; actor = actor.get_parent())
+                offset += actor.get_allocation_box().y1;
+
+            let top = adjustment.value - offset;
+            let pageSize = adjustment.page_size || global.stage.height;
+            let rowHeight = this._vItemSize + this._spacing;
+            firstVisibleRow = Math.floor(top / rowHeight);
+            lastVisibleRow = Math.ceil((top + pageSize) / rowHeight);
+            firstRow = firstVisibleRow - VIRTUAL_PREFETCH_ROWS;
+            lastRow = lastVisibleRow + VIRTUAL_PREFETCH_ROWS;
+        }
+
+        firstRow = Math.max(0, firstRow);
+        lastRow = Math.min(nRows, lastRow);
+        if (lastRow <= firstRow)
+            return [0, 0, 0, 0];
+
+        let nItems = this._items.length;
+        return [firstRow * nColumns,
+                Math.min(nItems, lastRow * nColumns),
+                Math.max(firstRow, firstVisibleRow) * nColumns,
+                Math.min(nItems, Math.min(lastRow, lastVisibleRow) * nColumns)];
+    },
+
+    _queueUpdateItems: function() {
+        if (this._virtualUpdateQueued)
+            return;
+
+        this._virtualUpdateQueued = true;
+        Meta.later_add(Meta.LaterType.BEFORE_REDRAW, Lang.bind(this,
+            function() {
+                this._virtualUpdateQueued = false;
+                this._updateItems();
+                return false;
+            }));
+    },
+
+    _updateItems: function() {
+        let [first, last, firstVisible, lastVisible] = this._getVisibleRange();
+        if (first == this._firstItem && last == this._lastItem &&
+            firstVisible == this._firstVisibleItem && lastVisible == this._lastVisibleItem)
+            return;
+
+        let focus = global.stage.key_focus;
+        let itemActors = {};
+        let unused = [];
+
+        for (let index in this._itemActors) {
+            let itemActor = this._itemActors[index];
+            let i = parseInt(index);
+
+            // The focused item stays around while it's scrolled out of
+            // view, so that it doesn't change under the keyboard focus
+            if (itemActor.item == this._items[i] &&
+                ((i >= first && i < last) || (focus && itemActor.actor.contains(focus))))
+                itemActors[i] = itemActor;
+            else
+                unused.push(itemActor.actor);
+        }
+
+        for (let i = first; i < last; i++) {
+            if (itemActors[i])
+                continue;
+
+            let actor;
+            if (this._updateItem && unused.length > 0) {
+                actor = unused.pop();
+                this._updateItem(actor, this._items[i]);
+            } else {
+                actor = this._createItem(this._items[i]);
+                this._grid.add_actor(actor);
+            }
+            itemActors[i] = { actor: actor, item: this._items[i] };
+        }
+
+        for (let i = 0; i < unused.length; i++)
+            unused[i].destroy();
+
+        // Icons in the prefetch rows shouldn't hold up the loading of
+        // those on screen; they are raised once scrolled into view
+        for (let index in itemActors) {
+            let delegate = itemActors[index].actor._delegate;
+            if (!delegate || !delegate.setPriority)
+                continue;
+
+            let i = parseInt(index);
+            delegate.setPriority(i >= firstVisible && i < lastVisible ? St.TextureCachePriority.VISIBLE
+                                                                      : St.TextureCachePriority.PREFETCH);
+        }
+
+        this._itemActors = itemActors;
+        this._firstItem = first;
+        this._lastItem = last;
+        this._firstVisibleItem = firstVisible;
+        this._lastVisibleItem = lastVisible;
+        this._grid.queue_relayout();
+    },
+
     childrenInRow: function(rowWidth) {
         return this._computeLayout(rowWidth)[0];
     },
@@ -309,17 +526,28 @@ const IconGrid = new Lang.Class({
         this._grid.get_children().forEach(Lang.bind(this, function (child) {
             child.destroy();
         }));
+        this._items = [];
+        this._itemActors = {};
+        this._firstItem = this._lastItem = -1;
     },
 
     addItem: function(actor) {
         this._grid.add_actor(actor);
     },
 
+    removeItem: function(actor) {
+        this._grid.remove_actor(actor);
+    },
+
     getItemAtIndex: function(index) {
+        if (this._createItem)
+            return this._itemActors[index] ? this._itemActors[index].actor : null;
         return this._grid.get_children()[index];
     },
 
     visibleItemsCount: function() {
+        if (this._createItem)
+            return this._items.length;
         return this._grid.get_children().length - this._grid.get_n_skip_paint();
     }
 });
@@ -72,19 +72,73 @@ let _defaultCssStylesheet = null;
 let _cssStylesheet = null;
 let _gdmCssStylesheet = null;
 let _overridesSettings = null;
+let _deferredStartupPhases = [];
+let _deferredStartupId = 0;
 
 let background = null;
 
+// Runs @func as a named phase of the startup timeline, bracketed by
+// events in the performance log; returns whatever @func returns
+function _startupPhase(name, func) {
+    let perfLog = Shell.PerfLog.get_default();
+
+    perfLog.event_s('startup.phaseStart', name);
+    let result = func();
+    perfLog.event_s('startup.phaseDone', name);
+
+    return result;
+}
+
+function _createSubsystem(name, constructor, params) {
+    return _startupPhase(name, function() {
+        return new constructor(params);
+    });
+}
+
+// Subsystems that aren't needed for the first frame are set up from
+// idle callbacks after startup, one per main loop iteration, so that
+// none of them holds up painting for long
+function _deferStartupPhase(name, func) {
+    _deferredStartupPhases.push({ name: name, func: func });
+
+    if (_deferredStartupId == 0)
+        _deferredStartupId = Mainloop.idle_add(_runDeferredStartupPhase);
+}
+
+function _runDeferredStartupPhase() {
+    let phase = _deferredStartupPhases.shift();
+
+    try {
+        _startupPhase(phase.name, phase.func);
+    } catch (e) {
+        logError(e, 'Failed to set up ' + phase.name);
+    }
+
+    if (_deferredStartupPhases.length > 0)
+        return true;
+
+    _deferredStartupId = 0;
+    Shell.PerfLog.get_default().event('startup.deferredDone');
+    return false;
+}
+
 function _createUserSession() {
     // Load the calendar server. Note that we are careful about
     // not loading any events until the user presses the clock
     global.launch_calendar_server();
 
-    placesManager = new PlaceDisplay.PlacesManager();
-    telepathyClient = new TelepathyClient.Client();
-    automountManager = new AutomountManager.AutomountManager();
-    autorunManager = new AutorunManager.AutorunManager();
-    networkAgent = new NetworkAgent.NetworkAgent();
+    placesManager = _createSubsystem('placesManager', PlaceDisplay.PlacesManager);
+    automountManager = _createSubsystem('automountManager', AutomountManager.AutomountManager);
+
+    _deferStartupPhase('telepathyClient', function() {
+        telepathyClient = new TelepathyClient.Client();
+    });
+    _deferStartupPhase('autorunManager', function() {
+        autorunManager = new AutorunManager.AutorunManager();
+    });
+    _deferStartupPhase('networkAgent', function() {
+        networkAgent = new NetworkAgent.NetworkAgent();
+    });
 }
 
 function _createGDMSession() {
@@ -133,8 +187,10 @@ function _initUserSession() {
 
     global.screen.override_workspace_layout(Meta.ScreenCorner.TOPLEFT, false, -1, 1);
 
-    ExtensionSystem.init();
-    ExtensionSystem.loadExtensions();
+    _startupPhase('extensions', function() {
+        ExtensionSystem.init();
+        ExtensionSystem.loadExtensions();
+    });
 
     Meta.keybindings_set_custom_handler('panel-run-dialog', function() {
        getRunDialog().open();
@@ -155,6 +211,8 @@ function start() {
     global.logError = _logError;
     global.log = _logDebug;
 
+    Shell.PerfLog.get_default().event('startup.start');
+
     // Chain up async errors reported from C
     global.connect('notify-error', function (global, msg, detail) { notifyError(msg, detail); });
 
@@ -207,30 +265,42 @@ function start() {
     global.overlay_group.reparent(uiGroup);
     global.stage.add_actor(uiGroup);
 
-    layoutManager = new Layout.LayoutManager();
-    xdndHandler = new XdndHandler.XdndHandler();
-    ctrlAltTabManager = new CtrlAltTab.CtrlAltTabManager();
+    layoutManager = _createSubsystem('layoutManager', Layout.LayoutManager);
+    xdndHandler = _createSubsystem('xdndHandler', XdndHandler.XdndHandler);
+    ctrlAltTabManager = _createSubsystem('ctrlAltTabManager', CtrlAltTab.CtrlAltTabManager);
     // This overview object is just a stub for non-user sessions
-    overview = new Overview.Overview({ isDummy: global.session_type != Shell.SessionType.USER });
-    magnifier = new Magnifier.Magnifier();
-    statusIconDispatcher = new StatusIconDispatcher.StatusIconDispatcher();
-    panel = new Panel.Panel();
-    wm = new WindowManager.WindowManager();
-    messageTray = new MessageTray.MessageTray();
-    keyboard = new Keyboard.Keyboard();
-    notificationDaemon = new NotificationDaemon.NotificationDaemon();
-    windowAttentionHandler = new WindowAttentionHandler.WindowAttentionHandler();
+    overview = _createSubsystem('overview', Overview.Overview,
+                                { isDummy: global.session_type != Shell.SessionType.USER });
+    statusIconDispatcher = _createSubsystem('statusIconDispatcher', StatusIconDispatcher.StatusIconDispatcher);
+    panel = _createSubsystem('panel', Panel.Panel);
+    wm = _createSubsystem('windowManager', WindowManager.WindowManager);
+    messageTray = _createSubsystem('messageTray', MessageTray.MessageTray);
+    notificationDaemon = _createSubsystem('notificationDaemon', NotificationDaemon.NotificationDaemon);
+    windowAttentionHandler = _createSubsystem('windowAttentionHandler', WindowAttentionHandler.WindowAttentionHandler);
+
+    _deferStartupPhase('magnifier', function() {
+        magnifier = new Magnifier.Magnifier();
+    });
+    _deferStartupPhase('keyboard', function() {
+        keyboard = new Keyboard.Keyboard();
+        keyboard.init();
+    });
 
     if (global.session_type == Shell.SessionType.USER)
         _createUserSession();
     else if (global.session_type == Shell.SessionType.GDM)
         _createGDMSession();
 
-    panel.startStatusArea();
+    _startupPhase('statusArea', function() {
+        panel.startStatusArea();
+    });
 
-    layoutManager.init();
-    keyboard.init();
-    overview.init();
+    _startupPhase('layoutManagerInit', function() {
+        layoutManager.init();
+    });
+    _startupPhase('overviewInit', function() {
+        overview.init();
+    });
 
     if (global.session_type == Shell.SessionType.USER)
         _initUserSession();
@@ -267,6 +337,8 @@ function start() {
     global.screen.connect('restacked', _windowsRestacked);
 
     _nWorkspacesChanged();
+
+    Shell.PerfLog.get_default().event('startup.done');
 }
 
 let _workspaces = [];
@@ -475,6 +547,14 @@ function setThemeStylesheet(cssStylesheet)
     _cssStylesheet = cssStylesheet;
 }
 
+function _loadStylesheet(theme, stylesheet) {
+    let perfLog = Shell.PerfLog.get_default();
+
+    perfLog.event_s('theme.stylesheetLoadStart', stylesheet);
+    theme.load_stylesheet(stylesheet);
+    perfLog.event_s('theme.stylesheetLoadDone', stylesheet);
+}
+
 /**
  * loadTheme:
  *
@@ -488,16 +568,20 @@ function loadTheme() {
     if (_cssStylesheet != null)
         cssStylesheet = _cssStylesheet;
 
+    let perfLog = Shell.PerfLog.get_default();
+
+    perfLog.event_s('theme.stylesheetLoadStart', cssStylesheet);
     let theme = new St.Theme ({ application_stylesheet: cssStylesheet });
+    perfLog.event_s('theme.stylesheetLoadDone', cssStylesheet);
 
     if (global.session_type == Shell.SessionType.GDM)
-        theme.load_stylesheet(_gdmCssStylesheet);
+        _loadStylesheet(theme, _gdmCssStylesheet);
 
     if (previousTheme) {
         let customStylesheets = previousTheme.get_custom_stylesheets();
 
         for (let i = 0; i < customStylesheets.length; i++)
-            theme.load_stylesheet(customStylesheets[i]);
+            _loadStylesheet(theme, customStylesheets[i]);
     }
 
     themeContext.set_theme (theme);
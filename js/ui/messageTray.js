@@ -31,6 +31,10 @@ const LONGER_HIDE_TIMEOUT = 0.6;
 
 const MAX_SOURCE_TITLE_WIDTH = 180;
 
+// Number of notifications added to a summary notification stack at
+// a time; older ones are added when the stack is scrolled to the top.
+const NOTIFICATION_STACK_WINDOW = 10;
+
 // We delay hiding of the tray if the mouse is within MOUSE_LEFT_ACTOR_THRESHOLD
 // range from the point where it left the tray.
 const MOUSE_LEFT_ACTOR_THRESHOLD = 20;
@@ -194,19 +198,24 @@ const URLHighlighter = new Lang.Class({
     _findUrlAtPos: function(event) {
         let success;
         let [x, y] = event.get_coords();
-        [success, x, y] = this.actor.transform_stage_point(x, y);
-        let find_pos = -1;
-        for (let i = 0; i < this.actor.clutter_text.text.length; i++) {
-            let [success, px, py, line_height] = this.actor.clutter_text.position_to_coords(i);
-            if (py > y || py + line_height < y || x < px)
-                continue;
-            find_pos = i;
-        }
-        if (find_pos != -1) {
-            for (let i = 0; i < this._urls.length; i++)
-            if (find_pos >= this._urls[i].pos &&
-                this._urls[i].pos + this._urls[i].url.length > find_pos)
-                return i;
+        [success, x, y] = this.actor.clutter_text.transform_stage_point(x, y);
+        let pos = Shell.util_get_text_offset_at_coords(this.actor.clutter_text, x, y);
+        if (pos == -1)
+            return -1;
+
+        // this._urls is sorted and its ranges don't overlap, so it can
+        // be searched as a table of intervals
+        let min = 0, max = this._urls.length;
+        while (min < max) {
+            let mid = Math.floor((min + max) / 2);
+            let url = this._urls[mid];
+
+            if (pos < url.pos)
+                max = mid;
+            else if (pos >= url.pos + url.url.length)
+                min = mid + 1;
+            else
+                return mid;
         }
         return -1;
     }
@@ -395,7 +404,16 @@ Signals.addSignalMethods(FocusGrabber.prototype);
 //
 // By default, the icon shown is created by calling
 // source.createNotificationIcon(). However, if @params contains an 'icon'
-// parameter, the passed in icon will be used.
+// parameter, the passed in icon will be used. 'icon' can also be a
+// function returning a new icon actor each time it is called.
+//
+// The notification's actors are only created when its actor is first
+// needed, and can be released again with releaseActor() while the
+// notification is not being displayed. Until then, the content passed
+// to update(), addButton() and setImage() is only recorded. Passing
+// actors to addActor(), setActionArea(), setImage() or as the 'icon'
+// parameter, or calling addBody(), which returns the label it adds,
+// makes the notification keep its actors until it is destroyed.
 //
 // If @params contains a 'titleMarkup', 'bannerMarkup', or
 // 'bodyMarkup' parameter with the value %true, then the corresponding
@@ -429,22 +447,49 @@ const Notification = new Lang.Class({
         this._titleDirection = Clutter.TextDirection.DEFAULT;
         this._spacing = 0;
         this._scrollPolicy = Gtk.PolicyType.AUTOMATIC;
+        this._iconVisible = true;
         this._imageBin = null;
+        this._actor = null;
+        this._actorDestroyId = 0;
+        this._pinned = false;
+        this._contentOps = [];
 
         source.connect('destroy', Lang.bind(this,
             function (source, reason) {
                 this.destroy(reason);
             }));
 
-        this.actor = new St.Button({ accessible_role: Atk.Role.NOTIFICATION });
-        this.actor._delegate = this;
-        this.actor.connect('clicked', Lang.bind(this, this._onClicked));
-        this.actor.connect('destroy', Lang.bind(this, this._onDestroy));
+        this.update(title, banner, params);
+    },
+
+    get actor() {
+        this._ensureActor();
+        return this._actor;
+    },
+
+    _ensureActor: function() {
+        if (this._actor || this._destroyed)
+            return;
+
+        this._createActor();
+
+        let ops = this._contentOps;
+        for (let i = 0; i < ops.length; i++)
+            ops[i].func.apply(this, ops[i].args);
+        if (this._pinned)
+            this._contentOps = [];
+    },
+
+    _createActor: function() {
+        this._actor = new St.Button({ accessible_role: Atk.Role.NOTIFICATION });
+        this._actor._delegate = this;
+        this._actor.connect('clicked', Lang.bind(this, this._onClicked));
+        this._actorDestroyId = this._actor.connect('destroy', Lang.bind(this, this._onDestroy));
 
         this._table = new St.Table({ name: 'notification',
                                      reactive: true });
         this._table.connect('style-changed', Lang.bind(this, this._styleChanged));
-        this.actor.set_child(this._table);
+        this._actor.set_child(this._table);
 
         this._buttonFocusManager = St.FocusManager.get_for_stage(global.stage);
 
@@ -477,8 +522,61 @@ const Notification = new Lang.Class({
         this._bannerUrlHighlighter = new URLHighlighter();
         this._bannerLabel = this._bannerUrlHighlighter.actor;
         this._bannerBox.add_actor(this._bannerLabel);
+    },
 
-        this.update(title, banner, params);
+    // releaseActor:
+    //
+    // Destroys the notification's actors if it is not being displayed
+    // and they can be recreated from the recorded content later.
+    //
+    // Return value: %true if the actors were released
+    releaseActor: function() {
+        if (!this._actor || this._pinned || this._destroyed || this.expanded)
+            return false;
+        if (this._actor.get_parent())
+            return false;
+
+        this._actor.disconnect(this._actorDestroyId);
+        this._actorDestroyId = 0;
+        this._actor._delegate = null;
+        this._actor.destroy();
+        this._actor = null;
+
+        this._table = null;
+        this._bannerBox = null;
+        this._titleLabel = null;
+        this._bannerUrlHighlighter = null;
+        this._bannerLabel = null;
+        this._icon = null;
+        this._scrollArea = null;
+        this._contentArea = null;
+        this._actionArea = null;
+        this._buttonBox = null;
+        this._imageBin = null;
+        this._titleFitsInBannerMode = true;
+        return true;
+    },
+
+    // Applies a change to the content of the notification now if it
+    // has an actor, and records it to be replayed on the actors created
+    // later, unless the notification can no longer release its actors.
+    _pushContentOp: function(func, args) {
+        let result = null;
+        if (this._actor)
+            result = func.apply(this, args);
+        if (!this._pinned)
+            this._contentOps.push({ func: func, args: args });
+        return result;
+    },
+
+    // Called for content that can't be recreated: from now on the
+    // notification keeps its actors until it is destroyed.
+    _pin: function() {
+        if (this._pinned)
+            return;
+        this._pinned = true;
+        this._ensureActor();
+        this._contentOps = [];
     },
 
     // update:
@@ -498,6 +596,38 @@ const Notification = new Lang.Class({
                                         bodyMarkup: false,
                                         clear: false });
 
+        if (params.icon && typeof(params.icon) != 'function')
+            this._pin();
+        if (params.clear)
+            this._contentOps = [];
+        else
+            this._dropReplacedUpdates(params);
+
+        this.title = title;
+        this._pushContentOp(this._updateContent, [title, banner, params]);
+    },
+
+    // Forgets the recorded updates that an update with @params entirely
+    // supersedes, so that the record doesn't keep growing when a
+    // notification is updated over and over
+    _dropReplacedUpdates: function(params) {
+        this._contentOps = this._contentOps.filter(function(op) {
+            if (op.func != this._updateContent)
+                return true;
+
+            let oldParams = op.args[2];
+
+            // Updates without an icon keep the current one
+            if (oldParams.icon && !params.icon)
+                return true;
+            // Custom content is kept, anything else is cleared
+            if (params.customContent && (oldParams.body || !oldParams.customContent))
+                return true;
+            return false;
+        }, this);
+    },
+
+    _updateContent: function(title, banner, params) {
         this._customContent = params.customContent;
 
         let oldFocus = global.stage.key_focus;
@@ -527,13 +657,17 @@ const Notification = new Lang.Class({
             this._buttonBox = null;
         }
         if (this._imageBin && params.clear)
-            this.unsetImage();
+            this._unsetImage();
 
         if (!this._scrollArea && !this._actionArea && !this._imageBin)
             this._table.remove_style_class_name('multi-line-notification');
 
         if (!this._icon) {
-            this._icon = params.icon || this.source.createNotificationIcon();
+            if (typeof(params.icon) == 'function')
+                this._icon = params.icon();
+            else
+                this._icon = params.icon || this.source.createNotificationIcon();
+            this._icon.visible = this._iconVisible;
             this._table.add(this._icon, { row: 0,
                                           col: 0,
                                           x_expand: false,
@@ -542,7 +676,6 @@ const Notification = new Lang.Class({
                                           y_align: St.Align.START });
         }
 
-        this.title = title;
         title = title ? _fixMarkup(title.replace(/\n/g, ' '), params.titleMarkup) : '';
         this._titleLabel.clutter_text.set_markup('<b>' + title + '</b>');
 
@@ -576,12 +709,14 @@ const Notification = new Lang.Class({
             this._addBannerBody();
 
         if (params.body)
-            this.addBody(params.body, params.bodyMarkup);
+            this._addBody(params.body, params.bodyMarkup);
         this.updated();
     },
 
     setIconVisible: function(visible) {
-        this._icon.visible = visible;
+        this._iconVisible = visible;
+        if (this._icon)
+            this._icon.visible = visible;
     },
 
     enableScrolling: function(enableScrolling) {
@@ -611,6 +746,11 @@ const Notification = new Lang.Class({
     //
     // Appends @actor to the notification's body
     addActor: function(actor, style) {
+        this._pin();
+        this._addActor(actor, style);
+    },
+
+    _addActor: function(actor, style) {
         if (!this._scrollArea) {
             this._createScrollArea();
         }
@@ -628,9 +768,15 @@ const Notification = new Lang.Class({
     //
     // Return value: the newly-added label
     addBody: function(text, markup, style) {
+        // The caller can hold on to the label, so it can't be recreated
+        this._pin();
+        return this._addBody(text, markup, style);
+    },
+
+    _addBody: function(text, markup, style) {
         let label = new URLHighlighter(text, true, markup);
 
-        this.addActor(label.actor, style);
+        this._addActor(label.actor, style);
         return label.actor;
     },
 
@@ -638,7 +784,7 @@ const Notification = new Lang.Class({
         if (this._bannerBodyText) {
             let text = this._bannerBodyText;
             this._bannerBodyText = null;
-            this.addBody(text, this._bannerBodyMarkup);
+            this._addBody(text, this._bannerBodyMarkup);
         }
     },
 
@@ -661,6 +807,11 @@ const Notification = new Lang.Class({
     // Puts @actor into the action area of the notification, replacing
     // the previous contents
     setActionArea: function(actor, props) {
+        this._pin();
+        this._setActionArea(actor, props);
+    },
+
+    _setActionArea: function(actor, props) {
         if (this._actionArea) {
             this._actionArea.destroy();
             this._actionArea = null;
@@ -691,9 +842,21 @@ const Notification = new Lang.Class({
                                                       col_span: this._imageBin ? 1 : 2 });
     },
 
+    // setImage:
+    // @image: the image actor, or a function returning a new one
+    //
+    // Shows @image next to the notification's content
     setImage: function(image) {
+        if (typeof(image) != 'function')
+            this._pin();
+        this._pushContentOp(this._setImage, [image]);
+    },
+
+    _setImage: function(image) {
+        if (typeof(image) == 'function')
+            image = image();
         if (this._imageBin)
-            this.unsetImage();
+            this._unsetImage();
         this._imageBin = new St.Bin();
         this._imageBin.child = image;
         this._imageBin.opacity = 230;
@@ -711,6 +874,10 @@ const Notification = new Lang.Class({
     },
 
     unsetImage: function() {
+        this._pushContentOp(this._unsetImage, []);
+    },
+
+    _unsetImage: function() {
         if (this._imageBin) {
             this._table.remove_style_class_name('notification-with-image');
             this._table.remove_actor(this._imageBin);
@@ -732,14 +899,18 @@ const Notification = new Lang.Class({
     // If the button is clicked, the notification will emit the
     // %action-invoked signal with @id as a parameter
     addButton: function(id, label) {
+        this._pushContentOp(this._addButton, [id, label]);
+    },
+
+    _addButton: function(id, label) {
         if (!this._buttonBox) {
 
             let box = new St.BoxLayout({ name: 'notification-actions' });
-            this.setActionArea(box, { x_expand: false,
-                                      y_expand: false,
-                                      x_fill: false,
-                                      y_fill: false,
-                                      x_align: St.Align.END });
+            this._setActionArea(box, { x_expand: false,
+                                       y_expand: false,
+                                       x_fill: false,
+                                       y_fill: false,
+                                       x_align: St.Align.END });
             this._buttonBox = box;
         }
 
@@ -853,7 +1024,7 @@ const Notification = new Lang.Class({
             Meta.later_add(Meta.LaterType.BEFORE_REDRAW,
                            Lang.bind(this,
                                      function() {
-                                        if (this._canExpandContent()) {
+                                        if (this._table && this._canExpandContent()) {
                                             this._addBannerBody();
                                             this._table.add_style_class_name('multi-line-notification');
                                             this.updated();
@@ -902,7 +1073,7 @@ const Notification = new Lang.Class({
     },
 
     collapseCompleted: function() {
-        if (this._destroyed)
+        if (this._destroyed || !this._actor)
             return;
         this.expanded = false;
         // Make sure we don't line wrap the title, and ellipsize it instead.
@@ -947,8 +1118,12 @@ const Notification = new Lang.Class({
 
     destroy: function(reason) {
         this._destroyedReason = reason;
-        this.actor.destroy();
-        this.actor._delegate = null;
+        if (this._actor) {
+            this._actor.destroy();
+            this._actor._delegate = null;
+        } else {
+            this._onDestroy();
+        }
     }
 });
 Signals.addSignalMethods(Notification.prototype);
@@ -1174,26 +1349,82 @@ const SummaryItem = new Lang.Class({
         this._sourceBox.add(this._sourceTitleBin, { expand: true, y_fill: false });
         this.actor.child = this._sourceBox;
 
-        this.notificationStackView = new St.ScrollView({ name: source.isChat ? '' : 'summary-notification-stack-scrollview',
-                                                         vscrollbar_policy: source.isChat ? Gtk.PolicyType.NEVER : Gtk.PolicyType.AUTOMATIC,
-                                                         hscrollbar_policy: Gtk.PolicyType.NEVER,
-                                                         style_class: 'vfade' });
-        this.notificationStack = new St.BoxLayout({ name: 'summary-notification-stack',
-                                                     vertical: true });
-        this.notificationStackView.add_actor(this.notificationStack);
+        // The notification stack and the right-click menu are only
+        // created when they are first shown
+        this._notificationStackView = null;
+        this._notificationStack = null;
         this._stackedNotifications = [];
+        this._rightClickMenu = null;
+    },
+
+    // Creates the notification stack if needed, so only use these when
+    // about to show it; see hasNotificationStack() and
+    // isNotificationStackEmpty() otherwise
+    get notificationStackView() {
+        this._ensureNotificationStack();
+        return this._notificationStackView;
+    },
+
+    get notificationStack() {
+        this._ensureNotificationStack();
+        return this._notificationStack;
+    },
+
+    hasNotificationStack: function() {
+        return this._notificationStackView != null;
+    },
+
+    isNotificationStackEmpty: function() {
+        return !this._notificationStack || this._notificationStack.get_n_children() == 0;
+    },
+
+    get rightClickMenu() {
+        if (!this._rightClickMenu)
+            this._createRightClickMenu();
+        return this._rightClickMenu;
+    },
+
+    _ensureNotificationStack: function() {
+        if (this._notificationStackView)
+            return;
+
+        let source = this.source;
+        this._notificationStackView = new St.ScrollView({ name: source.isChat ? '' : 'summary-notification-stack-scrollview',
+                                                          vscrollbar_policy: source.isChat ? Gtk.PolicyType.NEVER : Gtk.PolicyType.AUTOMATIC,
+                                                          hscrollbar_policy: Gtk.PolicyType.NEVER,
+                                                          style_class: 'vfade' });
+        this._notificationStack = new St.BoxLayout({ name: 'summary-notification-stack',
+                                                     vertical: true });
+        this._notificationStackView.add_actor(this._notificationStack);
 
         this._oldMaxScrollAdjustment = 0;
+        this._scrollOffsetFromBottom = -1;
 
-        this.notificationStackView.vscroll.adjustment.connect('changed', Lang.bind(this, function(adjustment) {
+        let adjustment = this._notificationStackView.vscroll.adjustment;
+        adjustment.connect('changed', Lang.bind(this, function(adjustment) {
             let currentValue = adjustment.value + adjustment.page_size;
-            if (currentValue == this._oldMaxScrollAdjustment)
+            if (this._scrollOffsetFromBottom >= 0) {
+                // Older notifications were added above the visible ones,
+                // keep those in place
+                adjustment.value = adjustment.upper - this._scrollOffsetFromBottom;
+                this._scrollOffsetFromBottom = -1;
+            } else if (currentValue == this._oldMaxScrollAdjustment) {
                 this.scrollTo(St.Side.BOTTOM);
+            }
             this._oldMaxScrollAdjustment = adjustment.upper;
         }));
+        adjustment.connect('notify::value', Lang.bind(this, function(adjustment) {
+            if (adjustment.value <= adjustment.lower &&
+                adjustment.upper > adjustment.page_size)
+                this._prependOlderNotificationsToStack();
+        }));
+    },
+
+    _createRightClickMenu: function() {
+        let source = this.source;
 
-        this.rightClickMenu = new St.BoxLayout({ name: 'summary-right-click-menu',
-                                                 vertical: true });
+        this._rightClickMenu = new St.BoxLayout({ name: 'summary-right-click-menu',
+                                                  vertical: true });
 
         let item;
 
@@ -1202,29 +1433,29 @@ const SummaryItem = new Lang.Class({
             source.open();
             this.emit('done-displaying-content');
         }));
-        this.rightClickMenu.add(item.actor);
+        this._rightClickMenu.add(item.actor);
 
         item = new PopupMenu.PopupMenuItem(_("Remove"));
         item.connect('activate', Lang.bind(this, function() {
             source.destroy();
             this.emit('done-displaying-content');
         }));
-        this.rightClickMenu.add(item.actor);
+        this._rightClickMenu.add(item.actor);
 
-	if (source.isChat) {
-            item = new PopupMenu.PopupMenuItem('');
-            item.actor.connect('notify::mapped', Lang.bind(this, function() {
-                item.label.set_text(source.isMuted ? _("Unmute") : _("Mute"));
+        if (source.isChat) {
+            let muteItem = new PopupMenu.PopupMenuItem('');
+            muteItem.actor.connect('notify::mapped', Lang.bind(this, function() {
+                muteItem.label.set_text(source.isMuted ? _("Unmute") : _("Mute"));
             }));
-            item.connect('activate', Lang.bind(this, function() {
+            muteItem.connect('activate', Lang.bind(this, function() {
                 source.setMuted(!source.isMuted);
                 this.emit('done-displaying-content');
             }));
-            this.rightClickMenu.add(item.actor);
-	}
+            this._rightClickMenu.add(muteItem.actor);
+        }
 
         let focusManager = St.FocusManager.get_for_stage(global.stage);
-        focusManager.add_group(this.rightClickMenu);
+        focusManager.add_group(this._rightClickMenu);
     },
 
     // getTitleNaturalWidth, getTitleWidth, and setTitleWidth include
@@ -1251,17 +1482,21 @@ const SummaryItem = new Lang.Class({
         this._sourceTitle.clutter_text.ellipsize = mode;
     },
 
+    // Only the most recent notifications get added to the stack; older
+    // ones are added by _prependOlderNotificationsToStack() when the
+    // user scrolls up to them.
     prepareNotificationStackForShowing: function() {
-        if (this.notificationStack.get_children().length > 0)
+        this._ensureNotificationStack();
+        if (this._notificationStack.get_n_children() > 0)
             return;
 
-        for (let i = 0; i < this.source.notifications.length; i++) {
-            this._appendNotificationToStack(this.source.notifications[i]);
-        }
+        let notifications = this.source.notifications;
+        let first = Math.max(0, notifications.length - NOTIFICATION_STACK_WINDOW);
+        for (let i = first; i < notifications.length; i++)
+            this._appendNotificationToStack(notifications[i]);
     },
 
     doneShowingNotificationStack: function() {
-        let notificationActors = this.notificationStack.get_children();
         for (let i = 0; i < this._stackedNotifications.length; i++) {
             let stackedNotification = this._stackedNotifications[i];
             let notification = stackedNotification.notification;
@@ -1269,40 +1504,74 @@ const SummaryItem = new Lang.Class({
             notification.disconnect(stackedNotification.notificationExpandedId);
             notification.disconnect(stackedNotification.notificationDoneDisplayingId);
             notification.disconnect(stackedNotification.notificationDestroyedId);
-            if (notification.actor.get_parent() == this.notificationStack)
-                this.notificationStack.remove_actor(notification.actor);
+            if (notification.actor.get_parent() == this._notificationStack)
+                this._notificationStack.remove_actor(notification.actor);
             notification.setIconVisible(true);
             notification.enableScrolling(true);
+            notification.releaseActor();
         }
         this._stackedNotifications = [];
+
+        if (this._notificationStackView) {
+            this._notificationStackView.destroy();
+            this._notificationStackView = null;
+            this._notificationStack = null;
+        }
     },
 
     _notificationAddedToSource: function(source, notification) {
-        if (this.notificationStack.mapped)
+        if (this._notificationStack && this._notificationStack.mapped)
             this._appendNotificationToStack(notification);
     },
 
-    _appendNotificationToStack: function(notification) {
+    _connectStackedNotification: function(notification) {
         let stackedNotification = {};
         stackedNotification.notification = notification;
         stackedNotification.notificationExpandedId = notification.connect('expanded', Lang.bind(this, this._contentUpdated));
         stackedNotification.notificationDoneDisplayingId = notification.connect('done-displaying', Lang.bind(this, this._notificationDoneDisplaying));
         stackedNotification.notificationDestroyedId = notification.connect('destroy', Lang.bind(this, this._notificationDestroyed));
-        this._stackedNotifications.push(stackedNotification);
         if (!this.source.isChat)
             notification.enableScrolling(false);
-        if (this.notificationStack.get_children().length > 0)
+        return stackedNotification;
+    },
+
+    _appendNotificationToStack: function(notification) {
+        this._stackedNotifications.push(this._connectStackedNotification(notification));
+        if (this._notificationStack.get_children().length > 0)
             notification.setIconVisible(false);
-        this.notificationStack.add(notification.actor);
+        this._notificationStack.add(notification.actor);
         notification.expand(false);
     },
 
+    _prependOlderNotificationsToStack: function() {
+        if (this._stackedNotifications.length == 0)
+            return;
+
+        let notifications = this.source.notifications;
+        let end = notifications.indexOf(this._stackedNotifications[0].notification);
+        if (end <= 0)
+            return;
+        let first = Math.max(0, end - NOTIFICATION_STACK_WINDOW);
+
+        let adjustment = this._notificationStackView.vscroll.adjustment;
+        this._scrollOffsetFromBottom = adjustment.upper - adjustment.value;
+
+        this._stackedNotifications[0].notification.setIconVisible(false);
+        for (let i = end - 1; i >= first; i--) {
+            let notification = notifications[i];
+            this._stackedNotifications.unshift(this._connectStackedNotification(notification));
+            notification.setIconVisible(i == first);
+            this._notificationStack.insert_child_at_index(notification.actor, 0);
+            notification.expand(false);
+        }
+    },
+
     // scrollTo:
     // @side: St.Side.TOP or St.Side.BOTTOM
     //
     // Scrolls the notifiction stack to the indicated edge
     scrollTo: function(side) {
-        let adjustment = this.notificationStackView.vscroll.adjustment;
+        let adjustment = this._notificationStackView.vscroll.adjustment;
         if (side == St.Side.TOP)
             adjustment.value = adjustment.lower;
         else if (side == St.Side.BOTTOM)
@@ -1875,7 +2144,7 @@ const MessageTray = new Lang.Class({
 
             if (this._showNotificationMouseX >= 0) {
                 let actorAtShowNotificationPosition =
-                    global.stage.get_actor_at_pos(Clutter.PickMode.ALL, this._showNotificationMouseX, this._showNotificationMouseY);
+                    Shell.hit_test_actor_at_pos(global.stage, Clutter.PickMode.ALL, this._showNotificationMouseX, this._showNotificationMouseY);
                 this._showNotificationMouseX = -1;
                 this._showNotificationMouseY = -1;
                 // Don't set this._pointerInTray to true if the pointer was initially in the area where the notification
@@ -2044,7 +2313,8 @@ const MessageTray = new Lang.Class({
         // to show notifications for legacy tray icons, but this would be necessary if we did.
         let requestedNotificationStackIsEmpty = (this._clickedSummaryItemMouseButton == 1 && this._clickedSummaryItem.source.notifications.length == 0);
         let wrongSummaryNotificationStack = (this._clickedSummaryItemMouseButton == 1 &&
-                                             this._summaryBoxPointer.bin.child != this._clickedSummaryItem.notificationStackView);
+                                             (!this._clickedSummaryItem.hasNotificationStack() ||
+                                              this._summaryBoxPointer.bin.child != this._clickedSummaryItem.notificationStackView));
         let wrongSummaryRightClickMenu = (this._clickedSummaryItemMouseButton == 3 &&
                                           this._summaryBoxPointer.bin.child != this._clickedSummaryItem.rightClickMenu);
         let wrongSummaryBoxPointer = (haveClickedSummaryItem &&
@@ -2267,6 +2537,8 @@ const MessageTray = new Lang.Class({
         this._notification = null;
         if (notification.isTransient)
             notification.destroy(NotificationDestroyedReason.EXPIRED);
+        else
+            notification.releaseActor();
     },
 
     _expandNotification: function(autoExpanding) {
@@ -2397,7 +2669,7 @@ const MessageTray = new Lang.Class({
     },
 
     _onSummaryBoxPointerContentUpdated: function() {
-        if (this._summaryBoxPointerItem.notificationStack.get_children().length == 0)
+        if (this._summaryBoxPointerItem.isNotificationStackEmpty())
             this._hideSummaryBoxPointer();
         this._adjustSummaryBoxPointerPosition();
 
@@ -2431,7 +2703,7 @@ const MessageTray = new Lang.Class({
         // We should be sure to hide the box pointer if all notifications in it are destroyed while
         // it is hiding, so that we don't show an an animation of an empty blob being hidden.
         if (this._summaryBoxPointerState == State.HIDING &&
-            this._summaryBoxPointerItem.notificationStack.get_children().length == 0) {
+            this._summaryBoxPointerItem.isNotificationStackEmpty()) {
             this._summaryBoxPointer.actor.hide();
             return;
         }
@@ -2451,7 +2723,8 @@ const MessageTray = new Lang.Class({
     },
 
     _hideSummaryBoxPointerCompleted: function() {
-        let doneShowingNotificationStack = (this._summaryBoxPointer.bin.child == this._summaryBoxPointerItem.notificationStackView);
+        let doneShowingNotificationStack = (this._summaryBoxPointerItem.hasNotificationStack() &&
+                                            this._summaryBoxPointer.bin.child == this._summaryBoxPointerItem.notificationStackView);
 
         this._summaryBoxPointerState = State.HIDDEN;
         this._summaryBoxPointer.bin.child = null;
@@ -76,6 +76,10 @@ const Urgency = {
     CRITICAL: 2
 };
 
+// Hints carrying an (iiibiiay) image, in the current and older
+// versions of the spec
+const IMAGE_DATA_HINTS = ['image-data', 'image_data', 'icon_data'];
+
 const rewriteRules = {
     'XChat': [
         { pattern:     /^XChat: Private message from: (\S*) \(.*\)$/,
@@ -108,7 +112,9 @@ const NotificationDaemon = new Lang.Class({
             Lang.bind(this, this._onFocusAppChanged));
     },
 
-    _iconForNotificationData: function(icon, hints, size) {
+    // @imageKey is the key of the 'image-data' hint in St.TextureCache,
+    // as returned by _addImageData()
+    _iconForNotificationData: function(icon, imageKey, imagePath, urgency, size) {
         let textureCache = St.TextureCache.get_default();
 
         // If an icon is not specified, we use 'image-data' or 'image-path' hint for an icon
@@ -129,15 +135,17 @@ const NotificationDaemon = new Lang.Class({
                 return new St.Icon({ icon_name: icon,
                                      icon_type: St.IconType.FULLCOLOR,
                                      icon_size: size });
-        } else if (hints['image-data']) {
-            let [width, height, rowStride, hasAlpha,
-                 bitsPerSample, nChannels, data] = hints['image-data'];
-            return textureCache.load_from_raw(data, hasAlpha, width, height, rowStride, size);
-        } else if (hints['image-path']) {
-            return textureCache.load_uri_async(GLib.filename_to_uri(hints['image-path'], null), size, size);
+        } else if (imageKey) {
+            let image = textureCache.load_cached(imageKey, size);
+            if (image)
+                return image;
+        }
+
+        if (imagePath) {
+            return textureCache.load_uri_async(GLib.filename_to_uri(imagePath, null), size, size);
         } else {
             let stockIcon;
-            switch (hints.urgency) {
+            switch (urgency) {
                 case Urgency.LOW:
                 case Urgency.NORMAL:
                     stockIcon = 'gtk-dialog-info';
@@ -152,6 +160,27 @@ const NotificationDaemon = new Lang.Class({
         }
     },
 
+    _imageForNotificationData: function(imageKey, imagePath, size) {
+        let textureCache = St.TextureCache.get_default();
+        let image = null;
+        if (imageKey)
+            image = textureCache.load_cached(imageKey, size);
+        if (!image && imagePath)
+            image = textureCache.load_uri_async(GLib.filename_to_uri(imagePath, null), size, size);
+        return image;
+    },
+
+    // Decodes the image into the texture cache and returns its key, so
+    // that the raw pixel data doesn't need to be kept around
+    _addImageData: function(imageData, size) {
+        try {
+            return St.TextureCache.get_default().add_image_data(imageData, size);
+        } catch (e) {
+            log('Invalid image-data hint in notification: ' + e.message);
+            return null;
+        }
+    },
+
     _lookupSource: function(title, pid, trayIcon) {
         for (let i = 0; i < this._sources.length; i++) {
             let source = this._sources[i];
@@ -250,8 +279,10 @@ const NotificationDaemon = new Lang.Class({
         }
 
         for (let hint in hints) {
-            // unpack the variants
-            hints[hint] = hints[hint].deep_unpack();
+            // unpack the variants; image data is left packed, since
+            // St.TextureCache can load it without copying it into JS
+            if (IMAGE_DATA_HINTS.indexOf(hint) == -1)
+                hints[hint] = hints[hint].deep_unpack();
         }
 
         hints = Params.parse(hints, { urgency: Urgency.NORMAL }, true);
@@ -341,11 +372,28 @@ const NotificationDaemon = new Lang.Class({
             [ndata.id, ndata.icon, ndata.summary, ndata.body,
              ndata.actions, ndata.hints, ndata.notification];
 
-        let iconActor = this._iconForNotificationData(icon, hints, source.ICON_SIZE);
+        // The image data is only decoded for the size it is shown at:
+        // as the icon if there is no other, or as the large image
+        let imageKey = null;
+        let imageSize = icon ? MessageTray.Notification.prototype.IMAGE_SIZE : source.ICON_SIZE;
+        if (hints['image-data'])
+            imageKey = this._addImageData(hints['image-data'], imageSize);
+        let imagePath = hints['image-path'];
+
+        // The decoded image stays in the texture cache; drop the raw
+        // data, which ndata keeps for as long as the notification exists
+        for (let i = 0; i < IMAGE_DATA_HINTS.length; i++)
+            delete hints[IMAGE_DATA_HINTS[i]];
+
+        // Icons and images are passed as functions, so that the
+        // notification can recreate them after releasing its actors.
+        // They only hold on to what they need, not the hints
+        let iconFunc = Lang.bind(this, this._iconForNotificationData,
+                                 icon, imageKey, imagePath, hints.urgency, source.ICON_SIZE);
 
         if (notification == null) {
             notification = new MessageTray.Notification(source, summary, body,
-                                                        { icon: iconActor,
+                                                        { icon: iconFunc,
                                                           bannerMarkup: true });
             ndata.notification = notification;
             notification.connect('destroy', Lang.bind(this,
@@ -370,25 +418,15 @@ const NotificationDaemon = new Lang.Class({
                     this._emitActionInvoked(ndata.id, actionId);
                 }));
         } else {
-            notification.update(summary, body, { icon: iconActor,
+            notification.update(summary, body, { icon: iconFunc,
                                                  bannerMarkup: true,
                                                  clear: true });
         }
 
         // We only display a large image if an icon is also specified.
-        if (icon && (hints['image-data'] || hints['image-path'])) {
-            let image = null;
-            if (hints['image-data']) {
-                let [width, height, rowStride, hasAlpha,
-                 bitsPerSample, nChannels, data] = hints['image-data'];
-                image = St.TextureCache.get_default().load_from_raw(data, hasAlpha,
-                                                                    width, height, rowStride, notification.IMAGE_SIZE);
-            } else if (hints['image-path']) {
-                image = St.TextureCache.get_default().load_uri_async(GLib.filename_to_uri(hints['image-path'], null),
-                                                                     notification.IMAGE_SIZE,
-                                                                     notification.IMAGE_SIZE);
-            }
-            notification.setImage(image);
+        if (icon && (imageKey || imagePath)) {
+            notification.setImage(Lang.bind(this, this._imageForNotificationData,
+                                            imageKey, imagePath, notification.IMAGE_SIZE));
         } else {
             notification.unsetImage();
         }
@@ -305,7 +305,7 @@ const AppMenuButton = new Lang.Class({
         let tracker = Shell.WindowTracker.get_default();
         let appSys = Shell.AppSystem.get_default();
         tracker.connect('notify::focus-app', Lang.bind(this, this._focusAppChanged));
-        appSys.connect('app-state-changed', Lang.bind(this, this._onAppStateChanged));
+        appSys.connect('apps-changed', Lang.bind(this, this._onAppsChanged));
 
         global.window_manager.connect('switch-workspace', Lang.bind(this, this._sync));
 
@@ -464,14 +464,15 @@ const AppMenuButton = new Lang.Class({
         }
     },
 
-    _onAppStateChanged: function(appSys, app) {
-        let state = app.state;
-        if (state != Shell.AppState.STARTING) {
+    _onAppsChanged: function(appSys) {
+        let apps = appSys.get_changed_apps();
+        for (let i = 0; i < apps.length; i++) {
+            let app = apps[i];
             this._startingApps = this._startingApps.filter(function(a) {
                 return a != app;
             });
-        } else if (state == Shell.AppState.STARTING) {
-            this._startingApps.push(app);
+            if (app.state == Shell.AppState.STARTING)
+                this._startingApps.push(app);
         }
         // For now just resync on all running state changes; this is mainly to handle
         // cases where the focused window's application changes without the focus
@@ -741,7 +742,7 @@ const ActivitiesButton = new Lang.Class({
 
     _xdndShowOverview: function(actor) {
         let [x, y, mask] = global.get_pointer();
-        let pickedActor = global.stage.get_actor_at_pos(Clutter.PickMode.REACTIVE, x, y);
+        let pickedActor = Shell.hit_test_actor_at_pos(global.stage, Clutter.PickMode.REACTIVE, x, y);
 
         if (pickedActor == this.actor) {
             if (!Main.overview.visible && !Main.overview.animationInProgress) {
@@ -924,6 +925,9 @@ const Panel = new Lang.Class({
         this.actor = new Shell.GenericContainer({ name: 'panel',
                                                   reactive: true });
         this.actor._delegate = this;
+        // Most frames don't change anything in the panel
+        if (St.cache_effect_get_enabled())
+            this.actor.add_effect_with_name('cache', new St.CacheEffect());
 
         this._statusArea = {};
 
@@ -56,6 +56,15 @@ const SearchResultDisplay = new Lang.Class({
         this.actor.get_children().forEach(function (actor) { actor.destroy(); });
     },
 
+    /**
+     * reset:
+     * Remove all results from this display, including any that
+     * clear() kept around to be shown again.
+     */
+    reset: function() {
+        this.clear();
+    },
+
     /**
      * getVisibleResultCount:
      *
@@ -208,6 +217,21 @@ const SearchProvider = new Lang.Class({
         return null;
     },
 
+    /**
+     * updateResultActor:
+     * @actor: An actor returned by createResultActor()
+     * @resultMeta: Object with the result's new metadata
+     * @terms: Array of the new search terms
+     *
+     * Called when a result is still shown after the search terms
+     * changed. Search providers that override createResultActor()
+     * may override this to update @actor in place and return %true;
+     * otherwise a new actor is created.
+     */
+    updateResultActor: function(actor, resultMeta, terms) {
+        return false;
+    },
+
     /**
      * activateResult:
      * @id: Result identifier string
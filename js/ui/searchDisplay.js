@@ -1,8 +1,10 @@
 // -*- mode: js; js-indent-level: 4; indent-tabs-mode: nil -*-
 
 const Clutter = imports.gi.Clutter;
+const GLib = imports.gi.GLib;
 const Lang = imports.lang;
 const Gtk = imports.gi.Gtk;
+const Mainloop = imports.mainloop;
 const Meta = imports.gi.Meta;
 const St = imports.gi.St;
 
@@ -14,6 +16,9 @@ const Search = imports.ui.search;
 
 const MAX_SEARCH_RESULTS_ROWS = 1;
 
+// Time spent rendering search results before letting a frame be drawn
+const MAX_RENDER_WORK_MILLIS = 5;
+
 
 const SearchResult = new Lang.Class({
     Name: 'SearchResult',
@@ -26,9 +31,38 @@ const SearchResult = new Lang.Class({
                                      x_align: St.Align.START,
                                      y_fill: true });
         this.actor._delegate = this;
+        this._terms = terms;
+        this._icon = null;
+        this._content = null;
+
+        this._createContent();
+
+        this.actor.connect('clicked', Lang.bind(this, this._onResultClicked));
+
+        let draggable = DND.makeDraggable(this.actor);
+        draggable.connect('drag-begin',
+                          Lang.bind(this, function() {
+                              Main.overview.beginItemDrag(this);
+                          }));
+        draggable.connect('drag-cancelled',
+                          Lang.bind(this, function() {
+                              Main.overview.cancelledItemDrag(this);
+                          }));
+        draggable.connect('drag-end',
+                          Lang.bind(this, function() {
+                              Main.overview.endItemDrag(this);
+                          }));
+    },
+
+    _createContent: function() {
+        let selected = this._content && this._content.has_style_pseudo_class('selected');
+        if (this._content)
+            this._content.destroy();
+
         this._dragActorSource = null;
+        this._icon = null;
 
-        let content = provider.createResultActor(metaInfo, terms);
+        let content = this.provider.createResultActor(this.metaInfo, this._terms);
         if (content == null) {
             content = new St.Bin({ style_class: 'search-result-content',
                                    reactive: true,
@@ -37,6 +71,7 @@ const SearchResult = new Lang.Class({
             let icon = new IconGrid.BaseIcon(this.metaInfo['name'],
                                              { createIcon: this.metaInfo['createIcon'] });
             content.set_child(icon.actor);
+            this._icon = icon;
             this._dragActorSource = icon.icon;
             this.actor.label_actor = icon.label;
         } else {
@@ -45,22 +80,24 @@ const SearchResult = new Lang.Class({
         }
         this._content = content;
         this.actor.set_child(content);
+        this.setSelected(selected);
+    },
 
-        this.actor.connect('clicked', Lang.bind(this, this._onResultClicked));
+    // update:
+    // @metaInfo: the result's new metadata
+    // @terms: the current search terms
+    //
+    // Refreshes a result that is shown again for new terms
+    update: function(metaInfo, terms) {
+        this.metaInfo = metaInfo;
+        this._terms = terms;
 
-        let draggable = DND.makeDraggable(this.actor);
-        draggable.connect('drag-begin',
-                          Lang.bind(this, function() {
-                              Main.overview.beginItemDrag(this);
-                          }));
-        draggable.connect('drag-cancelled',
-                          Lang.bind(this, function() {
-                              Main.overview.cancelledItemDrag(this);
-                          }));
-        draggable.connect('drag-end',
-                          Lang.bind(this, function() {
-                              Main.overview.endItemDrag(this);
-                          }));
+        if (this._icon) {
+            this._icon.label.text = metaInfo['name'];
+            this._icon.createIcon = metaInfo['createIcon'];
+        } else if (!this.provider.updateResultActor(this._content, metaInfo, terms)) {
+            this._createContent();
+        }
     },
 
     setSelected: function(selected) {
@@ -131,6 +168,10 @@ const GridSearchResults = new Lang.Class({
         this._notDisplayedResult = [];
         this._terms = [];
         this._pendingClear = false;
+
+        // Results by id that were cleared but can be shown again
+        // by the next renderResults()
+        this._unusedResults = {};
     },
 
     getResultsForDisplay: function() {
@@ -156,12 +197,40 @@ const GridSearchResults = new Lang.Class({
 
     renderResults: function(metas) {
         for (let i = 0; i < metas.length; i++) {
-            let display = new SearchResult(this.provider, metas[i], this._terms);
+            let display = this._unusedResults[metas[i].id];
+            if (display) {
+                delete this._unusedResults[metas[i].id];
+                display.update(metas[i], this._terms);
+            } else {
+                display = new SearchResult(this.provider, metas[i], this._terms);
+            }
             this._grid.addItem(display.actor);
         }
+        this._destroyUnusedResults();
+    },
+
+    reset: function() {
+        this.clear();
+        this._destroyUnusedResults();
+    },
+
+    _destroyUnusedResults: function() {
+        for (let id in this._unusedResults)
+            this._unusedResults[id].actor.destroy();
+        this._unusedResults = {};
     },
 
     clear: function () {
+        // Results that are still there for the next terms are reused
+        // rather than created again, which also avoids restarting
+        // their CSS transitions
+        this._destroyUnusedResults();
+        let count = this._grid.visibleItemsCount();
+        for (let i = count - 1; i >= 0; i--) {
+            let display = this._grid.getItemAtIndex(i)._delegate;
+            this._grid.removeItem(display.actor);
+            this._unusedResults[display.metaInfo.id] = display;
+        }
         this._grid.removeAll();
         this._pendingClear = false;
     },
@@ -228,6 +297,9 @@ const SearchResults = new Lang.Class({
 
         this._highlightDefault = false;
         this._defaultResult = null;
+
+        this._pendingRender = [];
+        this._renderIdleId = 0;
     },
 
     _updateOpenSearchProviderButtons: function() {
@@ -322,9 +394,14 @@ const SearchResults = new Lang.Class({
     },
 
     reset: function() {
+        this._cancelRender();
         this._searchSystem.reset();
         this._statusText.hide();
         this._clearDisplay();
+
+        // Nothing is going to be shown again
+        for (let i = 0; i < this._providerMeta.length; i++)
+            this._providerMeta[i].resultDisplay.reset();
     },
 
     startingSearch: function() {
@@ -393,6 +470,10 @@ const SearchResults = new Lang.Class({
             if (provider.async) {
                 provider.getResultMetasAsync(results, Lang.bind(this,
                     function(metas) {
+                        // Superseded by a search for other terms
+                        if (terms != this._searchSystem.getTerms())
+                            return;
+
                         this._clearDisplayForProvider(provider);
                         meta.actor.show();
                         this._content.hide();
@@ -421,25 +502,78 @@ const SearchResults = new Lang.Class({
         let terms = searchSystem.getTerms();
         this._openSearchSystem.setSearchTerms(terms);
 
+        // Results for the previous terms that weren't rendered yet
+        // are not needed anymore
+        this._cancelRender();
+
+        for (let i = 0; i < results.length; i++) {
+            let [provider, providerResults] = results[i];
+            let meta = this._metaForProvider(provider);
+            meta.hasPendingResults = true;
+            if (!provider.async)
+                this._pendingRender.push([provider, providerResults, terms]);
+        }
+
+        // The first providers are rendered right away, the remaining
+        // ones in later main loop iterations so that typing doesn't
+        // wait for all of them
+        if (this._renderChunk())
+            this._renderIdleId = Mainloop.idle_add(Lang.bind(this, this._renderChunk));
+
+        return true;
+    },
+
+    // Renders pending provider results until MAX_RENDER_WORK_MILLIS
+    // have passed; returns %true if there are more to render.
+    _renderChunk: function() {
+        let start = GLib.get_monotonic_time();
+
         // To avoid CSS transitions causing flickering when the first search
         // result stays the same, we hide the content while filling in the
         // results.
         this._content.hide();
 
-        for (let i = 0; i < results.length; i++) {
-            let [provider, providerResults] = results[i];
-            let meta = this._metaForProvider(provider);
-            meta.hasPendingResults = provider.async;
-            if (!meta.hasPendingResults)
-                this._updateProviderResults(provider, providerResults, terms);
+        while (this._pendingRender.length > 0) {
+            this._renderNext();
+
+            if (GLib.get_monotonic_time() - start > MAX_RENDER_WORK_MILLIS * 1000)
+                break;
         }
 
         this._content.show();
 
-        return true;
+        if (this._pendingRender.length > 0)
+            return true;
+
+        this._renderIdleId = 0;
+        return false;
+    },
+
+    _renderNext: function() {
+        let [provider, providerResults, terms] = this._pendingRender.shift();
+        this._metaForProvider(provider).hasPendingResults = false;
+        this._updateProviderResults(provider, providerResults, terms);
+    },
+
+    _cancelRender: function() {
+        if (this._renderIdleId) {
+            Mainloop.source_remove(this._renderIdleId);
+            this._renderIdleId = 0;
+        }
+        for (let i = 0; i < this._pendingRender.length; i++)
+            this._metaForProvider(this._pendingRender[i][0]).hasPendingResults = false;
+        this._pendingRender = [];
     },
 
     activateDefault: function() {
+        // The default result could be among the ones not rendered yet
+        if (this._renderIdleId) {
+            Mainloop.source_remove(this._renderIdleId);
+            this._renderIdleId = 0;
+            while (this._pendingRender.length > 0)
+                this._renderNext();
+        }
+
         if (this._defaultResult)
             this._defaultResult.activate();
     },
@@ -32,6 +32,13 @@ const Tweener = imports.tweener.tweener;
 // tween completes and then another is added before returning to the
 // main loop, the complete callback will not be called (until the new
 // tween finishes).
+//
+// Tweens that only animate GObject properties of a Clutter.Actor with
+// a named transition, and that don't ask for per-frame callbacks, are
+// run by Shell.Animator instead, which updates the properties from C
+// without calling into Javascript on every frame, unless
+// imports.tweener.tweener is already animating the target. Everything
+// else goes through imports.tweener.tweener as before.
 
 
 // ActionScript Tweener methods that imports.tweener.tweener doesn't
@@ -44,9 +51,32 @@ const Tweener = imports.tweener.tweener;
 // calls any of these is almost certainly wrong anyway, because they
 // affect the entire application.)
 
+// The parameters imports.tweener.tweener interprets itself, as opposed
+// to properties to tween
+const TWEENER_PARAMETERS = [ 'overwrite', 'time', 'delay', 'useFrames', 'skipUpdates',
+                             'transition', 'transitionParams', 'rounded', 'min', 'max',
+                             'base', 'count', 'waitFrames', 'isCaller',
+                             'onStart', 'onStartScope', 'onStartParams',
+                             'onUpdate', 'onUpdateScope', 'onUpdateParams',
+                             'onComplete', 'onCompleteScope', 'onCompleteParams',
+                             'onOverwrite', 'onOverwriteScope', 'onOverwriteParams',
+                             'onError', 'onErrorScope' ];
+
+// The subset of those that Shell.Animator tweens support
+const NATIVE_PARAMETERS = [ 'time', 'delay', 'transition',
+                            'onStart', 'onStartScope', 'onStartParams',
+                            'onComplete', 'onCompleteScope', 'onCompleteParams' ];
+
+// Whether simple tweens go to Shell.Animator; turning it off allows
+// comparing frame rates with and without it
+let _nativeTweens = true;
+
 // Called from Main.start
 function init() {
     Tweener.setFrameTicker(new ClutterFrameTicker());
+
+    if (GLib.getenv('GNOME_SHELL_DISABLE_NATIVE_TWEENS'))
+        _nativeTweens = false;
 }
 
 
@@ -57,9 +87,108 @@ function addCaller(target, tweeningParameters) {
 
 function addTween(target, tweeningParameters) {
     _wrapTweening(target, tweeningParameters);
+
+    if (_addNativeTween(target, tweeningParameters))
+        return;
+
+    // Like tweener's own tweens, animator tweens that would run at the
+    // same time lose these properties
+    if (target instanceof Clutter.Actor) {
+        let animator = Shell.Animator.get_default();
+        if (animator.get_tween_count(target) > 0) {
+            let time = tweeningParameters.time || 0;
+            let delay = tweeningParameters.delay || 0;
+            animator.remove_overlapping_tweens(target, _getTweenedProperties(tweeningParameters),
+                                               Math.round(time * 1000), Math.round(delay * 1000));
+        }
+    }
+
     Tweener.addTween(target, tweeningParameters);
 }
 
+function _getTweenedProperties(params) {
+    let properties = [];
+
+    for (let name in params) {
+        if (TWEENER_PARAMETERS.indexOf(name) < 0)
+            properties.push(name);
+    }
+
+    return properties;
+}
+
+// Maps the name of a tweener transition to the Clutter.AnimationMode
+// with the same equation; returns -1 if there is none
+function _getAnimationMode(transition) {
+    // imports.tweener.tweener's default
+    if (transition === undefined)
+        transition = 'easeOutExpo';
+
+    if (typeof(transition) != 'string')
+        return -1;
+
+    if (transition == 'linear' || transition == 'easeNone')
+        return Clutter.AnimationMode.LINEAR;
+
+    // easeInOutQuad => EASE_IN_OUT_QUAD
+    let name = transition.replace(/([A-Z])/g, '_$1').toUpperCase();
+    if (!/^EASE_(IN|OUT|IN_OUT)_[A-Z]+$/.test(name) || !(name in Clutter.AnimationMode))
+        return -1;
+
+    return Clutter.AnimationMode[name];
+}
+
+function _addNativeTween(target, params) {
+    if (!_nativeTweens || !(target instanceof Clutter.Actor))
+        return false;
+
+    let time = params.time || 0;
+    let delay = params.delay || 0;
+
+    // imports.tweener.tweener applies these right away
+    if (time == 0 && delay == 0)
+        return false;
+
+    let mode = _getAnimationMode(params.transition);
+    if (mode < 0)
+        return false;
+
+    let properties = [];
+    for (let name in params) {
+        if (TWEENER_PARAMETERS.indexOf(name) >= 0) {
+            if (NATIVE_PARAMETERS.indexOf(name) < 0)
+                return false;
+        } else if (typeof(params[name]) == 'number') {
+            properties.push(name);
+        } else {
+            return false;
+        }
+    }
+
+    if (properties.length == 0)
+        return false;
+
+    // imports.tweener.tweener only lets a new tween take over from
+    // those that overlap with it in time, and it has no API for doing
+    // that from outside; so leave such targets to it entirely
+    if (Tweener.getTweenCount(target) > 0)
+        return false;
+
+    let tween = Shell.Tween.new(target, Math.round(time * 1000), Math.round(delay * 1000), mode);
+    for (let i = 0; i < properties.length; i++) {
+        // Not a GObject property, such as one defined in Javascript
+        if (!tween.add_property(properties[i], params[properties[i]]))
+            return false;
+    }
+
+    // _wrapTweening() has made sure these exist
+    tween.connect('started', function() { params.onStart(); });
+    tween.connect('completed', function() { params.onComplete(); });
+
+    Shell.Animator.get_default().add_tween(tween);
+    return true;
+}
+
 function _wrapTweening(target, tweeningParameters) {
     let state = _getTweenState(target);
 
@@ -147,31 +276,60 @@ function _idleCompleted(target) {
 }
 
 function getTweenCount(scope) {
-    return Tweener.getTweenCount(scope);
+    let count = Tweener.getTweenCount(scope);
+
+    if (scope instanceof Clutter.Actor)
+        count += Shell.Animator.get_default().get_tween_count(scope);
+
+    return count;
 }
 
 // imports.tweener.tweener doesn't provide this method (which exists
 // in the ActionScript version) but it's easy to implement.
 function isTweening(scope) {
-    return Tweener.getTweenCount(scope) != 0;
+    return getTweenCount(scope) != 0;
+}
+
+// The property names passed after the scope, or null for all of them
+function _getPropertyArguments(args) {
+    let properties = Array.prototype.slice.call(args, 1);
+    return properties.length > 0 ? properties : null;
 }
 
 function removeTweens(scope) {
-    if (Tweener.removeTweens.apply(null, arguments)) {
+    let removed = Tweener.removeTweens.apply(null, arguments);
+
+    if (scope instanceof Clutter.Actor &&
+        Shell.Animator.get_default().remove_tweens(scope, _getPropertyArguments(arguments)))
+        removed = true;
+
+    if (removed) {
         // If we just removed the last active tween, clean up
-        if (Tweener.getTweenCount(scope) == 0)
+        if (getTweenCount(scope) == 0)
             _tweenCompleted(scope);
         return true;
     } else
         return false;
 }
 
-function pauseTweens() {
-    return Tweener.pauseTweens.apply(null, arguments);
+function pauseTweens(scope) {
+    let paused = Tweener.pauseTweens.apply(null, arguments);
+
+    if (scope instanceof Clutter.Actor &&
+        Shell.Animator.get_default().set_tweens_paused(scope, _getPropertyArguments(arguments), true))
+        paused = true;
+
+    return paused;
 }
 
-function resumeTweens() {
-    return Tweener.resumeTweens.apply(null, arguments);
+function resumeTweens(scope) {
+    let resumed = Tweener.resumeTweens.apply(null, arguments);
+
+    if (scope instanceof Clutter.Actor &&
+        Shell.Animator.get_default().set_tweens_paused(scope, _getPropertyArguments(arguments), false))
+        resumed = true;
+
+    return resumed;
 }
 
 
@@ -195,13 +353,15 @@ function registerSpecialPropertySplitter(name, splitFunction, parameters) {
 // ticker for Tweener just uses a simple timeout at a fixed frame rate
 // and has no idea of "catching up" by dropping frames.
 //
-// We substitute it with custom frame ticker here that connects
-// Tweener to a Clutter.TimeLine. Now, Clutter.Timeline itself isn't a
-// whole lot more sophisticated than a simple timeout at a fixed frame
-// rate, but at least it knows how to drop frames. (See
-// HippoAnimationManager for a more sophisticated view of continous
-// time updates; even better is to pay attention to the vertical
-// vblank and sync to that when possible.)
+// We substitute it with custom frame ticker here that takes its frames
+// from Shell.Animator, whose Clutter.Timeline also advances the tweens
+// run natively. Clutter.Timeline itself isn't a whole lot more
+// sophisticated than a simple timeout at a fixed frame rate, but at
+// least it knows how to drop frames; and sharing it means that both
+// kinds of tweens are updated on the same frames, from the same time.
+// (See HippoAnimationManager for a more sophisticated view of
+// continous time updates; even better is to pay attention to the
+// vertical vblank and sync to that when possible.)
 //
 const ClutterFrameTicker = new Lang.Class({
     Name: 'ClutterFrameTicker',
@@ -209,21 +369,13 @@ const ClutterFrameTicker = new Lang.Class({
     FRAME_RATE : 60,
 
     _init : function() {
-        // We don't have a finite duration; tweener will tell us to stop
-        // when we need to stop, so use 1000 seconds as "infinity", and
-        // set the timeline to loop. Doing this means we have to track
-        // time ourselves, since clutter timeline's time will cycle
-        // instead of strictly increase.
-        this._timeline = new Clutter.Timeline({ duration: 1000*1000 });
-        this._timeline.set_loop(true);
+        // The animator's time starts over whenever it stops, which may
+        // not be when we do, so track time ourselves
+        this._animator = Shell.Animator.get_default();
+        this._newFrameId = 0;
         this._startTime = -1;
         this._currentTime = -1;
 
-        this._timeline.connect('new-frame', Lang.bind(this,
-            function(timeline, frame) {
-                this._onNewFrame(frame);
-            }));
-
         let perf_log = Shell.PerfLog.get_default();
         perf_log.define_event("tweener.framePrepareStart",
                               "Start of a new animation frame",
@@ -233,18 +385,20 @@ const ClutterFrameTicker = new Lang.Class({
                               "");
     },
 
-    _onNewFrame : function(frame) {
+    _onNewFrame : function() {
+        let frameTime = this._animator.get_frame_time() / 1000.0;
+
         // If there is a lot of setup to start the animation, then
         // first frame number we get from clutter might be a long ways
         // into the animation (or the animation might even be done).
         // That looks bad, so we always start at the first frame of the
         // animation then only do frame dropping from there.
         if (this._startTime < 0)
-            this._startTime = GLib.get_monotonic_time() / 1000.0;
+            this._startTime = frameTime;
 
         // currentTime is in milliseconds
         let perf_log = Shell.PerfLog.get_default();
-        this._currentTime = GLib.get_monotonic_time() / 1000.0 - this._startTime;
+        this._currentTime = frameTime - this._startTime;
         perf_log.event("tweener.framePrepareStart");
         this.emit('prepare-frame');
         perf_log.event("tweener.framePrepareDone");
@@ -257,15 +411,16 @@ const ClutterFrameTicker = new Lang.Class({
     start : function() {
         if (St.get_slow_down_factor() > 0)
             Tweener.setTimeScale(1 / St.get_slow_down_factor());
-        this._timeline.start();
-        global.begin_work();
+        this._newFrameId = this._animator.connect('new-frame', Lang.bind(this, this._onNewFrame));
+        this._animator.hold_frames();
     },
 
     stop : function() {
-        this._timeline.stop();
+        this._animator.disconnect(this._newFrameId);
+        this._newFrameId = 0;
+        this._animator.release_frames();
         this._startTime = -1;
         this._currentTime = -1;
-        global.end_work();
     }
 });
 
@@ -207,5 +207,9 @@ const WandaSearchProvider = new Lang.Class({
     createResultActor: function (resultMeta, terms) {
         let icon = new WandaIconBin(resultMeta.id, resultMeta.name);
         return icon.actor;
+    },
+
+    updateResultActor: function (actor, resultMeta, terms) {
+        return true;
     }
 });
@@ -1158,7 +1158,7 @@ const Workspace = new Lang.Class({
             return true;
         }
 
-        let actorUnderPointer = global.stage.get_actor_at_pos(Clutter.PickMode.REACTIVE, x, y);
+        let actorUnderPointer = Shell.hit_test_actor_at_pos(global.stage, Clutter.PickMode.REACTIVE, x, y);
         for (let i = 0; i < this._windows.length; i++) {
             if (this._windows[i].actor == actorUnderPointer)
                 return true;
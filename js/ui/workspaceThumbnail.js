@@ -161,6 +161,10 @@ const WorkspaceThumbnail = new Lang.Class({
         this.actor = new St.Widget({ clip_to_allocation: true,
                                      style_class: 'workspace-thumbnail' });
         this.actor._delegate = this;
+        // Thumbnails of idle workspaces are repainted unchanged on
+        // every frame of the overview
+        if (St.cache_effect_get_enabled())
+            this.actor.add_effect_with_name('cache', new St.CacheEffect());
 
         this._contents = new Clutter.Group();
         this.actor.add_actor(this._contents);
@@ -410,8 +410,8 @@ const WorkspacesView = new Lang.Class({
 
         if (result == Overview.SwipeScrollResult.CLICK) {
             let [x, y, mod] = global.get_pointer();
-            let actor = global.stage.get_actor_at_pos(Clutter.PickMode.ALL,
-                                                      x, y);
+            let actor = Shell.hit_test_actor_at_pos(global.stage, Clutter.PickMode.ALL,
+                                                    x, y);
 
             // Only switch to the workspace when there's no application
             // windows open. The problem is that it's too easy to miss
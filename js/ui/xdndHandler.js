@@ -88,7 +88,7 @@ const XdndHandler = new Lang.Class({
     },
 
     _onPositionChanged: function(obj, x, y) {
-        let pickedActor = global.stage.get_actor_at_pos(Clutter.PickMode.ALL, x, y);
+        let pickedActor = Shell.hit_test_actor_at_pos(global.stage, Clutter.PickMode.ALL, x, y);
 
         // Make sure that the cursor window is on top
         if (this._cursorWindowClone)
@@ -0,0 +1,701 @@
+/*
+ * Copyright (C) 2012 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+/* The appointments of all calendars and their occurrences over a
+ * window of time that grows as the requested window moves, so that
+ * paging through the calendar only loads the part not seen yet.
+ * Loading from the calendars themselves is left to a callback.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include "calendar-event-cache.h"
+
+/* Don't let paging through the calendar grow the loaded window
+ * without bounds; past this, start over with just the requested one */
+#define MAX_LOADED_WINDOW (400 * 86400)
+
+struct _CalendarEventCache
+{
+  CalendarEventCacheLoadFunc load_func;
+  gpointer load_data;
+
+  icaltimezone *zone;
+
+  /* hash from uid to CalendarAppointment objects */
+  GHashTable *appointments;
+
+  /* occurrences of all appointments, indexed by time */
+  CalendarOccurrenceStore *occurrences;
+
+  /* the window the appointments and occurrences were generated for */
+  gboolean loaded;
+  time_t loaded_since;
+  time_t loaded_until;
+
+  gboolean invalid;
+};
+
+static time_t
+get_time_from_property (icalcomponent         *ical,
+                        icalproperty_kind      prop_kind,
+                        struct icaltimetype (* get_prop_func) (const icalproperty *prop),
+                        icaltimezone          *default_zone)
+{
+  icalproperty        *prop;
+  struct icaltimetype  ical_time;
+  icalparameter       *param;
+  icaltimezone        *timezone = NULL;
+
+  prop = icalcomponent_get_first_property (ical, prop_kind);
+  if (!prop)
+    return 0;
+
+  ical_time = get_prop_func (prop);
+
+  param = icalproperty_get_first_parameter (prop, ICAL_TZID_PARAMETER);
+  if (param)
+    timezone = icaltimezone_get_builtin_timezone_from_tzid (icalparameter_get_tzid (param));
+  else if (icaltime_is_utc (ical_time))
+    timezone = icaltimezone_get_utc_timezone ();
+  else
+    timezone = default_zone;
+
+  return icaltime_as_timet_with_zone (ical_time, timezone);
+}
+
+static char *
+get_ical_uid (icalcomponent *ical)
+{
+  return g_strdup (icalcomponent_get_uid (ical));
+}
+
+static char *
+get_ical_rid (icalcomponent *ical)
+{
+  icalproperty        *prop;
+  struct icaltimetype  ical_time;
+
+  prop = icalcomponent_get_first_property (ical, ICAL_RECURRENCEID_PROPERTY);
+  if (!prop)
+    return NULL;
+
+  ical_time = icalproperty_get_recurrenceid (prop);
+
+  return icaltime_is_valid_time (ical_time) && !icaltime_is_null_time (ical_time) ?
+    g_strdup (icaltime_as_ical_string (ical_time)) : NULL;
+}
+
+static char *
+get_ical_summary (icalcomponent *ical)
+{
+  icalproperty *prop;
+
+  prop = icalcomponent_get_first_property (ical, ICAL_SUMMARY_PROPERTY);
+  if (!prop)
+    return NULL;
+
+  return g_strdup (icalproperty_get_summary (prop));
+}
+
+static char *
+get_ical_description (icalcomponent *ical)
+{
+  icalproperty *prop;
+
+  prop = icalcomponent_get_first_property (ical, ICAL_DESCRIPTION_PROPERTY);
+  if (!prop)
+    return NULL;
+
+  return g_strdup (icalproperty_get_description (prop));
+}
+
+static inline time_t
+get_ical_start_time (icalcomponent *ical,
+                     icaltimezone  *default_zone)
+{
+  return get_time_from_property (ical,
+                                 ICAL_DTSTART_PROPERTY,
+                                 icalproperty_get_dtstart,
+                                 default_zone);
+}
+
+static inline time_t
+get_ical_end_time (icalcomponent *ical,
+                   icaltimezone  *default_zone)
+{
+  return get_time_from_property (ical,
+                                 ICAL_DTEND_PROPERTY,
+                                 icalproperty_get_dtend,
+                                 default_zone);
+}
+
+static gboolean
+get_ical_is_all_day (icalcomponent *ical,
+                     time_t         start_time,
+                     icaltimezone  *default_zone)
+{
+  icalproperty            *prop;
+  struct tm               *start_tm;
+  time_t                   end_time;
+  struct icaldurationtype  duration;
+  struct icaltimetype      start_icaltime;
+
+  start_icaltime = icalcomponent_get_dtstart (ical);
+  if (start_icaltime.is_date)
+    return TRUE;
+
+  start_tm = gmtime (&start_time);
+  if (start_tm->tm_sec  != 0 ||
+      start_tm->tm_min  != 0 ||
+      start_tm->tm_hour != 0)
+    return FALSE;
+
+  if ((end_time = get_ical_end_time (ical, default_zone)))
+    return (end_time - start_time) % 86400 == 0;
+
+  prop = icalcomponent_get_first_property (ical, ICAL_DURATION_PROPERTY);
+  if (!prop)
+    return FALSE;
+
+  duration = icalproperty_get_duration (prop);
+
+  return icaldurationtype_as_int (duration) % 86400 == 0;
+}
+
+static inline time_t
+get_ical_due_time (icalcomponent *ical,
+                   icaltimezone  *default_zone)
+{
+  return get_time_from_property (ical,
+                                 ICAL_DUE_PROPERTY,
+                                 icalproperty_get_due,
+                                 default_zone);
+}
+
+static inline time_t
+get_ical_completed_time (icalcomponent *ical,
+                         icaltimezone  *default_zone)
+{
+  return get_time_from_property (ical,
+                                 ICAL_COMPLETED_PROPERTY,
+                                 icalproperty_get_completed,
+                                 default_zone);
+}
+
+static inline int
+null_safe_strcmp (const char *a,
+                  const char *b)
+{
+  return (!a && !b) ? 0 : (a && !b) || (!a && b) ? 1 : strcmp (a, b);
+}
+
+static inline gboolean
+calendar_appointment_equal (CalendarAppointment *a,
+                            CalendarAppointment *b)
+{
+  GSList *la, *lb;
+
+  if (g_slist_length (a->occurrences) != g_slist_length (b->occurrences))
+      return FALSE;
+
+  for (la = a->occurrences, lb = b->occurrences; la && lb; la = la->next, lb = lb->next)
+    {
+      CalendarOccurrence *oa = la->data;
+      CalendarOccurrence *ob = lb->data;
+
+      if (oa->start_time != ob->start_time ||
+          oa->end_time   != ob->end_time)
+        return FALSE;
+    }
+
+  return
+    null_safe_strcmp (a->uid,          b->uid)          == 0 &&
+    null_safe_strcmp (a->uri,          b->uri)          == 0 &&
+    null_safe_strcmp (a->summary,      b->summary)      == 0 &&
+    null_safe_strcmp (a->description,  b->description)  == 0 &&
+    null_safe_strcmp (a->color_string, b->color_string) == 0 &&
+    a->start_time == b->start_time                         &&
+    a->end_time   == b->end_time                           &&
+    a->is_all_day == b->is_all_day;
+}
+
+static void
+calendar_appointment_free (CalendarAppointment *appointment)
+{
+  GSList *l;
+
+  for (l = appointment->occurrences; l; l = l->next)
+    g_free (l->data);
+  g_slist_free (appointment->occurrences);
+  appointment->occurrences = NULL;
+
+  g_free (appointment->uid);
+  appointment->uid = NULL;
+
+  g_free (appointment->rid);
+  appointment->rid = NULL;
+
+  g_free (appointment->uri);
+  appointment->uri = NULL;
+
+  g_free (appointment->summary);
+  appointment->summary = NULL;
+
+  g_free (appointment->description);
+  appointment->description = NULL;
+
+  g_free (appointment->color_string);
+  appointment->color_string = NULL;
+
+  appointment->start_time = 0;
+  appointment->is_all_day = FALSE;
+
+  g_free (appointment);
+}
+
+static void
+calendar_appointment_init (CalendarAppointment        *appointment,
+                           icalcomponent              *ical,
+                           const CalendarEventSource  *source,
+                           icaltimezone               *default_zone)
+{
+  appointment->uid          = get_ical_uid (ical);
+  appointment->rid          = get_ical_rid (ical);
+  appointment->uri          = g_strdup (source->uri);
+  appointment->summary      = get_ical_summary (ical);
+  appointment->description  = get_ical_description (ical);
+  appointment->color_string = g_strdup (source->color_string);
+  appointment->start_time   = get_ical_start_time (ical, default_zone);
+  appointment->end_time     = get_ical_end_time (ical, default_zone);
+  appointment->is_all_day   = get_ical_is_all_day (ical,
+                                                   appointment->start_time,
+                                                   default_zone);
+}
+
+static gboolean
+calendar_appointment_collect_occurrence (ECalComponent  *component,
+                                         time_t          occurrence_start,
+                                         time_t          occurrence_end,
+                                         gpointer        data)
+{
+  CalendarOccurrence *occurrence;
+  GSList **collect_loc = data;
+
+  occurrence             = g_new0 (CalendarOccurrence, 1);
+  occurrence->start_time = occurrence_start;
+  occurrence->end_time   = occurrence_end;
+
+  *collect_loc = g_slist_prepend (*collect_loc, occurrence);
+
+  return TRUE;
+}
+
+static void
+calendar_appointment_generate_occurrences (CalendarAppointment        *appointment,
+                                           icalcomponent              *ical,
+                                           const CalendarEventSource  *source,
+                                           time_t                      start,
+                                           time_t                      end,
+                                           icaltimezone               *default_zone)
+{
+  ECalComponent *ecal;
+
+  g_assert (appointment->occurrences == NULL);
+
+  ecal = e_cal_component_new ();
+  e_cal_component_set_icalcomponent (ecal,
+                                     icalcomponent_new_clone (ical));
+
+  e_cal_recur_generate_instances (ecal,
+                                  start,
+                                  end,
+                                  calendar_appointment_collect_occurrence,
+                                  &appointment->occurrences,
+                                  source->resolve_tzid,
+                                  source->resolve_tzid_data,
+                                  default_zone);
+
+  g_object_unref (ecal);
+
+  appointment->occurrences = g_slist_reverse (appointment->occurrences);
+}
+
+static CalendarAppointment *
+calendar_appointment_new (icalcomponent              *ical,
+                          const CalendarEventSource  *source,
+                          icaltimezone               *default_zone)
+{
+  CalendarAppointment *appointment;
+
+  appointment = g_new0 (CalendarAppointment, 1);
+
+  calendar_appointment_init (appointment,
+                             ical,
+                             source,
+                             default_zone);
+  return appointment;
+}
+
+/* ---------------------------------------------------------------------------------------------------- */
+
+static gint
+compare_occurrences (gconstpointer a,
+                     gconstpointer b)
+{
+  const CalendarOccurrence *oa = a;
+  const CalendarOccurrence *ob = b;
+
+  if (oa->start_time != ob->start_time)
+    return oa->start_time < ob->start_time ? -1 : 1;
+  if (oa->end_time != ob->end_time)
+    return oa->end_time < ob->end_time ? -1 : 1;
+  return 0;
+}
+
+CalendarEventCache *
+calendar_event_cache_new (CalendarEventCacheLoadFunc load_func,
+                          gpointer                   user_data)
+{
+  CalendarEventCache *cache;
+
+  cache = g_new0 (CalendarEventCache, 1);
+  cache->load_func = load_func;
+  cache->load_data = user_data;
+  cache->zone = icaltimezone_get_utc_timezone ();
+  cache->appointments = g_hash_table_new_full (g_str_hash,
+                                               g_str_equal,
+                                               g_free,
+                                               (GDestroyNotify) calendar_appointment_free);
+  cache->occurrences = calendar_occurrence_store_new ();
+
+  return cache;
+}
+
+void
+calendar_event_cache_free (CalendarEventCache *cache)
+{
+  calendar_occurrence_store_free (cache->occurrences);
+  g_hash_table_unref (cache->appointments);
+  g_free (cache);
+}
+
+/* Occurrences are generated in @zone; changing it drops everything
+ * loaded so far */
+void
+calendar_event_cache_set_zone (CalendarEventCache *cache,
+                               icaltimezone       *zone)
+{
+  if (zone == cache->zone)
+    return;
+
+  cache->zone = zone;
+  cache->invalid = TRUE;
+}
+
+/* Makes the next calendar_event_cache_ensure_range() start over */
+void
+calendar_event_cache_invalidate (CalendarEventCache *cache)
+{
+  cache->invalid = TRUE;
+}
+
+void
+calendar_event_cache_remove (CalendarEventCache *cache,
+                             const char         *uid)
+{
+  CalendarAppointment *appointment;
+
+  appointment = g_hash_table_lookup (cache->appointments, uid);
+  if (appointment == NULL)
+    return;
+
+  calendar_occurrence_store_remove_owner (cache->occurrences, appointment);
+  g_hash_table_remove (cache->appointments, uid);
+}
+
+/* Takes ownership of @appointment, replacing any appointment with
+ * the same uid */
+static void
+add_appointment (CalendarEventCache  *cache,
+                 CalendarAppointment *appointment)
+{
+  GSList *l;
+
+  calendar_event_cache_remove (cache, appointment->uid);
+
+  for (l = appointment->occurrences; l != NULL; l = l->next)
+    {
+      CalendarOccurrence *o = l->data;
+      calendar_occurrence_store_add (cache->occurrences, appointment,
+                                     o->start_time, o->end_time);
+    }
+
+  g_hash_table_insert (cache->appointments, g_strdup (appointment->uid), appointment);
+}
+
+/* Adds the occurrences of @extra that @appointment doesn't have yet;
+ * occurrences straddling the boundary between two loaded ranges are
+ * generated for both. Frees @extra. */
+static void
+merge_appointment (CalendarEventCache  *cache,
+                   CalendarAppointment *appointment,
+                   CalendarAppointment *extra)
+{
+  GSList *l;
+
+  for (l = extra->occurrences; l != NULL; l = l->next)
+    {
+      CalendarOccurrence *o = l->data;
+
+      if (g_slist_find_custom (appointment->occurrences, o, compare_occurrences) != NULL)
+        continue;
+
+      appointment->occurrences = g_slist_insert_sorted (appointment->occurrences,
+                                                        g_memdup (o, sizeof (CalendarOccurrence)),
+                                                        compare_occurrences);
+      calendar_occurrence_store_add (cache->occurrences, appointment,
+                                     o->start_time, o->end_time);
+    }
+
+  calendar_appointment_free (extra);
+}
+
+static CalendarAppointment *
+create_appointment (CalendarEventCache        *cache,
+                    icalcomponent             *ical,
+                    const CalendarEventSource *source,
+                    time_t                     since,
+                    time_t                     until)
+{
+  CalendarAppointment *appointment;
+
+  appointment = calendar_appointment_new (ical, source, cache->zone);
+  if (appointment == NULL)
+    return NULL;
+
+  calendar_appointment_generate_occurrences (appointment,
+                                             ical,
+                                             source,
+                                             since,
+                                             until,
+                                             cache->zone);
+  return appointment;
+}
+
+/**
+ * calendar_event_cache_add_objects:
+ * @cache: a #CalendarEventCache
+ * @source: where @objects come from
+ * @objects: (element-type icalcomponent): the appointments occurring
+ *   in [@since, @until)
+ * @since: start of the range being loaded
+ * @until: end of the range being loaded
+ *
+ * Adds the occurrences in [@since, @until) of @objects, merging them
+ * with the occurrences of the same appointments elsewhere in the
+ * loaded window. To be called from the load function.
+ */
+void
+calendar_event_cache_add_objects (CalendarEventCache        *cache,
+                                  const CalendarEventSource *source,
+                                  GSList                    *objects,
+                                  time_t                     since,
+                                  time_t                     until)
+{
+  GSList *l;
+
+  for (l = objects; l != NULL; l = l->next)
+    {
+      icalcomponent *ical = l->data;
+      CalendarAppointment *appointment, *existing;
+
+      appointment = create_appointment (cache, ical, source, since, until);
+      if (appointment == NULL)
+        continue;
+
+      existing = g_hash_table_lookup (cache->appointments, appointment->uid);
+      if (existing != NULL)
+        merge_appointment (cache, existing, appointment);
+      else
+        add_appointment (cache, appointment);
+    }
+}
+
+/**
+ * calendar_event_cache_update_objects:
+ * @cache: a #CalendarEventCache
+ * @source: where @objects come from
+ * @objects: (element-type icalcomponent): appointments that were added
+ *   or modified
+ * @only_new: if %TRUE, skip appointments that are already known
+ *
+ * Regenerates the occurrences of @objects over the loaded window.
+ * Appointments whose occurrences and details come out the same are
+ * left alone.
+ *
+ * Returns: %TRUE if anything visible changed
+ */
+gboolean
+calendar_event_cache_update_objects (CalendarEventCache        *cache,
+                                     const CalendarEventSource *source,
+                                     GSList                    *objects,
+                                     gboolean                   only_new)
+{
+  gboolean changed = FALSE;
+  GSList *l;
+
+  for (l = objects; l != NULL; l = l->next)
+    {
+      icalcomponent *ical = l->data;
+      CalendarAppointment *old, *appointment;
+
+      old = g_hash_table_lookup (cache->appointments, icalcomponent_get_uid (ical));
+      if (old != NULL && only_new)
+        continue;
+
+      appointment = create_appointment (cache, ical, source,
+                                        cache->loaded_since,
+                                        cache->loaded_until);
+      if (appointment == NULL)
+        continue;
+
+      if (old != NULL && calendar_appointment_equal (old, appointment))
+        {
+          calendar_appointment_free (appointment);
+          continue;
+        }
+
+      add_appointment (cache, appointment);
+      changed = TRUE;
+    }
+
+  return changed;
+}
+
+static void
+load_range (CalendarEventCache *cache,
+            time_t              since,
+            time_t              until)
+{
+  cache->load_func (cache, since, until, cache->load_data);
+}
+
+static void
+load_all (CalendarEventCache *cache,
+          time_t              since,
+          time_t              until)
+{
+  /* out with the old */
+  calendar_occurrence_store_clear (cache->occurrences);
+  g_hash_table_remove_all (cache->appointments);
+
+  cache->loaded_since = since;
+  cache->loaded_until = until;
+  load_range (cache, since, until);
+
+  cache->loaded = TRUE;
+  cache->invalid = FALSE;
+}
+
+/**
+ * calendar_event_cache_ensure_range:
+ * @cache: a #CalendarEventCache
+ * @since: start of the requested window
+ * @until: end of the requested window
+ * @force_reload: whether to start over
+ *
+ * Makes sure occurrences for [@since, @until) are loaded, reusing the
+ * loaded window where possible and only loading the part of the
+ * requested window that is not covered yet.
+ *
+ * Returns: %TRUE if the loaded window changed
+ */
+gboolean
+calendar_event_cache_ensure_range (CalendarEventCache *cache,
+                                   time_t              since,
+                                   time_t              until,
+                                   gboolean            force_reload)
+{
+  time_t new_since, new_until;
+
+  if (force_reload || cache->invalid || !cache->loaded)
+    {
+      load_all (cache, since, until);
+      return TRUE;
+    }
+
+  if (since >= cache->loaded_since && until <= cache->loaded_until)
+    return FALSE;
+
+  new_since = MIN (since, cache->loaded_since);
+  new_until = MAX (until, cache->loaded_until);
+
+  /* Jumping far away, or having paged through a lot already; loading
+   * the gap would be wasted work */
+  if (new_until - new_since > MAX_LOADED_WINDOW ||
+      until < cache->loaded_since - (until - since) ||
+      since > cache->loaded_until + (until - since))
+    {
+      load_all (cache, since, until);
+      return TRUE;
+    }
+
+  if (new_since < cache->loaded_since)
+    load_range (cache, new_since, cache->loaded_since);
+  if (new_until > cache->loaded_until)
+    load_range (cache, cache->loaded_until, new_until);
+
+  cache->loaded_since = new_since;
+  cache->loaded_until = new_until;
+
+  return TRUE;
+}
+
+void
+calendar_event_cache_get_loaded_range (CalendarEventCache *cache,
+                                       time_t             *since,
+                                       time_t             *until)
+{
+  *since = cache->loaded_since;
+  *until = cache->loaded_until;
+}
+
+CalendarAppointment *
+calendar_event_cache_lookup (CalendarEventCache *cache,
+                             const char         *uid)
+{
+  return g_hash_table_lookup (cache->appointments, uid);
+}
+
+/* Calls @func for each occurrence overlapping [@since, @until), with
+ * the #CalendarAppointment as owner */
+void
+calendar_event_cache_foreach_in_range (CalendarEventCache     *cache,
+                                       time_t                  since,
+                                       time_t                  until,
+                                       CalendarOccurrenceFunc  func,
+                                       gpointer                user_data)
+{
+  calendar_occurrence_store_foreach_in_range (cache->occurrences,
+                                              since, until,
+                                              func, user_data);
+}
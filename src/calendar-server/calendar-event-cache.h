@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2012 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#ifndef __CALENDAR_EVENT_CACHE_H__
+#define __CALENDAR_EVENT_CACHE_H__
+
+#include <time.h>
+#include <glib.h>
+
+#ifndef HANDLE_LIBICAL_MEMORY
+#define HANDLE_LIBICAL_MEMORY
+#endif
+#include <libecal/e-cal-recur.h>
+
+#include "calendar-occurrence-store.h"
+
+G_BEGIN_DECLS
+
+typedef struct
+{
+  time_t start_time;
+  time_t end_time;
+} CalendarOccurrence;
+
+typedef struct
+{
+  char   *uid;
+  char   *rid;
+  char   *uri;
+  char   *summary;
+  char   *description;
+  char   *color_string;
+  time_t  start_time;
+  time_t  end_time;
+  guint   is_all_day : 1;
+
+  /* Only used internally */
+  GSList *occurrences;
+} CalendarAppointment;
+
+/* Where a batch of calendar objects comes from */
+typedef struct
+{
+  const char                 *uri;
+  const char                 *color_string;
+  ECalRecurResolveTimezoneFn  resolve_tzid;
+  gpointer                    resolve_tzid_data;
+} CalendarEventSource;
+
+typedef struct _CalendarEventCache CalendarEventCache;
+
+/* Called to load the appointments occurring in [since, until); it
+ * should hand them to calendar_event_cache_add_objects() */
+typedef void (* CalendarEventCacheLoadFunc) (CalendarEventCache *cache,
+                                             time_t              since,
+                                             time_t              until,
+                                             gpointer            user_data);
+
+CalendarEventCache  *calendar_event_cache_new         (CalendarEventCacheLoadFunc  load_func,
+                                                       gpointer                    user_data);
+void                 calendar_event_cache_free        (CalendarEventCache         *cache);
+
+void                 calendar_event_cache_set_zone    (CalendarEventCache         *cache,
+                                                       icaltimezone               *zone);
+void                 calendar_event_cache_invalidate  (CalendarEventCache         *cache);
+
+gboolean             calendar_event_cache_ensure_range (CalendarEventCache        *cache,
+                                                        time_t                     since,
+                                                        time_t                     until,
+                                                        gboolean                   force_reload);
+void                 calendar_event_cache_get_loaded_range (CalendarEventCache    *cache,
+                                                            time_t                *since,
+                                                            time_t                *until);
+
+void                 calendar_event_cache_add_objects    (CalendarEventCache         *cache,
+                                                          const CalendarEventSource  *source,
+                                                          GSList                     *objects,
+                                                          time_t                      since,
+                                                          time_t                      until);
+gboolean             calendar_event_cache_update_objects (CalendarEventCache         *cache,
+                                                          const CalendarEventSource  *source,
+                                                          GSList                     *objects,
+                                                          gboolean                    only_new);
+void                 calendar_event_cache_remove         (CalendarEventCache         *cache,
+                                                          const char                 *uid);
+
+CalendarAppointment *calendar_event_cache_lookup         (CalendarEventCache         *cache,
+                                                          const char                 *uid);
+void                 calendar_event_cache_foreach_in_range (CalendarEventCache       *cache,
+                                                            time_t                    since,
+                                                            time_t                    until,
+                                                            CalendarOccurrenceFunc    func,
+                                                            gpointer                  user_data);
+
+G_END_DECLS
+
+#endif /* __CALENDAR_EVENT_CACHE_H__ */
@@ -0,0 +1,186 @@
+/*
+ * Copyright (C) 2012 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+/* An index of appointment occurrences that answers "which occurrences
+ * overlap [since, until)" without looking at every appointment.
+ *
+ * Occurrences are kept in a sequence ordered by start time. Together
+ * with the length of the longest occurrence ever added, this bounds
+ * the part of the sequence a range query has to look at: anything
+ * starting before (since - max_length) cannot reach since. Each owner
+ * (appointment) remembers its nodes so that it can be replaced without
+ * touching the rest of the store.
+ */
+
+#include "calendar-occurrence-store.h"
+
+typedef struct
+{
+  time_t   start_time;
+  time_t   end_time;
+  gpointer owner;
+} StoreEntry;
+
+struct _CalendarOccurrenceStore
+{
+  /* StoreEntry *, sorted by start_time */
+  GSequence  *entries;
+
+  /* owner -> GSList of GSequenceIter * */
+  GHashTable *owner_to_iters;
+
+  time_t      max_length;
+};
+
+static gint
+compare_entries (gconstpointer a,
+                 gconstpointer b,
+                 gpointer      user_data)
+{
+  const StoreEntry *ea = a;
+  const StoreEntry *eb = b;
+
+  if (ea->start_time < eb->start_time)
+    return -1;
+  if (ea->start_time > eb->start_time)
+    return 1;
+  return 0;
+}
+
+static void
+free_iter_list (gpointer data)
+{
+  g_slist_free (data);
+}
+
+CalendarOccurrenceStore *
+calendar_occurrence_store_new (void)
+{
+  CalendarOccurrenceStore *store;
+
+  store = g_new0 (CalendarOccurrenceStore, 1);
+  store->entries = g_sequence_new (g_free);
+  store->owner_to_iters = g_hash_table_new_full (g_direct_hash,
+                                                 g_direct_equal,
+                                                 NULL,
+                                                 free_iter_list);
+
+  return store;
+}
+
+void
+calendar_occurrence_store_free (CalendarOccurrenceStore *store)
+{
+  g_hash_table_destroy (store->owner_to_iters);
+  g_sequence_free (store->entries);
+  g_free (store);
+}
+
+void
+calendar_occurrence_store_add (CalendarOccurrenceStore *store,
+                               gpointer                 owner,
+                               time_t                   start_time,
+                               time_t                   end_time)
+{
+  StoreEntry *entry;
+  GSequenceIter *iter;
+  GSList *iters;
+
+  entry = g_new (StoreEntry, 1);
+  entry->start_time = start_time;
+  entry->end_time   = end_time;
+  entry->owner      = owner;
+
+  if (end_time - start_time > store->max_length)
+    store->max_length = end_time - start_time;
+
+  iter = g_sequence_insert_sorted (store->entries, entry, compare_entries, NULL);
+
+  iters = g_hash_table_lookup (store->owner_to_iters, owner);
+  g_hash_table_steal (store->owner_to_iters, owner);
+  g_hash_table_insert (store->owner_to_iters, owner, g_slist_prepend (iters, iter));
+}
+
+void
+calendar_occurrence_store_remove_owner (CalendarOccurrenceStore *store,
+                                        gpointer                 owner)
+{
+  GSList *iters, *l;
+
+  iters = g_hash_table_lookup (store->owner_to_iters, owner);
+  for (l = iters; l != NULL; l = l->next)
+    g_sequence_remove (l->data);
+
+  g_hash_table_remove (store->owner_to_iters, owner);
+}
+
+void
+calendar_occurrence_store_clear (CalendarOccurrenceStore *store)
+{
+  g_hash_table_remove_all (store->owner_to_iters);
+  g_sequence_remove_range (g_sequence_get_begin_iter (store->entries),
+                           g_sequence_get_end_iter (store->entries));
+  store->max_length = 0;
+}
+
+/* Calls @func for every occurrence that starts inside [since, until)
+ * or that started before @since and is still going on then; this is
+ * the set of events GetEvents reports for a window.
+ */
+void
+calendar_occurrence_store_foreach_in_range (CalendarOccurrenceStore *store,
+                                            time_t                   since,
+                                            time_t                   until,
+                                            CalendarOccurrenceFunc   func,
+                                            gpointer                 user_data)
+{
+  StoreEntry key;
+  GSequenceIter *iter;
+
+  key.start_time = since - store->max_length;
+  key.end_time   = 0;
+  key.owner      = NULL;
+
+  /* g_sequence_search() returns the position after any equal items;
+   * step back over those so they are not skipped. */
+  iter = g_sequence_search (store->entries, &key, compare_entries, NULL);
+  while (!g_sequence_iter_is_begin (iter))
+    {
+      GSequenceIter *prev = g_sequence_iter_prev (iter);
+      StoreEntry *entry = g_sequence_get (prev);
+
+      if (entry->start_time < key.start_time)
+        break;
+      iter = prev;
+    }
+
+  for (; !g_sequence_iter_is_end (iter); iter = g_sequence_iter_next (iter))
+    {
+      StoreEntry *entry = g_sequence_get (iter);
+
+      if (entry->start_time >= until)
+        break;
+
+      if ((entry->start_time >= since &&
+           entry->start_time < until) ||
+          (entry->start_time <= since &&
+           (entry->end_time - 1) > since))
+        func (entry->owner, entry->start_time, entry->end_time, user_data);
+    }
+}
@@ -0,0 +1,54 @@
+/*
+ * Copyright (C) 2012 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#ifndef __CALENDAR_OCCURRENCE_STORE_H__
+#define __CALENDAR_OCCURRENCE_STORE_H__
+
+#include <time.h>
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _CalendarOccurrenceStore CalendarOccurrenceStore;
+
+typedef void (* CalendarOccurrenceFunc) (gpointer owner,
+                                         time_t   start_time,
+                                         time_t   end_time,
+                                         gpointer user_data);
+
+CalendarOccurrenceStore *calendar_occurrence_store_new          (void);
+void                     calendar_occurrence_store_free         (CalendarOccurrenceStore *store);
+
+void                     calendar_occurrence_store_add          (CalendarOccurrenceStore *store,
+                                                                 gpointer                 owner,
+                                                                 time_t                   start_time,
+                                                                 time_t                   end_time);
+void                     calendar_occurrence_store_remove_owner (CalendarOccurrenceStore *store,
+                                                                 gpointer                 owner);
+void                     calendar_occurrence_store_clear        (CalendarOccurrenceStore *store);
+
+void                     calendar_occurrence_store_foreach_in_range (CalendarOccurrenceStore *store,
+                                                                     time_t                   since,
+                                                                     time_t                   until,
+                                                                     CalendarOccurrenceFunc   func,
+                                                                     gpointer                 user_data);
+
+G_END_DECLS
+
+#endif /* __CALENDAR_OCCURRENCE_STORE_H__ */
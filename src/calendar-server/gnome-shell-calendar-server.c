@@ -46,6 +46,7 @@
 #define CALENDAR_CONFIG_TIMEZONE CALENDAR_CONFIG_PREFIX "/display/timezone"
 
 #include "calendar-sources.h"
+#include "calendar-event-cache.h"
 
 /* Set the environment variable CALENDAR_SERVER_DEBUG to show debug */
 static void print_debug (const gchar *str, ...);
@@ -80,175 +81,6 @@ static App *_global_app = NULL;
 
 /* ---------------------------------------------------------------------------------------------------- */
 
-typedef struct
-{
-  time_t start_time;
-  time_t end_time;
-} CalendarOccurrence;
-
-typedef struct
-{
-  char   *uid;
-  char   *rid;
-  char   *uri;
-  char   *summary;
-  char   *description;
-  char   *color_string;
-  time_t  start_time;
-  time_t  end_time;
-  guint   is_all_day : 1;
-
-  /* Only used internally */
-  GSList *occurrences;
-} CalendarAppointment;
-
-static time_t
-get_time_from_property (icalcomponent         *ical,
-                        icalproperty_kind      prop_kind,
-                        struct icaltimetype (* get_prop_func) (const icalproperty *prop),
-                        icaltimezone          *default_zone)
-{
-  icalproperty        *prop;
-  struct icaltimetype  ical_time;
-  icalparameter       *param;
-  icaltimezone        *timezone = NULL;
-
-  prop = icalcomponent_get_first_property (ical, prop_kind);
-  if (!prop)
-    return 0;
-
-  ical_time = get_prop_func (prop);
-
-  param = icalproperty_get_first_parameter (prop, ICAL_TZID_PARAMETER);
-  if (param)
-    timezone = icaltimezone_get_builtin_timezone_from_tzid (icalparameter_get_tzid (param));
-  else if (icaltime_is_utc (ical_time))
-    timezone = icaltimezone_get_utc_timezone ();
-  else
-    timezone = default_zone;
-
-  return icaltime_as_timet_with_zone (ical_time, timezone);
-}
-
-static char *
-get_ical_uid (icalcomponent *ical)
-{
-  return g_strdup (icalcomponent_get_uid (ical));
-}
-
-static char *
-get_ical_rid (icalcomponent *ical)
-{
-  icalproperty        *prop;
-  struct icaltimetype  ical_time;
-
-  prop = icalcomponent_get_first_property (ical, ICAL_RECURRENCEID_PROPERTY);
-  if (!prop)
-    return NULL;
-
-  ical_time = icalproperty_get_recurrenceid (prop);
-
-  return icaltime_is_valid_time (ical_time) && !icaltime_is_null_time (ical_time) ?
-    g_strdup (icaltime_as_ical_string (ical_time)) : NULL;
-}
-
-static char *
-get_ical_summary (icalcomponent *ical)
-{
-  icalproperty *prop;
-
-  prop = icalcomponent_get_first_property (ical, ICAL_SUMMARY_PROPERTY);
-  if (!prop)
-    return NULL;
-
-  return g_strdup (icalproperty_get_summary (prop));
-}
-
-static char *
-get_ical_description (icalcomponent *ical)
-{
-  icalproperty *prop;
-
-  prop = icalcomponent_get_first_property (ical, ICAL_DESCRIPTION_PROPERTY);
-  if (!prop)
-    return NULL;
-
-  return g_strdup (icalproperty_get_description (prop));
-}
-
-static inline time_t
-get_ical_start_time (icalcomponent *ical,
-                     icaltimezone  *default_zone)
-{
-  return get_time_from_property (ical,
-                                 ICAL_DTSTART_PROPERTY,
-                                 icalproperty_get_dtstart,
-                                 default_zone);
-}
-
-static inline time_t
-get_ical_end_time (icalcomponent *ical,
-                   icaltimezone  *default_zone)
-{
-  return get_time_from_property (ical,
-                                 ICAL_DTEND_PROPERTY,
-                                 icalproperty_get_dtend,
-                                 default_zone);
-}
-
-static gboolean
-get_ical_is_all_day (icalcomponent *ical,
-                     time_t         start_time,
-                     icaltimezone  *default_zone)
-{
-  icalproperty            *prop;
-  struct tm               *start_tm;
-  time_t                   end_time;
-  struct icaldurationtype  duration;
-  struct icaltimetype      start_icaltime;
-
-  start_icaltime = icalcomponent_get_dtstart (ical);
-  if (start_icaltime.is_date)
-    return TRUE;
-
-  start_tm = gmtime (&start_time);
-  if (start_tm->tm_sec  != 0 ||
-      start_tm->tm_min  != 0 ||
-      start_tm->tm_hour != 0)
-    return FALSE;
-
-  if ((end_time = get_ical_end_time (ical, default_zone)))
-    return (end_time - start_time) % 86400 == 0;
-
-  prop = icalcomponent_get_first_property (ical, ICAL_DURATION_PROPERTY);
-  if (!prop)
-    return FALSE;
-
-  duration = icalproperty_get_duration (prop);
-
-  return icaldurationtype_as_int (duration) % 86400 == 0;
-}
-
-static inline time_t
-get_ical_due_time (icalcomponent *ical,
-                   icaltimezone  *default_zone)
-{
-  return get_time_from_property (ical,
-                                 ICAL_DUE_PROPERTY,
-                                 icalproperty_get_due,
-                                 default_zone);
-}
-
-static inline time_t
-get_ical_completed_time (icalcomponent *ical,
-                         icaltimezone  *default_zone)
-{
-  return get_time_from_property (ical,
-                                 ICAL_COMPLETED_PROPERTY,
-                                 icalproperty_get_completed,
-                                 default_zone);
-}
-
 static char *
 get_source_color (ECalClient *esource)
 {
@@ -286,94 +118,6 @@ get_source_uri (ECalClient *esource)
     return NULL;
 }
 
-static inline int
-null_safe_strcmp (const char *a,
-                  const char *b)
-{
-  return (!a && !b) ? 0 : (a && !b) || (!a && b) ? 1 : strcmp (a, b);
-}
-
-static inline gboolean
-calendar_appointment_equal (CalendarAppointment *a,
-                            CalendarAppointment *b)
-{
-  GSList *la, *lb;
-
-  if (g_slist_length (a->occurrences) != g_slist_length (b->occurrences))
-      return FALSE;
-
-  for (la = a->occurrences, lb = b->occurrences; la && lb; la = la->next, lb = lb->next)
-    {
-      CalendarOccurrence *oa = la->data;
-      CalendarOccurrence *ob = lb->data;
-
-      if (oa->start_time != ob->start_time ||
-          oa->end_time   != ob->end_time)
-        return FALSE;
-    }
-
-  return
-    null_safe_strcmp (a->uid,          b->uid)          == 0 &&
-    null_safe_strcmp (a->uri,          b->uri)          == 0 &&
-    null_safe_strcmp (a->summary,      b->summary)      == 0 &&
-    null_safe_strcmp (a->description,  b->description)  == 0 &&
-    null_safe_strcmp (a->color_string, b->color_string) == 0 &&
-    a->start_time == b->start_time                         &&
-    a->end_time   == b->end_time                           &&
-    a->is_all_day == b->is_all_day;
-}
-
-static void
-calendar_appointment_free (CalendarAppointment *appointment)
-{
-  GSList *l;
-
-  for (l = appointment->occurrences; l; l = l->next)
-    g_free (l->data);
-  g_slist_free (appointment->occurrences);
-  appointment->occurrences = NULL;
-
-  g_free (appointment->uid);
-  appointment->uid = NULL;
-
-  g_free (appointment->rid);
-  appointment->rid = NULL;
-
-  g_free (appointment->uri);
-  appointment->uri = NULL;
-
-  g_free (appointment->summary);
-  appointment->summary = NULL;
-
-  g_free (appointment->description);
-  appointment->description = NULL;
-
-  g_free (appointment->color_string);
-  appointment->color_string = NULL;
-
-  appointment->start_time = 0;
-  appointment->is_all_day = FALSE;
-}
-
-static void
-calendar_appointment_init (CalendarAppointment  *appointment,
-                           icalcomponent        *ical,
-                           ECalClient           *cal,
-                           icaltimezone         *default_zone)
-{
-  appointment->uid          = get_ical_uid (ical);
-  appointment->rid          = get_ical_rid (ical);
-  appointment->uri          = get_source_uri (cal);
-  appointment->summary      = get_ical_summary (ical);
-  appointment->description  = get_ical_description (ical);
-  appointment->color_string = get_source_color (cal);
-  appointment->start_time   = get_ical_start_time (ical, default_zone);
-  appointment->end_time     = get_ical_end_time (ical, default_zone);
-  appointment->is_all_day   = get_ical_is_all_day (ical,
-                                                   appointment->start_time,
-                                                   default_zone);
-}
-
 static icaltimezone *
 resolve_timezone_id (const char *tzid,
                      ECalClient *source)
@@ -389,69 +133,6 @@ resolve_timezone_id (const char *tzid,
   return retval;
 }
 
-static gboolean
-calendar_appointment_collect_occurrence (ECalComponent  *component,
-                                         time_t          occurrence_start,
-                                         time_t          occurrence_end,
-                                         gpointer        data)
-{
-  CalendarOccurrence *occurrence;
-  GSList **collect_loc = data;
-
-  occurrence             = g_new0 (CalendarOccurrence, 1);
-  occurrence->start_time = occurrence_start;
-  occurrence->end_time   = occurrence_end;
-
-  *collect_loc = g_slist_prepend (*collect_loc, occurrence);
-
-  return TRUE;
-}
-
-static void
-calendar_appointment_generate_occurrences (CalendarAppointment *appointment,
-                                           icalcomponent       *ical,
-                                           ECalClient          *cal,
-                                           time_t               start,
-                                           time_t               end,
-                                           icaltimezone        *default_zone)
-{
-  ECalComponent *ecal;
-
-  g_assert (appointment->occurrences == NULL);
-
-  ecal = e_cal_component_new ();
-  e_cal_component_set_icalcomponent (ecal,
-                                     icalcomponent_new_clone (ical));
-
-  e_cal_recur_generate_instances (ecal,
-                                  start,
-                                  end,
-                                  calendar_appointment_collect_occurrence,
-                                  &appointment->occurrences,
-                                  (ECalRecurResolveTimezoneFn) resolve_timezone_id,
-                                  cal,
-                                  default_zone);
-
-  g_object_unref (ecal);
-
-  appointment->occurrences = g_slist_reverse (appointment->occurrences);
-}
-
-static CalendarAppointment *
-calendar_appointment_new (icalcomponent        *ical,
-                          ECalClient           *cal,
-                          icaltimezone         *default_zone)
-{
-  CalendarAppointment *appointment;
-
-  appointment = g_new0 (CalendarAppointment, 1);
-
-  calendar_appointment_init (appointment,
-                             ical,
-                             cal,
-                             default_zone);
-  return appointment;
-}
 
 /* ---------------------------------------------------------------------------------------------------- */
 
@@ -470,19 +151,19 @@ struct _App
   guint                zone_listener;
   GConfClient         *gconf_client;
 
-  /* hash from uid to CalendarAppointment objects */
-  GHashTable *appointments;
+  /* appointments and their occurrences over a window that grows as
+   * the requested window moves */
+  CalendarEventCache *cache;
 
   gchar *timezone_location;
 
   guint changed_timeout_id;
 
-  gboolean cache_invalid;
-
   GList *live_views;
 };
 
-static void
+/* Returns %TRUE if the timezone changed */
+static gboolean
 app_update_timezone (App *app)
 {
   gchar *location;
@@ -497,7 +178,11 @@ app_update_timezone (App *app)
       g_free (app->timezone_location);
       app->timezone_location = location;
       print_debug ("Using timezone %s", app->timezone_location);
+      return TRUE;
     }
+
+  g_free (location);
+  return FALSE;
 }
 
 static gboolean
@@ -529,9 +214,37 @@ app_schedule_changed (App *app)
 }
 
 static void
-invalidate_cache (App *app)
+event_source_init (CalendarEventSource *source,
+                   ECalClient          *cal)
+{
+  source->uri = get_source_uri (cal);
+  source->color_string = get_source_color (cal);
+  source->resolve_tzid = (ECalRecurResolveTimezoneFn) resolve_timezone_id;
+  source->resolve_tzid_data = cal;
+}
+
+static void
+event_source_clear (CalendarEventSource *source)
+{
+  g_free ((char *) source->uri);
+  g_free ((char *) source->color_string);
+}
+
+static void
+app_update_objects (App            *app,
+                    ECalClientView *view,
+                    GSList         *objects,
+                    gboolean        only_new)
 {
-  app->cache_invalid = TRUE;
+  CalendarEventSource source;
+  gboolean changed;
+
+  event_source_init (&source, e_cal_client_view_get_client (view));
+  changed = calendar_event_cache_update_objects (app->cache, &source, objects, only_new);
+  event_source_clear (&source);
+
+  if (changed)
+    app_schedule_changed (app);
 }
 
 static void
@@ -540,24 +253,12 @@ on_objects_added (ECalClientView *view,
                   gpointer        user_data)
 {
   App *app = user_data;
-  GSList *l;
 
   print_debug ("%s for calendar", G_STRFUNC);
 
-  for (l = objects; l != NULL; l = l->next)
-    {
-      icalcomponent *ical = l->data;
-      const char *uid;
-
-      uid = icalcomponent_get_uid (ical);
-
-      if (g_hash_table_lookup (app->appointments, uid) == NULL)
-        {
-          /* new appointment we don't know about => changed signal */
-          invalidate_cache (app);
-          app_schedule_changed (app);
-        }
-    }
+  /* Starting a view reports everything it matches as added; we
+   * already know about those */
+  app_update_objects (app, view, objects, TRUE);
 }
 
 static void
@@ -566,9 +267,10 @@ on_objects_modified (ECalClientView *view,
                      gpointer        user_data)
 {
   App *app = user_data;
+
   print_debug ("%s for calendar", G_STRFUNC);
-  invalidate_cache (app);
-  app_schedule_changed (app);
+
+  app_update_objects (app, view, objects, FALSE);
 }
 
 static void
@@ -577,23 +279,30 @@ on_objects_removed (ECalClientView *view,
                     gpointer        user_data)
 {
   App *app = user_data;
+  GSList *l;
+
   print_debug ("%s for calendar", G_STRFUNC);
-  invalidate_cache (app);
+
+  for (l = uids; l != NULL; l = l->next)
+    {
+      ECalComponentId *id = l->data;
+
+      /* Removing a detached instance changes the occurrences of the
+       * master, which we don't track separately */
+      if (id->rid != NULL && *id->rid != '\0')
+        calendar_event_cache_invalidate (app->cache);
+      else
+        calendar_event_cache_remove (app->cache, id->uid);
+    }
+
   app_schedule_changed (app);
 }
 
 static void
-app_load_events (App *app)
+app_stop_views (App *app)
 {
-  GSList *sources;
-  GSList *l;
   GList *ll;
-  gchar *since_iso8601;
-  gchar *until_iso8601;
 
-  /* out with the old */
-  g_hash_table_remove_all (app->appointments);
-  /* nuke existing views */
   for (ll = app->live_views; ll != NULL; ll = ll->next)
     {
       ECalClientView *view = E_CAL_CLIENT_VIEW (ll->data);
@@ -605,75 +314,51 @@ app_load_events (App *app)
     }
   g_list_free (app->live_views);
   app->live_views = NULL;
+}
 
-  /* timezone could have changed */
-  app_update_timezone (app);
+static gchar *
+make_time_range_query (time_t since,
+                       time_t until)
+{
+  gchar *since_iso8601;
+  gchar *until_iso8601;
+  gchar *query;
+
+  since_iso8601 = isodate_from_time_t (since);
+  until_iso8601 = isodate_from_time_t (until);
+
+  query = g_strdup_printf ("occur-in-time-range? (make-time \"%s\") "
+                           "(make-time \"%s\")",
+                           since_iso8601,
+                           until_iso8601);
+
+  g_free (since_iso8601);
+  g_free (until_iso8601);
+
+  return query;
+}
 
-  since_iso8601 = isodate_from_time_t (app->since);
-  until_iso8601 = isodate_from_time_t (app->until);
+/* Watch the whole loaded window for changes */
+static void
+app_start_views (App *app)
+{
+  GSList *sources;
+  GSList *l;
+  gchar *query;
+  time_t since, until;
 
-  print_debug ("Loading events since %s until %s",
-               since_iso8601,
-               until_iso8601);
+  calendar_event_cache_get_loaded_range (app->cache, &since, &until);
+  query = make_time_range_query (since, until);
 
   sources = calendar_sources_get_appointment_sources (app->sources);
   for (l = sources; l != NULL; l = l->next)
     {
       ECalClient *cal = E_CAL_CLIENT (l->data);
       GError *error;
-      gchar *query;
-      GSList *objects, *j;
       ECalClientView *view;
 
-      e_cal_client_set_default_timezone (cal, app->zone);
-
-      error = NULL;
-      if (!e_client_open_sync (E_CLIENT (cal), TRUE, NULL, &error))
-        {
-          g_warning ("Error opening calendar %s: %s\n",
-		     e_client_get_uri (E_CLIENT (cal)), error->message);
-          g_error_free (error);
-          continue;
-        }
-
-      query = g_strdup_printf ("occur-in-time-range? (make-time \"%s\") "
-                               "(make-time \"%s\")",
-                               since_iso8601,
-                               until_iso8601);
-      error = NULL;
-      objects = NULL;
-      if (!e_cal_client_get_object_list_sync (cal,
-					      query,
-					      &objects,
-					      NULL, /* cancellable */
-					      &error))
-        {
-          g_warning ("Error querying calendar %s: %s\n",
-		     e_client_get_uri (E_CLIENT (cal)), error->message);
-          g_error_free (error);
-          g_free (query);
-          continue;
-        }
-
-      for (j = objects; j != NULL; j = j->next)
-        {
-          icalcomponent *ical = j->data;
-          CalendarAppointment *appointment;
-
-          appointment = calendar_appointment_new (ical, cal, app->zone);
-          if (appointment == NULL)
-            continue;
-
-          calendar_appointment_generate_occurrences (appointment,
-                                                     ical,
-                                                     cal,
-                                                     app->since,
-                                                     app->until,
-                                                     app->zone);
-          g_hash_table_insert (app->appointments, g_strdup (appointment->uid), appointment);
-        }
-
-      e_cal_client_free_icalcomp_slist (objects);
+      if (!e_client_is_opened (E_CLIENT (cal)))
+        continue;
 
       error = NULL;
       if (!e_cal_client_get_view_sync (cal,
@@ -702,12 +387,88 @@ app_load_events (App *app)
           e_cal_client_view_start (view, NULL);
           app->live_views = g_list_prepend (app->live_views, view);
         }
+    }
+
+  g_free (query);
+}
 
-      g_free (query);
+/* Loads the appointments occurring in [since, until) and their
+ * occurrences in that range into the cache */
+static void
+app_load_range (CalendarEventCache *cache,
+                time_t              since,
+                time_t              until,
+                gpointer            user_data)
+{
+  App *app = user_data;
+  GSList *sources;
+  GSList *l;
+  gchar *query;
+
+  print_debug ("Loading events since %" G_GINT64_FORMAT " until %" G_GINT64_FORMAT,
+               (gint64) since,
+               (gint64) until);
+
+  query = make_time_range_query (since, until);
+
+  sources = calendar_sources_get_appointment_sources (app->sources);
+  for (l = sources; l != NULL; l = l->next)
+    {
+      ECalClient *cal = E_CAL_CLIENT (l->data);
+      CalendarEventSource source;
+      GError *error;
+      GSList *objects;
+
+      e_cal_client_set_default_timezone (cal, app->zone);
+
+      error = NULL;
+      if (!e_client_open_sync (E_CLIENT (cal), TRUE, NULL, &error))
+        {
+          g_warning ("Error opening calendar %s: %s\n",
+		     e_client_get_uri (E_CLIENT (cal)), error->message);
+          g_error_free (error);
+          continue;
+        }
+
+      error = NULL;
+      objects = NULL;
+      if (!e_cal_client_get_object_list_sync (cal,
+					      query,
+					      &objects,
+					      NULL, /* cancellable */
+					      &error))
+        {
+          g_warning ("Error querying calendar %s: %s\n",
+		     e_client_get_uri (E_CLIENT (cal)), error->message);
+          g_error_free (error);
+          continue;
+        }
+
+      event_source_init (&source, cal);
+      calendar_event_cache_add_objects (cache, &source, objects, since, until);
+      event_source_clear (&source);
+
+      e_cal_client_free_icalcomp_slist (objects);
+    }
+
+  g_free (query);
+}
+
+/* Makes sure occurrences for the requested window are loaded, reusing
+ * the loaded window where possible */
+static void
+app_ensure_events (App      *app,
+                   gboolean  force_reload)
+{
+  /* timezone could have changed */
+  if (app_update_timezone (app))
+    calendar_event_cache_set_zone (app->cache, app->zone);
+
+  if (calendar_event_cache_ensure_range (app->cache, app->since, app->until, force_reload))
+    {
+      app_stop_views (app);
+      app_start_views (app);
     }
-  g_free (since_iso8601);
-  g_free (until_iso8601);
-  app->cache_invalid = FALSE;
 }
 
 static void
@@ -717,7 +478,7 @@ on_appointment_sources_changed (CalendarSources *sources,
   App *app = user_data;
 
   print_debug ("Sources changed\n");
-  app_load_events (app);
+  app_ensure_events (app, TRUE);
 }
 
 static App *
@@ -733,12 +494,10 @@ app_new (GDBusConnection *connection)
                                              G_CALLBACK (on_appointment_sources_changed),
                                              app);
 
-  app->appointments = g_hash_table_new_full (g_str_hash,
-                                             g_str_equal,
-                                             g_free,
-                                             (GDestroyNotify) calendar_appointment_free);
+  app->cache = calendar_event_cache_new (app_load_range, app);
 
   app_update_timezone (app);
+  calendar_event_cache_set_zone (app->cache, app->zone);
 
   return app;
 }
@@ -746,21 +505,11 @@ app_new (GDBusConnection *connection)
 static void
 app_free (App *app)
 {
-  GList *ll;
-  for (ll = app->live_views; ll != NULL; ll = ll->next)
-    {
-      ECalClientView *view = E_CAL_CLIENT_VIEW (ll->data);
-      g_signal_handlers_disconnect_by_func (view, on_objects_added, app);
-      g_signal_handlers_disconnect_by_func (view, on_objects_modified, app);
-      g_signal_handlers_disconnect_by_func (view, on_objects_removed, app);
-      e_cal_client_view_stop (view, NULL);
-      g_object_unref (view);
-    }
-  g_list_free (app->live_views);
+  app_stop_views (app);
 
   g_free (app->timezone_location);
 
-  g_hash_table_unref (app->appointments);
+  calendar_event_cache_free (app->cache);
 
   g_object_unref (app->connection);
   g_signal_handler_disconnect (app->sources,
@@ -775,6 +524,28 @@ app_free (App *app)
 
 /* ---------------------------------------------------------------------------------------------------- */
 
+static void
+add_event_to_builder (gpointer owner,
+                      time_t   start_time,
+                      time_t   end_time,
+                      gpointer user_data)
+{
+  CalendarAppointment *a = owner;
+  GVariantBuilder *builder = user_data;
+  GVariantBuilder extras_builder;
+
+  g_variant_builder_init (&extras_builder, G_VARIANT_TYPE ("a{sv}"));
+  g_variant_builder_add (builder,
+                         "(sssbxxa{sv})",
+                         a->uid,
+                         a->summary != NULL ? a->summary : "",
+                         a->description != NULL ? a->description : "",
+                         (gboolean) a->is_all_day,
+                         (gint64) start_time,
+                         (gint64) end_time,
+                         &extras_builder);
+}
+
 static void
 handle_method_call (GDBusConnection       *connection,
                     const gchar           *sender,
@@ -790,12 +561,9 @@ handle_method_call (GDBusConnection       *connection,
   if (g_strcmp0 (method_name, "GetEvents") == 0)
     {
       GVariantBuilder builder;
-      GHashTableIter hash_iter;
-      CalendarAppointment *a;
       gint64 since;
       gint64 until;
       gboolean force_reload;
-      gboolean window_changed;
 
       g_variant_get (parameters,
                      "(xxb)",
@@ -816,7 +584,6 @@ handle_method_call (GDBusConnection       *connection,
                    until,
                    force_reload ? "true" : "false");
 
-      window_changed = FALSE;
       if (!(app->until == until && app->since == since))
         {
           GVariantBuilder *builder;
@@ -824,7 +591,6 @@ handle_method_call (GDBusConnection       *connection,
 
           app->until = until;
           app->since = since;
-          window_changed = TRUE;
 
           builder = g_variant_builder_new (G_VARIANT_TYPE ("a{sv}"));
           invalidated_builder = g_variant_builder_new (G_VARIANT_TYPE ("as"));
@@ -844,46 +610,18 @@ handle_method_call (GDBusConnection       *connection,
                                          NULL); /* GError** */
         }
 
-      /* reload events if necessary */
-      if (window_changed || force_reload || app->cache_invalid)
-        {
-          app_load_events (app);
-        }
+      /* load events if necessary */
+      app_ensure_events (app, force_reload);
 
       /* The a{sv} is used as an escape hatch in case we want to provide more
        * information in the future without breaking ABI
        */
       g_variant_builder_init (&builder, G_VARIANT_TYPE ("a(sssbxxa{sv})"));
-      g_hash_table_iter_init (&hash_iter, app->appointments);
-      while (g_hash_table_iter_next (&hash_iter, NULL, (gpointer) &a))
-        {
-          GVariantBuilder extras_builder;
-          GSList *l;
-
-          for (l = a->occurrences; l; l = l->next)
-            {
-              CalendarOccurrence *o = l->data;
-              time_t start_time = o->start_time;
-              time_t end_time   = o->end_time;
-
-              if ((start_time >= app->since &&
-                   start_time < app->until) ||
-                  (start_time <= app->since &&
-                  (end_time - 1) > app->since))
-                {
-                  g_variant_builder_init (&extras_builder, G_VARIANT_TYPE ("a{sv}"));
-                  g_variant_builder_add (&builder,
-                                         "(sssbxxa{sv})",
-                                         a->uid,
-                                         a->summary != NULL ? a->summary : "",
-                                         a->description != NULL ? a->description : "",
-                                         (gboolean) a->is_all_day,
-                                         (gint64) start_time,
-                                         (gint64) end_time,
-                                         extras_builder);
-                }
-            }
-        }
+      calendar_event_cache_foreach_in_range (app->cache,
+                                             app->since,
+                                             app->until,
+                                             add_event_to_builder,
+                                             &builder);
       g_dbus_method_invocation_return_value (invocation,
                                              g_variant_new ("(a(sssbxxa{sv}))", &builder));
     }
@@ -0,0 +1,609 @@
+/*
+ * Copyright (C) 2012 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+/* Serves a copy of calendar-server/test-calendar.ics through the event
+ * cache the way the calendar server serves its calendars, and checks
+ * that:
+ * - range queries on the occurrence store agree with a linear scan of
+ *   the expanded recurrences, also after an appointment is removed or
+ *   everything is reloaded
+ * - moving the requested window only loads what is not loaded yet, and
+ *   the merged occurrences match a single load
+ * - after the file changes only new or changed appointments are
+ *   replaced
+ */
+
+#include "config.h"
+
+#include <string.h>
+#include <unistd.h>
+#include <glib/gstdio.h>
+
+#include "calendar-event-cache.h"
+
+#define JAN_1  1325376000 /* 2012-01-01 UTC */
+#define FEB_1  1328054400
+#define FEB_15 (FEB_1 + 14 * 86400)
+#define MAR_1  1330560000
+#define MAR_15 (MAR_1 + 14 * 86400)
+#define APR_1  1333238400
+
+/* In the middle of the first daily standup, 09:00-09:15 */
+#define MAR_1_0905 (MAR_1 + 9 * 3600 + 5 * 60)
+
+typedef struct
+{
+  time_t since;
+  time_t until;
+} Range;
+
+typedef struct
+{
+  const char *uid;
+  time_t      start_time;
+  time_t      end_time;
+} Occurrence;
+
+static const char *calendar_path;
+static GArray *loads;
+static gboolean fail;
+
+static icaltimezone *
+resolve_timezone_id (const char *tzid,
+                     gpointer    data)
+{
+  return icaltimezone_get_builtin_timezone_from_tzid (tzid);
+}
+
+static const CalendarEventSource test_source = {
+  "file", NULL, (ECalRecurResolveTimezoneFn) resolve_timezone_id, NULL
+};
+
+static icalcomponent *
+parse_calendar (void)
+{
+  icalcomponent *calendar;
+  gchar *contents;
+
+  if (!g_file_get_contents (calendar_path, &contents, NULL, NULL))
+    g_error ("Cannot read %s", calendar_path);
+
+  calendar = icalparser_parse_string (contents);
+  g_free (contents);
+  g_assert (calendar != NULL);
+
+  return calendar;
+}
+
+/* The events of @calendar, owned by @calendar */
+static GSList *
+get_objects (icalcomponent *calendar)
+{
+  icalcomponent *ical;
+  GSList *objects = NULL;
+
+  for (ical = icalcomponent_get_first_component (calendar, ICAL_VEVENT_COMPONENT);
+       ical != NULL;
+       ical = icalcomponent_get_next_component (calendar, ICAL_VEVENT_COMPONENT))
+    objects = g_slist_prepend (objects, ical);
+
+  return g_slist_reverse (objects);
+}
+
+static void
+load_range (CalendarEventCache *cache,
+            time_t              since,
+            time_t              until,
+            gpointer            user_data)
+{
+  icalcomponent *calendar;
+  GSList *objects;
+  Range range;
+
+  range.since = since;
+  range.until = until;
+  g_array_append_val (loads, range);
+
+  calendar = parse_calendar ();
+  objects = get_objects (calendar);
+  calendar_event_cache_add_objects (cache, &test_source, objects, since, until);
+  g_slist_free (objects);
+  icalcomponent_free (calendar);
+}
+
+static void
+check_loads (const char  *test,
+             const Range *expected,
+             guint        n_expected)
+{
+  guint i;
+
+  if (loads->len != n_expected)
+    {
+      g_print ("%s: expected %u loads, got %u\n", test, n_expected, loads->len);
+      fail = TRUE;
+    }
+
+  for (i = 0; i < MIN (loads->len, n_expected); i++)
+    {
+      Range *r = &g_array_index (loads, Range, i);
+
+      if (r->since != expected[i].since || r->until != expected[i].until)
+        {
+          g_print ("%s: load %u: expected %ld-%ld, got %ld-%ld\n", test, i,
+                   (long) expected[i].since, (long) expected[i].until,
+                   (long) r->since, (long) r->until);
+          fail = TRUE;
+        }
+    }
+
+  g_array_set_size (loads, 0);
+}
+
+static void
+collect_occurrence (gpointer owner,
+                    time_t   start_time,
+                    time_t   end_time,
+                    gpointer user_data)
+{
+  CalendarAppointment *appointment = owner;
+  Occurrence o;
+
+  o.uid = g_intern_string (appointment->uid);
+  o.start_time = start_time;
+  o.end_time = end_time;
+  g_array_append_val (user_data, o);
+}
+
+static gint
+compare_occurrences (gconstpointer a,
+                     gconstpointer b)
+{
+  const Occurrence *oa = a;
+  const Occurrence *ob = b;
+
+  if (oa->start_time != ob->start_time)
+    return oa->start_time < ob->start_time ? -1 : 1;
+  if (oa->end_time != ob->end_time)
+    return oa->end_time < ob->end_time ? -1 : 1;
+  return strcmp (oa->uid, ob->uid);
+}
+
+static GArray *
+get_occurrences (CalendarEventCache *cache,
+                 time_t              since,
+                 time_t              until)
+{
+  GArray *occurrences = g_array_new (FALSE, FALSE, sizeof (Occurrence));
+
+  calendar_event_cache_foreach_in_range (cache, since, until,
+                                         collect_occurrence, occurrences);
+  g_array_sort (occurrences, compare_occurrences);
+
+  return occurrences;
+}
+
+static void
+check_same_occurrences (const char         *test,
+                        CalendarEventCache *cache,
+                        CalendarEventCache *reference,
+                        time_t              since,
+                        time_t              until)
+{
+  GArray *got = get_occurrences (cache, since, until);
+  GArray *expected = get_occurrences (reference, since, until);
+  guint i;
+
+  if (expected->len == 0)
+    {
+      g_print ("%s: no occurrences found in %s\n", test, calendar_path);
+      fail = TRUE;
+    }
+
+  if (got->len != expected->len)
+    {
+      g_print ("%s: expected %u occurrences, got %u\n", test, expected->len, got->len);
+      fail = TRUE;
+    }
+  else
+    {
+      for (i = 0; i < got->len; i++)
+        {
+          if (compare_occurrences (&g_array_index (got, Occurrence, i),
+                                   &g_array_index (expected, Occurrence, i)) != 0)
+            {
+              g_print ("%s: occurrence %u differs\n", test, i);
+              fail = TRUE;
+              break;
+            }
+        }
+    }
+
+  g_array_free (got, TRUE);
+  g_array_free (expected, TRUE);
+}
+
+static gboolean
+collect_expanded (ECalComponent *component,
+                  time_t         start,
+                  time_t         end,
+                  gpointer       data)
+{
+  Occurrence o;
+
+  o.uid = NULL;
+  o.start_time = start;
+  o.end_time = end;
+  g_array_append_val (data, o);
+
+  return TRUE;
+}
+
+/* Expands the recurrences of the calendar directly, without the cache */
+static GArray *
+expand_calendar (time_t since,
+                 time_t until)
+{
+  GArray *occurrences = g_array_new (FALSE, FALSE, sizeof (Occurrence));
+  icalcomponent *calendar;
+  GSList *objects, *l;
+
+  calendar = parse_calendar ();
+  objects = get_objects (calendar);
+
+  for (l = objects; l != NULL; l = l->next)
+    {
+      icalcomponent *ical = l->data;
+      ECalComponent *ecal = e_cal_component_new ();
+      guint i, first = occurrences->len;
+
+      e_cal_component_set_icalcomponent (ecal, icalcomponent_new_clone (ical));
+      e_cal_recur_generate_instances (ecal, since, until,
+                                      collect_expanded, occurrences,
+                                      (ECalRecurResolveTimezoneFn) resolve_timezone_id,
+                                      NULL,
+                                      icaltimezone_get_utc_timezone ());
+      g_object_unref (ecal);
+
+      for (i = first; i < occurrences->len; i++)
+        g_array_index (occurrences, Occurrence, i).uid =
+          g_intern_string (icalcomponent_get_uid (ical));
+    }
+
+  g_slist_free (objects);
+  icalcomponent_free (calendar);
+
+  return occurrences;
+}
+
+static void
+count_occurrence (gpointer owner,
+                  time_t   start_time,
+                  time_t   end_time,
+                  gpointer user_data)
+{
+  (*(guint *) user_data)++;
+}
+
+static guint
+count_linear (GArray *occurrences,
+              time_t  since,
+              time_t  until)
+{
+  guint i, n = 0;
+
+  for (i = 0; i < occurrences->len; i++)
+    {
+      Occurrence *o = &g_array_index (occurrences, Occurrence, i);
+
+      if (o->uid == NULL)
+        continue;
+
+      if ((o->start_time >= since && o->start_time < until) ||
+          (o->start_time <= since && (o->end_time - 1) > since))
+        n++;
+    }
+
+  return n;
+}
+
+static void
+check_windows (const char         *test,
+               CalendarEventCache *cache,
+               GArray             *occurrences,
+               time_t              first,
+               time_t              last)
+{
+  time_t since;
+
+  if (occurrences->len == 0)
+    {
+      g_print ("%s: no occurrences found in %s\n", test, calendar_path);
+      fail = TRUE;
+    }
+
+  /* Month-sized windows, as the calendar popup requests, and
+   * single days, stepping a day at a time */
+  for (since = first; since < last; since += 86400)
+    {
+      time_t lengths[] = { 86400, 31 * 86400 };
+      guint i;
+
+      for (i = 0; i < G_N_ELEMENTS (lengths); i++)
+        {
+          guint n_store = 0;
+          guint n_linear = count_linear (occurrences, since, since + lengths[i]);
+
+          calendar_event_cache_foreach_in_range (cache, since, since + lengths[i],
+                                                 count_occurrence, &n_store);
+          if (n_store != n_linear)
+            {
+              g_print ("%s: window %ld+%ld: expected %u occurrences, got %u\n",
+                       test, (long) since, (long) lengths[i], n_linear, n_store);
+              fail = TRUE;
+            }
+        }
+    }
+}
+
+static void
+test_ranges (void)
+{
+  CalendarEventCache *cache;
+  GArray *occurrences;
+  const char *weekly = g_intern_string ("weekly-meeting@test");
+  guint i;
+
+  cache = calendar_event_cache_new (load_range, NULL);
+
+  calendar_event_cache_ensure_range (cache, JAN_1, APR_1, FALSE);
+  occurrences = expand_calendar (JAN_1, APR_1);
+  check_windows ("ranges", cache, occurrences, JAN_1 - 31 * 86400, APR_1);
+
+  /* As when an appointment is removed from the calendar */
+  calendar_event_cache_remove (cache, weekly);
+  for (i = 0; i < occurrences->len; i++)
+    {
+      Occurrence *o = &g_array_index (occurrences, Occurrence, i);
+      if (o->uid == weekly)
+        o->uid = NULL;
+    }
+  check_windows ("remove", cache, occurrences, JAN_1, APR_1);
+  g_array_free (occurrences, TRUE);
+
+  /* Starting over drops everything that was loaded before */
+  calendar_event_cache_ensure_range (cache, FEB_1, MAR_1, TRUE);
+  occurrences = expand_calendar (FEB_1, MAR_1);
+  check_windows ("reload", cache, occurrences, JAN_1, APR_1);
+  g_array_free (occurrences, TRUE);
+
+  g_array_set_size (loads, 0);
+  calendar_event_cache_free (cache);
+}
+
+static void
+test_incremental (CalendarEventCache *cache)
+{
+  static const Range first[] = {
+    { FEB_1, MAR_1_0905 }
+  };
+  static const Range forward[] = {
+    { MAR_1_0905, APR_1 }
+  };
+  static const Range backward[] = {
+    { JAN_1, FEB_1 }
+  };
+  CalendarEventCache *reference;
+
+  calendar_event_cache_ensure_range (cache, FEB_1, MAR_1_0905, FALSE);
+  check_loads ("first", first, G_N_ELEMENTS (first));
+
+  /* Paging forward, with the boundary in the middle of an occurrence */
+  calendar_event_cache_ensure_range (cache, MAR_1_0905, APR_1, FALSE);
+  check_loads ("forward", forward, G_N_ELEMENTS (forward));
+
+  /* Already loaded */
+  if (calendar_event_cache_ensure_range (cache, FEB_15, MAR_15, FALSE))
+    {
+      g_print ("inside: loaded window changed\n");
+      fail = TRUE;
+    }
+  check_loads ("inside", NULL, 0);
+
+  calendar_event_cache_ensure_range (cache, JAN_1, FEB_1, FALSE);
+  check_loads ("backward", backward, G_N_ELEMENTS (backward));
+
+  reference = calendar_event_cache_new (load_range, NULL);
+  calendar_event_cache_ensure_range (reference, JAN_1, APR_1, FALSE);
+  g_array_set_size (loads, 0);
+
+  check_same_occurrences ("merge", cache, reference, JAN_1, APR_1);
+
+  calendar_event_cache_free (reference);
+}
+
+static void
+change_calendar (void)
+{
+  static const char lunch[] =
+    "BEGIN:VEVENT\n"
+    "UID:lunch@test\n"
+    "DTSTAMP:20120101T000000Z\n"
+    "DTSTART:20120320T120000Z\n"
+    "DTEND:20120320T130000Z\n"
+    "SUMMARY:Lunch\n"
+    "END:VEVENT\n";
+  gchar *contents, *end;
+  gchar **parts;
+  GString *changed;
+
+  if (!g_file_get_contents (calendar_path, &contents, NULL, NULL))
+    g_error ("Cannot read %s", calendar_path);
+
+  /* Rename one appointment and add another */
+  parts = g_strsplit (contents, "SUMMARY:Standup", 2);
+  g_assert (parts[1] != NULL);
+  changed = g_string_new (parts[0]);
+  g_string_append (changed, "SUMMARY:Daily standup");
+  g_string_append (changed, parts[1]);
+  g_strfreev (parts);
+
+  end = strstr (changed->str, "END:VCALENDAR");
+  g_assert (end != NULL);
+  g_string_insert (changed, end - changed->str, lunch);
+
+  if (!g_file_set_contents (calendar_path, changed->str, -1, NULL))
+    g_error ("Cannot write %s", calendar_path);
+
+  g_string_free (changed, TRUE);
+  g_free (contents);
+}
+
+static void
+check_replaced (const char          *test,
+                CalendarEventCache  *cache,
+                const char          *uid,
+                CalendarAppointment *before,
+                gboolean             expected)
+{
+  CalendarAppointment *after = calendar_event_cache_lookup (cache, uid);
+
+  if (after == NULL)
+    {
+      g_print ("%s: %s is gone\n", test, uid);
+      fail = TRUE;
+    }
+  else if ((after != before) != expected)
+    {
+      g_print ("%s: %s was %sreplaced\n", test, uid, expected ? "not " : "");
+      fail = TRUE;
+    }
+}
+
+static void
+test_update (CalendarEventCache *cache)
+{
+  static const char *uids[] = {
+    "weekly-meeting@test", "daily-standup@test", "vacation@test",
+    "dentist@test", "new-year@test", "reminder@test"
+  };
+  CalendarAppointment *before[G_N_ELEMENTS (uids)];
+  CalendarAppointment *lunch, *standup;
+  icalcomponent *calendar;
+  GSList *objects;
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS (uids); i++)
+    before[i] = calendar_event_cache_lookup (cache, uids[i]);
+
+  change_calendar ();
+  calendar = parse_calendar ();
+  objects = get_objects (calendar);
+
+  /* As reported when the views are started: only the added event is
+   * new */
+  if (!calendar_event_cache_update_objects (cache, &test_source, objects, TRUE))
+    {
+      g_print ("added: no change reported\n");
+      fail = TRUE;
+    }
+  for (i = 0; i < G_N_ELEMENTS (uids); i++)
+    check_replaced ("added", cache, uids[i], before[i], FALSE);
+
+  lunch = calendar_event_cache_lookup (cache, "lunch@test");
+  if (lunch == NULL)
+    {
+      g_print ("added: lunch@test is missing\n");
+      fail = TRUE;
+    }
+
+  /* As reported when every event is modified: only the renamed one
+   * actually changed */
+  if (!calendar_event_cache_update_objects (cache, &test_source, objects, FALSE))
+    {
+      g_print ("modified: no change reported\n");
+      fail = TRUE;
+    }
+  for (i = 0; i < G_N_ELEMENTS (uids); i++)
+    check_replaced ("modified", cache, uids[i], before[i],
+                    strcmp (uids[i], "daily-standup@test") == 0);
+  check_replaced ("modified", cache, "lunch@test", lunch, FALSE);
+
+  standup = calendar_event_cache_lookup (cache, "daily-standup@test");
+  if (standup == NULL || g_strcmp0 (standup->summary, "Daily standup") != 0)
+    {
+      g_print ("modified: daily-standup@test wasn't renamed\n");
+      fail = TRUE;
+    }
+
+  if (calendar_event_cache_update_objects (cache, &test_source, objects, FALSE))
+    {
+      g_print ("unchanged: change reported\n");
+      fail = TRUE;
+    }
+
+  /* Nothing was loaded again */
+  check_loads ("update", NULL, 0);
+
+  g_slist_free (objects);
+  icalcomponent_free (calendar);
+}
+
+int
+main (int argc, char **argv)
+{
+  CalendarEventCache *cache;
+  const char *fixture;
+  gchar *contents;
+  gsize length;
+  gchar *path;
+  gint fd;
+
+  g_type_init ();
+
+  fixture = argc > 1 ? argv[1] : "calendar-server/test-calendar.ics";
+
+  /* Work on a copy, which gets changed halfway */
+  if (!g_file_get_contents (fixture, &contents, &length, NULL))
+    g_error ("Cannot read %s", fixture);
+
+  fd = g_file_open_tmp ("test-event-cache-XXXXXX.ics", &path, NULL);
+  g_assert (fd >= 0);
+  close (fd);
+
+  if (!g_file_set_contents (path, contents, length, NULL))
+    g_error ("Cannot write %s", path);
+  g_free (contents);
+
+  calendar_path = path;
+  loads = g_array_new (FALSE, FALSE, sizeof (Range));
+  cache = calendar_event_cache_new (load_range, NULL);
+
+  test_ranges ();
+  test_incremental (cache);
+  test_update (cache);
+
+  calendar_event_cache_free (cache);
+  g_array_free (loads, TRUE);
+
+  g_unlink (path);
+  g_free (path);
+
+  return fail ? 1 : 0;
+}
@@ -37,6 +37,7 @@
 #include <meta/meta-plugin.h>
 
 #include "shell-global-private.h"
+#include "shell-hit-test.h"
 #include "shell-perf-log.h"
 #include "shell-wm-private.h"
 
@@ -205,6 +206,8 @@ gnome_shell_plugin_start (MetaPlugin *plugin)
   shell_plugin->global = shell_global_get ();
   _shell_global_set_plugin (shell_plugin->global, META_PLUGIN (shell_plugin));
 
+  shell_hit_test_track_stage (shell_global_get_stage (shell_plugin->global));
+
   gjs_context = _shell_global_get_gjs_context (shell_plugin->global);
 
   if (!gjs_context_eval (gjs_context,
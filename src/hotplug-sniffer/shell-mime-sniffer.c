@@ -32,6 +32,8 @@
 #include "shell-mime-sniffer.h"
 #include "hotplug-mimetypes.h"
 
+#include <math.h>
+
 #include <glib/gi18n.h>
 
 #include <gdk-pixbuf/gdk-pixbuf.h>
@@ -45,6 +47,14 @@
 #define DIRECTORY_LOAD_ITEMS_PER_CALLBACK 100
 #define HIGH_SCORE_RATIO 0.10
 
+/* Number of directory enumerations kept in flight at once */
+#define MAX_CONCURRENT_ENUMERATIONS 4
+
+/* Don't try to draw conclusions from fewer matched files than this */
+#define MIN_ITEMS_FOR_DECISION 200
+/* z-score for the confidence interval around each ratio (~99%) */
+#define DECISION_Z_SCORE 2.58
+
 G_DEFINE_TYPE (ShellMimeSniffer, shell_mime_sniffer, G_TYPE_OBJECT);
 
 enum {
@@ -62,9 +72,16 @@ static GParamSpec *properties[NUM_PROPERTIES] = { NULL, };
 typedef struct {
   ShellMimeSniffer *self;
 
-  GFile *file;
-  GFileEnumerator *enumerator;
-  GList *deep_count_subdirectories;
+  /* One queue of pending subdirectories per top-level directory of
+   * the volume, visited round-robin so that the sample is spread over
+   * the whole tree rather than exhausting the first branch. Index 0
+   * holds the root itself.
+   */
+  GPtrArray *branches;
+  guint next_branch;
+
+  guint n_in_flight;
+  gboolean stopping;
 
   gint audio_count;
   gint image_count;
@@ -74,6 +91,14 @@ typedef struct {
   gint total_items;
 } DeepCountState;
 
+typedef struct {
+  DeepCountState *state;
+
+  GFile *file;
+  GFileEnumerator *enumerator;
+  guint branch;
+} DeepCountJob;
+
 struct _ShellMimeSnifferPrivate {
   GFile *file;
 
@@ -82,10 +107,10 @@ struct _ShellMimeSnifferPrivate {
 
   GSimpleAsyncResult *async_result;
   gchar **sniffed_mime;
+  guint n_files_sniffed;
 };
 
-static void deep_count_load (DeepCountState *state,
-                             GFile *file);
+static void deep_count_schedule (DeepCountState *state);
 
 static void
 init_mimetypes (void)
@@ -174,20 +199,14 @@ results_cmp_func (gconstpointer a,
   return 0;
 }
 
-static void
-prepare_async_result (DeepCountState *state)
+static GArray *
+compute_results (DeepCountState *state)
 {
-  ShellMimeSniffer *self = state->self;
   GArray *results;
-  GPtrArray *sniffed_mime;
   SniffedResult result;
 
-  sniffed_mime = g_ptr_array_new ();
   results = g_array_new (TRUE, TRUE, sizeof (SniffedResult));
 
-  if (state->total_items == 0)
-    goto out;
-
   result.type = "x-content/video";
   result.ratio = (gdouble) state->video_count / (gdouble) state->total_items;
   g_array_append_val (results, result);
@@ -206,6 +225,71 @@ prepare_async_result (DeepCountState *state)
 
   g_array_sort (results, results_cmp_func);
 
+  return results;
+}
+
+/* Half-width of the confidence interval of a sampled ratio */
+static gdouble
+ratio_margin (gdouble ratio,
+              gint    n_items)
+{
+  return DECISION_Z_SCORE * sqrt (ratio * (1.0 - ratio) / n_items);
+}
+
+/* Whether looking at more files could still change the outcome of
+ * prepare_async_result(): the leading type must be clearly ahead, and
+ * the runners-up clearly on one side of HIGH_SCORE_RATIO.
+ */
+static gboolean
+classification_is_decided (DeepCountState *state)
+{
+  GArray *results;
+  SniffedResult *r;
+  gint n = state->total_items;
+  gboolean decided = TRUE;
+  guint idx;
+
+  if (n < MIN_ITEMS_FOR_DECISION)
+    return FALSE;
+
+  results = compute_results (state);
+  r = (SniffedResult *) results->data;
+
+  if (r[0].ratio - r[1].ratio <= ratio_margin (r[0].ratio, n) + ratio_margin (r[1].ratio, n))
+    decided = FALSE;
+
+  for (idx = 1; decided && idx < results->len; idx++)
+    {
+      if (fabs (r[idx].ratio - HIGH_SCORE_RATIO) <= ratio_margin (r[idx].ratio, n))
+        decided = FALSE;
+    }
+
+  /* If both the third and fourth type qualify, which one is reported
+   * depends on their order */
+  if (decided && r[3].ratio >= HIGH_SCORE_RATIO &&
+      r[2].ratio - r[3].ratio <= ratio_margin (r[2].ratio, n) + ratio_margin (r[3].ratio, n))
+    decided = FALSE;
+
+  g_array_free (results, TRUE);
+
+  return decided;
+}
+
+static void
+prepare_async_result (DeepCountState *state)
+{
+  ShellMimeSniffer *self = state->self;
+  GArray *results = NULL;
+  GPtrArray *sniffed_mime;
+  SniffedResult result;
+
+  sniffed_mime = g_ptr_array_new ();
+
+  if (state->total_items == 0)
+    goto out;
+
+  results = compute_results (state);
+
   result = g_array_index (results, SniffedResult, 0);
   g_ptr_array_add (sniffed_mime, g_strdup (result.type));
 
@@ -224,25 +308,40 @@ prepare_async_result (DeepCountState *state)
   g_ptr_array_add (sniffed_mime, NULL);
   self->priv->sniffed_mime = (gchar **) g_ptr_array_free (sniffed_mime, FALSE);
 
-  g_array_free (results, TRUE);
+  if (results != NULL)
+    g_array_free (results, TRUE);
   g_simple_async_result_complete_in_idle (self->priv->async_result);
 }
 
+static void
+deep_count_queue_dir (DeepCountState *state,
+                      guint branch,
+                      GFile *dir)
+{
+  if (branch >= state->branches->len)
+    g_ptr_array_add (state->branches, g_queue_new ());
+
+  g_queue_push_tail (g_ptr_array_index (state->branches, branch), dir);
+}
+
 /* adapted from nautilus/libnautilus-private/nautilus-directory-async.c */
 static void
-deep_count_one (DeepCountState *state,
+deep_count_one (DeepCountJob *job,
 		GFileInfo *info)
 {
+  DeepCountState *state = job->state;
   GFile *subdir;
   const char *content_type;
 
   if (g_file_info_get_file_type (info) == G_FILE_TYPE_DIRECTORY)
     {
-      /* record the fact that we have to descend into this directory */
-      subdir = g_file_get_child (state->file, g_file_info_get_name (info));
-      state->deep_count_subdirectories =
-        g_list_append (state->deep_count_subdirectories, subdir);
-    } 
+      /* record the fact that we have to descend into this directory;
+       * each directory directly below the root starts a new branch */
+      subdir = g_file_get_child (job->file, g_file_info_get_name (info));
+      deep_count_queue_dir (state,
+                            job->branch == 0 ? state->branches->len : job->branch,
+                            subdir);
+    }
   else
     {
       content_type = g_file_info_get_content_type (info);
@@ -253,46 +352,65 @@ deep_count_one (DeepCountState *state,
 static void
 deep_count_finish (DeepCountState *state)
 {
-  prepare_async_result (state);
+  ShellMimeSniffer *self = state->self;
 
-  if (state->enumerator)
+  if (self->priv->watchdog_id != 0)
     {
-      if (!g_file_enumerator_is_closed (state->enumerator))
-        g_file_enumerator_close_async (state->enumerator,
-                                       0, NULL, NULL, NULL);
-
-      g_object_unref (state->enumerator);
+      g_source_remove (self->priv->watchdog_id);
+      self->priv->watchdog_id = 0;
     }
 
-  g_cancellable_reset (state->self->priv->cancellable);
-  g_clear_object (&state->file);
+  self->priv->n_files_sniffed = state->total_items;
+  prepare_async_result (state);
 
-  g_list_free_full (state->deep_count_subdirectories, g_object_unref);
+  g_cancellable_reset (self->priv->cancellable);
+
+  g_ptr_array_free (state->branches, TRUE);
 
   g_free (state);
 }
 
 static void
-deep_count_next_dir (DeepCountState *state)
+deep_count_job_done (DeepCountJob *job)
 {
-  GFile *new_file;
-
-  g_clear_object (&state->file);
+  DeepCountState *state = job->state;
 
-  if (state->deep_count_subdirectories != NULL)
+  if (job->enumerator)
     {
-      /* Work on a new directory. */
-      new_file = state->deep_count_subdirectories->data;
-      state->deep_count_subdirectories =
-        g_list_remove (state->deep_count_subdirectories, new_file);
+      if (!g_file_enumerator_is_closed (job->enumerator))
+        g_file_enumerator_close_async (job->enumerator,
+                                       0, NULL, NULL, NULL);
 
-      deep_count_load (state, new_file);
-      g_object_unref (new_file);
+      g_object_unref (job->enumerator);
     }
-  else
+
+  g_clear_object (&job->file);
+  g_slice_free (DeepCountJob, job);
+
+  state->n_in_flight--;
+
+  if (!state->stopping)
+    deep_count_schedule (state);
+
+  if (state->n_in_flight == 0)
+    deep_count_finish (state);
+}
+
+/* Called after each batch of files has been counted */
+static gboolean
+deep_count_check_stop (DeepCountState *state)
+{
+  if (g_cancellable_is_cancelled (state->self->priv->cancellable))
+    state->stopping = TRUE;
+
+  if (!state->stopping && classification_is_decided (state))
     {
-      deep_count_finish (state);
+      /* Let the other enumerations in flight wind down */
+      state->stopping = TRUE;
+      g_cancellable_cancel (state->self->priv->cancellable);
     }
+
+  return state->stopping;
 }
 
 static void
@@ -300,44 +418,37 @@ deep_count_more_files_callback (GObject *source_object,
 				GAsyncResult *res,
 				gpointer user_data)
 {
-  DeepCountState *state;
+  DeepCountJob *job;
   GList *files, *l;
   GFileInfo *info;
 
-  state = user_data;
+  job = user_data;
 
-  if (g_cancellable_is_cancelled (state->self->priv->cancellable))
-    {
-      deep_count_finish (state);
-      return;
-    }
-	
-  files = g_file_enumerator_next_files_finish (state->enumerator,
+  files = g_file_enumerator_next_files_finish (job->enumerator,
                                                res, NULL);
   
   for (l = files; l != NULL; l = l->next)
     {
       info = l->data;
-      deep_count_one (state, info);
+      deep_count_one (job, info);
       g_object_unref (info);
     }
 
-  if (files == NULL)
+  if (deep_count_check_stop (job->state) || files == NULL)
     {
-      g_file_enumerator_close_async (state->enumerator, 0, NULL, NULL, NULL);
-      g_object_unref (state->enumerator);
-      state->enumerator = NULL;
-
-      deep_count_next_dir (state);
+      deep_count_job_done (job);
     }
   else
     {
-      g_file_enumerator_next_files_async (state->enumerator,
+      /* New directories might have been queued */
+      deep_count_schedule (job->state);
+
+      g_file_enumerator_next_files_async (job->enumerator,
                                           DIRECTORY_LOAD_ITEMS_PER_CALLBACK,
                                           G_PRIORITY_LOW,
-                                          state->self->priv->cancellable,
+                                          job->state->self->priv->cancellable,
                                           deep_count_more_files_callback,
-                                          state);
+                                          job);
     }
 
   g_list_free (files);
@@ -348,49 +459,91 @@ deep_count_callback (GObject *source_object,
 		     GAsyncResult *res,
 		     gpointer user_data)
 {
-  DeepCountState *state;
+  DeepCountJob *job;
   GFileEnumerator *enumerator;
 
-  state = user_data;
-
-  if (g_cancellable_is_cancelled (state->self->priv->cancellable))
-    {
-      deep_count_finish (state);
-      return;
-    }
+  job = user_data;
 
   enumerator = g_file_enumerate_children_finish (G_FILE (source_object),
                                                  res, NULL);
 	
-  if (enumerator == NULL)
+  /* Check first: when cancelled there is no enumerator either, and
+   * the queued directories must not be scheduled */
+  if (deep_count_check_stop (job->state) || enumerator == NULL)
     {
-      deep_count_next_dir (state);
+      job->enumerator = enumerator;
+      deep_count_job_done (job);
     }
   else
     {
-      state->enumerator = enumerator;
-      g_file_enumerator_next_files_async (state->enumerator,
+      job->enumerator = enumerator;
+      g_file_enumerator_next_files_async (job->enumerator,
                                           DIRECTORY_LOAD_ITEMS_PER_CALLBACK,
                                           G_PRIORITY_LOW,
-                                          state->self->priv->cancellable,
+                                          job->state->self->priv->cancellable,
                                           deep_count_more_files_callback,
-                                          state);
+                                          job);
     }
 }
 
 static void
 deep_count_load (DeepCountState *state,
+                 guint branch,
                  GFile *file)
 {
-  state->file = g_object_ref (file);
+  DeepCountJob *job;
+
+  job = g_slice_new0 (DeepCountJob);
+  job->state = state;
+  job->file = file;
+  job->branch = branch;
 
-  g_file_enumerate_children_async (state->file,
+  state->n_in_flight++;
+
+  g_file_enumerate_children_async (job->file,
                                    LOADER_ATTRS,
                                    G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS, /* flags */
                                    G_PRIORITY_LOW, /* prio */
                                    state->self->priv->cancellable,
                                    deep_count_callback,
-                                   state);
+                                   job);
+}
+
+/* Start enumerating pending directories, taking the next one from
+ * each branch in turn, until MAX_CONCURRENT_ENUMERATIONS are running.
+ */
+static void
+deep_count_schedule (DeepCountState *state)
+{
+  guint n_branches = state->branches->len;
+  guint n_tried = 0;
+
+  while (state->n_in_flight < MAX_CONCURRENT_ENUMERATIONS &&
+         n_tried < n_branches)
+    {
+      guint branch = state->next_branch % n_branches;
+      GFile *dir = g_queue_pop_head (g_ptr_array_index (state->branches, branch));
+
+      state->next_branch = branch + 1;
+
+      if (dir == NULL)
+        {
+          n_tried++;
+          continue;
+        }
+
+      n_tried = 0;
+      deep_count_load (state, branch, dir);
+    }
+}
+
+static void
+free_branch (gpointer data)
+{
+  GQueue *queue = data;
+
+  g_queue_foreach (queue, (GFunc) g_object_unref, NULL);
+  g_queue_free (queue);
 }
 
 static void
@@ -400,8 +553,10 @@ deep_count_start (ShellMimeSniffer *self)
 
   state = g_new0 (DeepCountState, 1);
   state->self = self;
+  state->branches = g_ptr_array_new_with_free_func (free_branch);
 
-  deep_count_load (state, self->priv->file);
+  deep_count_queue_dir (state, 0, g_object_ref (self->priv->file));
+  deep_count_schedule (state);
 }
 
 static void
@@ -606,3 +761,12 @@ shell_mime_sniffer_sniff_finish (ShellMimeSniffer *self,
 
   return g_strdupv (self->priv->sniffed_mime);
 }
+
+/* Number of files whose type was counted by the last sniff, which is
+ * less than the number of files on the volume when the crawl stopped
+ * early */
+guint
+shell_mime_sniffer_get_n_files_sniffed (ShellMimeSniffer *self)
+{
+  return self->priv->n_files_sniffed;
+}
@@ -64,6 +64,8 @@ gchar ** shell_mime_sniffer_sniff_finish (ShellMimeSniffer *self,
                                           GAsyncResult *res,
                                           GError **error);
 
+guint shell_mime_sniffer_get_n_files_sniffed (ShellMimeSniffer *self);
+
 G_END_DECLS
 
 #endif /* __SHELL_MIME_SNIFFER_H__ */
@@ -0,0 +1,258 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+/*
+ * test-mime-sniffer.c: test program for the hotplug content sniffer
+ *
+ * Copyright (C) 2012 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include "shell-mime-sniffer.h"
+
+#include <string.h>
+#include <glib/gstdio.h>
+
+/* Enough content for GIO to sniff the type; empty files are
+ * reported as application/x-zerosize */
+static const gchar jpeg_data[] = "\xff\xd8\xff\xe0\x00\x10JFIF";
+static const gchar mp3_data[] = "ID3\x03\x00\x00\x00\x00\x00\x00";
+
+static GMainLoop *loop;
+static gchar **sniffed;
+static gboolean fail;
+static const char *test;
+
+typedef struct {
+  guint n_branches;
+  guint depth;
+  guint files_per_dir;
+  /* one in audio_every files is audio, the rest pictures */
+  guint audio_every;
+} TreeSpec;
+
+static void
+populate_dir (const gchar    *path,
+              const TreeSpec *spec,
+              guint           depth,
+              guint          *counter)
+{
+  guint i;
+
+  g_mkdir_with_parents (path, 0700);
+
+  for (i = 0; i < spec->files_per_dir; i++)
+    {
+      gboolean audio = spec->audio_every > 0 && (*counter)++ % spec->audio_every == 0;
+      gchar *name = g_strdup_printf ("file%u.%s", i, audio ? "mp3" : "jpg");
+      gchar *file = g_build_filename (path, name, NULL);
+
+      if (audio)
+        g_file_set_contents (file, mp3_data, sizeof (mp3_data) - 1, NULL);
+      else
+        g_file_set_contents (file, jpeg_data, sizeof (jpeg_data) - 1, NULL);
+
+      g_free (file);
+      g_free (name);
+    }
+
+  if (depth < spec->depth)
+    {
+      gchar *subdir = g_build_filename (path, "sub", NULL);
+      populate_dir (subdir, spec, depth + 1, counter);
+      g_free (subdir);
+    }
+}
+
+static gchar *
+create_tree (const TreeSpec *spec)
+{
+  gchar *template;
+  gchar *root;
+  guint counter = 0;
+  guint i;
+
+  /* Prefer a tmpfs so the test measures the crawler, not the disk */
+  if (g_file_test ("/dev/shm", G_FILE_TEST_IS_DIR))
+    template = g_build_filename ("/dev/shm", "test-mime-sniffer-XXXXXX", NULL);
+  else
+    template = g_build_filename (g_get_tmp_dir (), "test-mime-sniffer-XXXXXX", NULL);
+
+  root = g_mkdtemp (template);
+  g_assert (root != NULL);
+
+  for (i = 0; i < spec->n_branches; i++)
+    {
+      gchar *name = g_strdup_printf ("branch%u", i);
+      gchar *branch = g_build_filename (root, name, NULL);
+
+      populate_dir (branch, spec, 0, &counter);
+
+      g_free (branch);
+      g_free (name);
+    }
+
+  return root;
+}
+
+static void
+remove_tree (const gchar *path)
+{
+  GDir *dir = g_dir_open (path, 0, NULL);
+  const gchar *name;
+
+  if (dir != NULL)
+    {
+      while ((name = g_dir_read_name (dir)) != NULL)
+        {
+          gchar *child = g_build_filename (path, name, NULL);
+
+          if (g_file_test (child, G_FILE_TEST_IS_DIR))
+            remove_tree (child);
+          else
+            g_unlink (child);
+
+          g_free (child);
+        }
+      g_dir_close (dir);
+    }
+
+  g_rmdir (path);
+}
+
+static void
+sniff_ready_cb (GObject      *source,
+                GAsyncResult *res,
+                gpointer      user_data)
+{
+  GError *error = NULL;
+
+  sniffed = shell_mime_sniffer_sniff_finish (SHELL_MIME_SNIFFER (source),
+                                             res, &error);
+  if (error != NULL)
+    {
+      g_print ("%s: sniffing failed: %s\n", test, error->message);
+      g_error_free (error);
+      fail = TRUE;
+    }
+
+  g_main_loop_quit (loop);
+}
+
+static guint
+count_files (const TreeSpec *spec)
+{
+  return spec->n_branches * (spec->depth + 1) * spec->files_per_dir;
+}
+
+/* Sniffs a tree built from @spec, checking that the result is
+ * @expected and that the crawl stopped after at most @max_files files */
+static void
+run_sniffer (const TreeSpec *spec,
+             const gchar   **expected,
+             guint           max_files)
+{
+  ShellMimeSniffer *sniffer;
+  GFile *file;
+  gchar *root;
+  gchar *got;
+  gchar *wanted;
+  gint64 start;
+  guint n_files;
+
+  root = create_tree (spec);
+  file = g_file_new_for_path (root);
+
+  start = g_get_monotonic_time ();
+
+  sniffer = shell_mime_sniffer_new (file);
+  shell_mime_sniffer_sniff_async (sniffer, sniff_ready_cb, NULL);
+
+  g_main_loop_run (loop);
+
+  n_files = shell_mime_sniffer_get_n_files_sniffed (sniffer);
+  g_object_unref (sniffer);
+
+  g_print ("%s: sniffed %u of %u files in %" G_GINT64_FORMAT " ms\n",
+           test, n_files, count_files (spec),
+           (g_get_monotonic_time () - start) / 1000);
+
+  if (n_files > max_files)
+    {
+      g_print ("%s: expected the crawl to stop after %u files\n",
+               test, max_files);
+      fail = TRUE;
+    }
+
+  if (sniffed != NULL)
+    {
+      got = g_strjoinv (",", sniffed);
+      wanted = g_strjoinv (",", (gchar **) expected);
+
+      if (strcmp (got, wanted) != 0)
+        {
+          g_print ("%s: expected: %s, got: %s\n", test, wanted, got);
+          fail = TRUE;
+        }
+
+      g_free (got);
+      g_free (wanted);
+      g_strfreev (sniffed);
+      sniffed = NULL;
+    }
+
+  g_object_unref (file);
+  remove_tree (root);
+  g_free (root);
+}
+
+static void
+test_pictures (void)
+{
+  /* Wide and deep enough that the crawler should decide early */
+  static const TreeSpec spec = { 16, 8, 50, 0 };
+  static const gchar *expected[] = { "x-content/pictures", NULL };
+
+  test = "pictures";
+  /* The answer is clear as soon as enough files are counted, so
+   * only a small part of the tree should be read */
+  run_sniffer (&spec, expected, count_files (&spec) / 4);
+}
+
+static void
+test_mixed (void)
+{
+  /* One in three files is audio, spread evenly over every branch */
+  static const TreeSpec spec = { 8, 4, 30, 3 };
+  static const gchar *expected[] = { "x-content/pictures", "x-content/audio", NULL };
+
+  test = "mixed";
+  run_sniffer (&spec, expected, count_files (&spec) - 1);
+}
+
+int
+main (int argc, char **argv)
+{
+  g_type_init ();
+
+  loop = g_main_loop_new (NULL, FALSE);
+
+  test_pictures ();
+  test_mixed ();
+
+  g_main_loop_unref (loop);
+
+  return fail ? 1 : 0;
+}
@@ -24,8 +24,10 @@
 #include "shell-a11y.h"
 #include "shell-global.h"
 #include "shell-global-private.h"
+#include "shell-hit-test.h"
 #include "shell-perf-log.h"
 #include "st.h"
+#include "st/st-pipeline-cache.h"
 
 extern GType gnome_shell_plugin_get_type (void);
 
@@ -192,6 +194,41 @@ malloc_statistics_callback (ShellPerfLog *perf_log,
 #endif
 }
 
+static void
+st_statistics_callback (ShellPerfLog *perf_log,
+                        gpointer      data)
+{
+  guint hits, misses;
+
+  st_pipeline_cache_get_stats (&hits, &misses);
+
+  shell_perf_log_update_statistic_i (perf_log,
+                                     "st.pipelineCacheHits",
+                                     hits);
+  shell_perf_log_update_statistic_i (perf_log,
+                                     "st.pipelineCacheMisses",
+                                     misses);
+}
+
+static void
+hit_test_statistics_callback (ShellPerfLog *perf_log,
+                              gpointer      data)
+{
+  guint resolved_lookups, pick_render_lookups, stage_picks;
+
+  shell_hit_test_get_stats (&resolved_lookups, &pick_render_lookups, &stage_picks);
+
+  shell_perf_log_update_statistic_i (perf_log,
+                                     "hitTest.resolvedLookups",
+                                     resolved_lookups);
+  shell_perf_log_update_statistic_i (perf_log,
+                                     "hitTest.pickRenderLookups",
+                                     pick_render_lookups);
+  shell_perf_log_update_statistic_i (perf_log,
+                                     "hitTest.stagePicks",
+                                     stage_picks);
+}
+
 static void
 shell_perf_log_init (void)
 {
@@ -217,6 +254,79 @@ shell_perf_log_init (void)
   shell_perf_log_add_statistics_callback (perf_log,
                                           malloc_statistics_callback,
                                           NULL, NULL);
+
+  shell_perf_log_define_statistic (perf_log,
+                                   "st.pipelineCacheHits",
+                                   "Lookups of shared materials and shader programs that were already set up",
+                                   "i");
+  shell_perf_log_define_statistic (perf_log,
+                                   "st.pipelineCacheMisses",
+                                   "Materials and shader programs set up or compiled",
+                                   "i");
+
+  shell_perf_log_add_statistics_callback (perf_log,
+                                          st_statistics_callback,
+                                          NULL, NULL);
+
+  shell_perf_log_define_statistic (perf_log,
+                                   "hitTest.resolvedLookups",
+                                   "Shell lookups of the actor at a position resolved without a pick render",
+                                   "i");
+  shell_perf_log_define_statistic (perf_log,
+                                   "hitTest.pickRenderLookups",
+                                   "Shell lookups of the actor at a position that fell back to a pick render",
+                                   "i");
+  shell_perf_log_define_statistic (perf_log,
+                                   "hitTest.stagePicks",
+                                   "Pick renders of the stage, including those Clutter does to deliver pointer events",
+                                   "i");
+
+  shell_perf_log_add_statistics_callback (perf_log,
+                                          hit_test_statistics_callback,
+                                          NULL, NULL);
+
+  /* Startup timeline, recorded by Main.start() */
+  shell_perf_log_define_event (perf_log,
+                               "startup.start",
+                               "Starting to set up the user interface",
+                               "");
+  shell_perf_log_define_event (perf_log,
+                               "startup.phaseStart",
+                               "Starting to create or initialize a subsystem",
+                               "s");
+  shell_perf_log_define_event (perf_log,
+                               "startup.phaseDone",
+                               "Done creating or initializing a subsystem",
+                               "s");
+  shell_perf_log_define_event (perf_log,
+                               "startup.done",
+                               "Done setting up the user interface",
+                               "");
+  shell_perf_log_define_event (perf_log,
+                               "startup.deferredDone",
+                               "Done creating the subsystems deferred until after startup",
+                               "");
+  shell_perf_log_define_event (perf_log,
+                               "extensions.loadStart",
+                               "Starting to load an extension",
+                               "s");
+  shell_perf_log_define_event (perf_log,
+                               "extensions.loadDone",
+                               "Done loading an extension",
+                               "s");
+  shell_perf_log_define_event (perf_log,
+                               "theme.stylesheetLoadStart",
+                               "Starting to load a stylesheet",
+                               "s");
+  shell_perf_log_define_event (perf_log,
+                               "theme.stylesheetLoadDone",
+                               "Done loading a stylesheet",
+                               "s");
+
+  /* When running a performance script, record from the very start
+   * so that the startup timeline ends up in the output */
+  if (g_getenv ("SHELL_PERF_MODULE") != NULL)
+    shell_perf_log_set_enabled (perf_log, TRUE);
 }
 
 static void
@@ -0,0 +1,1026 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+
+#include "config.h"
+
+#include <math.h>
+
+#include "shell-animator.h"
+#include "shell-global.h"
+#include "st.h"
+
+/**
+ * SECTION:shell-animator
+ * @short_description: Animates numeric actor properties without
+ *   going through Javascript on every frame
+ *
+ * A #ShellTween moves a set of numeric properties of one actor from
+ * their values when the tween starts to target values, over the same
+ * duration and with the same easing. Once added to the #ShellAnimator,
+ * all tweens are advanced together from a single timeline, and each
+ * tween emits #ShellTween::started and #ShellTween::completed once,
+ * so Javascript only runs at the start and at the end of an animation.
+ *
+ * The same timeline drives imports.tweener.tweener, through
+ * #ShellAnimator::new-frame and shell_animator_get_frame_time(), so
+ * that animations run by either advance on the same frames and with
+ * the same clock.
+ *
+ * The animator follows the semantics of imports.tweener.tweener so
+ * that js/ui/tweener.js can hand simple tweens over to it: a new
+ * tween takes over the properties of any tween on the same actor
+ * whose time overlaps with it, and removed or overwritten tweens do
+ * not emit #ShellTween::completed.
+ */
+
+typedef struct {
+  GParamSpec *pspec;
+  double from;
+  double to;
+} TweenProperty;
+
+struct _ShellTween
+{
+  GObject parent;
+
+  ClutterActor *actor;
+  guint destroy_id;
+
+  ClutterAnimationMode mode;
+  guint duration;
+  guint delay;
+
+  GArray *properties;
+
+  /* In the animator's time, in milliseconds */
+  double start_time;
+  double paused_time;
+
+  guint added : 1;
+  guint started : 1;
+  guint paused : 1;
+  guint removed : 1;
+};
+
+enum {
+  STARTED,
+  COMPLETED,
+  LAST_SIGNAL
+};
+
+static guint signals[LAST_SIGNAL] = { 0 };
+
+G_DEFINE_TYPE (ShellTween, shell_tween, G_TYPE_OBJECT);
+
+struct _ShellAnimator
+{
+  GObject parent;
+
+  GQueue tweens;
+  gboolean updating;
+
+  /* We don't have a finite duration, so use 1000 seconds as infinity
+   * and loop; the current time is tracked separately since the
+   * timeline's time cycles */
+  ClutterTimeline *timeline;
+  gboolean running;
+  guint n_frame_holds;
+  gint64 start_time;
+  gint64 frame_time;
+  double current_time;
+};
+
+enum {
+  NEW_FRAME,
+  LAST_ANIMATOR_SIGNAL
+};
+
+static guint animator_signals[LAST_ANIMATOR_SIGNAL] = { 0 };
+
+G_DEFINE_TYPE (ShellAnimator, shell_animator, G_TYPE_OBJECT);
+
+static void remove_tween (ShellAnimator   *animator,
+                          ShellTween      *tween);
+static void on_new_frame (ClutterTimeline *timeline,
+                          gint             frame,
+                          ShellAnimator   *animator);
+
+static void
+shell_tween_init (ShellTween *tween)
+{
+  tween->properties = g_array_new (FALSE, FALSE, sizeof (TweenProperty));
+}
+
+static void
+shell_tween_dispose (GObject *object)
+{
+  ShellTween *tween = SHELL_TWEEN (object);
+
+  if (tween->actor)
+    {
+      g_signal_handler_disconnect (tween->actor, tween->destroy_id);
+      g_object_unref (tween->actor);
+      tween->actor = NULL;
+    }
+
+  G_OBJECT_CLASS (shell_tween_parent_class)->dispose (object);
+}
+
+static void
+shell_tween_finalize (GObject *object)
+{
+  ShellTween *tween = SHELL_TWEEN (object);
+
+  g_array_free (tween->properties, TRUE);
+
+  G_OBJECT_CLASS (shell_tween_parent_class)->finalize (object);
+}
+
+static void
+shell_tween_class_init (ShellTweenClass *klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+
+  gobject_class->dispose = shell_tween_dispose;
+  gobject_class->finalize = shell_tween_finalize;
+
+  /**
+   * ShellTween::started:
+   * @tween: the #ShellTween
+   *
+   * Emitted when the tween's delay has passed and it starts
+   * changing the properties of the actor.
+   */
+  signals[STARTED] = g_signal_new ("started",
+                                   SHELL_TYPE_TWEEN,
+                                   G_SIGNAL_RUN_LAST,
+                                   0,
+                                   NULL, NULL, NULL,
+                                   G_TYPE_NONE, 0);
+
+  /**
+   * ShellTween::completed:
+   * @tween: the #ShellTween
+   *
+   * Emitted once all the properties have reached their target
+   * values. It is not emitted for tweens that are removed or taken
+   * over by another tween before that.
+   */
+  signals[COMPLETED] = g_signal_new ("completed",
+                                     SHELL_TYPE_TWEEN,
+                                     G_SIGNAL_RUN_LAST,
+                                     0,
+                                     NULL, NULL, NULL,
+                                     G_TYPE_NONE, 0);
+}
+
+static void
+on_actor_destroy (ClutterActor *actor,
+                  ShellTween   *tween)
+{
+  remove_tween (shell_animator_get_default (), tween);
+}
+
+/**
+ * shell_tween_new:
+ * @actor: the #ClutterActor to animate
+ * @duration: the duration of the tween, in milliseconds
+ * @delay: the time to wait before starting, in milliseconds
+ * @mode: the easing mode; %CLUTTER_CUSTOM_MODE is not supported
+ *
+ * Creates a tween that can be filled in with shell_tween_add_property()
+ * and then started with shell_animator_add_tween(). Like the durations
+ * of Clutter animations, @duration and @delay are scaled with the
+ * slow down factor set with st_set_slow_down_factor().
+ *
+ * Return value: (transfer full): a new #ShellTween
+ */
+ShellTween *
+shell_tween_new (ClutterActor         *actor,
+                 guint                 duration,
+                 guint                 delay,
+                 ClutterAnimationMode  mode)
+{
+  ShellTween *tween;
+
+  g_return_val_if_fail (CLUTTER_IS_ACTOR (actor), NULL);
+  g_return_val_if_fail (mode != CLUTTER_CUSTOM_MODE && mode < CLUTTER_ANIMATION_LAST, NULL);
+
+  tween = g_object_new (SHELL_TYPE_TWEEN, NULL);
+
+  tween->actor = g_object_ref (actor);
+  tween->destroy_id = g_signal_connect (actor, "destroy",
+                                        G_CALLBACK (on_actor_destroy), tween);
+  tween->mode = mode;
+  tween->duration = duration * st_get_slow_down_factor ();
+  tween->delay = delay * st_get_slow_down_factor ();
+
+  return tween;
+}
+
+static gboolean
+is_numeric_type (GType type)
+{
+  switch (G_TYPE_FUNDAMENTAL (type))
+    {
+    case G_TYPE_CHAR:
+    case G_TYPE_UCHAR:
+    case G_TYPE_INT:
+    case G_TYPE_UINT:
+    case G_TYPE_LONG:
+    case G_TYPE_ULONG:
+    case G_TYPE_INT64:
+    case G_TYPE_UINT64:
+    case G_TYPE_FLOAT:
+    case G_TYPE_DOUBLE:
+      return TRUE;
+    default:
+      return FALSE;
+    }
+}
+
+/**
+ * shell_tween_add_property:
+ * @tween: a #ShellTween
+ * @property_name: the name of a property of the tween's actor
+ * @value: the value to animate the property to
+ *
+ * Adds a property to the tween. The animation starts from the value
+ * the property has when the tween starts, after its delay.
+ *
+ * Return value: %TRUE if the property was added, %FALSE if the actor
+ *   has no readable and writable numeric property called @property_name
+ */
+gboolean
+shell_tween_add_property (ShellTween *tween,
+                          const char *property_name,
+                          double      value)
+{
+  TweenProperty property;
+  GParamSpec *pspec;
+
+  g_return_val_if_fail (SHELL_IS_TWEEN (tween), FALSE);
+  g_return_val_if_fail (!tween->added, FALSE);
+
+  pspec = g_object_class_find_property (G_OBJECT_GET_CLASS (tween->actor),
+                                        property_name);
+  if (pspec == NULL ||
+      (pspec->flags & G_PARAM_READWRITE) != G_PARAM_READWRITE ||
+      (pspec->flags & G_PARAM_CONSTRUCT_ONLY) != 0 ||
+      !is_numeric_type (pspec->value_type))
+    return FALSE;
+
+  property.pspec = pspec;
+  property.from = property.to = value;
+  g_array_append_val (tween->properties, property);
+
+  return TRUE;
+}
+
+static double
+get_property_value (GObject    *object,
+                    GParamSpec *pspec)
+{
+  GValue value = { 0, };
+  GValue double_value = { 0, };
+  double result;
+
+  g_value_init (&value, pspec->value_type);
+  g_value_init (&double_value, G_TYPE_DOUBLE);
+
+  g_object_get_property (object, pspec->name, &value);
+  g_value_transform (&value, &double_value);
+  result = g_value_get_double (&double_value);
+
+  g_value_unset (&value);
+
+  return result;
+}
+
+static void
+set_property_value (GObject    *object,
+                    GParamSpec *pspec,
+                    double      value)
+{
+  GValue new_value = { 0, };
+  GValue double_value = { 0, };
+
+  g_value_init (&new_value, pspec->value_type);
+  g_value_init (&double_value, G_TYPE_DOUBLE);
+  g_value_set_double (&double_value, value);
+
+  /* Like setting the property from Javascript, this truncates
+   * for integer properties */
+  g_value_transform (&double_value, &new_value);
+  g_object_set_property (object, pspec->name, &new_value);
+
+  g_value_unset (&new_value);
+}
+
+/* The easing equations of Robert Penner, as used by imports.tweener
+ * and Clutter, for a change from 0 to 1 over a duration of 1 */
+static double
+ease (ClutterAnimationMode mode,
+      double               t)
+{
+  double s, p;
+
+  switch (mode)
+    {
+    case CLUTTER_LINEAR:
+      return t;
+
+    case CLUTTER_EASE_IN_QUAD:
+      return t * t;
+    case CLUTTER_EASE_OUT_QUAD:
+      return -t * (t - 2);
+    case CLUTTER_EASE_IN_OUT_QUAD:
+      t *= 2;
+      if (t < 1)
+        return 0.5 * t * t;
+      t -= 1;
+      return -0.5 * (t * (t - 2) - 1);
+
+    case CLUTTER_EASE_IN_CUBIC:
+      return t * t * t;
+    case CLUTTER_EASE_OUT_CUBIC:
+      t -= 1;
+      return t * t * t + 1;
+    case CLUTTER_EASE_IN_OUT_CUBIC:
+      t *= 2;
+      if (t < 1)
+        return 0.5 * t * t * t;
+      t -= 2;
+      return 0.5 * (t * t * t + 2);
+
+    case CLUTTER_EASE_IN_QUART:
+      return t * t * t * t;
+    case CLUTTER_EASE_OUT_QUART:
+      t -= 1;
+      return -(t * t * t * t - 1);
+    case CLUTTER_EASE_IN_OUT_QUART:
+      t *= 2;
+      if (t < 1)
+        return 0.5 * t * t * t * t;
+      t -= 2;
+      return -0.5 * (t * t * t * t - 2);
+
+    case CLUTTER_EASE_IN_QUINT:
+      return t * t * t * t * t;
+    case CLUTTER_EASE_OUT_QUINT:
+      t -= 1;
+      return t * t * t * t * t + 1;
+    case CLUTTER_EASE_IN_OUT_QUINT:
+      t *= 2;
+      if (t < 1)
+        return 0.5 * t * t * t * t * t;
+      t -= 2;
+      return 0.5 * (t * t * t * t * t + 2);
+
+    case CLUTTER_EASE_IN_SINE:
+      return -cos (t * G_PI / 2) + 1;
+    case CLUTTER_EASE_OUT_SINE:
+      return sin (t * G_PI / 2);
+    case CLUTTER_EASE_IN_OUT_SINE:
+      return -0.5 * (cos (G_PI * t) - 1);
+
+    case CLUTTER_EASE_IN_EXPO:
+      return t == 0 ? 0 : pow (2, 10 * (t - 1));
+    case CLUTTER_EASE_OUT_EXPO:
+      return t == 1 ? 1 : -pow (2, -10 * t) + 1;
+    case CLUTTER_EASE_IN_OUT_EXPO:
+      if (t == 0 || t == 1)
+        return t;
+      t *= 2;
+      if (t < 1)
+        return 0.5 * pow (2, 10 * (t - 1));
+      return 0.5 * (-pow (2, -10 * (t - 1)) + 2);
+
+    case CLUTTER_EASE_IN_CIRC:
+      return -(sqrt (1 - t * t) - 1);
+    case CLUTTER_EASE_OUT_CIRC:
+      t -= 1;
+      return sqrt (1 - t * t);
+    case CLUTTER_EASE_IN_OUT_CIRC:
+      t *= 2;
+      if (t < 1)
+        return -0.5 * (sqrt (1 - t * t) - 1);
+      t -= 2;
+      return 0.5 * (sqrt (1 - t * t) + 1);
+
+    case CLUTTER_EASE_IN_ELASTIC:
+      if (t == 0 || t == 1)
+        return t;
+      p = 0.3;
+      s = p / 4;
+      t -= 1;
+      return -(pow (2, 10 * t) * sin ((t - s) * (2 * G_PI) / p));
+    case CLUTTER_EASE_OUT_ELASTIC:
+      if (t == 0 || t == 1)
+        return t;
+      p = 0.3;
+      s = p / 4;
+      return pow (2, -10 * t) * sin ((t - s) * (2 * G_PI) / p) + 1;
+    case CLUTTER_EASE_IN_OUT_ELASTIC:
+      if (t == 0 || t == 1)
+        return t;
+      p = 0.3 * 1.5;
+      s = p / 4;
+      t = 2 * t - 1;
+      if (t < 0)
+        return -0.5 * pow (2, 10 * t) * sin ((t - s) * (2 * G_PI) / p);
+      return 0.5 * pow (2, -10 * t) * sin ((t - s) * (2 * G_PI) / p) + 1;
+
+    case CLUTTER_EASE_IN_BACK:
+      s = 1.70158;
+      return t * t * ((s + 1) * t - s);
+    case CLUTTER_EASE_OUT_BACK:
+      s = 1.70158;
+      t -= 1;
+      return t * t * ((s + 1) * t + s) + 1;
+    case CLUTTER_EASE_IN_OUT_BACK:
+      s = 1.70158 * 1.525;
+      t *= 2;
+      if (t < 1)
+        return 0.5 * (t * t * ((s + 1) * t - s));
+      t -= 2;
+      return 0.5 * (t * t * ((s + 1) * t + s) + 2);
+
+    case CLUTTER_EASE_OUT_BOUNCE:
+      if (t < 1 / 2.75)
+        return 7.5625 * t * t;
+      if (t < 2 / 2.75)
+        {
+          t -= 1.5 / 2.75;
+          return 7.5625 * t * t + 0.75;
+        }
+      if (t < 2.5 / 2.75)
+        {
+          t -= 2.25 / 2.75;
+          return 7.5625 * t * t + 0.9375;
+        }
+      t -= 2.625 / 2.75;
+      return 7.5625 * t * t + 0.984375;
+    case CLUTTER_EASE_IN_BOUNCE:
+      return 1 - ease (CLUTTER_EASE_OUT_BOUNCE, 1 - t);
+    case CLUTTER_EASE_IN_OUT_BOUNCE:
+      if (t < 0.5)
+        return 0.5 * ease (CLUTTER_EASE_IN_BOUNCE, 2 * t);
+      return 0.5 * ease (CLUTTER_EASE_OUT_BOUNCE, 2 * t - 1) + 0.5;
+
+    default:
+      g_warn_if_reached ();
+      return t;
+    }
+}
+
+static void
+shell_animator_init (ShellAnimator *animator)
+{
+  g_queue_init (&animator->tweens);
+
+  animator->timeline = clutter_timeline_new (1000 * 1000);
+  clutter_timeline_set_loop (animator->timeline, TRUE);
+
+  g_signal_connect (animator->timeline, "new-frame",
+                    G_CALLBACK (on_new_frame), animator);
+
+  animator->start_time = -1;
+  animator->current_time = 0;
+}
+
+static void
+shell_animator_class_init (ShellAnimatorClass *klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+
+  /**
+   * ShellAnimator::new-frame:
+   * @animator: the #ShellAnimator
+   *
+   * Emitted on every frame while the animator is running, after its
+   * own tweens have been advanced.
+   */
+  animator_signals[NEW_FRAME] =
+    g_signal_new ("new-frame",
+                  G_TYPE_FROM_CLASS (gobject_class),
+                  G_SIGNAL_RUN_LAST,
+                  0,
+                  NULL, NULL, NULL,
+                  G_TYPE_NONE, 0);
+}
+
+/**
+ * shell_animator_get_default:
+ *
+ * Return Value: (transfer none): The global #ShellAnimator instance
+ */
+ShellAnimator *
+shell_animator_get_default (void)
+{
+  static ShellAnimator *instance;
+
+  if (instance == NULL)
+    instance = g_object_new (SHELL_TYPE_ANIMATOR, NULL);
+
+  return instance;
+}
+
+/* Runs the timeline as long as there are tweens or frame holds */
+static void
+update_running (ShellAnimator *animator)
+{
+  gboolean running = (animator->n_frame_holds > 0 ||
+                      !g_queue_is_empty (&animator->tweens));
+
+  if (running == animator->running)
+    return;
+
+  animator->running = running;
+
+  if (running)
+    {
+      clutter_timeline_start (animator->timeline);
+      shell_global_begin_work (shell_global_get ());
+    }
+  else
+    {
+      clutter_timeline_stop (animator->timeline);
+      animator->start_time = -1;
+      animator->frame_time = 0;
+      animator->current_time = 0;
+
+      shell_global_end_work (shell_global_get ());
+    }
+}
+
+/* Tweens removed while we are updating are only marked, since we might
+ * be walking the list; they are dropped at the end of the update */
+static void
+remove_tween (ShellAnimator *animator,
+              ShellTween    *tween)
+{
+  if (!tween->added || tween->removed)
+    return;
+
+  tween->removed = TRUE;
+
+  if (animator->updating)
+    return;
+
+  g_queue_remove (&animator->tweens, tween);
+  g_object_unref (tween);
+
+  update_running (animator);
+}
+
+static gboolean
+update_tween (ShellAnimator *animator,
+              ShellTween    *tween)
+{
+  GObject *object = G_OBJECT (tween->actor);
+  double t, progress;
+  guint i;
+
+  if (tween->paused || animator->current_time < tween->start_time)
+    return FALSE;
+
+  if (!tween->started)
+    {
+      tween->started = TRUE;
+
+      for (i = 0; i < tween->properties->len; i++)
+        {
+          TweenProperty *property = &g_array_index (tween->properties, TweenProperty, i);
+          property->from = get_property_value (object, property->pspec);
+        }
+
+      g_signal_emit (tween, signals[STARTED], 0);
+      if (tween->removed)
+        return FALSE;
+    }
+
+  if (tween->duration > 0)
+    t = MIN ((animator->current_time - tween->start_time) / tween->duration, 1.0);
+  else
+    t = 1.0;
+
+  /* End exactly on the target values whatever the easing */
+  progress = t < 1.0 ? ease (tween->mode, t) : 1.0;
+
+  g_object_freeze_notify (object);
+
+  for (i = 0; i < tween->properties->len; i++)
+    {
+      TweenProperty *property = &g_array_index (tween->properties, TweenProperty, i);
+      set_property_value (object, property->pspec,
+                          property->from + (property->to - property->from) * progress);
+    }
+
+  g_object_thaw_notify (object);
+
+  return t >= 1.0;
+}
+
+static void
+on_new_frame (ClutterTimeline *timeline,
+              gint             frame,
+              ShellAnimator   *animator)
+{
+  GList *l, *last;
+  gint64 now = g_get_monotonic_time ();
+
+  /* If there was a lot of setup to start the animation, the first
+   * frame might be a long way into it; always start with the first
+   * frame of the animation and only drop frames from there. */
+  if (animator->start_time < 0)
+    animator->start_time = now;
+
+  animator->frame_time = now;
+  animator->current_time = (now - animator->start_time) / 1000.;
+
+  /* Tweens added by the signal handlers are appended and only
+   * looked at from the next frame */
+  animator->updating = TRUE;
+  last = animator->tweens.tail;
+
+  for (l = animator->tweens.head; l != NULL; l = l->next)
+    {
+      ShellTween *tween = l->data;
+
+      if (!tween->removed && update_tween (animator, tween))
+        {
+          /* Completed tweens are removed before emitting ::completed,
+           * so handlers see that the actor stopped being animated */
+          tween->removed = TRUE;
+          g_signal_emit (tween, signals[COMPLETED], 0);
+        }
+
+      if (l == last)
+        break;
+    }
+
+  animator->updating = FALSE;
+
+  l = animator->tweens.head;
+  while (l != NULL)
+    {
+      GList *next = l->next;
+      ShellTween *tween = l->data;
+
+      if (tween->removed)
+        {
+          g_queue_delete_link (&animator->tweens, l);
+          g_object_unref (tween);
+        }
+
+      l = next;
+    }
+
+  g_signal_emit (animator, animator_signals[NEW_FRAME], 0);
+
+  update_running (animator);
+}
+
+/* Javascript spells property names with underscores, while the
+ * names of param specs are canonicalized to dashes */
+static gboolean
+property_name_equal (const char *canonical_name,
+                     const char *name)
+{
+  for (; *canonical_name && *name; canonical_name++, name++)
+    {
+      if (*canonical_name != *name &&
+          !(*canonical_name == '-' && *name == '_'))
+        return FALSE;
+    }
+
+  return *canonical_name == *name;
+}
+
+static gboolean
+property_in_list (TweenProperty      *property,
+                  const char * const *property_names)
+{
+  int i;
+
+  if (property_names == NULL)
+    return TRUE;
+
+  for (i = 0; property_names[i] != NULL; i++)
+    if (property_name_equal (property->pspec->name, property_names[i]))
+      return TRUE;
+
+  return FALSE;
+}
+
+/* Drops the properties of @tween that are in @property_names (or all,
+ * if it is %NULL); returns %TRUE if any were dropped */
+static gboolean
+remove_properties (ShellAnimator      *animator,
+                   ShellTween         *tween,
+                   const char * const *property_names)
+{
+  gboolean removed = FALSE;
+  guint i;
+
+  for (i = 0; i < tween->properties->len; )
+    {
+      TweenProperty *property = &g_array_index (tween->properties, TweenProperty, i);
+
+      if (property_in_list (property, property_names))
+        {
+          g_array_remove_index (tween->properties, i);
+          removed = TRUE;
+        }
+      else
+        i++;
+    }
+
+  if (tween->properties->len == 0)
+    remove_tween (animator, tween);
+
+  return removed;
+}
+
+/* Takes @property_names away from the tweens of @actor that run at
+ * some point between @start_time and @end_time, like
+ * imports.tweener.tweener does when a tween is added */
+static gboolean
+remove_overlapping_properties (ShellAnimator      *animator,
+                               ClutterActor       *actor,
+                               const char * const *property_names,
+                               double              start_time,
+                               double              end_time)
+{
+  gboolean removed = FALSE;
+  GList *l, *next;
+
+  for (l = animator->tweens.head; l != NULL; l = next)
+    {
+      ShellTween *other = l->data;
+
+      /* remove_properties() might delete the link */
+      next = l->next;
+
+      if (other->removed || other->actor != actor ||
+          other->start_time >= end_time ||
+          other->start_time + other->duration <= start_time)
+        continue;
+
+      removed |= remove_properties (animator, other, property_names);
+    }
+
+  return removed;
+}
+
+/**
+ * shell_animator_add_tween:
+ * @animator: a #ShellAnimator
+ * @tween: a #ShellTween
+ *
+ * Starts running @tween after its delay. Any properties it animates
+ * are taken away from the tweens on the same actor that would run at
+ * the same time.
+ */
+void
+shell_animator_add_tween (ShellAnimator *animator,
+                          ShellTween    *tween)
+{
+  const char **names;
+  double start_time;
+  guint i;
+
+  g_return_if_fail (SHELL_IS_ANIMATOR (animator));
+  g_return_if_fail (SHELL_IS_TWEEN (tween));
+  g_return_if_fail (!tween->added && tween->actor != NULL);
+
+  if (tween->properties->len == 0)
+    return;
+
+  names = g_newa (const char *, tween->properties->len + 1);
+  for (i = 0; i < tween->properties->len; i++)
+    names[i] = g_array_index (tween->properties, TweenProperty, i).pspec->name;
+  names[i] = NULL;
+
+  start_time = animator->current_time + tween->delay;
+  remove_overlapping_properties (animator, tween->actor, names,
+                                 start_time, start_time + tween->duration);
+
+  tween->added = TRUE;
+  tween->start_time = start_time;
+
+  g_queue_push_tail (&animator->tweens, g_object_ref (tween));
+
+  update_running (animator);
+}
+
+/**
+ * shell_animator_remove_overlapping_tweens:
+ * @animator: a #ShellAnimator
+ * @actor: a #ClutterActor
+ * @property_names: (array zero-terminated=1): the properties to take away
+ * @duration: the duration of the other animation, in milliseconds
+ * @delay: the time until the other animation starts, in milliseconds
+ *
+ * Stops animating the given properties of @actor in the tweens that
+ * would run at the same time as an animation with @duration and
+ * @delay that is started elsewhere, for instance by
+ * imports.tweener.tweener. Tweens that only run before or after it
+ * are kept, as with shell_animator_add_tween(). @duration and @delay
+ * are scaled with the slow down factor.
+ *
+ * Return value: %TRUE if any animated property was removed
+ */
+gboolean
+shell_animator_remove_overlapping_tweens (ShellAnimator      *animator,
+                                          ClutterActor       *actor,
+                                          const char * const *property_names,
+                                          guint               duration,
+                                          guint               delay)
+{
+  double start_time;
+
+  g_return_val_if_fail (SHELL_IS_ANIMATOR (animator), FALSE);
+  g_return_val_if_fail (property_names != NULL, FALSE);
+
+  start_time = animator->current_time + delay * st_get_slow_down_factor ();
+
+  return remove_overlapping_properties (animator, actor, property_names,
+                                        start_time,
+                                        start_time + duration * st_get_slow_down_factor ());
+}
+
+/**
+ * shell_animator_remove_tweens:
+ * @animator: a #ShellAnimator
+ * @actor: a #ClutterActor
+ * @property_names: (array zero-terminated=1) (allow-none): the properties
+ *   to stop animating, or %NULL for all of them
+ *
+ * Stops animating the given properties of @actor, leaving them at
+ * their current values.
+ *
+ * Return value: %TRUE if any animated property was removed
+ */
+gboolean
+shell_animator_remove_tweens (ShellAnimator      *animator,
+                              ClutterActor       *actor,
+                              const char * const *property_names)
+{
+  gboolean removed = FALSE;
+  GList *l, *next;
+
+  g_return_val_if_fail (SHELL_IS_ANIMATOR (animator), FALSE);
+
+  for (l = animator->tweens.head; l != NULL; l = next)
+    {
+      ShellTween *tween = l->data;
+
+      /* remove_properties() might delete the link */
+      next = l->next;
+
+      if (!tween->removed && tween->actor == actor)
+        removed |= remove_properties (animator, tween, property_names);
+    }
+
+  return removed;
+}
+
+static gboolean
+tween_has_property (ShellTween         *tween,
+                    const char * const *property_names)
+{
+  guint i;
+
+  for (i = 0; i < tween->properties->len; i++)
+    if (property_in_list (&g_array_index (tween->properties, TweenProperty, i),
+                          property_names))
+      return TRUE;
+
+  return FALSE;
+}
+
+/**
+ * shell_animator_set_tweens_paused:
+ * @animator: a #ShellAnimator
+ * @actor: a #ClutterActor
+ * @property_names: (array zero-terminated=1) (allow-none): the properties
+ *   whose tweens should be paused or resumed, or %NULL for all of them
+ * @paused: whether to pause or resume
+ *
+ * Pauses or resumes the tweens of @actor that animate any of the given
+ * properties. A resumed tween continues where it was paused.
+ *
+ * Return value: %TRUE if any tween was paused or resumed
+ */
+gboolean
+shell_animator_set_tweens_paused (ShellAnimator      *animator,
+                                  ClutterActor       *actor,
+                                  const char * const *property_names,
+                                  gboolean            paused)
+{
+  gboolean changed = FALSE;
+  GList *l;
+
+  g_return_val_if_fail (SHELL_IS_ANIMATOR (animator), FALSE);
+
+  paused = paused != FALSE;
+
+  for (l = animator->tweens.head; l != NULL; l = l->next)
+    {
+      ShellTween *tween = l->data;
+
+      if (tween->removed || tween->actor != actor || tween->paused == paused ||
+          !tween_has_property (tween, property_names))
+        continue;
+
+      if (paused)
+        tween->paused_time = animator->current_time;
+      else
+        tween->start_time += animator->current_time - tween->paused_time;
+
+      tween->paused = paused;
+      changed = TRUE;
+    }
+
+  return changed;
+}
+
+/**
+ * shell_animator_get_tween_count:
+ * @animator: a #ShellAnimator
+ * @actor: a #ClutterActor
+ *
+ * Return value: the number of properties of @actor that are being
+ *   animated, or wait for their tween to start
+ */
+guint
+shell_animator_get_tween_count (ShellAnimator *animator,
+                                ClutterActor  *actor)
+{
+  guint count = 0;
+  GList *l;
+
+  g_return_val_if_fail (SHELL_IS_ANIMATOR (animator), 0);
+
+  for (l = animator->tweens.head; l != NULL; l = l->next)
+    {
+      ShellTween *tween = l->data;
+
+      if (!tween->removed && tween->actor == actor)
+        count += tween->properties->len;
+    }
+
+  return count;
+}
+
+/**
+ * shell_animator_hold_frames:
+ * @animator: a #ShellAnimator
+ *
+ * Keeps @animator running, and emitting #ShellAnimator::new-frame,
+ * even when it has no tweens of its own, until a matching call to
+ * shell_animator_release_frames().
+ */
+void
+shell_animator_hold_frames (ShellAnimator *animator)
+{
+  g_return_if_fail (SHELL_IS_ANIMATOR (animator));
+
+  animator->n_frame_holds++;
+  update_running (animator);
+}
+
+/**
+ * shell_animator_release_frames:
+ * @animator: a #ShellAnimator
+ *
+ * Undoes a call to shell_animator_hold_frames().
+ */
+void
+shell_animator_release_frames (ShellAnimator *animator)
+{
+  g_return_if_fail (SHELL_IS_ANIMATOR (animator));
+  g_return_if_fail (animator->n_frame_holds > 0);
+
+  animator->n_frame_holds--;
+  update_running (animator);
+}
+
+/**
+ * shell_animator_get_frame_time:
+ * @animator: a #ShellAnimator
+ *
+ * Gets the time of the current frame, as used to advance the tweens
+ * of @animator; it stays the same for the whole frame.
+ *
+ * Return value: the monotonic time of the current frame, in
+ *   microseconds, or 0 if @animator isn't running
+ */
+gint64
+shell_animator_get_frame_time (ShellAnimator *animator)
+{
+  g_return_val_if_fail (SHELL_IS_ANIMATOR (animator), 0);
+
+  return animator->frame_time;
+}
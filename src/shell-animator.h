@@ -0,0 +1,76 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+#ifndef __SHELL_ANIMATOR_H__
+#define __SHELL_ANIMATOR_H__
+
+#include <clutter/clutter.h>
+
+G_BEGIN_DECLS
+
+typedef struct _ShellTween ShellTween;
+typedef struct _ShellTweenClass ShellTweenClass;
+
+#define SHELL_TYPE_TWEEN              (shell_tween_get_type ())
+#define SHELL_TWEEN(object)           (G_TYPE_CHECK_INSTANCE_CAST ((object), SHELL_TYPE_TWEEN, ShellTween))
+#define SHELL_TWEEN_CLASS(klass)      (G_TYPE_CHECK_CLASS_CAST ((klass), SHELL_TYPE_TWEEN, ShellTweenClass))
+#define SHELL_IS_TWEEN(object)        (G_TYPE_CHECK_INSTANCE_TYPE ((object), SHELL_TYPE_TWEEN))
+#define SHELL_IS_TWEEN_CLASS(klass)   (G_TYPE_CHECK_CLASS_TYPE ((klass), SHELL_TYPE_TWEEN))
+#define SHELL_TWEEN_GET_CLASS(obj)    (G_TYPE_INSTANCE_GET_CLASS ((obj), SHELL_TYPE_TWEEN, ShellTweenClass))
+
+struct _ShellTweenClass
+{
+  GObjectClass parent_class;
+};
+
+GType shell_tween_get_type (void) G_GNUC_CONST;
+
+ShellTween *shell_tween_new          (ClutterActor         *actor,
+                                      guint                 duration,
+                                      guint                 delay,
+                                      ClutterAnimationMode  mode);
+gboolean    shell_tween_add_property (ShellTween           *tween,
+                                      const char           *property_name,
+                                      double                value);
+
+typedef struct _ShellAnimator ShellAnimator;
+typedef struct _ShellAnimatorClass ShellAnimatorClass;
+
+#define SHELL_TYPE_ANIMATOR              (shell_animator_get_type ())
+#define SHELL_ANIMATOR(object)           (G_TYPE_CHECK_INSTANCE_CAST ((object), SHELL_TYPE_ANIMATOR, ShellAnimator))
+#define SHELL_ANIMATOR_CLASS(klass)      (G_TYPE_CHECK_CLASS_CAST ((klass), SHELL_TYPE_ANIMATOR, ShellAnimatorClass))
+#define SHELL_IS_ANIMATOR(object)        (G_TYPE_CHECK_INSTANCE_TYPE ((object), SHELL_TYPE_ANIMATOR))
+#define SHELL_IS_ANIMATOR_CLASS(klass)   (G_TYPE_CHECK_CLASS_TYPE ((klass), SHELL_TYPE_ANIMATOR))
+#define SHELL_ANIMATOR_GET_CLASS(obj)    (G_TYPE_INSTANCE_GET_CLASS ((obj), SHELL_TYPE_ANIMATOR, ShellAnimatorClass))
+
+struct _ShellAnimatorClass
+{
+  GObjectClass parent_class;
+};
+
+GType shell_animator_get_type (void) G_GNUC_CONST;
+
+ShellAnimator *shell_animator_get_default (void);
+
+void     shell_animator_add_tween          (ShellAnimator      *animator,
+                                            ShellTween         *tween);
+gboolean shell_animator_remove_tweens      (ShellAnimator      *animator,
+                                            ClutterActor       *actor,
+                                            const char * const *property_names);
+gboolean shell_animator_remove_overlapping_tweens (ShellAnimator      *animator,
+                                                   ClutterActor       *actor,
+                                                   const char * const *property_names,
+                                                   guint               duration,
+                                                   guint               delay);
+gboolean shell_animator_set_tweens_paused  (ShellAnimator      *animator,
+                                            ClutterActor       *actor,
+                                            const char * const *property_names,
+                                            gboolean            paused);
+guint    shell_animator_get_tween_count    (ShellAnimator      *animator,
+                                            ClutterActor       *actor);
+
+void     shell_animator_hold_frames        (ShellAnimator      *animator);
+void     shell_animator_release_frames     (ShellAnimator      *animator);
+gint64   shell_animator_get_frame_time     (ShellAnimator      *animator);
+
+G_END_DECLS
+
+#endif /* __SHELL_ANIMATOR_H__ */
@@ -6,4 +6,7 @@
 
 void _shell_app_system_notify_app_state_changed (ShellAppSystem *self, ShellApp *app);
 
+ShellApp *_shell_app_system_lookup_wm_class (ShellAppSystem *system,
+                                            const char     *wm_class);
+
 #endif
@@ -12,6 +12,7 @@
 #include <clutter/clutter.h>
 #include <glib/gi18n.h>
 #include <meta/display.h>
+#include <meta/util.h>
 
 #include "shell-app-private.h"
 #include "shell-window-tracker-private.h"
@@ -36,6 +37,7 @@ enum {
 
 enum {
   APP_STATE_CHANGED,
+  APPS_CHANGED,
   INSTALLED_CHANGED,
   LAST_SIGNAL
 };
@@ -48,6 +50,16 @@ struct _ShellAppSystemPrivate {
   GHashTable *running_apps;
   GHashTable *id_to_app;
 
+  /* <ShellApp *app, NULL>: apps whose state changed since the
+   * last "apps-changed" emission */
+  GHashTable *changed_apps;
+  guint apps_changed_later_id;
+  /* The apps reported by the "apps-changed" emission in progress */
+  GSList *emitting_apps;
+
+  /* <char *lowercase_stem, ShellApp *app>, rebuilt with the apps tree */
+  GHashTable *wm_class_to_app;
+
   GSList *known_vendor_prefixes;
 
   GMenuTree *settings_tree;
@@ -73,6 +85,24 @@ static void shell_app_system_class_init(ShellAppSystemClass *klass)
                                              NULL, NULL, NULL,
                                              G_TYPE_NONE, 1,
                                              SHELL_TYPE_APP);
+
+  /**
+   * ShellAppSystem::apps-changed:
+   * @self: the #ShellAppSystem
+   *
+   * Emitted at most once per frame, before redraw, summarizing all
+   * the #ShellAppSystem::app-state-changed emissions since the last
+   * time. Consumers that only need to re-layout should use this
+   * rather than reacting to each individual state change; handlers
+   * can get the applications concerned with
+   * shell_app_system_get_changed_apps().
+   */
+  signals[APPS_CHANGED] = g_signal_new ("apps-changed",
+                                        SHELL_TYPE_APP_SYSTEM,
+                                        G_SIGNAL_RUN_LAST,
+                                        0,
+                                        NULL, NULL, NULL,
+                                        G_TYPE_NONE, 0);
   signals[INSTALLED_CHANGED] =
     g_signal_new ("installed-changed",
 		  SHELL_TYPE_APP_SYSTEM,
@@ -94,9 +124,13 @@ shell_app_system_init (ShellAppSystem *self)
                                                    ShellAppSystemPrivate);
 
   priv->running_apps = g_hash_table_new_full (NULL, NULL, (GDestroyNotify) g_object_unref, NULL);
+  priv->changed_apps = g_hash_table_new_full (NULL, NULL, (GDestroyNotify) g_object_unref, NULL);
   priv->id_to_app = g_hash_table_new_full (g_str_hash, g_str_equal,
                                            NULL,
                                            (GDestroyNotify)g_object_unref);
+  priv->wm_class_to_app = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                                 (GDestroyNotify)g_free,
+                                                 NULL);
   priv->setting_id_to_app = g_hash_table_new_full (g_str_hash, g_str_equal,
                                                    NULL,
                                                    (GDestroyNotify)g_object_unref);
@@ -124,8 +158,13 @@ shell_app_system_finalize (GObject *object)
   g_object_unref (priv->apps_tree);
   g_object_unref (priv->settings_tree);
 
+  if (priv->apps_changed_later_id)
+    meta_later_remove (priv->apps_changed_later_id);
+
   g_hash_table_destroy (priv->running_apps);
+  g_hash_table_destroy (priv->changed_apps);
   g_hash_table_destroy (priv->id_to_app);
+  g_hash_table_destroy (priv->wm_class_to_app);
   g_hash_table_destroy (priv->setting_id_to_app);
 
   g_slist_foreach (priv->known_vendor_prefixes, (GFunc)g_free, NULL);
@@ -300,6 +339,59 @@ get_flattened_entries_from_tree (GMenuTree *tree)
   return table;
 }
 
+static void
+add_wm_class_stem (ShellAppSystem *self,
+                   const char     *id,
+                   ShellApp       *app)
+{
+  char *stem;
+
+  if (!g_str_has_suffix (id, ".desktop"))
+    return;
+
+  stem = g_strndup (id, strlen (id) - strlen (".desktop"));
+  /* Earlier entries win; this mirrors the lookup order of
+   * shell_app_system_lookup_heuristic_basename().
+   */
+  if (g_hash_table_lookup (self->priv->wm_class_to_app, stem) == NULL)
+    g_hash_table_insert (self->priv->wm_class_to_app, stem, app);
+  else
+    g_free (stem);
+}
+
+/* Build an index from the lowercased, vendor-prefix-stripped desktop
+ * file id (without the .desktop suffix) to the app, so that resolving
+ * a window by WM_CLASS is a single hash lookup.
+ */
+static void
+rebuild_wm_class_index (ShellAppSystem *self)
+{
+  GHashTableIter iter;
+  gpointer key, value;
+  GSList *prefix;
+
+  g_hash_table_remove_all (self->priv->wm_class_to_app);
+
+  /* Exact ids take precedence over vendor-prefixed ones */
+  g_hash_table_iter_init (&iter, self->priv->id_to_app);
+  while (g_hash_table_iter_next (&iter, &key, &value))
+    add_wm_class_stem (self, key, value);
+
+  for (prefix = self->priv->known_vendor_prefixes; prefix; prefix = prefix->next)
+    {
+      const char *vendor = prefix->data;
+
+      g_hash_table_iter_init (&iter, self->priv->id_to_app);
+      while (g_hash_table_iter_next (&iter, &key, &value))
+        {
+          const char *id = key;
+
+          if (g_str_has_prefix (id, vendor))
+            add_wm_class_stem (self, id + strlen (vendor), value);
+        }
+    }
+}
+
 static void
 on_apps_tree_changed_cb (GMenuTree *tree,
                          gpointer   user_data)
@@ -401,6 +493,8 @@ on_apps_tree_changed_cb (GMenuTree *tree,
       
   g_hash_table_destroy (new_apps);
 
+  rebuild_wm_class_index (self);
+
   g_signal_emit (self, signals[INSTALLED_CHANGED], 0);
 }
 
@@ -608,6 +702,46 @@ shell_app_system_lookup_heuristic_basename (ShellAppSystem *system,
   return NULL;
 }
 
+/* Large enough for any sane WM_CLASS; longer ones take the slow path */
+#define WM_CLASS_BUFFER_SIZE 256
+
+/**
+ * _shell_app_system_lookup_wm_class:
+ * @system: a #ShellAppSystem
+ * @wm_class: WM_CLASS of a window
+ *
+ * Find the application whose desktop file id matches @wm_class,
+ * after lowercasing it and replacing spaces with dashes (this
+ * handles "Fedora Eclipse", probably others). Known vendor prefixes
+ * are tried as well. Unlike shell_app_system_lookup_heuristic_basename()
+ * this does not allocate for reasonably sized class names.
+ *
+ * Returns: (transfer none): A #ShellApp for @wm_class, or %NULL
+ */
+ShellApp *
+_shell_app_system_lookup_wm_class (ShellAppSystem *system,
+                                   const char     *wm_class)
+{
+  char buf[WM_CLASS_BUFFER_SIZE];
+  char *stem;
+  ShellApp *result;
+  gsize len, i;
+
+  len = strlen (wm_class);
+  stem = len < sizeof (buf) ? buf : g_malloc (len + 1);
+
+  for (i = 0; i < len; i++)
+    stem[i] = wm_class[i] == ' ' ? '-' : g_ascii_tolower (wm_class[i]);
+  stem[len] = '\0';
+
+  result = g_hash_table_lookup (system->priv->wm_class_to_app, stem);
+
+  if (stem != buf)
+    g_free (stem);
+
+  return result;
+}
+
 /**
  * shell_app_system_get_all:
  * @system:
@@ -632,6 +766,40 @@ shell_app_system_get_all (ShellAppSystem  *self)
   return result;
 }
 
+static gboolean
+emit_apps_changed (gpointer data)
+{
+  ShellAppSystem *self = data;
+  GHashTable *changed_apps;
+  GSList *apps = NULL, *outer_apps;
+  GHashTableIter iter;
+  gpointer key;
+
+  self->priv->apps_changed_later_id = 0;
+
+  /* Swap in a fresh table so that handlers causing further state
+   * changes get them reported in the next frame.
+   */
+  changed_apps = self->priv->changed_apps;
+  self->priv->changed_apps = g_hash_table_new_full (NULL, NULL, (GDestroyNotify) g_object_unref, NULL);
+
+  g_hash_table_iter_init (&iter, changed_apps);
+  while (g_hash_table_iter_next (&iter, &key, NULL))
+    apps = g_slist_prepend (apps, key);
+
+  apps = g_slist_sort (apps, (GCompareFunc)shell_app_compare);
+
+  outer_apps = self->priv->emitting_apps;
+  self->priv->emitting_apps = apps;
+  g_signal_emit (self, signals[APPS_CHANGED], 0);
+  self->priv->emitting_apps = outer_apps;
+
+  g_slist_free (apps);
+  g_hash_table_destroy (changed_apps);
+
+  return FALSE;
+}
+
 void
 _shell_app_system_notify_app_state_changed (ShellAppSystem *self,
                                             ShellApp       *app)
@@ -649,9 +817,34 @@ _shell_app_system_notify_app_state_changed (ShellAppSystem *self,
       g_hash_table_remove (self->priv->running_apps, app);
       break;
     }
+
+  if (!g_hash_table_lookup_extended (self->priv->changed_apps, app, NULL, NULL))
+    g_hash_table_insert (self->priv->changed_apps, g_object_ref (app), NULL);
+  if (self->priv->apps_changed_later_id == 0)
+    self->priv->apps_changed_later_id = meta_later_add (META_LATER_BEFORE_REDRAW,
+                                                        emit_apps_changed,
+                                                        self, NULL);
+
   g_signal_emit (self, signals[APP_STATE_CHANGED], 0, app);
 }
 
+/**
+ * shell_app_system_get_changed_apps:
+ * @self: A #ShellAppSystem
+ *
+ * Returns the applications whose state changed since the previous
+ * emission of #ShellAppSystem::apps-changed. Only meaningful from a
+ * handler of that signal; the list is empty otherwise. The returned
+ * list will be sorted by shell_app_compare().
+ *
+ * Returns: (element-type ShellApp) (transfer container): Changed applications
+ */
+GSList *
+shell_app_system_get_changed_apps (ShellAppSystem *self)
+{
+  return g_slist_copy (self->priv->emitting_apps);
+}
+
 /**
  * shell_app_system_get_running:
  * @self: A #ShellAppSystem
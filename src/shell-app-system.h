@@ -55,6 +55,8 @@ GSList         *shell_app_system_get_all                   (ShellAppSystem  *sys
 
 GSList         *shell_app_system_get_running               (ShellAppSystem  *self);
 
+GSList         *shell_app_system_get_changed_apps          (ShellAppSystem  *self);
+
 GSList         *shell_app_system_initial_search            (ShellAppSystem  *system,
                                                             GSList          *terms);
 GSList         *shell_app_system_subsearch                 (ShellAppSystem  *system,
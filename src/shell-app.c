@@ -10,6 +10,7 @@
 
 #include "shell-app-private.h"
 #include "shell-enum-types.h"
+#include "shell-fade-effect.h"
 #include "shell-global.h"
 #include "shell-util.h"
 #include "shell-app-system-private.h"
@@ -228,7 +229,8 @@ shell_app_create_faded_icon_cpu (StTextureCache *cache,
   gboolean have_alpha;
   gint fade_start;
   gint fade_range;
-  guint i, j;
+  guint *fade;
+  gint i, j;
   guint pixbuf_byte_size;
   guint8 *orig_pixels;
   guint8 *pixels;
@@ -279,22 +281,31 @@ shell_app_create_faded_icon_cpu (StTextureCache *cache,
   pixels = g_malloc0 (rowstride * height);
   memcpy (pixels, orig_pixels, pixbuf_byte_size);
 
+  /* Per-byte fade factors for the right half, in 8.8 fixed point, so
+   * that the loop below walks each row in memory order doing only
+   * integer math. */
   fade_start = width / 2;
   fade_range = width - fade_start;
-  for (i = fade_start; i < width; i++)
+  fade = g_new (guint, fade_range * n_channels);
+  for (i = 0; i < fade_range; i++)
     {
-      for (j = 0; j < height; j++)
-        {
-          guchar *pixel = &pixels[j * rowstride + i * n_channels];
-          float fade = 1.0 - ((float) i - fade_start) / fade_range;
-          pixel[0] = 0.5 + pixel[0] * fade;
-          pixel[1] = 0.5 + pixel[1] * fade;
-          pixel[2] = 0.5 + pixel[2] * fade;
-          if (have_alpha)
-            pixel[3] = 0.5 + pixel[3] * fade;
-        }
+      guint factor = ((fade_range - i) * 256 + fade_range / 2) / fade_range;
+      guint c;
+
+      for (c = 0; c < n_channels; c++)
+        fade[i * n_channels + c] = factor;
     }
 
+  for (j = 0; j < height; j++)
+    {
+      guchar *row = &pixels[j * rowstride + fade_start * n_channels];
+
+      for (i = 0; i < fade_range * n_channels; i++)
+        row[i] = (row[i] * fade[i] + 128) >> 8;
+    }
+
+  g_free (fade);
+
   texture = cogl_texture_new_from_data (width,
                                         height,
                                         COGL_TEXTURE_NONE,
@@ -332,6 +343,15 @@ shell_app_get_faded_icon (ShellApp *app, int size)
   if (!app->entry)
     return window_backed_app_get_icon (app, size);
 
+  /* Fade the normal icon while painting if the GPU can do it; this
+   * shares the texture with the unfaded icon of the same size. */
+  if (shell_fade_effect_is_supported ())
+    {
+      result = shell_app_create_icon_texture (app, size);
+      clutter_actor_add_effect (result, shell_fade_effect_new ());
+      return result;
+    }
+
   /* Use icon: prefix so that we get evicted from the cache on
    * icon theme changes. */
   cache_key = g_strdup_printf ("icon:%s,size=%d,faded", shell_app_get_id (app), size);
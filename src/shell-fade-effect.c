@@ -0,0 +1,203 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+
+/* An effect for a #ClutterTexture that fades the right half of the
+ * texture out horizontally, the look we use for application icons in
+ * the top bar.
+ *
+ * Rather than computing a faded copy of the image on the CPU, the
+ * texture is painted with a second layer holding a one pixel high
+ * gradient and the two are multiplied together by the GPU. Since the
+ * actor's own texture is used, a faded icon shares its texture with the
+ * normal icon of the same size in the texture cache.
+ */
+
+#include "config.h"
+
+#include "shell-fade-effect.h"
+
+#include <cogl/cogl.h>
+
+#include "st/st-pipeline-cache.h"
+
+/* Width of the gradient texture; it is stretched over the actor with
+ * linear filtering so it doesn't need to match the icon size.
+ */
+#define GRADIENT_WIDTH 256
+
+typedef struct _ShellFadeEffectClass   ShellFadeEffectClass;
+
+struct _ShellFadeEffect
+{
+  ClutterEffect parent_instance;
+
+  CoglHandle material;
+};
+
+struct _ShellFadeEffectClass
+{
+  ClutterEffectClass parent_class;
+};
+
+G_DEFINE_TYPE (ShellFadeEffect, shell_fade_effect, CLUTTER_TYPE_EFFECT);
+
+static CoglHandle
+create_gradient_texture (void)
+{
+  guint8 pixels[GRADIENT_WIDTH * 4];
+  int i;
+
+  /* Fully opaque on the left half, then a linear ramp to transparent at
+   * the right edge; premultiplied, so all four channels are the same. */
+  for (i = 0; i < GRADIENT_WIDTH; i++)
+    {
+      guint8 value;
+
+      if (i < GRADIENT_WIDTH / 2)
+        value = 255;
+      else /* 2 * (1 - u) at the texel center */
+        value = (255 * (2 * (GRADIENT_WIDTH - i) - 1) + GRADIENT_WIDTH / 2) / GRADIENT_WIDTH;
+
+      pixels[i * 4 + 0] = value;
+      pixels[i * 4 + 1] = value;
+      pixels[i * 4 + 2] = value;
+      pixels[i * 4 + 3] = value;
+    }
+
+  return cogl_texture_new_from_data (GRADIENT_WIDTH, 1,
+                                     COGL_TEXTURE_NO_ATLAS,
+                                     COGL_PIXEL_FORMAT_RGBA_8888_PRE,
+                                     COGL_PIXEL_FORMAT_RGBA_8888_PRE,
+                                     GRADIENT_WIDTH * 4,
+                                     pixels);
+}
+
+static gboolean
+setup_fade_material (CoglHandle material)
+{
+  CoglHandle gradient;
+
+  gradient = create_gradient_texture ();
+  if (gradient == COGL_INVALID_HANDLE)
+    return FALSE;
+
+  /* Layer 0 is the actor's texture, modulated with the paint opacity
+   * by the default combine; layer 1 scales the result by the gradient */
+  cogl_material_set_layer (material, 1, gradient);
+  cogl_handle_unref (gradient);
+
+  cogl_material_set_layer_wrap_mode (material, 1,
+                                     COGL_MATERIAL_WRAP_MODE_CLAMP_TO_EDGE);
+
+  return cogl_material_set_layer_combine (material, 1,
+                                          "RGBA = MODULATE (PREVIOUS, TEXTURE)",
+                                          NULL);
+}
+
+static CoglHandle
+get_material_template (void)
+{
+  return st_pipeline_cache_get_material ("shell-fade-effect",
+                                         setup_fade_material);
+}
+
+static void
+shell_fade_effect_paint (ClutterEffect           *effect,
+                         ClutterEffectPaintFlags  flags)
+{
+  ShellFadeEffect *self = SHELL_FADE_EFFECT (effect);
+  ClutterActor *actor;
+  CoglHandle texture;
+  ClutterActorBox box;
+  guint8 paint_opacity;
+
+  actor = clutter_actor_meta_get_actor (CLUTTER_ACTOR_META (effect));
+
+  if (!CLUTTER_IS_TEXTURE (actor) ||
+      self->material == COGL_INVALID_HANDLE)
+    {
+      clutter_actor_continue_paint (actor);
+      return;
+    }
+
+  /* Nothing to draw until the texture cache has loaded the icon */
+  texture = clutter_texture_get_cogl_texture (CLUTTER_TEXTURE (actor));
+  if (texture == COGL_INVALID_HANDLE)
+    return;
+
+  cogl_material_set_layer (self->material, 0, texture);
+
+  paint_opacity = clutter_actor_get_paint_opacity (actor);
+  cogl_material_set_color4ub (self->material,
+                              paint_opacity, paint_opacity,
+                              paint_opacity, paint_opacity);
+
+  clutter_actor_get_allocation_box (actor, &box);
+
+  cogl_set_source (self->material);
+  cogl_rectangle (0, 0, box.x2 - box.x1, box.y2 - box.y1);
+}
+
+static void
+shell_fade_effect_dispose (GObject *object)
+{
+  ShellFadeEffect *self = SHELL_FADE_EFFECT (object);
+
+  if (self->material != COGL_INVALID_HANDLE)
+    {
+      cogl_handle_unref (self->material);
+      self->material = COGL_INVALID_HANDLE;
+    }
+
+  G_OBJECT_CLASS (shell_fade_effect_parent_class)->dispose (object);
+}
+
+static void
+shell_fade_effect_class_init (ShellFadeEffectClass *klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+  ClutterEffectClass *effect_class = CLUTTER_EFFECT_CLASS (klass);
+
+  gobject_class->dispose = shell_fade_effect_dispose;
+
+  effect_class->paint = shell_fade_effect_paint;
+}
+
+static void
+shell_fade_effect_init (ShellFadeEffect *self)
+{
+  CoglHandle template;
+
+  template = get_material_template ();
+  if (template != COGL_INVALID_HANDLE)
+    self->material = cogl_material_copy (template);
+  else
+    self->material = COGL_INVALID_HANDLE;
+}
+
+/**
+ * shell_fade_effect_is_supported:
+ *
+ * Checks whether the GPU can do the multitexturing the effect needs.
+ * Must be called with a Cogl context, i.e. after Clutter is initialized.
+ *
+ * Return value: %TRUE if a #ShellFadeEffect can be used
+ */
+gboolean
+shell_fade_effect_is_supported (void)
+{
+  return get_material_template () != COGL_INVALID_HANDLE;
+}
+
+/**
+ * shell_fade_effect_new:
+ *
+ * Creates an effect that fades the right half of a #ClutterTexture
+ * out horizontally.
+ *
+ * Return value: (transfer full): a new #ShellFadeEffect
+ */
+ClutterEffect *
+shell_fade_effect_new (void)
+{
+  return g_object_new (SHELL_TYPE_FADE_EFFECT, NULL);
+}
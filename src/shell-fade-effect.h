@@ -0,0 +1,22 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+#ifndef __SHELL_FADE_EFFECT_H__
+#define __SHELL_FADE_EFFECT_H__
+
+#include <clutter/clutter.h>
+
+G_BEGIN_DECLS
+
+#define SHELL_TYPE_FADE_EFFECT                 (shell_fade_effect_get_type ())
+#define SHELL_FADE_EFFECT(obj)                 (G_TYPE_CHECK_INSTANCE_CAST ((obj), SHELL_TYPE_FADE_EFFECT, ShellFadeEffect))
+#define SHELL_IS_FADE_EFFECT(obj)              (G_TYPE_CHECK_INSTANCE_TYPE ((obj), SHELL_TYPE_FADE_EFFECT))
+
+typedef struct _ShellFadeEffect        ShellFadeEffect;
+
+GType          shell_fade_effect_get_type      (void) G_GNUC_CONST;
+
+gboolean       shell_fade_effect_is_supported  (void);
+ClutterEffect *shell_fade_effect_new           (void);
+
+G_END_DECLS
+
+#endif /* __SHELL_FADE_EFFECT_H__ */
@@ -0,0 +1,497 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+
+/**
+ * SECTION:shell-hit-test
+ * @short_description: Finds the actor at a stage position without picking
+ *
+ * clutter_stage_get_actor_at_pos() renders the whole stage in pick mode
+ * and reads back a pixel, which stalls on the GPU. The shell calls it on
+ * every pointer motion during drag-and-drop, so that adds up with a full
+ * overview.
+ *
+ * shell_hit_test_actor_at_pos() walks the actor tree in reverse paint
+ * order instead, and tests the point against the transformed allocation
+ * of each actor. This only works for actors that are scaled and
+ * translated, and whose pick implementation we know; when it finds any
+ * other actor that might be under the point, it falls back to a real
+ * pick.
+ *
+ * Subtrees are skipped when the point is outside their paint volume.
+ * Clutter already keeps the paint volumes of actors up to date as they
+ * are allocated, moved and redrawn, and they include the children of
+ * actors that don't clip them, so they work as a bounding volume
+ * hierarchy without us having to maintain a separate spatial index and
+ * track every allocation change; and the volumes are usually cached
+ * from the last paint.
+ */
+
+#include "config.h"
+
+#include "shell-hit-test.h"
+#include "shell-generic-container.h"
+#include "st.h"
+
+typedef enum {
+  HIT_NONE,
+  HIT_ACTOR,
+  /* The point is over something we can't resolve ourselves */
+  HIT_COMPLEX
+} HitResult;
+
+typedef enum {
+  /* The allocation, then the children on top */
+  PICK_DEFAULT,
+  PICK_BOX_LAYOUT,
+  PICK_SCROLL_VIEW,
+  PICK_GENERIC_CONTAINER,
+  PICK_UNKNOWN
+} PickKind;
+
+typedef void (* PickFunc) (ClutterActor       *actor,
+                           const ClutterColor *color);
+
+/* Lookups made through shell_hit_test_actor_at_pos() */
+static guint n_resolved_lookups;
+static guint n_pick_render_lookups;
+
+/* All pick renders of the stage, including Clutter's own to deliver
+ * pointer events; see shell_hit_test_track_stage() */
+static guint n_stage_picks;
+
+static PickFunc
+get_class_pick (GType type)
+{
+  /* Never unreffed; these classes stay around anyway */
+  return CLUTTER_ACTOR_CLASS (g_type_class_ref (type))->pick;
+}
+
+static PickKind
+get_pick_kind (ClutterActor *actor)
+{
+  static PickFunc actor_pick, group_pick, texture_pick, box_layout_pick;
+  static PickFunc scroll_view_pick, generic_container_pick;
+  PickFunc pick;
+
+  if (G_UNLIKELY (actor_pick == NULL))
+    {
+      actor_pick = get_class_pick (CLUTTER_TYPE_ACTOR);
+      group_pick = get_class_pick (CLUTTER_TYPE_GROUP);
+      texture_pick = get_class_pick (CLUTTER_TYPE_TEXTURE);
+      box_layout_pick = get_class_pick (ST_TYPE_BOX_LAYOUT);
+      scroll_view_pick = get_class_pick (ST_TYPE_SCROLL_VIEW);
+      generic_container_pick = get_class_pick (SHELL_TYPE_GENERIC_CONTAINER);
+    }
+
+  pick = CLUTTER_ACTOR_GET_CLASS (actor)->pick;
+
+  if (pick == actor_pick || pick == group_pick)
+    return PICK_DEFAULT;
+  /* Without pick-with-alpha, ClutterTexture chains up to the default
+   * pick; this covers icons and window textures */
+  else if (pick == texture_pick)
+    return (clutter_texture_get_pick_with_alpha (CLUTTER_TEXTURE (actor))
+            ? PICK_UNKNOWN : PICK_DEFAULT);
+  else if (pick == box_layout_pick)
+    return PICK_BOX_LAYOUT;
+  else if (pick == scroll_view_pick)
+    return PICK_SCROLL_VIEW;
+  else if (pick == generic_container_pick)
+    return PICK_GENERIC_CONTAINER;
+  else
+    return PICK_UNKNOWN;
+}
+
+/* Whether @matrix maps the actor's plane to the stage with only a
+ * scale and a translation, so that its boxes stay boxes.
+ */
+static gboolean
+is_axis_aligned (const CoglMatrix *matrix)
+{
+  return (matrix->xy == 0 && matrix->yx == 0 &&
+          matrix->zx == 0 && matrix->zy == 0 && matrix->zw == 0 &&
+          matrix->wx == 0 && matrix->wy == 0 && matrix->ww == 1 &&
+          matrix->xx != 0 && matrix->yy != 0);
+}
+
+static gboolean
+point_in_rect (gfloat x,
+               gfloat y,
+               gfloat x1,
+               gfloat y1,
+               gfloat x2,
+               gfloat y2)
+{
+  return x >= x1 && x < x2 && y >= y1 && y < y2;
+}
+
+/* Whether nothing outside the paint volume and the allocation of
+ * @actor, an actor of kind @kind, can be picked, its children included.
+ * Some paint volumes, like that of ClutterText, can be smaller than the
+ * allocation, which is still picked. */
+static gboolean
+pick_within_paint_volume (ClutterActor *actor,
+                          PickKind      kind)
+{
+  switch (kind)
+    {
+    case PICK_DEFAULT:
+    case PICK_SCROLL_VIEW:
+    case PICK_GENERIC_CONTAINER:
+      return TRUE;
+
+    case PICK_BOX_LAYOUT:
+      {
+        /* The paint volume of a scrolled box layout is its content
+         * box, while its background is picked over the allocation */
+        StAdjustment *hadjustment, *vadjustment;
+
+        st_scrollable_get_adjustments (ST_SCROLLABLE (actor),
+                                       &hadjustment, &vadjustment);
+        return hadjustment == NULL && vadjustment == NULL;
+      }
+
+    case PICK_UNKNOWN:
+    default:
+      return FALSE;
+    }
+}
+
+static HitResult hit_test_actor (ClutterActor     *actor,
+                                 const CoglMatrix *parent_matrix,
+                                 ClutterPickMode   pick_mode,
+                                 gfloat            x,
+                                 gfloat            y,
+                                 ClutterActor    **hit);
+
+static HitResult
+hit_test_children (ClutterActor     *actor,
+                   const CoglMatrix *matrix,
+                   ClutterPickMode   pick_mode,
+                   gfloat            x,
+                   gfloat            y,
+                   ClutterActor    **hit)
+{
+  ShellGenericContainer *container = NULL;
+  ClutterActor *child;
+  HitResult result;
+
+  if (get_pick_kind (actor) == PICK_GENERIC_CONTAINER)
+    container = SHELL_GENERIC_CONTAINER (actor);
+
+  for (child = clutter_actor_get_last_child (actor);
+       child != NULL;
+       child = clutter_actor_get_previous_sibling (child))
+    {
+      if (container && shell_generic_container_get_skip_paint (container, child))
+        continue;
+
+      result = hit_test_actor (child, matrix, pick_mode, x, y, hit);
+      if (result != HIT_NONE)
+        return result;
+    }
+
+  return HIT_NONE;
+}
+
+/* StScrollView only picks its child and the scrollbars it shows */
+static HitResult
+hit_test_scroll_view (ClutterActor     *actor,
+                      const CoglMatrix *matrix,
+                      ClutterPickMode   pick_mode,
+                      gfloat            x,
+                      gfloat            y,
+                      ClutterActor    **hit)
+{
+  StScrollView *scroll = ST_SCROLL_VIEW (actor);
+  ClutterActor *child;
+  gboolean hscrollbar_visible, vscrollbar_visible;
+  HitResult result;
+
+  g_object_get (scroll,
+                "hscrollbar-visible", &hscrollbar_visible,
+                "vscrollbar-visible", &vscrollbar_visible,
+                NULL);
+
+  if (vscrollbar_visible)
+    {
+      result = hit_test_actor (st_scroll_view_get_vscroll_bar (scroll),
+                               matrix, pick_mode, x, y, hit);
+      if (result != HIT_NONE)
+        return result;
+    }
+
+  if (hscrollbar_visible)
+    {
+      result = hit_test_actor (st_scroll_view_get_hscroll_bar (scroll),
+                               matrix, pick_mode, x, y, hit);
+      if (result != HIT_NONE)
+        return result;
+    }
+
+  child = st_bin_get_child (ST_BIN (scroll));
+  if (child)
+    return hit_test_actor (child, matrix, pick_mode, x, y, hit);
+
+  return HIT_NONE;
+}
+
+static HitResult
+hit_test_actor (ClutterActor     *actor,
+                const CoglMatrix *parent_matrix,
+                ClutterPickMode   pick_mode,
+                gfloat            x,
+                gfloat            y,
+                ClutterActor    **hit)
+{
+  static guint pick_signal_id;
+  CoglMatrix local, matrix;
+  ClutterActorBox box;
+  gfloat local_x, local_y, width, height;
+  gfloat offset_x = 0, offset_y = 0;
+  PickKind kind;
+  HitResult result;
+
+  if (G_UNLIKELY (pick_signal_id == 0))
+    pick_signal_id = g_signal_lookup ("pick", CLUTTER_TYPE_ACTOR);
+
+  if (!CLUTTER_ACTOR_IS_MAPPED (actor))
+    return HIT_NONE;
+
+  /* See shell_util_set_hidden_from_pick() */
+  if (g_object_get_data (G_OBJECT (actor), "shell-stop-pick") != NULL)
+    return HIT_NONE;
+
+  /* Somebody else draws something into the pick buffer */
+  if (g_signal_has_handler_pending (actor, pick_signal_id, 0, TRUE))
+    return HIT_COMPLEX;
+
+  kind = get_pick_kind (actor);
+
+  clutter_actor_get_transformation_matrix (actor, &local);
+  cogl_matrix_multiply (&matrix, parent_matrix, &local);
+
+  if (!is_axis_aligned (&matrix))
+    {
+      ClutterActorBox paint_box, allocation_box;
+      ClutterVertex vertices[4];
+
+      /* We can't tell where a rotated actor is picked, but we can
+       * still tell that it is nowhere near the point */
+      if (pick_within_paint_volume (actor, kind) &&
+          clutter_actor_get_paint_box (actor, &paint_box) &&
+          !point_in_rect (x, y, paint_box.x1, paint_box.y1, paint_box.x2, paint_box.y2))
+        {
+          clutter_actor_get_abs_allocation_vertices (actor, vertices);
+          clutter_actor_box_from_vertices (&allocation_box, vertices);
+          if (!point_in_rect (x, y,
+                              allocation_box.x1, allocation_box.y1,
+                              allocation_box.x2, allocation_box.y2))
+            return HIT_NONE;
+        }
+
+      return HIT_COMPLEX;
+    }
+
+  local_x = (x - matrix.xw) / matrix.xx;
+  local_y = (y - matrix.yw) / matrix.yy;
+
+  clutter_actor_get_allocation_box (actor, &box);
+  width = box.x2 - box.x1;
+  height = box.y2 - box.y1;
+
+  if (pick_within_paint_volume (actor, kind) &&
+      !point_in_rect (local_x, local_y, 0, 0, width, height))
+    {
+      const ClutterPaintVolume *volume = clutter_actor_get_paint_volume (actor);
+
+      if (volume != NULL)
+        {
+          ClutterVertex origin;
+
+          clutter_paint_volume_get_origin (volume, &origin);
+          if (!point_in_rect (local_x, local_y,
+                              origin.x, origin.y,
+                              origin.x + clutter_paint_volume_get_width (volume),
+                              origin.y + clutter_paint_volume_get_height (volume)))
+            return HIT_NONE;
+        }
+    }
+
+  if (clutter_actor_has_clip (actor))
+    {
+      gfloat clip_x, clip_y, clip_width, clip_height;
+
+      clutter_actor_get_clip (actor, &clip_x, &clip_y, &clip_width, &clip_height);
+      if (!point_in_rect (local_x, local_y,
+                          clip_x, clip_y,
+                          clip_x + clip_width, clip_y + clip_height))
+        return HIT_NONE;
+    }
+  else if (clutter_actor_get_clip_to_allocation (actor))
+    {
+      if (!point_in_rect (local_x, local_y, 0, 0, width, height))
+        return HIT_NONE;
+    }
+
+  switch (kind)
+    {
+    case PICK_UNKNOWN:
+      /* We assume that custom pick implementations stay within the
+       * allocation, like clutter_actor_get_paint_volume() does for
+       * most actors.
+       */
+      if (clutter_actor_get_n_children (actor) == 0 &&
+          !point_in_rect (local_x, local_y, 0, 0, width, height))
+        return HIT_NONE;
+      return HIT_COMPLEX;
+
+    case PICK_SCROLL_VIEW:
+      result = hit_test_scroll_view (actor, &matrix, pick_mode, x, y, hit);
+      break;
+
+    case PICK_BOX_LAYOUT:
+      {
+        /* st_box_layout_pick() draws the background where it stays
+         * while scrolling, and clips the children to the content box */
+        StAdjustment *hadjustment, *vadjustment;
+
+        st_scrollable_get_adjustments (ST_SCROLLABLE (actor),
+                                       &hadjustment, &vadjustment);
+        if (hadjustment)
+          offset_x = (int) st_adjustment_get_value (hadjustment);
+        if (vadjustment)
+          offset_y = (int) st_adjustment_get_value (vadjustment);
+
+        if (hadjustment || vadjustment)
+          {
+            StThemeNode *theme_node = st_widget_get_theme_node (ST_WIDGET (actor));
+            ClutterActorBox content_box;
+
+            st_theme_node_get_content_box (theme_node, &box, &content_box);
+            if (!point_in_rect (local_x, local_y,
+                                (int) (content_box.x1 + offset_x),
+                                (int) (content_box.y1 + offset_y),
+                                (int) (content_box.x2 + offset_x),
+                                (int) (content_box.y2 + offset_y)))
+              {
+                result = HIT_NONE;
+                break;
+              }
+          }
+      }
+      /* fall through */
+
+    case PICK_DEFAULT:
+    case PICK_GENERIC_CONTAINER:
+      result = hit_test_children (actor, &matrix, pick_mode, x, y, hit);
+      break;
+    }
+
+  if (result != HIT_NONE)
+    return result;
+
+  if ((pick_mode == CLUTTER_PICK_ALL || CLUTTER_ACTOR_IS_REACTIVE (actor)) &&
+      point_in_rect (local_x, local_y,
+                     offset_x, offset_y, offset_x + width, offset_y + height))
+    {
+      *hit = actor;
+      return HIT_ACTOR;
+    }
+
+  return HIT_NONE;
+}
+
+/**
+ * shell_hit_test_actor_at_pos:
+ * @stage: a #ClutterStage
+ * @pick_mode: how the actors should be picked
+ * @x: X coordinate to check
+ * @y: Y coordinate to check
+ *
+ * Like clutter_stage_get_actor_at_pos(), but avoids the pick render
+ * when the actors around the point are only scaled and translated.
+ *
+ * Return value: (transfer none): the actor at the specified coordinates
+ */
+ClutterActor *
+shell_hit_test_actor_at_pos (ClutterStage    *stage,
+                             ClutterPickMode  pick_mode,
+                             gfloat           x,
+                             gfloat           y)
+{
+  ClutterActor *stage_actor = CLUTTER_ACTOR (stage);
+  ClutterActor *child, *hit = NULL;
+  ClutterActorBox box;
+  CoglMatrix identity;
+  HitResult result = HIT_NONE;
+
+  g_return_val_if_fail (CLUTTER_IS_STAGE (stage), NULL);
+
+  if (pick_mode == CLUTTER_PICK_NONE)
+    return clutter_stage_get_actor_at_pos (stage, pick_mode, x, y);
+
+  /* Like a pick, this brings the allocations up to date first */
+  clutter_actor_get_allocation_box (stage_actor, &box);
+
+  /* The stage itself doesn't draw into the pick buffer */
+  cogl_matrix_init_identity (&identity);
+  for (child = clutter_actor_get_last_child (stage_actor);
+       child != NULL && result == HIT_NONE;
+       child = clutter_actor_get_previous_sibling (child))
+    result = hit_test_actor (child, &identity, pick_mode, x, y, &hit);
+
+  if (result == HIT_COMPLEX)
+    {
+      n_pick_render_lookups++;
+      return clutter_stage_get_actor_at_pos (stage, pick_mode, x, y);
+    }
+
+  n_resolved_lookups++;
+
+  return result == HIT_ACTOR ? hit : stage_actor;
+}
+
+static void
+on_stage_pick (ClutterActor       *stage,
+               const ClutterColor *color,
+               gpointer            data)
+{
+  n_stage_picks++;
+}
+
+/**
+ * shell_hit_test_track_stage:
+ * @stage: a #ClutterStage
+ *
+ * Starts counting the pick renders of @stage, whoever asks for them,
+ * for shell_hit_test_get_stats().
+ */
+void
+shell_hit_test_track_stage (ClutterStage *stage)
+{
+  g_return_if_fail (CLUTTER_IS_STAGE (stage));
+
+  g_signal_connect (stage, "pick", G_CALLBACK (on_stage_pick), NULL);
+}
+
+/**
+ * shell_hit_test_get_stats:
+ * @resolved_lookups: (out): number of lookups resolved by walking the actors
+ * @pick_render_lookups: (out): number of lookups that needed a pick render
+ * @stage_picks: (out): number of pick renders of the tracked stage
+ *
+ * Gets the number of shell_hit_test_actor_at_pos() calls since startup,
+ * and the number of times the stage passed to
+ * shell_hit_test_track_stage() was rendered in pick mode, for the
+ * performance log. The latter includes the picks Clutter does itself
+ * to deliver pointer events.
+ */
+void
+shell_hit_test_get_stats (guint *resolved_lookups,
+                          guint *pick_render_lookups,
+                          guint *stage_picks)
+{
+  *resolved_lookups = n_resolved_lookups;
+  *pick_render_lookups = n_pick_render_lookups;
+  *stage_picks = n_stage_picks;
+}
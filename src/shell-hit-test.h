@@ -0,0 +1,22 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+#ifndef __SHELL_HIT_TEST_H__
+#define __SHELL_HIT_TEST_H__
+
+#include <clutter/clutter.h>
+
+G_BEGIN_DECLS
+
+ClutterActor *shell_hit_test_actor_at_pos (ClutterStage    *stage,
+                                           ClutterPickMode  pick_mode,
+                                           gfloat           x,
+                                           gfloat           y);
+
+void          shell_hit_test_track_stage  (ClutterStage    *stage);
+
+void          shell_hit_test_get_stats    (guint           *resolved_lookups,
+                                           guint           *pick_render_lookups,
+                                           guint           *stage_picks);
+
+G_END_DECLS
+
+#endif /* __SHELL_HIT_TEST_H__ */
@@ -0,0 +1,667 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+
+/* A PNG writer for large images that uses all the available CPUs.
+ *
+ * The image is split into bands of rows. Each band is filtered and
+ * deflated independently on a thread pool; all bands but the last end
+ * with a sync flush, so the raw deflate output of consecutive bands can
+ * simply be concatenated into a single zlib stream, the same way pigz
+ * does it. The Adler-32 checksums of the bands are combined at the end.
+ * Bands are written to the output stream in order as soon as they are
+ * done, so writing overlaps with compressing the rest of the image.
+ */
+
+#include "config.h"
+
+#include <string.h>
+#include <unistd.h>
+
+#include "shell-png-encoder.h"
+
+/* Amount of uncompressed data per band; large enough that restarting
+ * the compression dictionary for each band costs little, small enough
+ * to keep all the CPUs busy on a single monitor screenshot.
+ */
+#define BAND_SIZE (256 * 1024)
+
+#define ADLER_BASE 65521
+/* Largest n such that 255n(n+1)/2 + (n+1)(ADLER_BASE-1) fits in 32 bits */
+#define ADLER_NMAX 5552
+
+enum {
+  FILTER_NONE,
+  FILTER_SUB,
+  FILTER_UP,
+  FILTER_AVERAGE,
+  FILTER_PAETH,
+  N_FILTERS
+};
+
+typedef struct {
+  const guchar *data;
+  int stride;
+  int width;
+  int height;
+  gboolean has_alpha;
+  int bpp; /* bytes per output pixel */
+  int level;
+  GCancellable *cancellable;
+
+  GMutex mutex;
+  GCond cond;
+} EncodeJob;
+
+typedef struct {
+  EncodeJob *job;
+  int first_row;
+  int n_rows;
+  gboolean last;
+
+  gboolean done;
+  GError *error;
+  guint32 adler;
+  gsize raw_size;
+  GByteArray *compressed;
+} Band;
+
+static guint32 crc_table[256];
+
+static void
+init_crc_table (void)
+{
+  guint32 c;
+  int n, k;
+
+  for (n = 0; n < 256; n++)
+    {
+      c = (guint32) n;
+      for (k = 0; k < 8; k++)
+        {
+          if (c & 1)
+            c = 0xedb88320L ^ (c >> 1);
+          else
+            c = c >> 1;
+        }
+      crc_table[n] = c;
+    }
+}
+
+static guint32
+update_crc (guint32       crc,
+            const guchar *buf,
+            gsize         len)
+{
+  gsize i;
+
+  for (i = 0; i < len; i++)
+    crc = crc_table[(crc ^ buf[i]) & 0xff] ^ (crc >> 8);
+
+  return crc;
+}
+
+static guint32
+update_adler32 (guint32       adler,
+                const guchar *buf,
+                gsize         len)
+{
+  guint32 a = adler & 0xffff;
+  guint32 b = adler >> 16;
+
+  while (len > 0)
+    {
+      gsize n = MIN (len, ADLER_NMAX);
+
+      len -= n;
+      while (n--)
+        {
+          a += *buf++;
+          b += a;
+        }
+
+      a %= ADLER_BASE;
+      b %= ADLER_BASE;
+    }
+
+  return (b << 16) | a;
+}
+
+/* Checksum of the concatenation of two buffers, given the checksum of
+ * each and the length of the second one; this is adler32_combine() from
+ * zlib.
+ */
+static guint32
+combine_adler32 (guint32 adler1,
+                 guint32 adler2,
+                 gsize   len2)
+{
+  guint32 rem = len2 % ADLER_BASE;
+  guint32 sum1 = adler1 & 0xffff;
+  guint32 sum2 = (rem * sum1) % ADLER_BASE;
+
+  sum1 += (adler2 & 0xffff) + ADLER_BASE - 1;
+  sum2 += (adler1 >> 16) + (adler2 >> 16) + ADLER_BASE - rem;
+
+  if (sum1 >= ADLER_BASE)
+    sum1 -= ADLER_BASE;
+  if (sum1 >= ADLER_BASE)
+    sum1 -= ADLER_BASE;
+  if (sum2 >= (ADLER_BASE << 1))
+    sum2 -= (ADLER_BASE << 1);
+  if (sum2 >= ADLER_BASE)
+    sum2 -= ADLER_BASE;
+
+  return sum1 | (sum2 << 16);
+}
+
+/* Converts a row of native-endian cairo pixels to PNG's RGB or RGBA,
+ * undoing the alpha premultiplication the way cairo's own PNG writer
+ * does.
+ */
+static void
+convert_row (const EncodeJob *job,
+             int              row,
+             guchar          *dest)
+{
+  const guint32 *src = (const guint32 *) (job->data + row * job->stride);
+  int i;
+
+  for (i = 0; i < job->width; i++)
+    {
+      guint32 pixel = src[i];
+      guint r = (pixel >> 16) & 0xff;
+      guint g = (pixel >> 8) & 0xff;
+      guint b = pixel & 0xff;
+
+      if (job->has_alpha)
+        {
+          guint alpha = pixel >> 24;
+
+          if (alpha == 0)
+            {
+              r = g = b = 0;
+            }
+          else if (alpha != 0xff)
+            {
+              r = (r * 255 + alpha / 2) / alpha;
+              g = (g * 255 + alpha / 2) / alpha;
+              b = (b * 255 + alpha / 2) / alpha;
+            }
+
+          *dest++ = r;
+          *dest++ = g;
+          *dest++ = b;
+          *dest++ = alpha;
+        }
+      else
+        {
+          *dest++ = r;
+          *dest++ = g;
+          *dest++ = b;
+        }
+    }
+}
+
+static guchar
+paeth_predictor (int a,
+                 int b,
+                 int c)
+{
+  int p = a + b - c;
+  int pa = ABS (p - a);
+  int pb = ABS (p - b);
+  int pc = ABS (p - c);
+
+  if (pa <= pb && pa <= pc)
+    return a;
+  else if (pb <= pc)
+    return b;
+  else
+    return c;
+}
+
+/* Applies @filter to @row, given the previous (unfiltered) row @prev
+ * which is all zeros for the first row of the image. Returns the sum
+ * of the filtered bytes taken as signed, the heuristic libpng uses to
+ * pick a filter.
+ */
+static guint
+filter_row (int           filter,
+            const guchar *row,
+            const guchar *prev,
+            gsize         row_size,
+            int           bpp,
+            guchar       *dest)
+{
+  guint sum = 0;
+  gsize i;
+
+  for (i = 0; i < row_size; i++)
+    {
+      int left = i >= (gsize) bpp ? row[i - bpp] : 0;
+      int up = prev[i];
+      int up_left = i >= (gsize) bpp ? prev[i - bpp] : 0;
+      guchar value;
+
+      switch (filter)
+        {
+        case FILTER_SUB:
+          value = row[i] - left;
+          break;
+        case FILTER_UP:
+          value = row[i] - up;
+          break;
+        case FILTER_AVERAGE:
+          value = row[i] - (left + up) / 2;
+          break;
+        case FILTER_PAETH:
+          value = row[i] - paeth_predictor (left, up, up_left);
+          break;
+        case FILTER_NONE:
+        default:
+          value = row[i];
+          break;
+        }
+
+      dest[i] = value;
+      sum += value < 128 ? value : 256 - value;
+    }
+
+  return sum;
+}
+
+/* Writes the filter type byte and the filtered row into @dest */
+static void
+filter_row_best (const EncodeJob *job,
+                 const guchar    *row,
+                 const guchar    *prev,
+                 gsize            row_size,
+                 guchar          *scratch,
+                 guchar          *dest)
+{
+  guint best_sum = G_MAXUINT;
+  int best_filter = FILTER_NONE;
+  int filter;
+
+  /* Not worth filtering if we don't compress, and "up" is cheap and
+   * does very well on screen contents, so the fast levels use just it.
+   */
+  if (job->level == 0)
+    {
+      dest[0] = FILTER_NONE;
+      memcpy (dest + 1, row, row_size);
+      return;
+    }
+  else if (job->level >= 1 && job->level <= 3)
+    {
+      dest[0] = FILTER_UP;
+      filter_row (FILTER_UP, row, prev, row_size, job->bpp, dest + 1);
+      return;
+    }
+
+  for (filter = 0; filter < N_FILTERS; filter++)
+    {
+      guint sum = filter_row (filter, row, prev, row_size, job->bpp, scratch);
+
+      if (sum < best_sum)
+        {
+          best_sum = sum;
+          best_filter = filter;
+          memcpy (dest + 1, scratch, row_size);
+        }
+    }
+
+  dest[0] = best_filter;
+}
+
+static gboolean
+compress_band (Band         *band,
+               const guchar *raw,
+               gsize         raw_size)
+{
+  EncodeJob *job = band->job;
+  GConverter *compressor;
+  GConverterFlags flags;
+  GConverterResult result;
+  gsize bytes_read, bytes_written;
+  gsize in_pos = 0;
+  gsize out_size;
+  guchar *out;
+
+  compressor = G_CONVERTER (g_zlib_compressor_new (G_ZLIB_COMPRESSOR_FORMAT_RAW,
+                                                   job->level));
+
+  /* The last band terminates the deflate stream; the others are
+   * flushed to a byte boundary so they can be concatenated.
+   */
+  flags = band->last ? G_CONVERTER_INPUT_AT_END : G_CONVERTER_FLUSH;
+
+  /* Worst case deflate expansion is a few bytes per stored block */
+  out_size = raw_size + raw_size / 8 + 64;
+  out = g_malloc (out_size);
+
+  while (TRUE)
+    {
+      result = g_converter_convert (compressor,
+                                    raw + in_pos, raw_size - in_pos,
+                                    out, out_size,
+                                    flags,
+                                    &bytes_read, &bytes_written,
+                                    &band->error);
+      if (result == G_CONVERTER_ERROR)
+        break;
+
+      in_pos += bytes_read;
+      g_byte_array_append (band->compressed, out, bytes_written);
+
+      if (result == G_CONVERTER_FINISHED || result == G_CONVERTER_FLUSHED)
+        break;
+
+      /* zlib is done flushing once it no longer fills the output */
+      if (!band->last && in_pos == raw_size && bytes_written < out_size)
+        break;
+    }
+
+  g_free (out);
+  g_object_unref (compressor);
+
+  return result != G_CONVERTER_ERROR;
+}
+
+static void
+encode_band (gpointer data,
+             gpointer user_data)
+{
+  Band *band = data;
+  EncodeJob *job = band->job;
+  gsize row_size = job->width * job->bpp;
+  gsize raw_size = band->n_rows * (row_size + 1);
+  guchar *raw = NULL;
+  guchar *row, *prev, *scratch;
+  int i;
+
+  if (g_cancellable_set_error_if_cancelled (job->cancellable, &band->error))
+    goto out;
+
+  raw = g_malloc (raw_size);
+  row = g_malloc (row_size);
+  prev = g_malloc0 (row_size);
+  scratch = g_malloc (row_size);
+
+  /* Filters look at the row above, which belongs to the previous band */
+  if (band->first_row > 0)
+    convert_row (job, band->first_row - 1, prev);
+
+  for (i = 0; i < band->n_rows; i++)
+    {
+      guchar *tmp;
+
+      convert_row (job, band->first_row + i, row);
+      filter_row_best (job, row, prev, row_size, scratch,
+                       raw + i * (row_size + 1));
+
+      tmp = prev;
+      prev = row;
+      row = tmp;
+    }
+
+  g_free (row);
+  g_free (prev);
+  g_free (scratch);
+
+  band->raw_size = raw_size;
+  band->adler = update_adler32 (1, raw, raw_size);
+  compress_band (band, raw, raw_size);
+
+ out:
+  g_free (raw);
+
+  g_mutex_lock (&job->mutex);
+  band->done = TRUE;
+  g_cond_broadcast (&job->cond);
+  g_mutex_unlock (&job->mutex);
+}
+
+static GThreadPool *
+get_thread_pool (void)
+{
+  static gsize once_init = 0;
+  static GThreadPool *pool = NULL;
+
+  if (g_once_init_enter (&once_init))
+    {
+      long n_cpus = sysconf (_SC_NPROCESSORS_ONLN);
+
+      init_crc_table ();
+      pool = g_thread_pool_new (encode_band, NULL,
+                                CLAMP (n_cpus, 1, 32), FALSE, NULL);
+
+      g_once_init_leave (&once_init, 1);
+    }
+
+  return pool;
+}
+
+static void
+put_uint32 (guchar  *buf,
+            guint32  value)
+{
+  buf[0] = value >> 24;
+  buf[1] = value >> 16;
+  buf[2] = value >> 8;
+  buf[3] = value;
+}
+
+static gboolean
+write_data (GOutputStream  *stream,
+            const guchar   *data,
+            gsize           len,
+            GCancellable   *cancellable,
+            GError        **error)
+{
+  if (len == 0)
+    return TRUE;
+
+  return g_output_stream_write_all (stream, data, len, NULL, cancellable, error);
+}
+
+/* Writes a chunk whose data is the concatenation of up to three pieces,
+ * so that the zlib header and trailer don't need to be copied into the
+ * compressed data.
+ */
+static gboolean
+write_chunk (GOutputStream  *stream,
+             const char     *type,
+             const guchar   *prefix,
+             gsize           prefix_len,
+             const guchar   *data,
+             gsize           data_len,
+             const guchar   *suffix,
+             gsize           suffix_len,
+             GCancellable   *cancellable,
+             GError        **error)
+{
+  guchar header[8];
+  guchar trailer[4];
+  guint32 crc;
+
+  put_uint32 (header, prefix_len + data_len + suffix_len);
+  memcpy (header + 4, type, 4);
+
+  crc = update_crc (0xffffffff, header + 4, 4);
+  crc = update_crc (crc, prefix, prefix_len);
+  crc = update_crc (crc, data, data_len);
+  crc = update_crc (crc, suffix, suffix_len);
+  put_uint32 (trailer, crc ^ 0xffffffff);
+
+  return (write_data (stream, header, 8, cancellable, error) &&
+          write_data (stream, prefix, prefix_len, cancellable, error) &&
+          write_data (stream, data, data_len, cancellable, error) &&
+          write_data (stream, suffix, suffix_len, cancellable, error) &&
+          write_data (stream, trailer, 4, cancellable, error));
+}
+
+static void
+get_zlib_header (int     level,
+                 guchar *header)
+{
+  int flevel;
+
+  if (level == -1)
+    level = 6;
+
+  if (level < 2)
+    flevel = 0;
+  else if (level < 6)
+    flevel = 1;
+  else if (level == 6)
+    flevel = 2;
+  else
+    flevel = 3;
+
+  /* Deflate with a 32K window, and a check value that makes the
+   * header a multiple of 31 */
+  header[0] = 0x78;
+  header[1] = flevel << 6;
+  header[1] += 31 - ((header[0] << 8) + header[1]) % 31;
+}
+
+/**
+ * shell_png_encoder_write_surface:
+ * @surface: a cairo image surface in %CAIRO_FORMAT_RGB24 or %CAIRO_FORMAT_ARGB32
+ * @stream: stream to write the PNG file to
+ * @level: zlib compression level, 0 to 9, or %SHELL_PNG_ENCODER_LEVEL_DEFAULT
+ * @cancellable: optional #GCancellable
+ * @error: return location for an error
+ *
+ * Encodes @surface as a PNG file, like cairo_surface_write_to_png_stream(),
+ * but compressing on all the available CPUs. The stream is not closed.
+ *
+ * Return value: %TRUE if the image was written successfully
+ */
+gboolean
+shell_png_encoder_write_surface (cairo_surface_t  *surface,
+                                 GOutputStream    *stream,
+                                 int               level,
+                                 GCancellable     *cancellable,
+                                 GError          **error)
+{
+  static const guchar signature[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+  GThreadPool *pool = get_thread_pool ();
+  EncodeJob job;
+  Band *bands;
+  int n_bands, rows_per_band;
+  guchar ihdr[13];
+  guchar zlib_header[2];
+  guchar zlib_trailer[4];
+  guint32 adler = 1;
+  GError *band_error = NULL;
+  gboolean success = TRUE;
+  int i;
+
+  g_return_val_if_fail (cairo_surface_get_type (surface) == CAIRO_SURFACE_TYPE_IMAGE, FALSE);
+  g_return_val_if_fail (level >= -1 && level <= 9, FALSE);
+
+  cairo_surface_flush (surface);
+
+  job.data = cairo_image_surface_get_data (surface);
+  job.stride = cairo_image_surface_get_stride (surface);
+  job.width = cairo_image_surface_get_width (surface);
+  job.height = cairo_image_surface_get_height (surface);
+  job.has_alpha = cairo_image_surface_get_format (surface) == CAIRO_FORMAT_ARGB32;
+  job.bpp = job.has_alpha ? 4 : 3;
+  job.level = level;
+  job.cancellable = cancellable;
+
+  g_return_val_if_fail (job.has_alpha ||
+                        cairo_image_surface_get_format (surface) == CAIRO_FORMAT_RGB24, FALSE);
+  g_return_val_if_fail (job.width > 0 && job.height > 0, FALSE);
+
+  g_mutex_init (&job.mutex);
+  g_cond_init (&job.cond);
+
+  rows_per_band = MAX (1, BAND_SIZE / (job.width * job.bpp + 1));
+  n_bands = (job.height + rows_per_band - 1) / rows_per_band;
+  bands = g_new0 (Band, n_bands);
+
+  for (i = 0; i < n_bands; i++)
+    {
+      Band *band = &bands[i];
+
+      band->job = &job;
+      band->first_row = i * rows_per_band;
+      band->n_rows = MIN (rows_per_band, job.height - band->first_row);
+      band->last = i == n_bands - 1;
+      band->compressed = g_byte_array_new ();
+
+      g_thread_pool_push (pool, band, NULL);
+    }
+
+  put_uint32 (ihdr, job.width);
+  put_uint32 (ihdr + 4, job.height);
+  ihdr[8] = 8;                      /* bit depth */
+  ihdr[9] = job.has_alpha ? 6 : 2;  /* color type: RGBA or RGB */
+  ihdr[10] = 0;                     /* compression: deflate */
+  ihdr[11] = 0;                     /* filter method: adaptive */
+  ihdr[12] = 0;                     /* no interlacing */
+
+  get_zlib_header (level, zlib_header);
+
+  success = (write_data (stream, signature, 8, cancellable, error) &&
+             write_chunk (stream, "IHDR", NULL, 0, ihdr, 13, NULL, 0, cancellable, error));
+
+  /* Each band goes out in its own IDAT chunk as soon as it and all the
+   * ones before it are done. Even after a failure we still have to wait
+   * for all the bands, since they point into our stack frame.
+   */
+  for (i = 0; i < n_bands; i++)
+    {
+      Band *band = &bands[i];
+
+      g_mutex_lock (&job.mutex);
+      while (!band->done)
+        g_cond_wait (&job.cond, &job.mutex);
+      g_mutex_unlock (&job.mutex);
+
+      if (band->error != NULL)
+        {
+          if (band_error == NULL)
+            band_error = band->error;
+          else
+            g_error_free (band->error);
+        }
+
+      if (success && band_error == NULL)
+        {
+          adler = i == 0 ? band->adler : combine_adler32 (adler, band->adler, band->raw_size);
+          if (band->last)
+            put_uint32 (zlib_trailer, adler);
+
+          success = write_chunk (stream, "IDAT",
+                                 zlib_header, i == 0 ? 2 : 0,
+                                 band->compressed->data, band->compressed->len,
+                                 zlib_trailer, band->last ? 4 : 0,
+                                 cancellable, error);
+        }
+
+      g_byte_array_free (band->compressed, TRUE);
+    }
+
+  if (success && band_error != NULL)
+    {
+      g_propagate_error (error, band_error);
+      success = FALSE;
+    }
+  else if (band_error != NULL)
+    {
+      g_error_free (band_error);
+    }
+
+  if (success)
+    success = write_chunk (stream, "IEND", NULL, 0, NULL, 0, NULL, 0, cancellable, error);
+
+  g_free (bands);
+  g_mutex_clear (&job.mutex);
+  g_cond_clear (&job.cond);
+
+  return success;
+}
@@ -0,0 +1,23 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+#ifndef __SHELL_PNG_ENCODER_H__
+#define __SHELL_PNG_ENCODER_H__
+
+#include <gio/gio.h>
+#include <cairo.h>
+
+G_BEGIN_DECLS
+
+/* zlib compression levels: 0 stores the data uncompressed, 1 is the
+ * fastest and 9 the smallest. -1 picks zlib's default.
+ */
+#define SHELL_PNG_ENCODER_LEVEL_DEFAULT -1
+
+gboolean shell_png_encoder_write_surface (cairo_surface_t  *surface,
+                                          GOutputStream    *stream,
+                                          int               level,
+                                          GCancellable     *cancellable,
+                                          GError          **error);
+
+G_END_DECLS
+
+#endif /* __SHELL_PNG_ENCODER_H__ */
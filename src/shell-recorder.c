@@ -62,6 +62,32 @@ struct _ShellRecorder {
 
   gboolean only_paint; /* Used to temporarily suppress recording */
 
+  /* Host-memory copy of the stage contents. Each paint only reads back
+   * the part of the stage that was redrawn and merges it in here, so a
+   * mostly static screen costs very little to record.
+   */
+  guint8 *shadow;
+  int shadow_width;
+  int shadow_height;
+  gboolean shadow_valid;
+  guint8 *damage_buffer; /* scratch space for reading back the redraw clip */
+  gsize damage_buffer_size;
+
+  /* Areas redrawn while we weren't recording a frame; they are redrawn
+   * again before the next frame so the shadow copy picks them up.
+   */
+  cairo_rectangle_int_t pending_damage;
+  gboolean have_pending_damage;
+
+  gboolean force_frame; /* record the next frame even if nothing changed */
+  int last_pointer_x; /* cursor position in the last recorded frame */
+  int last_pointer_y;
+
+  guint64 bytes_read; /* total read back from the stage */
+  guint frames_recorded; /* frames sent to the pipeline */
+  guint frames_skipped; /* frames not recorded because nothing changed */
+  guint frames_dropped; /* frames not recorded to keep to the framerate */
+
   int framerate;
   char *pipeline_description;
   char *filename;
@@ -80,9 +106,9 @@ struct _ShellRecorder {
   /* GSource IDs for different timeouts and idles */
   guint redraw_timeout;
   guint redraw_idle;
+  guint pending_damage_timeout;
   guint update_memory_used_timeout;
   guint update_pointer_timeout;
-  guint repaint_hook_id;
 };
 
 struct _RecorderPipeline
@@ -102,6 +128,8 @@ static void recorder_set_pipeline (ShellRecorder *recorder,
 static void recorder_set_filename (ShellRecorder *recorder,
                                    const char    *filename);
 
+static void recorder_queue_redraw (ShellRecorder *recorder);
+
 static void recorder_pipeline_set_caps (RecorderPipeline *pipeline);
 static void recorder_pipeline_closed   (RecorderPipeline *pipeline);
 
@@ -110,7 +138,11 @@ enum {
   PROP_STAGE,
   PROP_FRAMERATE,
   PROP_PIPELINE,
-  PROP_FILENAME
+  PROP_FILENAME,
+  PROP_BYTES_READ,
+  PROP_FRAMES_RECORDED,
+  PROP_FRAMES_SKIPPED,
+  PROP_FRAMES_DROPPED
 };
 
 G_DEFINE_TYPE(ShellRecorder, shell_recorder, G_TYPE_OBJECT);
@@ -237,22 +269,6 @@ get_memory_target (void)
   return DEFAULT_MEMORY_TARGET;
 }
 
-/*
- * Used to force full stage redraws during recording to avoid artifacts
- *
- * Note: That this will cause the stage to be repainted on
- * every animation frame even if the frame wouldn't normally cause any new
- * drawing
- */
-static gboolean
-recorder_repaint_hook (gpointer data)
-{
-  ClutterActor *stage = data;
-  clutter_actor_queue_redraw (stage);
-
-  return TRUE;
-}
-
 static void
 shell_recorder_init (ShellRecorder *recorder)
 {
@@ -291,6 +307,9 @@ shell_recorder_finalize (GObject  *object)
   if (recorder->cursor_image)
     cairo_surface_destroy (recorder->cursor_image);
 
+  g_free (recorder->shadow);
+  g_free (recorder->damage_buffer);
+
   recorder_set_stage (recorder, NULL);
   recorder_set_pipeline (recorder, NULL);
   recorder_set_filename (recorder, NULL);
@@ -354,7 +373,8 @@ recorder_redraw_timeout (gpointer data)
   ShellRecorder *recorder = data;
 
   recorder->redraw_timeout = 0;
-  clutter_actor_queue_redraw (CLUTTER_ACTOR (recorder->stage));
+  recorder->force_frame = TRUE;
+  recorder_queue_redraw (recorder);
 
   return FALSE;
 }
@@ -380,6 +400,31 @@ recorder_remove_redraw_timeout (ShellRecorder *recorder)
     }
 }
 
+/* Timeout used to redraw the areas painted while we were dropping
+ * frames, once the next frame can be recorded
+ */
+static gboolean
+recorder_pending_damage_timeout (gpointer data)
+{
+  ShellRecorder *recorder = data;
+
+  recorder->pending_damage_timeout = 0;
+  if (recorder->have_pending_damage)
+    recorder_queue_redraw (recorder);
+
+  return FALSE;
+}
+
+static void
+recorder_remove_pending_damage_timeout (ShellRecorder *recorder)
+{
+  if (recorder->pending_damage_timeout != 0)
+    {
+      g_source_remove (recorder->pending_damage_timeout);
+      recorder->pending_damage_timeout = 0;
+    }
+}
+
 static void
 recorder_fetch_cursor_image (ShellRecorder *recorder)
 {
@@ -509,6 +554,130 @@ get_wall_time (void)
   return tv.tv_sec * 1000000000LL + tv.tv_usec * 1000LL;
 }
 
+static void
+recorder_add_pending_damage (ShellRecorder               *recorder,
+                             const cairo_rectangle_int_t *clip)
+{
+  if (recorder->have_pending_damage)
+    {
+      cairo_rectangle_int_t *damage = &recorder->pending_damage;
+      int x2 = MAX (damage->x + damage->width, clip->x + clip->width);
+      int y2 = MAX (damage->y + damage->height, clip->y + clip->height);
+
+      damage->x = MIN (damage->x, clip->x);
+      damage->y = MIN (damage->y, clip->y);
+      damage->width = x2 - damage->x;
+      damage->height = y2 - damage->y;
+    }
+  else
+    {
+      recorder->pending_damage = *clip;
+      recorder->have_pending_damage = TRUE;
+    }
+}
+
+static void
+recorder_ensure_shadow (ShellRecorder *recorder)
+{
+  if (recorder->shadow == NULL ||
+      recorder->shadow_width != recorder->stage_width ||
+      recorder->shadow_height != recorder->stage_height)
+    {
+      g_free (recorder->shadow);
+      recorder->shadow = g_malloc (recorder->stage_width * 4 * recorder->stage_height);
+      recorder->shadow_width = recorder->stage_width;
+      recorder->shadow_height = recorder->stage_height;
+      recorder->shadow_valid = FALSE;
+    }
+}
+
+/* Gets the part of the stage redrawn in the current paint, clamped to
+ * the stage; if the shadow copy isn't usable, this is the whole stage.
+ */
+static void
+recorder_get_damage (ShellRecorder         *recorder,
+                     cairo_rectangle_int_t *damage)
+{
+  int x2, y2;
+
+  if (!recorder->shadow_valid)
+    {
+      damage->x = damage->y = 0;
+      damage->width = recorder->stage_width;
+      damage->height = recorder->stage_height;
+      return;
+    }
+
+  clutter_stage_get_redraw_clip_bounds (recorder->stage, damage);
+
+  x2 = MIN (damage->x + damage->width, recorder->stage_width);
+  y2 = MIN (damage->y + damage->height, recorder->stage_height);
+  damage->x = MAX (damage->x, 0);
+  damage->y = MAX (damage->y, 0);
+  damage->width = MAX (x2 - damage->x, 0);
+  damage->height = MAX (y2 - damage->y, 0);
+}
+
+/* Reads back @damage from the stage and merges it into the shadow copy.
+ * Returns %TRUE if any pixels differ from what we had before.
+ */
+static gboolean
+recorder_update_shadow (ShellRecorder               *recorder,
+                        const cairo_rectangle_int_t *damage)
+{
+  gsize damage_size;
+  int shadow_stride;
+  int damage_stride;
+  gboolean changed;
+  int i;
+
+  if (damage->width == 0 || damage->height == 0)
+    return !recorder->shadow_valid;
+
+  damage_stride = damage->width * 4;
+  damage_size = damage_stride * damage->height;
+  if (damage_size > recorder->damage_buffer_size)
+    {
+      g_free (recorder->damage_buffer);
+      recorder->damage_buffer = g_malloc (damage_size);
+      recorder->damage_buffer_size = damage_size;
+    }
+
+  cogl_read_pixels (damage->x, damage->y,
+                    damage->width,
+                    damage->height,
+                    COGL_READ_PIXELS_COLOR_BUFFER,
+                    CLUTTER_CAIRO_FORMAT_ARGB32,
+                    recorder->damage_buffer);
+  recorder->bytes_read += damage_size;
+
+  changed = !recorder->shadow_valid;
+  shadow_stride = recorder->shadow_width * 4;
+
+  for (i = 0; i < damage->height; i++)
+    {
+      guint8 *src = recorder->damage_buffer + i * damage_stride;
+      guint8 *dest = recorder->shadow + (damage->y + i) * shadow_stride + damage->x * 4;
+
+      if (changed || memcmp (dest, src, damage_stride) != 0)
+        {
+          memcpy (dest, src, damage_stride);
+          changed = TRUE;
+        }
+    }
+
+  recorder->shadow_valid = TRUE;
+
+  return changed;
+}
+
+static gboolean
+recorder_cursor_moved (ShellRecorder *recorder)
+{
+  return (recorder->pointer_x != recorder->last_pointer_x ||
+          recorder->pointer_y != recorder->last_pointer_y);
+}
+
 /* Retrieve a frame and feed it into the pipeline
  */
 static void
@@ -518,12 +687,23 @@ recorder_record_frame (ShellRecorder *recorder)
   guint8 *data;
   guint size;
   GstClockTime now;
+  GstClockTime min_interval;
+  cairo_rectangle_int_t damage;
+
+  recorder_ensure_shadow (recorder);
+  recorder_get_damage (recorder, &damage);
 
   /* If we get into the red zone, stop buffering new frames; 13/16 is
   * a bit more than the 3/4 threshold for a red indicator to keep the
   * indicator from flashing between red and yellow. */
   if (recorder->memory_used > (recorder->memory_target * 13) / 16)
-    return;
+    {
+      /* We don't know what changes we're missing; start over from a
+       * full frame once we are recording again.
+       */
+      recorder->shadow_valid = FALSE;
+      return;
+    }
 
   /* Drop frames to get down to something like the target frame rate; since frames
    * are generated with VBlank sync, we don't have full control anyways, so we just
@@ -531,20 +711,50 @@ recorder_record_frame (ShellRecorder *recorder)
    * desired inter-frame interval.
    */
   now = get_wall_time();
-  if (now - recorder->last_frame_time < (3 * 1000000000LL / (4 * recorder->framerate)))
-    return;
+  min_interval = 3 * 1000000000LL / (4 * recorder->framerate);
+  if (now - recorder->last_frame_time < min_interval)
+    {
+      recorder->frames_dropped++;
+
+      /* Redraw the area again for the next frame we do record; what is
+       * in the framebuffer now will have the recording indicator on it.
+       * Redrawing right away would only get dropped again, so wait
+       * until the next frame is due; if the stage paints again before
+       * that, the pending area is simply redrawn later.
+       */
+      if (damage.width > 0 && damage.height > 0)
+        {
+          recorder_add_pending_damage (recorder, &damage);
+          if (recorder->pending_damage_timeout == 0)
+            recorder->pending_damage_timeout =
+              g_timeout_add (1 + (recorder->last_frame_time + min_interval - now) / 1000000,
+                             recorder_pending_damage_timeout, recorder);
+        }
+      return;
+    }
 
   recorder->last_frame_time = now;
 
+  /* A frame identical to the last one is simply not sent; buffers are
+   * timestamped with the time they were captured, so the encoder still
+   * sees the right timeline. We do send a repeated frame if we haven't
+   * sent anything for MAXIMUM_PAUSE_TIME.
+   */
+  if (!recorder_update_shadow (recorder, &damage) &&
+      !recorder_cursor_moved (recorder) &&
+      !recorder->force_frame)
+    {
+      recorder->frames_skipped++;
+      return;
+    }
+
+  recorder->force_frame = FALSE;
+  recorder->last_pointer_x = recorder->pointer_x;
+  recorder->last_pointer_y = recorder->pointer_y;
+
   size = recorder->stage_width * recorder->stage_height * 4;
 
-  data = g_malloc (recorder->stage_width * 4 * recorder->stage_height);
-  cogl_read_pixels (0, 0, /* x/y */
-                    recorder->stage_width,
-                    recorder->stage_height,
-                    COGL_READ_PIXELS_COLOR_BUFFER,
-                    CLUTTER_CAIRO_FORMAT_ARGB32,
-                    data);
+  data = g_memdup (recorder->shadow, size);
 
   buffer = gst_buffer_new();
   GST_BUFFER_SIZE(buffer) = size;
@@ -557,6 +767,8 @@ recorder_record_frame (ShellRecorder *recorder)
   shell_recorder_src_add_buffer (SHELL_RECORDER_SRC (recorder->current_pipeline->src), buffer);
   gst_buffer_unref (buffer);
 
+  recorder->frames_recorded++;
+
   /* Reset the timeout that we used to avoid an overlong pause in the stream */
   recorder_remove_redraw_timeout (recorder);
   recorder_add_redraw_timeout (recorder);
@@ -612,9 +824,26 @@ static gboolean
 recorder_idle_redraw (gpointer data)
 {
   ShellRecorder *recorder = data;
+  cairo_rectangle_int_t clip;
 
   recorder->redraw_idle = 0;
-  clutter_actor_queue_redraw (CLUTTER_ACTOR (recorder->stage));
+
+  /* The cursor is drawn into the frame by us rather than being part of
+   * the stage, so unless some area is waiting to be recorded, all we
+   * need is a paint; redraw a single pixel to get one.
+   */
+  if (recorder->have_pending_damage)
+    {
+      clip = recorder->pending_damage;
+      recorder->have_pending_damage = FALSE;
+    }
+  else
+    {
+      clip.x = clip.y = 0;
+      clip.width = clip.height = 1;
+    }
+
+  clutter_actor_queue_redraw_with_clip (CLUTTER_ACTOR (recorder->stage), &clip);
 
   return FALSE;
 }
@@ -659,6 +888,7 @@ recorder_event_filter (XEvent        *xev,
               recorder->cursor_image = NULL;
             }
 
+          recorder->force_frame = TRUE;
           recorder_queue_redraw (recorder);
         }
     }
@@ -846,6 +1076,8 @@ recorder_set_stage (ShellRecorder *recorder,
           g_source_remove (recorder->redraw_idle);
           recorder->redraw_idle = 0;
         }
+
+      recorder_remove_pending_damage_timeout (recorder);
     }
 
   recorder->stage = stage;
@@ -985,6 +1217,18 @@ shell_recorder_get_property (GObject         *object,
     case PROP_FILENAME:
       g_value_set_string (value, recorder->filename);
       break;
+    case PROP_BYTES_READ:
+      g_value_set_uint64 (value, recorder->bytes_read);
+      break;
+    case PROP_FRAMES_RECORDED:
+      g_value_set_uint (value, recorder->frames_recorded);
+      break;
+    case PROP_FRAMES_SKIPPED:
+      g_value_set_uint (value, recorder->frames_skipped);
+      break;
+    case PROP_FRAMES_DROPPED:
+      g_value_set_uint (value, recorder->frames_dropped);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -1033,6 +1277,46 @@ shell_recorder_class_init (ShellRecorderClass *klass)
                                                         "The filename template to use for output files",
                                                         NULL,
                                                         G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class,
+                                   PROP_BYTES_READ,
+                                   g_param_spec_uint64 ("bytes-read",
+                                                        "Bytes Read",
+                                                        "Total amount of data read back from the stage",
+                                                        0,
+                                                        G_MAXUINT64,
+                                                        0,
+                                                        G_PARAM_READABLE));
+
+  g_object_class_install_property (gobject_class,
+                                   PROP_FRAMES_RECORDED,
+                                   g_param_spec_uint ("frames-recorded",
+                                                      "Frames Recorded",
+                                                      "Number of frames sent to the encoder",
+                                                      0,
+                                                      G_MAXUINT,
+                                                      0,
+                                                      G_PARAM_READABLE));
+
+  g_object_class_install_property (gobject_class,
+                                   PROP_FRAMES_SKIPPED,
+                                   g_param_spec_uint ("frames-skipped",
+                                                      "Frames Skipped",
+                                                      "Number of frames not recorded because nothing changed",
+                                                      0,
+                                                      G_MAXUINT,
+                                                      0,
+                                                      G_PARAM_READABLE));
+
+  g_object_class_install_property (gobject_class,
+                                   PROP_FRAMES_DROPPED,
+                                   g_param_spec_uint ("frames-dropped",
+                                                      "Frames Dropped",
+                                                      "Number of frames not recorded to keep to the framerate",
+                                                      0,
+                                                      G_MAXUINT,
+                                                      0,
+                                                      G_PARAM_READABLE));
 }
 
 /* Sets the GstCaps (video format, in this case) on the stream
@@ -1721,8 +2005,9 @@ shell_recorder_record (ShellRecorder *recorder)
   recorder->state = RECORDER_STATE_RECORDING;
   recorder_add_update_pointer_timeout (recorder);
 
-  /* Set up repaint hook */
-  recorder->repaint_hook_id = clutter_threads_add_repaint_func(recorder_repaint_hook, recorder->stage, NULL);
+  /* The shadow copy may be stale after a pause */
+  recorder->shadow_valid = FALSE;
+  recorder->have_pending_damage = FALSE;
 
   /* Record an initial frame and also redraw with the indicator */
   clutter_actor_queue_redraw (CLUTTER_ACTOR (recorder->stage));
@@ -1755,6 +2040,7 @@ shell_recorder_pause (ShellRecorder *recorder)
   /* We want to record one more frame since some time may have
    * elapsed since the last frame
    */
+  recorder->force_frame = TRUE;
   clutter_actor_paint (CLUTTER_ACTOR (recorder->stage));
 
   if (recorder->filename_has_count)
@@ -1765,12 +2051,6 @@ shell_recorder_pause (ShellRecorder *recorder)
 
   /* Queue a redraw to remove the recording indicator */
   clutter_actor_queue_redraw (CLUTTER_ACTOR (recorder->stage));
-
-  if (recorder->repaint_hook_id != 0)
-  {
-    clutter_threads_remove_repaint_func (recorder->repaint_hook_id);
-    recorder->repaint_hook_id = 0;
-  }
 }
 
 /**
@@ -1793,8 +2073,15 @@ shell_recorder_close (ShellRecorder *recorder)
 
   recorder_remove_update_pointer_timeout (recorder);
   recorder_remove_redraw_timeout (recorder);
+  recorder_remove_pending_damage_timeout (recorder);
   recorder_close_pipeline (recorder);
 
+  g_free (recorder->shadow);
+  recorder->shadow = NULL;
+  g_free (recorder->damage_buffer);
+  recorder->damage_buffer = NULL;
+  recorder->damage_buffer_size = 0;
+
   recorder->state = RECORDER_STATE_CLOSED;
   recorder->count = 0;
   g_free (recorder->unique);
@@ -13,6 +13,7 @@
 #include <meta/meta-shaped-texture.h>
 
 #include "shell-global.h"
+#include "shell-png-encoder.h"
 #include "shell-screenshot.h"
 
 struct _ShellScreenshotClass
@@ -25,6 +26,8 @@ struct _ShellScreenshot
   GObject parent_instance;
 
   ShellGlobal *global;
+
+  ShellScreenshotCompression compression;
 };
 
 /* Used for async screenshot grabbing */
@@ -32,6 +35,7 @@ typedef struct _screenshot_data {
   ShellScreenshot  *screenshot;
 
   char *filename;
+  int compression_level;
 
   cairo_surface_t *image;
   cairo_rectangle_int_t screenshot_area;
@@ -55,6 +59,36 @@ shell_screenshot_init (ShellScreenshot *screenshot)
   screenshot->global = shell_global_get ();
 }
 
+static int
+get_compression_level (ShellScreenshotCompression compression)
+{
+  switch (compression)
+    {
+    case SHELL_SCREENSHOT_COMPRESSION_NONE:
+      return 0;
+    case SHELL_SCREENSHOT_COMPRESSION_FAST:
+      return 1;
+    case SHELL_SCREENSHOT_COMPRESSION_DEFAULT:
+    default:
+      return SHELL_PNG_ENCODER_LEVEL_DEFAULT;
+    }
+}
+
+static _screenshot_data *
+screenshot_data_new (ShellScreenshot *screenshot,
+                     const char      *filename,
+                     ShellScreenshotCallback callback)
+{
+  _screenshot_data *data = g_new0 (_screenshot_data, 1);
+
+  data->screenshot = g_object_ref (screenshot);
+  data->filename = g_strdup (filename);
+  data->compression_level = get_compression_level (screenshot->compression);
+  data->callback = callback;
+
+  return data;
+}
+
 static void
 on_screenshot_written (GObject *source,
                        GAsyncResult *result,
@@ -77,12 +111,52 @@ write_screenshot_thread (GSimpleAsyncResult *result,
                          GObject *object,
                          GCancellable *cancellable)
 {
-  cairo_status_t status;
+  GFile *file;
+  GFileOutputStream *stream;
+  GError *error = NULL;
+  gboolean success = FALSE;
   _screenshot_data *screenshot_data = g_async_result_get_user_data (G_ASYNC_RESULT (result));
   g_assert (screenshot_data != NULL);
 
-  status = cairo_surface_write_to_png (screenshot_data->image, screenshot_data->filename);
-  g_simple_async_result_set_op_res_gboolean (result, status == CAIRO_STATUS_SUCCESS);
+  file = g_file_new_for_path (screenshot_data->filename);
+  stream = g_file_replace (file, NULL, FALSE, G_FILE_CREATE_NONE, cancellable, &error);
+
+  if (stream != NULL)
+    {
+      success = shell_png_encoder_write_surface (screenshot_data->image,
+                                                 G_OUTPUT_STREAM (stream),
+                                                 screenshot_data->compression_level,
+                                                 cancellable, &error);
+
+      if (success)
+        {
+          success = g_output_stream_close (G_OUTPUT_STREAM (stream),
+                                           cancellable, &error);
+        }
+      else
+        {
+          /* Cancelling the close keeps the partial file from replacing
+           * the target */
+          GCancellable *cancel_close = g_cancellable_new ();
+
+          g_cancellable_cancel (cancel_close);
+          g_output_stream_close (G_OUTPUT_STREAM (stream), cancel_close, NULL);
+          g_object_unref (cancel_close);
+        }
+
+      g_object_unref (stream);
+    }
+
+  if (error != NULL)
+    {
+      g_warning ("Failed to write screenshot %s: %s",
+                 screenshot_data->filename, error->message);
+      g_error_free (error);
+    }
+
+  g_object_unref (file);
+
+  g_simple_async_result_set_op_res_gboolean (result, success);
 }
 
 static void
@@ -278,11 +352,8 @@ shell_screenshot_screenshot (ShellScreenshot *screenshot,
                              ShellScreenshotCallback callback)
 {
   ClutterActor *stage;
-  _screenshot_data *data = g_new0 (_screenshot_data, 1);
+  _screenshot_data *data = screenshot_data_new (screenshot, filename, callback);
 
-  data->screenshot = g_object_ref (screenshot);
-  data->filename = g_strdup (filename);
-  data->callback = callback;
   data->include_cursor = include_cursor;
 
   stage = CLUTTER_ACTOR (shell_global_get_stage (screenshot->global));
@@ -317,15 +388,12 @@ shell_screenshot_screenshot_area (ShellScreenshot *screenshot,
                                   ShellScreenshotCallback callback)
 {
   ClutterActor *stage;
-  _screenshot_data *data = g_new0 (_screenshot_data, 1);
+  _screenshot_data *data = screenshot_data_new (screenshot, filename, callback);
 
-  data->screenshot = g_object_ref (screenshot);
-  data->filename = g_strdup (filename);
   data->screenshot_area.x = x;
   data->screenshot_area.y = y;
   data->screenshot_area.width = width;
   data->screenshot_area.height = height;
-  data->callback = callback;
 
   stage = CLUTTER_ACTOR (shell_global_get_stage (screenshot->global));
 
@@ -356,7 +424,7 @@ shell_screenshot_screenshot_window (ShellScreenshot *screenshot,
 {
   GSimpleAsyncResult *result;
 
-  _screenshot_data *screenshot_data = g_new0 (_screenshot_data, 1);
+  _screenshot_data *screenshot_data = screenshot_data_new (screenshot, filename, callback);
 
   MetaScreen *screen = shell_global_get_screen (screenshot->global);
   MetaDisplay *display = meta_screen_get_display (screen);
@@ -367,10 +435,6 @@ shell_screenshot_screenshot_window (ShellScreenshot *screenshot,
   MetaRectangle rect;
   cairo_rectangle_int_t clip;
 
-  screenshot_data->screenshot = g_object_ref (screenshot);
-  screenshot_data->filename = g_strdup (filename);
-  screenshot_data->callback = callback;
-
   window_actor = CLUTTER_ACTOR (meta_window_get_compositor_private (window));
   clutter_actor_get_position (window_actor, &actor_x, &actor_y);
 
@@ -409,6 +473,23 @@ shell_screenshot_screenshot_window (ShellScreenshot *screenshot,
   g_object_unref (result);
 }
 
+/**
+ * shell_screenshot_set_compression:
+ * @screenshot: the #ShellScreenshot
+ * @compression: a #ShellScreenshotCompression
+ *
+ * Sets how hard to compress the PNG files written by subsequent
+ * screenshots.
+ */
+void
+shell_screenshot_set_compression (ShellScreenshot            *screenshot,
+                                  ShellScreenshotCompression  compression)
+{
+  g_return_if_fail (SHELL_IS_SCREENSHOT (screenshot));
+
+  screenshot->compression = compression;
+}
+
 ShellScreenshot *
 shell_screenshot_new (void)
 {
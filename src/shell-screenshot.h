@@ -23,8 +23,27 @@ typedef struct _ShellScreenshotClass ShellScreenshotClass;
 
 GType shell_screenshot_get_type (void) G_GNUC_CONST;
 
+/**
+ * ShellScreenshotCompression:
+ * @SHELL_SCREENSHOT_COMPRESSION_DEFAULT: a good tradeoff between file size and speed
+ * @SHELL_SCREENSHOT_COMPRESSION_FAST: favour speed over file size
+ * @SHELL_SCREENSHOT_COMPRESSION_NONE: store the image data uncompressed
+ *
+ * How much effort to spend compressing the PNG files written; the
+ * faster modes are meant for automated tests that take lots of
+ * screenshots.
+ */
+typedef enum {
+  SHELL_SCREENSHOT_COMPRESSION_DEFAULT,
+  SHELL_SCREENSHOT_COMPRESSION_FAST,
+  SHELL_SCREENSHOT_COMPRESSION_NONE
+} ShellScreenshotCompression;
+
 ShellScreenshot *shell_screenshot_new (void);
 
+void    shell_screenshot_set_compression      (ShellScreenshot *screenshot,
+                                                ShellScreenshotCompression compression);
+
 typedef void (*ShellScreenshotCallback)  (ShellScreenshot *screenshot,
                                            gboolean success,
                                            cairo_rectangle_int_t *screenshot_area);
@@ -534,6 +534,153 @@ shell_util_format_date (const char *format,
   return result;
 }
 
+/* http://daringfireball.net/2010/07/improved_regex_for_matching_urls
+ * The non-ASCII characters are quotation marks: « “ ‘ and » ” ’ */
+#define URL_BALANCED_PARENS "\\((?:[^\\s()<>]+|(?:\\(?:[^\\s()<>]+\\)))*\\)"
+#define URL_LEADING_JUNK "[\\s`(\\[{'\"<\xc2\xab\xe2\x80\x9c\xe2\x80\x98]"
+#define URL_NOT_TRAILING_JUNK "[^\\s`!()\\[\\]{};:'\".,<>?\xc2\xab\xc2\xbb\xe2\x80\x9c\xe2\x80\x9d\xe2\x80\x98\xe2\x80\x99]"
+
+/* (*UCP) makes \s and \w match Unicode spaces and word characters,
+ * such as a no-break space, as in the Javascript version of the
+ * pattern, rather than only ASCII ones */
+#define URL_PATTERN                                                  \
+  "(*UCP)"                                                           \
+  "(^|" URL_LEADING_JUNK ")"                                         \
+  "("                                                                \
+    "(?:"                                                            \
+      "[a-z][\\w-]+://"                       /* scheme:// */         \
+      "|"                                                            \
+      "www\\d{0,3}[.]"                        /* www. */              \
+      "|"                                                            \
+      "[a-z0-9.\\-]+[.][a-z]{2,4}/"           /* foo.xx/ */           \
+    ")"                                                              \
+    "(?:"                                     /* one or more: */      \
+      "[^\\s()<>]+"                           /* run of non-space non-() */ \
+      "|"                                     /* or */                \
+      URL_BALANCED_PARENS                     /* balanced parens */   \
+    ")+"                                                             \
+    "(?:"                                     /* end with: */         \
+      URL_BALANCED_PARENS                     /* balanced parens */   \
+      "|"                                     /* or */                \
+      URL_NOT_TRAILING_JUNK                   /* last non-junk char */ \
+    ")"                                                              \
+  ")"
+
+/* Offsets handed to Javascript are in UTF-16 code units, like
+ * the indices of Javascript strings */
+static int
+utf16_length (const char *start,
+              const char *end)
+{
+  const char *p;
+  int length = 0;
+
+  for (p = start; p < end; p = g_utf8_next_char (p))
+    length += g_utf8_get_char (p) > 0xffff ? 2 : 1;
+
+  return length;
+}
+
+/**
+ * shell_util_find_urls:
+ * @text: a UTF-8 string
+ * @n_offsets: (out): the number of returned offsets
+ *
+ * Finds the URLs in @text in a single pass, with a regular
+ * expression that is only compiled once. The pattern is the one
+ * from http://daringfireball.net/2010/07/improved_regex_for_matching_urls
+ * and matches URLs with or without a scheme.
+ *
+ * Return value: (array length=n_offsets) (transfer full): the start
+ *   and end offset of each URL in turn, in UTF-16 code units as used
+ *   to index Javascript strings
+ */
+int *
+shell_util_find_urls (const char *text,
+                      int        *n_offsets)
+{
+  static GRegex *regex = NULL;
+  GMatchInfo *match_info;
+  GArray *offsets;
+  const char *last = text;
+  int last_offset = 0;
+
+  if (G_UNLIKELY (regex == NULL))
+    {
+      GError *error = NULL;
+
+      regex = g_regex_new (URL_PATTERN, G_REGEX_CASELESS | G_REGEX_OPTIMIZE, 0, &error);
+      if (regex == NULL)
+        g_error ("Failed to compile the URL pattern: %s", error->message);
+    }
+
+  offsets = g_array_new (FALSE, FALSE, sizeof (int));
+
+  g_regex_match (regex, text, 0, &match_info);
+  while (g_match_info_matches (match_info))
+    {
+      int start, end;
+      int start_offset, end_offset;
+
+      g_match_info_fetch_pos (match_info, 2, &start, &end);
+
+      /* Matches come in order and don't overlap, so we only need
+       * to count the characters since the last one */
+      start_offset = last_offset + utf16_length (last, text + start);
+      end_offset = start_offset + utf16_length (text + start, text + end);
+
+      g_array_append_val (offsets, start_offset);
+      g_array_append_val (offsets, end_offset);
+
+      last = text + end;
+      last_offset = end_offset;
+
+      g_match_info_next (match_info, NULL);
+    }
+  g_match_info_free (match_info);
+
+  *n_offsets = offsets->len;
+  return (int *) g_array_free (offsets, FALSE);
+}
+
+/**
+ * shell_util_get_text_offset_at_coords:
+ * @text: a #ClutterText
+ * @x: X coordinate, relative to @text
+ * @y: Y coordinate, relative to @text
+ *
+ * Finds the character of @text under a point, directly from its
+ * layout rather than by asking for the position of each character.
+ *
+ * Return value: the offset of the character, in UTF-16 code units as
+ *   for shell_util_find_urls(), or -1 if there is no character at
+ *   (@x, @y)
+ */
+int
+shell_util_get_text_offset_at_coords (ClutterText *text,
+                                      gfloat       x,
+                                      gfloat       y)
+{
+  PangoLayout *layout;
+  const char *layout_text;
+  gint layout_x, layout_y;
+  int index, trailing;
+
+  g_return_val_if_fail (CLUTTER_IS_TEXT (text), -1);
+
+  layout = clutter_text_get_layout (text);
+  clutter_text_get_layout_offsets (text, &layout_x, &layout_y);
+
+  if (!pango_layout_xy_to_index (layout,
+                                 (x - layout_x) * PANGO_SCALE,
+                                 (y - layout_y) * PANGO_SCALE,
+                                 &index, &trailing))
+    return -1;
+
+  layout_text = pango_layout_get_text (layout);
+  return utf16_length (layout_text, layout_text + index);
+}
+
 /**
  * shell_util_get_week_start:
  *
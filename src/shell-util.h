@@ -25,6 +25,12 @@ char    *shell_util_normalize_and_casefold     (const char       *str);
 char    *shell_util_format_date                (const char       *format,
                                                 gint64            time_ms);
 
+int     *shell_util_find_urls                  (const char       *text,
+                                                int              *n_offsets);
+int      shell_util_get_text_offset_at_coords  (ClutterText      *text,
+                                                gfloat            x,
+                                                gfloat            y);
+
 void     shell_write_soup_message_to_stream    (GOutputStream    *stream,
                                                 SoupMessage      *message,
                                                 GError          **error);
@@ -19,7 +19,9 @@
 
 #include "shell-window-tracker-private.h"
 #include "shell-app-private.h"
+#include "shell-app-system-private.h"
 #include "shell-global.h"
+#include "shell-perf-log.h"
 #include "st.h"
 
 /* This file includes modified code from
@@ -39,17 +41,36 @@
  * have it also track through startup-notification.
  */
 
+/* Upper bound on the negative WM_CLASS cache */
+#define MAX_WM_CLASS_MISSES 256
+
 struct _ShellWindowTracker
 {
   GObject parent;
 
+  /* The current focus app, and the one listeners were last told about */
   ShellApp *focus_app;
+  ShellApp *notified_focus_app;
+  guint focus_app_notify_id;
 
   /* <MetaWindow * window, ShellApp *app> */
   GHashTable *window_to_app;
 
   /* <int, ShellApp *app> */
   GHashTable *launched_pid_to_app;
+
+  /* <const char *id, ShellStartupSequence *sequence>, rebuilt lazily */
+  GHashTable *startup_id_to_sequence;
+  gboolean startup_sequences_dirty;
+
+  /* <char *wm_class, NULL>: classes known not to match any app;
+   * cleared when the installed applications change. */
+  GHashTable *wm_class_misses;
+
+  /* Reported through the perf log */
+  int wm_class_hits;
+  int wm_class_negative_hits;
+  int wm_class_lookups;
 };
 
 G_DEFINE_TYPE (ShellWindowTracker, shell_window_tracker, G_TYPE_OBJECT);
@@ -126,30 +147,6 @@ shell_window_tracker_class_init (ShellWindowTrackerClass *klass)
                                                    G_TYPE_NONE, 0);
 }
 
-/**
- * get_appid_from_window:
- *
- * Turn the WM_CLASS property into our best guess at a .desktop file id.
- */
-static char *
-get_appid_from_window (MetaWindow  *window)
-{
-  const char *wmclass;
-  char *appid_guess;
-
-  wmclass = meta_window_get_wm_class (window);
-  if (!wmclass)
-    return NULL;
-
-  appid_guess = g_ascii_strdown (wmclass, -1);
-
-  /* This handles "Fedora Eclipse", probably others.
-   * Note g_strdelimit is modify-in-place. */
-  g_strdelimit (appid_guess, " ", '-');
-
-  return appid_guess;
-}
-
 /**
  * shell_window_tracker_is_window_interesting:
  *
@@ -211,28 +208,88 @@ shell_window_tracker_is_window_interesting (MetaWindow *window)
  * Return value: (transfer full): A newly-referenced #ShellApp, or %NULL
  */
 static ShellApp *
-get_app_from_window_wmclass (MetaWindow  *window)
+get_app_from_window_wmclass (ShellWindowTracker  *tracker,
+                             MetaWindow          *window)
 {
   ShellApp *app;
-  ShellAppSystem *appsys;
-  char *wmclass;
-  char *with_desktop;
-
-  appsys = shell_app_system_get_default ();
-  wmclass = get_appid_from_window (window);
+  const char *wmclass;
 
+  wmclass = meta_window_get_wm_class (window);
   if (!wmclass)
     return NULL;
 
-  with_desktop = g_strjoin (NULL, wmclass, ".desktop", NULL);
-  g_free (wmclass);
+  tracker->wm_class_lookups++;
 
-  app = shell_app_system_lookup_heuristic_basename (appsys, with_desktop);
-  if (app != NULL)
-    g_object_ref (app);
-  g_free (with_desktop);
+  if (g_hash_table_lookup_extended (tracker->wm_class_misses, wmclass, NULL, NULL))
+    {
+      tracker->wm_class_negative_hits++;
+      return NULL;
+    }
 
-  return app;
+  app = _shell_app_system_lookup_wm_class (shell_app_system_get_default (), wmclass);
+  if (app == NULL)
+    {
+      /* Windows can make up a new WM_CLASS each time; don't let those
+       * pile up between reloads of the app tree */
+      if (g_hash_table_size (tracker->wm_class_misses) >= MAX_WM_CLASS_MISSES)
+        g_hash_table_remove_all (tracker->wm_class_misses);
+      g_hash_table_insert (tracker->wm_class_misses, g_strdup (wmclass), NULL);
+      return NULL;
+    }
+
+  tracker->wm_class_hits++;
+
+  return g_object_ref (app);
+}
+
+/**
+ * get_app_from_window_startup_id:
+ * @tracker: a #ShellWindowTracker
+ * @window: a #MetaWindow
+ *
+ * Check if @window matches a startup sequence we know the
+ * application for.
+ *
+ * Return value: (transfer full): A newly-referenced #ShellApp, or %NULL
+ */
+static ShellApp *
+get_app_from_window_startup_id (ShellWindowTracker  *tracker,
+                                MetaWindow          *window)
+{
+  ShellStartupSequence *sequence;
+  const char *startup_id;
+  ShellApp *result;
+
+  startup_id = meta_window_get_startup_id (window);
+  if (!startup_id)
+    return NULL;
+
+  if (tracker->startup_sequences_dirty)
+    {
+      GSList *iter;
+
+      g_hash_table_remove_all (tracker->startup_id_to_sequence);
+      for (iter = shell_window_tracker_get_startup_sequences (tracker); iter; iter = iter->next)
+        {
+          sequence = iter->data;
+          /* Key is owned by the sequence, so it has to be replaced
+           * along with the value */
+          g_hash_table_replace (tracker->startup_id_to_sequence,
+                               (char*)shell_startup_sequence_get_id (sequence),
+                               g_boxed_copy (SHELL_TYPE_STARTUP_SEQUENCE, sequence));
+        }
+      tracker->startup_sequences_dirty = FALSE;
+    }
+
+  sequence = g_hash_table_lookup (tracker->startup_id_to_sequence, startup_id);
+  if (sequence == NULL)
+    return NULL;
+
+  result = shell_startup_sequence_get_app (sequence);
+  if (result != NULL)
+    g_object_ref (result);
+
+  return result;
 }
 
 /**
@@ -329,7 +386,6 @@ get_app_for_window (ShellWindowTracker    *tracker,
                     MetaWindow            *window)
 {
   ShellApp *result = NULL;
-  const char *startup_id;
 
   /* First, we check whether we already know about this window,
    * if so, just return that.
@@ -351,7 +407,7 @@ get_app_for_window (ShellWindowTracker    *tracker,
   /* Check if the app's WM_CLASS specifies an app; this is
    * canonical if it does.
    */
-  result = get_app_from_window_wmclass (window);
+  result = get_app_from_window_wmclass (tracker, window);
   if (result != NULL)
     return result;
 
@@ -360,27 +416,7 @@ get_app_for_window (ShellWindowTracker    *tracker,
     return result;
 
   /* Now we check whether we have a match through startup-notification */
-  startup_id = meta_window_get_startup_id (window);
-  if (startup_id)
-    {
-      GSList *iter, *sequences;
-
-      sequences = shell_window_tracker_get_startup_sequences (tracker);
-      for (iter = sequences; iter; iter = iter->next)
-        {
-          ShellStartupSequence *sequence = iter->data;
-          const char *id = shell_startup_sequence_get_id (sequence);
-          if (strcmp (id, startup_id) != 0)
-            continue;
-
-          result = shell_startup_sequence_get_app (sequence);
-          if (result)
-            {
-              result = g_object_ref (result);
-              break;
-            }
-        }
-    }
+  result = get_app_from_window_startup_id (tracker, window);
 
   /* If we didn't get a startup-notification match, see if we matched
    * any other windows in the group.
@@ -574,6 +610,8 @@ on_startup_sequence_changed (MetaScreen            *screen,
 {
   ShellApp *app;
 
+  self->startup_sequences_dirty = TRUE;
+
   app = shell_startup_sequence_get_app ((ShellStartupSequence*)sequence);
   if (app)
     _shell_app_handle_startup_sequence (app, sequence);
@@ -581,6 +619,53 @@ on_startup_sequence_changed (MetaScreen            *screen,
   g_signal_emit (G_OBJECT (self), signals[STARTUP_SEQUENCE_CHANGED], 0, sequence);
 }
 
+/* Emitted each time the app tree is reloaded; a WM_CLASS we didn't
+ * know about may now belong to a newly installed app */
+static void
+on_installed_changed (ShellAppSystem     *appsys,
+                      ShellWindowTracker *self)
+{
+  g_hash_table_remove_all (self->wm_class_misses);
+}
+
+static void
+statistics_callback (ShellPerfLog       *perf_log,
+                     ShellWindowTracker *self)
+{
+  shell_perf_log_update_statistic_i (perf_log,
+                                     "windowTracker.wmClassLookups",
+                                     self->wm_class_lookups);
+  shell_perf_log_update_statistic_i (perf_log,
+                                     "windowTracker.wmClassHits",
+                                     self->wm_class_hits);
+  shell_perf_log_update_statistic_i (perf_log,
+                                     "windowTracker.wmClassNegativeHits",
+                                     self->wm_class_negative_hits);
+}
+
+static void
+init_statistics (ShellWindowTracker *self)
+{
+  ShellPerfLog *perf_log = shell_perf_log_get_default ();
+
+  shell_perf_log_define_statistic (perf_log,
+                                   "windowTracker.wmClassLookups",
+                                   "Number of windows resolved by WM_CLASS",
+                                   "i");
+  shell_perf_log_define_statistic (perf_log,
+                                   "windowTracker.wmClassHits",
+                                   "Number of WM_CLASS lookups that found an application",
+                                   "i");
+  shell_perf_log_define_statistic (perf_log,
+                                   "windowTracker.wmClassNegativeHits",
+                                   "Number of WM_CLASS lookups answered by the negative cache",
+                                   "i");
+
+  shell_perf_log_add_statistics_callback (perf_log,
+                                          (ShellPerfStatisticsCallback)statistics_callback,
+                                          self, NULL);
+}
+
 static void
 shell_window_tracker_init (ShellWindowTracker *self)
 {
@@ -591,6 +676,18 @@ shell_window_tracker_init (ShellWindowTracker *self)
 
   self->launched_pid_to_app = g_hash_table_new_full (NULL, NULL, NULL, (GDestroyNotify) g_object_unref);
 
+  self->startup_id_to_sequence = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                                        NULL, (GDestroyNotify) sn_startup_sequence_unref);
+  self->startup_sequences_dirty = TRUE;
+
+  self->wm_class_misses = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                                 g_free, NULL);
+
+  init_statistics (self);
+
+  g_signal_connect (shell_app_system_get_default (), "installed-changed",
+                    G_CALLBACK (on_installed_changed), self);
+
   screen = shell_global_get_screen (shell_global_get ());
 
   g_signal_connect (G_OBJECT (screen), "startup-sequence-changed",
@@ -605,8 +702,17 @@ shell_window_tracker_finalize (GObject *object)
 {
   ShellWindowTracker *self = SHELL_WINDOW_TRACKER (object);
 
+  if (self->focus_app_notify_id)
+    meta_later_remove (self->focus_app_notify_id);
+  if (self->focus_app)
+    g_object_unref (self->focus_app);
+  if (self->notified_focus_app)
+    g_object_unref (self->notified_focus_app);
+
   g_hash_table_destroy (self->window_to_app);
   g_hash_table_destroy (self->launched_pid_to_app);
+  g_hash_table_destroy (self->startup_id_to_sequence);
+  g_hash_table_destroy (self->wm_class_misses);
 
   G_OBJECT_CLASS (shell_window_tracker_parent_class)->finalize(object);
 }
@@ -714,6 +820,28 @@ _shell_window_tracker_add_child_process_app (ShellWindowTracker *tracker,
    */
 }
 
+static gboolean
+notify_focus_app (gpointer data)
+{
+  ShellWindowTracker *tracker = data;
+
+  tracker->focus_app_notify_id = 0;
+
+  /* Focus may have come back to where it was */
+  if (tracker->focus_app == tracker->notified_focus_app)
+    return FALSE;
+
+  if (tracker->notified_focus_app != NULL)
+    g_object_unref (tracker->notified_focus_app);
+  tracker->notified_focus_app = tracker->focus_app;
+  if (tracker->notified_focus_app != NULL)
+    g_object_ref (tracker->notified_focus_app);
+
+  g_object_notify (G_OBJECT (tracker), "focus-app");
+
+  return FALSE;
+}
+
 static void
 set_focus_app (ShellWindowTracker  *tracker,
                ShellApp            *new_focus_app)
@@ -729,7 +857,14 @@ set_focus_app (ShellWindowTracker  *tracker,
   if (tracker->focus_app != NULL)
     g_object_ref (tracker->focus_app);
 
-  g_object_notify (G_OBJECT (tracker), "focus-app");
+  /* Focus can bounce between several windows while a session is
+   * restored or the workspace is switched; the "focus-app" property
+   * follows right away, but listeners are only told once per frame.
+   */
+  if (tracker->focus_app_notify_id == 0)
+    tracker->focus_app_notify_id = meta_later_add (META_LATER_BEFORE_REDRAW,
+                                                   notify_focus_app,
+                                                   tracker, NULL);
 }
 
 static void
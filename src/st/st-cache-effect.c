@@ -0,0 +1,619 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+/*
+ * st-cache-effect.c: Effect keeping a rendering of a static actor
+ *
+ * Copyright 2012 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * SECTION:st-cache-effect
+ * @short_description: an effect caching the rendering of an actor
+ *
+ * #StCacheEffect renders its actor and all of its children into a
+ * texture, and paints that texture instead of the actors as long as
+ * nothing changes. Any redraw queued on the actor or one of its
+ * descendants drops the cached rendering, as does a change of the
+ * paint opacity or a rotation of the actor.
+ *
+ * Moving or scaling the actor keeps the rendering, which is then drawn
+ * scaled and filtered for as long as the actor keeps moving, so that
+ * sliding or zooming a static actor in and out doesn't repaint it on
+ * every frame. Once it stops somewhere that the rendering doesn't land
+ * on whole pixels, it is rendered again so that it is sharp.
+ *
+ * The actor is only rendered offscreen once it has painted twice in a
+ * row without a redraw being queued, so that an actor changing on
+ * every frame is painted directly. All the cached renderings together
+ * are limited to a fixed amount of texture memory; the least recently
+ * painted ones are dropped first.
+ *
+ * Only actors that are not rotated out of the plane of the stage are
+ * cached.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <math.h>
+#include <string.h>
+
+#include <cogl/cogl.h>
+
+#include "st-cache-effect.h"
+
+/* Texture memory used by all the cached renderings together */
+#define CACHE_BUDGET_BYTES (32 * 1024 * 1024)
+
+typedef struct _StCacheEffectClass  StCacheEffectClass;
+
+typedef struct {
+  CoglMatrix modelview;
+  CoglMatrix projection;
+  float      viewport[4];
+  guint8     opacity;
+} PaintState;
+
+/* Maps the window coordinates the texture was rendered at to those it
+ * is painted at */
+typedef struct {
+  float    scale_x;
+  float    scale_y;
+  float    offset_x;
+  float    offset_y;
+  gboolean exact;
+} CacheTransform;
+
+struct _StCacheEffect
+{
+  ClutterEffect parent_instance;
+
+  ClutterActor *actor;
+  gulong        queue_redraw_id;
+
+  CoglHandle    material;
+  CoglHandle    texture;
+  CoglHandle    offscreen;
+  int           width;
+  int           height;
+  GList        *lru_link;
+
+  /* Position of the texture in window coordinates */
+  int           x_offset;
+  int           y_offset;
+
+  /* The state the texture was rendered with */
+  PaintState    state;
+
+  /* The state of the last paint */
+  PaintState    last_state;
+  guint         have_state : 1;
+
+  guint         dirty : 1;
+  guint         linear_filter : 1;
+};
+
+struct _StCacheEffectClass
+{
+  ClutterEffectClass parent_class;
+};
+
+G_DEFINE_TYPE (StCacheEffect, st_cache_effect, CLUTTER_TYPE_EFFECT);
+
+static GQueue cache_lru = G_QUEUE_INIT;
+static gsize cache_size;
+static gboolean cache_debug;
+static gboolean cache_enabled = TRUE;
+
+static void
+release_cache (StCacheEffect *self)
+{
+  if (self->texture == COGL_INVALID_HANDLE)
+    return;
+
+  cogl_material_remove_layer (self->material, 0);
+  cogl_handle_unref (self->offscreen);
+  cogl_handle_unref (self->texture);
+  self->offscreen = COGL_INVALID_HANDLE;
+  self->texture = COGL_INVALID_HANDLE;
+
+  cache_size -= (gsize) self->width * self->height * 4;
+  g_queue_delete_link (&cache_lru, self->lru_link);
+  self->lru_link = NULL;
+}
+
+static gboolean
+ensure_texture (StCacheEffect *self,
+                int            width,
+                int            height)
+{
+  gsize size = (gsize) width * height * 4;
+
+  if (self->texture != COGL_INVALID_HANDLE &&
+      self->width == width && self->height == height)
+    return TRUE;
+
+  release_cache (self);
+
+  if (size > CACHE_BUDGET_BYTES)
+    return FALSE;
+
+  while (cache_size + size > CACHE_BUDGET_BYTES)
+    release_cache (g_queue_peek_head (&cache_lru));
+
+  self->texture = cogl_texture_new_with_size (width, height,
+                                              COGL_TEXTURE_NO_SLICING |
+                                              COGL_TEXTURE_NO_ATLAS,
+                                              COGL_PIXEL_FORMAT_RGBA_8888_PRE);
+  if (self->texture == COGL_INVALID_HANDLE)
+    return FALSE;
+
+  self->offscreen = cogl_offscreen_new_to_texture (self->texture);
+  if (self->offscreen == COGL_INVALID_HANDLE)
+    {
+      cogl_handle_unref (self->texture);
+      self->texture = COGL_INVALID_HANDLE;
+      return FALSE;
+    }
+
+  cogl_material_set_layer (self->material, 0, self->texture);
+
+  self->width = width;
+  self->height = height;
+  cache_size += size;
+
+  g_queue_push_tail (&cache_lru, self);
+  self->lru_link = g_queue_peek_tail_link (&cache_lru);
+
+  return TRUE;
+}
+
+static void
+get_paint_state (StCacheEffect *self,
+                 PaintState    *state)
+{
+  cogl_get_modelview_matrix (&state->modelview);
+  cogl_get_projection_matrix (&state->projection);
+  cogl_get_viewport (state->viewport);
+  state->opacity = clutter_actor_get_paint_opacity (self->actor);
+}
+
+static void
+project_point (const PaintState *state,
+               const CoglMatrix *transform,
+               float             x,
+               float             y,
+               float            *window_x,
+               float            *window_y)
+{
+  float z = 0, w = 1;
+
+  cogl_matrix_transform_point (transform, &x, &y, &z, &w);
+
+  *window_x = state->viewport[0] + (x / w + 1) * state->viewport[2] / 2;
+  *window_y = state->viewport[1] + (1 - y / w) * state->viewport[3] / 2;
+}
+
+static gboolean
+paint_state_equal (const PaintState *a,
+                   const PaintState *b)
+{
+  return (a->opacity == b->opacity &&
+          memcmp (a->viewport, b->viewport, sizeof (a->viewport)) == 0 &&
+          cogl_matrix_equal ((CoglMatrix *) &a->projection,
+                             (CoglMatrix *) &b->projection) &&
+          cogl_matrix_equal ((CoglMatrix *) &a->modelview,
+                             (CoglMatrix *) &b->modelview));
+}
+
+/* Projects the origin of the actor and gets the size of a unit along
+ * its X and Y axes in window coordinates; fails if the axes aren't
+ * parallel to those of the window. Points some way apart are used, so
+ * that rounding doesn't show. */
+static gboolean
+project_axes (const PaintState *state,
+              float            *origin,
+              float            *scale)
+{
+  CoglMatrix transform;
+  float x[2], y[2];
+
+  if (state->modelview.zx != 0 || state->modelview.zy != 0)
+    return FALSE;
+
+  cogl_matrix_multiply (&transform, &state->projection, &state->modelview);
+  project_point (state, &transform, 0, 0, &origin[0], &origin[1]);
+  project_point (state, &transform, 100, 0, &x[0], &x[1]);
+  project_point (state, &transform, 0, 100, &y[0], &y[1]);
+
+  if (fabsf (x[1] - origin[1]) > 0.01 || fabsf (y[0] - origin[0]) > 0.01)
+    return FALSE;
+
+  scale[0] = (x[0] - origin[0]) / 100;
+  scale[1] = (y[1] - origin[1]) / 100;
+
+  return fabsf (scale[0]) > 0.0001 && fabsf (scale[1]) > 0.0001;
+}
+
+/* Checks whether painting with @new_state would give the same pixels as
+ * @old_state, moved and scaled within the plane of the stage, and if so
+ * returns the transformation between the two. It is exact if it only
+ * moves by whole pixels.
+ */
+static gboolean
+get_cache_transform (const PaintState *old_state,
+                     const PaintState *new_state,
+                     CacheTransform   *transform)
+{
+  float old_origin[2], old_scale[2];
+  float new_origin[2], new_scale[2];
+
+  if (old_state->opacity != new_state->opacity ||
+      memcmp (old_state->viewport, new_state->viewport, sizeof (old_state->viewport)) != 0 ||
+      !cogl_matrix_equal ((CoglMatrix *) &old_state->projection,
+                          (CoglMatrix *) &new_state->projection))
+    return FALSE;
+
+  if (!project_axes (old_state, old_origin, old_scale) ||
+      !project_axes (new_state, new_origin, new_scale))
+    return FALSE;
+
+  transform->scale_x = new_scale[0] / old_scale[0];
+  transform->scale_y = new_scale[1] / old_scale[1];
+  transform->offset_x = new_origin[0] - old_origin[0] * transform->scale_x;
+  transform->offset_y = new_origin[1] - old_origin[1] * transform->scale_y;
+
+  transform->exact = (fabsf (transform->scale_x - 1) < 0.0001 &&
+                      fabsf (transform->scale_y - 1) < 0.0001 &&
+                      fabsf (transform->offset_x - floorf (transform->offset_x + 0.5)) < 0.001 &&
+                      fabsf (transform->offset_y - floorf (transform->offset_y + 0.5)) < 0.001);
+  if (transform->exact)
+    {
+      transform->scale_x = transform->scale_y = 1;
+      transform->offset_x = floorf (transform->offset_x + 0.5);
+      transform->offset_y = floorf (transform->offset_y + 0.5);
+    }
+
+  return TRUE;
+}
+
+static gboolean
+update_cache (StCacheEffect    *self,
+              const PaintState *state)
+{
+  const float *viewport = state->viewport;
+  const ClutterPaintVolume *volume;
+  ClutterVertex origin;
+  CoglMatrix transform, narrow, projection;
+  CoglColor transparent;
+  float corners[4][2];
+  float x1 = G_MAXFLOAT, y1 = G_MAXFLOAT, x2 = -G_MAXFLOAT, y2 = -G_MAXFLOAT;
+  float width, height;
+  int i;
+
+  if (state->modelview.zx != 0 || state->modelview.zy != 0)
+    return FALSE;
+
+  volume = clutter_actor_get_paint_volume (self->actor);
+  if (volume == NULL)
+    return FALSE;
+
+  clutter_paint_volume_get_origin (volume, &origin);
+  width = clutter_paint_volume_get_width (volume);
+  height = clutter_paint_volume_get_height (volume);
+
+  corners[0][0] = origin.x;         corners[0][1] = origin.y;
+  corners[1][0] = origin.x + width; corners[1][1] = origin.y;
+  corners[2][0] = origin.x;         corners[2][1] = origin.y + height;
+  corners[3][0] = origin.x + width; corners[3][1] = origin.y + height;
+
+  cogl_matrix_multiply (&transform, &state->projection, &state->modelview);
+
+  for (i = 0; i < 4; i++)
+    {
+      float x, y;
+
+      project_point (state, &transform, corners[i][0], corners[i][1], &x, &y);
+      x1 = MIN (x1, x);
+      y1 = MIN (y1, y);
+      x2 = MAX (x2, x);
+      y2 = MAX (y2, y);
+    }
+
+  x1 = floorf (x1);
+  y1 = floorf (y1);
+  x2 = ceilf (x2);
+  y2 = ceilf (y2);
+
+  if (x2 <= x1 || y2 <= y1)
+    return FALSE;
+
+  if (!ensure_texture (self, x2 - x1, y2 - y1))
+    return FALSE;
+
+  self->state = *state;
+  self->x_offset = x1;
+  self->y_offset = y1;
+
+  /* Paint exactly as we would on the stage, but with the projection
+   * narrowed down to the box from x1,y1 to x2,y2 so that it fills our
+   * texture. Unlike moving the viewport, this keeps the parts outside
+   * the stage, which an actor sliding in needs.
+   */
+  cogl_matrix_init_identity (&narrow);
+  narrow.xx = viewport[2] / (x2 - x1);
+  narrow.xw = narrow.xx * (1 - 2 * (x1 - viewport[0]) / viewport[2]) - 1;
+  narrow.yy = viewport[3] / (y2 - y1);
+  narrow.yw = 1 - narrow.yy * (1 - 2 * (y1 - viewport[1]) / viewport[3]);
+  cogl_matrix_multiply (&projection, &narrow, &state->projection);
+
+  cogl_push_framebuffer (self->offscreen);
+  cogl_set_viewport (0, 0, x2 - x1, y2 - y1);
+  cogl_set_projection_matrix (&projection);
+  cogl_set_modelview_matrix ((CoglMatrix *) &state->modelview);
+
+  cogl_color_init_from_4ub (&transparent, 0, 0, 0, 0);
+  cogl_clear (&transparent, COGL_BUFFER_BIT_COLOR);
+
+  clutter_actor_continue_paint (self->actor);
+
+  cogl_pop_framebuffer ();
+
+  return TRUE;
+}
+
+static void
+paint_cache (StCacheEffect        *self,
+             const CacheTransform *transform)
+{
+  const float *viewport = self->state.viewport;
+  CoglMatrix projection, identity;
+  float x1 = self->x_offset;
+  float y1 = self->y_offset;
+  float x2 = self->x_offset + self->width;
+  float y2 = self->y_offset + self->height;
+  gboolean linear_filter = FALSE;
+
+  if (transform != NULL)
+    {
+      x1 = x1 * transform->scale_x + transform->offset_x;
+      y1 = y1 * transform->scale_y + transform->offset_y;
+      x2 = x2 * transform->scale_x + transform->offset_x;
+      y2 = y2 * transform->scale_y + transform->offset_y;
+      linear_filter = !transform->exact;
+    }
+
+  /* Nearest filtering as long as texels land on pixels, so that the
+   * result is identical to painting the actor */
+  if (linear_filter != self->linear_filter)
+    {
+      CoglMaterialFilter filter = (linear_filter ? COGL_MATERIAL_FILTER_LINEAR
+                                                 : COGL_MATERIAL_FILTER_NEAREST);
+
+      cogl_material_set_layer_filters (self->material, 0, filter, filter);
+      self->linear_filter = linear_filter;
+    }
+
+  g_queue_unlink (&cache_lru, self->lru_link);
+  g_queue_push_tail_link (&cache_lru, self->lru_link);
+
+  /* Draw in window coordinates */
+  cogl_get_projection_matrix (&projection);
+  cogl_ortho (viewport[0], viewport[0] + viewport[2],
+              viewport[1] + viewport[3], viewport[1],
+              -1.0, 1.0);
+  cogl_push_matrix ();
+  cogl_matrix_init_identity (&identity);
+  cogl_set_modelview_matrix (&identity);
+
+  cogl_set_source (self->material);
+  cogl_rectangle (x1, y1, x2, y2);
+
+  if (cache_debug)
+    {
+      if (linear_filter)
+        cogl_set_source_color4ub (0, 0, 0x40, 0x40);
+      else
+        cogl_set_source_color4ub (0, 0x40, 0, 0x40);
+      cogl_rectangle (x1, y1, x2, y2);
+    }
+
+  cogl_pop_matrix ();
+  cogl_set_projection_matrix (&projection);
+}
+
+static void
+st_cache_effect_paint (ClutterEffect           *effect,
+                       ClutterEffectPaintFlags  flags)
+{
+  StCacheEffect *self = ST_CACHE_EFFECT (effect);
+  CacheTransform transform;
+  PaintState state;
+  gboolean dirty;
+
+  dirty = self->dirty || (flags & CLUTTER_EFFECT_PAINT_ACTOR_DIRTY) != 0;
+  self->dirty = FALSE;
+
+  get_paint_state (self, &state);
+
+  if (dirty || !self->have_state)
+    {
+      release_cache (self);
+    }
+  else if (self->texture != COGL_INVALID_HANDLE &&
+           get_cache_transform (&self->state, &state, &transform) &&
+           (transform.exact || !paint_state_equal (&self->last_state, &state)))
+    {
+      /* Either where it was rendered, or on the move; an actor that
+       * stopped off the pixel grid is rendered again below */
+      self->last_state = state;
+      paint_cache (self, &transform);
+      return;
+    }
+  else if (get_cache_transform (&self->last_state, &state, &transform))
+    {
+      /* Only moved since the last paint, so this looks like a static
+       * actor that is worth rendering offscreen */
+      self->last_state = state;
+      if (update_cache (self, &state))
+        {
+          paint_cache (self, NULL);
+          return;
+        }
+    }
+  else
+    {
+      release_cache (self);
+    }
+
+  self->last_state = state;
+  self->have_state = TRUE;
+
+  clutter_actor_continue_paint (self->actor);
+}
+
+static void
+on_queue_redraw (ClutterActor  *actor,
+                 ClutterActor  *origin,
+                 StCacheEffect *self)
+{
+  self->dirty = TRUE;
+}
+
+static void
+st_cache_effect_set_actor (ClutterActorMeta *meta,
+                           ClutterActor     *actor)
+{
+  StCacheEffect *self = ST_CACHE_EFFECT (meta);
+
+  if (self->actor)
+    {
+      g_signal_handler_disconnect (self->actor, self->queue_redraw_id);
+      self->queue_redraw_id = 0;
+    }
+
+  release_cache (self);
+  self->have_state = FALSE;
+
+  CLUTTER_ACTOR_META_CLASS (st_cache_effect_parent_class)->set_actor (meta, actor);
+
+  self->actor = clutter_actor_meta_get_actor (meta);
+
+  if (self->actor)
+    self->queue_redraw_id = g_signal_connect (self->actor, "queue-redraw",
+                                              G_CALLBACK (on_queue_redraw), self);
+}
+
+static void
+st_cache_effect_dispose (GObject *gobject)
+{
+  StCacheEffect *self = ST_CACHE_EFFECT (gobject);
+
+  if (self->actor)
+    {
+      g_signal_handler_disconnect (self->actor, self->queue_redraw_id);
+      self->queue_redraw_id = 0;
+      self->actor = NULL;
+    }
+
+  release_cache (self);
+
+  if (self->material != COGL_INVALID_HANDLE)
+    {
+      cogl_handle_unref (self->material);
+      self->material = COGL_INVALID_HANDLE;
+    }
+
+  G_OBJECT_CLASS (st_cache_effect_parent_class)->dispose (gobject);
+}
+
+static void
+st_cache_effect_class_init (StCacheEffectClass *klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+  ClutterActorMetaClass *meta_class = CLUTTER_ACTOR_META_CLASS (klass);
+  ClutterEffectClass *effect_class = CLUTTER_EFFECT_CLASS (klass);
+
+  gobject_class->dispose = st_cache_effect_dispose;
+
+  meta_class->set_actor = st_cache_effect_set_actor;
+
+  effect_class->paint = st_cache_effect_paint;
+}
+
+static void
+st_cache_effect_init (StCacheEffect *self)
+{
+  self->material = cogl_material_new ();
+
+  /* The texture is drawn at the same pixels it was rendered to */
+  cogl_material_set_layer_filters (self->material, 0,
+                                   COGL_MATERIAL_FILTER_NEAREST,
+                                   COGL_MATERIAL_FILTER_NEAREST);
+}
+
+/**
+ * st_cache_effect_new:
+ *
+ * Creates a new #StCacheEffect, to be added to an actor whose
+ * appearance rarely changes.
+ *
+ * Return value: the newly created #StCacheEffect
+ */
+ClutterEffect *
+st_cache_effect_new (void)
+{
+  return g_object_new (ST_TYPE_CACHE_EFFECT, NULL);
+}
+
+/**
+ * st_cache_effect_set_debug:
+ * @debug: whether to tint cached renderings
+ *
+ * If @debug is %TRUE, the actors painted from a cached rendering are
+ * tinted green. This takes effect the next time they are painted.
+ */
+void
+st_cache_effect_set_debug (gboolean debug)
+{
+  cache_debug = debug != FALSE;
+}
+
+/**
+ * st_cache_effect_set_enabled:
+ * @enabled: whether actors should use a #StCacheEffect
+ *
+ * Records whether the user interface should add #StCacheEffect<!-- -->s
+ * to the actors that might benefit from them, which it does by default.
+ * Turning it off allows comparing frame rates with and without caching;
+ * it doesn't affect effects that were already added.
+ */
+void
+st_cache_effect_set_enabled (gboolean enabled)
+{
+  cache_enabled = enabled != FALSE;
+}
+
+/**
+ * st_cache_effect_get_enabled:
+ *
+ * Return value: whether actors should use a #StCacheEffect, as set by
+ *   st_cache_effect_set_enabled()
+ */
+gboolean
+st_cache_effect_get_enabled (void)
+{
+  return cache_enabled;
+}
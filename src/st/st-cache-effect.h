@@ -0,0 +1,48 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+/*
+ * st-cache-effect.h: Effect keeping a rendering of a static actor
+ *
+ * Copyright 2012 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#if !defined(ST_H_INSIDE) && !defined(ST_COMPILATION)
+#error "Only <st/st.h> can be included directly.h"
+#endif
+
+#ifndef __ST_CACHE_EFFECT_H__
+#define __ST_CACHE_EFFECT_H__
+
+#include <clutter/clutter.h>
+
+G_BEGIN_DECLS
+
+#define ST_TYPE_CACHE_EFFECT        (st_cache_effect_get_type ())
+#define ST_CACHE_EFFECT(obj)        (G_TYPE_CHECK_INSTANCE_CAST ((obj), ST_TYPE_CACHE_EFFECT, StCacheEffect))
+#define ST_IS_CACHE_EFFECT(obj)     (G_TYPE_CHECK_INSTANCE_TYPE ((obj), ST_TYPE_CACHE_EFFECT))
+
+typedef struct _StCacheEffect       StCacheEffect;
+
+GType          st_cache_effect_get_type    (void) G_GNUC_CONST;
+
+ClutterEffect *st_cache_effect_new         (void);
+
+void           st_cache_effect_set_debug   (gboolean debug);
+
+void           st_cache_effect_set_enabled (gboolean enabled);
+gboolean       st_cache_effect_get_enabled (void);
+
+G_END_DECLS
+
+#endif /* __ST_CACHE_EFFECT_H__ */
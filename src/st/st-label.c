@@ -69,6 +69,170 @@ G_DEFINE_TYPE (StLabel, st_label, ST_TYPE_WIDGET);
 
 static GType st_label_accessible_get_type (void) G_GNUC_CONST;
 
+/* Measuring a label means building a PangoLayout for it, and the same
+ * strings in the same font are measured over and over: an application
+ * name shows up in the app grid, the dash tooltips, alt-tab and search
+ * results. We keep the measured extents in a cache shared by all labels,
+ * so a new label only pays for shaping when it is first painted.
+ */
+#define SIZE_CACHE_MAX_ENTRIES 4096
+
+typedef struct {
+  PangoFontDescription *font;
+  char                 *text;
+  gfloat                for_size;
+  PangoEllipsizeMode    ellipsize;
+  gboolean              vertical;
+} SizeCacheKey;
+
+typedef struct {
+  SizeCacheKey key;
+  gfloat       min_size;
+  gfloat       natural_size;
+} SizeCacheEntry;
+
+static GHashTable *size_cache = NULL;
+
+static guint
+size_cache_key_hash (gconstpointer data)
+{
+  const SizeCacheKey *key = data;
+
+  return (pango_font_description_hash (key->font) ^
+          g_str_hash (key->text) ^
+          ((guint) (gint) key->for_size << 4) ^
+          (key->ellipsize << 1) ^
+          key->vertical);
+}
+
+static gboolean
+size_cache_key_equal (gconstpointer a,
+                      gconstpointer b)
+{
+  const SizeCacheKey *key_a = a;
+  const SizeCacheKey *key_b = b;
+
+  return (key_a->for_size == key_b->for_size &&
+          key_a->ellipsize == key_b->ellipsize &&
+          key_a->vertical == key_b->vertical &&
+          strcmp (key_a->text, key_b->text) == 0 &&
+          pango_font_description_equal (key_a->font, key_b->font));
+}
+
+static void
+size_cache_entry_free (gpointer data)
+{
+  SizeCacheEntry *entry = data;
+
+  pango_font_description_free (entry->key.font);
+  g_free (entry->key.text);
+  g_slice_free (SizeCacheEntry, entry);
+}
+
+static void
+on_font_options_changed (ClutterBackend *backend,
+                         gpointer        user_data)
+{
+  g_hash_table_remove_all (size_cache);
+}
+
+static void
+ensure_size_cache (void)
+{
+  ClutterBackend *backend;
+
+  if (size_cache != NULL)
+    return;
+
+  size_cache = g_hash_table_new_full (size_cache_key_hash,
+                                      size_cache_key_equal,
+                                      NULL,
+                                      size_cache_entry_free);
+
+  /* Everything measured so far is invalid if the font rendering changes */
+  backend = clutter_get_default_backend ();
+  g_signal_connect (backend, "resolution-changed",
+                    G_CALLBACK (on_font_options_changed), NULL);
+  g_signal_connect (backend, "font-changed",
+                    G_CALLBACK (on_font_options_changed), NULL);
+}
+
+/* Only plain, non-interactive text measures the same in every label */
+static gboolean
+label_size_is_cacheable (ClutterText *text)
+{
+  return (!clutter_text_get_editable (text) &&
+          !clutter_text_get_use_markup (text) &&
+          !clutter_text_get_line_wrap (text) &&
+          !clutter_text_get_single_line_mode (text) &&
+          clutter_text_get_password_char (text) == 0 &&
+          clutter_text_get_font_description (text) != NULL);
+}
+
+static void
+label_get_preferred_size (StLabel  *label,
+                          gboolean  vertical,
+                          gfloat    for_size,
+                          gfloat   *min_size_p,
+                          gfloat   *natural_size_p)
+{
+  ClutterActor *actor = label->priv->label;
+  ClutterText *text = CLUTTER_TEXT (actor);
+  SizeCacheKey key;
+  SizeCacheEntry *entry;
+  gfloat min_size, natural_size;
+
+  if (!label_size_is_cacheable (text))
+    {
+      if (!vertical)
+        clutter_actor_get_preferred_width (actor, for_size,
+                                           min_size_p, natural_size_p);
+      else
+        clutter_actor_get_preferred_height (actor, for_size,
+                                            min_size_p, natural_size_p);
+      return;
+    }
+
+  ensure_size_cache ();
+
+  /* The lookup key borrows from the ClutterText; only stored keys own copies */
+  key.font = clutter_text_get_font_description (text);
+  key.text = (char *) clutter_text_get_text (text);
+  key.for_size = for_size;
+  key.ellipsize = clutter_text_get_ellipsize (text);
+  key.vertical = vertical;
+
+  entry = g_hash_table_lookup (size_cache, &key);
+  if (entry == NULL)
+    {
+      if (!vertical)
+        clutter_actor_get_preferred_width (actor, for_size,
+                                           &min_size, &natural_size);
+      else
+        clutter_actor_get_preferred_height (actor, for_size,
+                                            &min_size, &natural_size);
+
+      if (g_hash_table_size (size_cache) >= SIZE_CACHE_MAX_ENTRIES)
+        g_hash_table_remove_all (size_cache);
+
+      entry = g_slice_new (SizeCacheEntry);
+      entry->key.font = pango_font_description_copy (key.font);
+      entry->key.text = g_strdup (key.text);
+      entry->key.for_size = for_size;
+      entry->key.ellipsize = key.ellipsize;
+      entry->key.vertical = vertical;
+      entry->min_size = min_size;
+      entry->natural_size = natural_size;
+
+      g_hash_table_replace (size_cache, &entry->key, entry);
+    }
+
+  if (min_size_p)
+    *min_size_p = entry->min_size;
+  if (natural_size_p)
+    *natural_size_p = entry->natural_size;
+}
+
 static void
 st_label_set_property (GObject      *gobject,
                        guint         prop_id,
@@ -135,14 +299,13 @@ st_label_get_preferred_width (ClutterActor *actor,
                               gfloat       *min_width_p,
                               gfloat       *natural_width_p)
 {
-  StLabelPrivate *priv = ST_LABEL (actor)->priv;
+  StLabel *label = ST_LABEL (actor);
   StThemeNode *theme_node = st_widget_get_theme_node (ST_WIDGET (actor));
 
   st_theme_node_adjust_for_height (theme_node, &for_height);
 
-  clutter_actor_get_preferred_width (priv->label, for_height,
-                                     min_width_p,
-                                     natural_width_p);
+  label_get_preferred_size (label, FALSE,
+                            for_height, min_width_p, natural_width_p);
 
   st_theme_node_adjust_preferred_width (theme_node, min_width_p, natural_width_p);
 }
@@ -153,14 +316,13 @@ st_label_get_preferred_height (ClutterActor *actor,
                                gfloat       *min_height_p,
                                gfloat       *natural_height_p)
 {
-  StLabelPrivate *priv = ST_LABEL (actor)->priv;
+  StLabel *label = ST_LABEL (actor);
   StThemeNode *theme_node = st_widget_get_theme_node (ST_WIDGET (actor));
 
   st_theme_node_adjust_for_width (theme_node, &for_width);
 
-  clutter_actor_get_preferred_height (priv->label, for_width,
-                                      min_height_p,
-                                      natural_height_p);
+  label_get_preferred_size (label, TRUE,
+                            for_width, min_height_p, natural_height_p);
 
   st_theme_node_adjust_preferred_height (theme_node, min_height_p, natural_height_p);
 }
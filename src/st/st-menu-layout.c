@@ -0,0 +1,661 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+/*
+ * st-menu-layout.c: Container for the columns of a menu item
+ *
+ * Copyright 2012 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * SECTION:st-menu-layout
+ * @short_description: a container laying out a menu item in columns
+ *
+ * #StMenuLayout lays out its children in a row of columns, the way
+ * the items of a popup menu do. Each child covers one or more columns
+ * (or all the remaining width), and is aligned within them. The menu
+ * collects the natural column widths of all its items with
+ * st_menu_layout_get_column_widths(), and hands the maximum back to
+ * each of them with st_menu_layout_set_column_widths() so that the
+ * columns line up.
+ *
+ * An item can also have a "dot", which is placed in the left padding
+ * (or right padding, for RTL locales) of the container.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <math.h>
+
+#include <clutter/clutter.h>
+
+#include "st-menu-layout.h"
+#include "st-private.h"
+
+#define ST_MENU_LAYOUT_GET_PRIVATE(obj) (G_TYPE_INSTANCE_GET_PRIVATE ((obj), ST_TYPE_MENU_LAYOUT, StMenuLayoutPrivate))
+
+typedef struct {
+  ClutterActor *actor;
+  int           span;
+  StAlign       align;
+  guint         expand : 1;
+
+  /* Natural width for an unconstrained height; < 0 if not known */
+  gfloat        natural_width;
+} StMenuLayoutChild;
+
+struct _StMenuLayoutPrivate
+{
+  GList        *children;
+  ClutterActor *dot;
+
+  int           spacing;
+
+  /* Set by the menu; NULL until then */
+  GArray       *column_widths;
+
+  /* Our own natural column widths, as returned to the menu */
+  GArray       *natural_columns;
+  guint         natural_columns_valid : 1;
+};
+
+static void clutter_container_iface_init (ClutterContainerIface *iface);
+
+G_DEFINE_TYPE_WITH_CODE (StMenuLayout, st_menu_layout, ST_TYPE_WIDGET,
+                         G_IMPLEMENT_INTERFACE (CLUTTER_TYPE_CONTAINER,
+                                                clutter_container_iface_init));
+
+static StMenuLayoutChild *
+find_child (StMenuLayout *layout,
+            ClutterActor *actor)
+{
+  GList *l;
+
+  for (l = layout->priv->children; l; l = l->next)
+    {
+      StMenuLayoutChild *child = l->data;
+
+      if (child->actor == actor)
+        return child;
+    }
+
+  return NULL;
+}
+
+static gfloat
+get_child_natural_width (StMenuLayoutChild *child)
+{
+  if (child->natural_width < 0)
+    clutter_actor_get_preferred_width (child->actor, -1,
+                                       NULL, &child->natural_width);
+
+  return child->natural_width;
+}
+
+static int
+get_column_width (StMenuLayoutPrivate *priv,
+                  int                  column)
+{
+  if (column < 0 || column >= (int) priv->column_widths->len)
+    return 0;
+
+  return g_array_index (priv->column_widths, int, column);
+}
+
+static void
+invalidate_widths (StMenuLayout *layout)
+{
+  StMenuLayoutPrivate *priv = layout->priv;
+  GList *l;
+
+  for (l = priv->children; l; l = l->next)
+    ((StMenuLayoutChild *) l->data)->natural_width = -1;
+
+  priv->natural_columns_valid = FALSE;
+}
+
+/* Children added with clutter_container_add_actor() rather than
+ * st_menu_layout_append() get a single column, aligned to the start.
+ */
+static void
+st_menu_layout_actor_added (ClutterContainer *container,
+                            ClutterActor     *actor)
+{
+  StMenuLayout *layout = ST_MENU_LAYOUT (container);
+  StMenuLayoutChild *child;
+
+  if (actor == layout->priv->dot || find_child (layout, actor))
+    return;
+
+  child = g_slice_new0 (StMenuLayoutChild);
+  child->actor = actor;
+  child->span = 1;
+  child->align = ST_ALIGN_START;
+  child->natural_width = -1;
+
+  layout->priv->children = g_list_append (layout->priv->children, child);
+  invalidate_widths (layout);
+}
+
+static void
+st_menu_layout_actor_removed (ClutterContainer *container,
+                              ClutterActor     *actor)
+{
+  StMenuLayout *layout = ST_MENU_LAYOUT (container);
+  StMenuLayoutPrivate *priv = layout->priv;
+  StMenuLayoutChild *child;
+
+  if (actor == priv->dot)
+    {
+      priv->dot = NULL;
+      return;
+    }
+
+  child = find_child (layout, actor);
+  if (child == NULL)
+    return;
+
+  priv->children = g_list_remove (priv->children, child);
+  g_slice_free (StMenuLayoutChild, child);
+  invalidate_widths (layout);
+}
+
+static void
+clutter_container_iface_init (ClutterContainerIface *iface)
+{
+  iface->actor_added = st_menu_layout_actor_added;
+  iface->actor_removed = st_menu_layout_actor_removed;
+}
+
+static void
+st_menu_layout_queue_relayout (ClutterActor *actor)
+{
+  /* A child changing size queues a relayout on us as well */
+  invalidate_widths (ST_MENU_LAYOUT (actor));
+
+  CLUTTER_ACTOR_CLASS (st_menu_layout_parent_class)->queue_relayout (actor);
+}
+
+static void
+st_menu_layout_get_preferred_width (ClutterActor *actor,
+                                    gfloat        for_height,
+                                    gfloat       *min_width_p,
+                                    gfloat       *natural_width_p)
+{
+  StMenuLayoutPrivate *priv = ST_MENU_LAYOUT (actor)->priv;
+  StThemeNode *theme_node = st_widget_get_theme_node (ST_WIDGET (actor));
+  gfloat width = 0;
+  GList *l;
+  guint i;
+
+  st_theme_node_adjust_for_height (theme_node, &for_height);
+
+  if (priv->column_widths)
+    {
+      for (i = 0; i < priv->column_widths->len; i++)
+        {
+          if (i > 0)
+            width += priv->spacing;
+          width += g_array_index (priv->column_widths, int, i);
+        }
+    }
+  else
+    {
+      for (l = priv->children; l; l = l->next)
+        {
+          if (l != priv->children)
+            width += priv->spacing;
+          width += get_child_natural_width (l->data);
+        }
+    }
+
+  if (min_width_p)
+    *min_width_p = width;
+  if (natural_width_p)
+    *natural_width_p = width;
+
+  st_theme_node_adjust_preferred_width (theme_node, min_width_p, natural_width_p);
+}
+
+static void
+st_menu_layout_get_preferred_height (ClutterActor *actor,
+                                     gfloat        for_width,
+                                     gfloat       *min_height_p,
+                                     gfloat       *natural_height_p)
+{
+  StMenuLayoutPrivate *priv = ST_MENU_LAYOUT (actor)->priv;
+  StThemeNode *theme_node = st_widget_get_theme_node (ST_WIDGET (actor));
+  gfloat height = 0, x = 0;
+  int col = 0;
+  GList *l;
+
+  st_theme_node_adjust_for_width (theme_node, &for_width);
+
+  for (l = priv->children; l; l = l->next)
+    {
+      StMenuLayoutChild *child = l->data;
+      gfloat child_width, natural_height;
+      int j;
+
+      if (priv->column_widths)
+        {
+          child_width = 0;
+          if (child->span == -1)
+            {
+              for (j = col; j < (int) priv->column_widths->len; j++)
+                child_width += get_column_width (priv, j);
+            }
+          else
+            {
+              for (j = 0; j < child->span; j++)
+                child_width += get_column_width (priv, col++);
+            }
+        }
+      else
+        {
+          if (child->span == -1 && for_width >= 0)
+            child_width = MAX (0, for_width - x);
+          else
+            child_width = get_child_natural_width (child);
+        }
+      x += child_width + priv->spacing;
+
+      clutter_actor_get_preferred_height (child->actor, child_width,
+                                          NULL, &natural_height);
+      height = MAX (height, natural_height);
+    }
+
+  if (min_height_p)
+    *min_height_p = height;
+  if (natural_height_p)
+    *natural_height_p = height;
+
+  st_theme_node_adjust_preferred_height (theme_node, min_height_p, natural_height_p);
+}
+
+static void
+st_menu_layout_allocate (ClutterActor          *actor,
+                         const ClutterActorBox *box,
+                         ClutterAllocationFlags flags)
+{
+  StMenuLayoutPrivate *priv = ST_MENU_LAYOUT (actor)->priv;
+  StThemeNode *theme_node = st_widget_get_theme_node (ST_WIDGET (actor));
+  ClutterActorBox content_box;
+  gboolean rtl;
+  gfloat height, x;
+  int col = 0;
+  GList *l;
+
+  clutter_actor_set_allocation (actor, box, flags);
+
+  st_theme_node_get_content_box (theme_node, box, &content_box);
+  height = content_box.y2 - content_box.y1;
+  rtl = clutter_actor_get_text_direction (actor) == CLUTTER_TEXT_DIRECTION_RTL;
+
+  if (priv->dot)
+    {
+      /* The dot is placed outside the content box, one quarter of the
+       * padding from the border of the container (so 3/4 from the
+       * inner border); the padding is content_box.x1.
+       */
+      ClutterActorBox dot_box;
+      gfloat dot_width = floorf (content_box.x1 / 2 + 0.5);
+
+      if (!rtl)
+        {
+          dot_box.x1 = floorf (content_box.x1 / 4 + 0.5);
+          dot_box.x2 = dot_box.x1 + dot_width;
+        }
+      else
+        {
+          dot_box.x2 = content_box.x2 + 3 * floorf (content_box.x1 / 4 + 0.5);
+          dot_box.x1 = dot_box.x2 - dot_width;
+        }
+      dot_box.y1 = floorf (content_box.y1 + (height - dot_width) / 2 + 0.5);
+      dot_box.y2 = dot_box.y1 + dot_width;
+
+      clutter_actor_allocate (priv->dot, &dot_box, flags);
+    }
+
+  /* For LTR, x is the right edge of the last child and increases;
+   * for RTL, it is the left edge and decreases.
+   */
+  x = rtl ? content_box.x2 : content_box.x1;
+
+  for (l = priv->children; l; l = l->next)
+    {
+      StMenuLayoutChild *child = l->data;
+      ClutterActorBox child_box;
+      gfloat natural_width, natural_height;
+      gfloat avail_width, extra_width;
+      int j;
+
+      natural_width = get_child_natural_width (child);
+
+      if (child->span == -1)
+        avail_width = rtl ? x - content_box.x1 : content_box.x2 - x;
+      else if (priv->column_widths)
+        {
+          avail_width = 0;
+          for (j = 0; j < child->span; j++)
+            avail_width += get_column_width (priv, col++);
+        }
+      else
+        avail_width = natural_width;
+
+      extra_width = priv->column_widths ? avail_width - natural_width : 0;
+
+      if (!rtl)
+        {
+          if (child->expand)
+            {
+              child_box.x1 = x;
+              child_box.x2 = x + avail_width;
+            }
+          else if (child->align == ST_ALIGN_MIDDLE)
+            {
+              child_box.x1 = x + floorf (extra_width / 2 + 0.5);
+              child_box.x2 = child_box.x1 + natural_width;
+            }
+          else if (child->align == ST_ALIGN_END)
+            {
+              child_box.x2 = x + avail_width;
+              child_box.x1 = child_box.x2 - natural_width;
+            }
+          else
+            {
+              child_box.x1 = x;
+              child_box.x2 = x + natural_width;
+            }
+        }
+      else
+        {
+          if (child->expand)
+            {
+              child_box.x1 = x - avail_width;
+              child_box.x2 = x;
+            }
+          else if (child->align == ST_ALIGN_MIDDLE)
+            {
+              child_box.x1 = x - floorf (extra_width / 2 + 0.5);
+              child_box.x2 = child_box.x1 + natural_width;
+            }
+          else if (child->align == ST_ALIGN_END)
+            {
+              /* align to the left */
+              child_box.x1 = x - avail_width;
+              child_box.x2 = child_box.x1 + natural_width;
+            }
+          else
+            {
+              /* align to the right */
+              child_box.x2 = x;
+              child_box.x1 = x - natural_width;
+            }
+        }
+
+      clutter_actor_get_preferred_height (child->actor,
+                                          child_box.x2 - child_box.x1,
+                                          NULL, &natural_height);
+      child_box.y1 = floorf (content_box.y1 + (height - natural_height) / 2 + 0.5);
+      child_box.y2 = child_box.y1 + natural_height;
+
+      clutter_actor_allocate (child->actor, &child_box, flags);
+
+      if (!rtl)
+        x += avail_width + priv->spacing;
+      else
+        x -= avail_width + priv->spacing;
+    }
+}
+
+static void
+st_menu_layout_style_changed (StWidget *widget)
+{
+  StMenuLayoutPrivate *priv = ST_MENU_LAYOUT (widget)->priv;
+  StThemeNode *theme_node = st_widget_get_theme_node (widget);
+  int old_spacing = priv->spacing;
+  double spacing;
+
+  spacing = st_theme_node_get_length (theme_node, "spacing");
+  priv->spacing = (int)(spacing + 0.5);
+  if (priv->spacing != old_spacing)
+    clutter_actor_queue_relayout (CLUTTER_ACTOR (widget));
+
+  ST_WIDGET_CLASS (st_menu_layout_parent_class)->style_changed (widget);
+}
+
+static void
+st_menu_layout_finalize (GObject *gobject)
+{
+  StMenuLayoutPrivate *priv = ST_MENU_LAYOUT (gobject)->priv;
+  GList *l;
+
+  for (l = priv->children; l; l = l->next)
+    g_slice_free (StMenuLayoutChild, l->data);
+  g_list_free (priv->children);
+
+  if (priv->column_widths)
+    g_array_free (priv->column_widths, TRUE);
+  g_array_free (priv->natural_columns, TRUE);
+
+  G_OBJECT_CLASS (st_menu_layout_parent_class)->finalize (gobject);
+}
+
+static void
+st_menu_layout_class_init (StMenuLayoutClass *klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+  ClutterActorClass *actor_class = CLUTTER_ACTOR_CLASS (klass);
+  StWidgetClass *widget_class = ST_WIDGET_CLASS (klass);
+
+  g_type_class_add_private (klass, sizeof (StMenuLayoutPrivate));
+
+  gobject_class->finalize = st_menu_layout_finalize;
+
+  actor_class->get_preferred_width = st_menu_layout_get_preferred_width;
+  actor_class->get_preferred_height = st_menu_layout_get_preferred_height;
+  actor_class->allocate = st_menu_layout_allocate;
+  actor_class->queue_relayout = st_menu_layout_queue_relayout;
+
+  widget_class->style_changed = st_menu_layout_style_changed;
+}
+
+static void
+st_menu_layout_init (StMenuLayout *layout)
+{
+  layout->priv = ST_MENU_LAYOUT_GET_PRIVATE (layout);
+
+  layout->priv->natural_columns = g_array_new (FALSE, FALSE, sizeof (int));
+}
+
+/**
+ * st_menu_layout_new:
+ *
+ * Creates a new #StMenuLayout.
+ *
+ * Return value: the newly created #StMenuLayout actor
+ */
+StWidget *
+st_menu_layout_new (void)
+{
+  return g_object_new (ST_TYPE_MENU_LAYOUT, NULL);
+}
+
+/**
+ * st_menu_layout_append:
+ * @layout: a #StMenuLayout
+ * @actor: a #ClutterActor
+ * @span: the number of columns @actor covers, or -1 for all the
+ *   remaining width
+ * @expand: whether @actor is given all of the width of its columns
+ * @align: the alignment of @actor within its columns if it doesn't
+ *   expand
+ *
+ * Adds @actor after the existing children of @layout.
+ */
+void
+st_menu_layout_append (StMenuLayout *layout,
+                       ClutterActor *actor,
+                       int           span,
+                       gboolean      expand,
+                       StAlign       align)
+{
+  StMenuLayoutChild *child;
+
+  g_return_if_fail (ST_IS_MENU_LAYOUT (layout));
+  g_return_if_fail (CLUTTER_IS_ACTOR (actor));
+  g_return_if_fail (span == -1 || span > 0);
+
+  child = g_slice_new0 (StMenuLayoutChild);
+  child->actor = actor;
+  child->span = span;
+  child->expand = expand != FALSE;
+  child->align = align;
+  child->natural_width = -1;
+
+  layout->priv->children = g_list_append (layout->priv->children, child);
+
+  clutter_actor_add_child (CLUTTER_ACTOR (layout), actor);
+}
+
+/**
+ * st_menu_layout_set_dot:
+ * @layout: a #StMenuLayout
+ * @dot: (allow-none): a #ClutterActor, or %NULL
+ *
+ * Sets the actor shown in the padding before the first column of
+ * @layout, replacing any previous one.
+ */
+void
+st_menu_layout_set_dot (StMenuLayout *layout,
+                        ClutterActor *dot)
+{
+  StMenuLayoutPrivate *priv;
+
+  g_return_if_fail (ST_IS_MENU_LAYOUT (layout));
+  g_return_if_fail (dot == NULL || CLUTTER_IS_ACTOR (dot));
+
+  priv = layout->priv;
+
+  if (priv->dot == dot)
+    return;
+
+  if (priv->dot)
+    clutter_actor_remove_child (CLUTTER_ACTOR (layout), priv->dot);
+
+  priv->dot = NULL;
+
+  if (dot)
+    {
+      priv->dot = dot;
+      clutter_actor_add_child (CLUTTER_ACTOR (layout), dot);
+    }
+}
+
+/**
+ * st_menu_layout_get_dot:
+ * @layout: a #StMenuLayout
+ *
+ * Return value: (transfer none): the dot of @layout, or %NULL
+ */
+ClutterActor *
+st_menu_layout_get_dot (StMenuLayout *layout)
+{
+  g_return_val_if_fail (ST_IS_MENU_LAYOUT (layout), NULL);
+
+  return layout->priv->dot;
+}
+
+/**
+ * st_menu_layout_get_column_widths:
+ * @layout: a #StMenuLayout
+ * @n_columns: (out): return location for the number of columns
+ *
+ * Gets the natural widths of the columns of @layout, in logical order
+ * (from the dot to the end), not in visual order. A child spanning
+ * several columns has its width in the first of them, and 0 for the
+ * others.
+ *
+ * The widths are cached until a relayout is queued on @layout.
+ *
+ * Return value: (array length=n_columns) (transfer none): the column widths
+ */
+const int *
+st_menu_layout_get_column_widths (StMenuLayout *layout,
+                                  int          *n_columns)
+{
+  StMenuLayoutPrivate *priv;
+  GList *l;
+
+  g_return_val_if_fail (ST_IS_MENU_LAYOUT (layout), NULL);
+
+  priv = layout->priv;
+
+  if (!priv->natural_columns_valid)
+    {
+      g_array_set_size (priv->natural_columns, 0);
+
+      for (l = priv->children; l; l = l->next)
+        {
+          StMenuLayoutChild *child = l->data;
+          int width = get_child_natural_width (child);
+          int j;
+
+          g_array_append_val (priv->natural_columns, width);
+
+          width = 0;
+          for (j = 1; j < child->span; j++)
+            g_array_append_val (priv->natural_columns, width);
+        }
+
+      priv->natural_columns_valid = TRUE;
+    }
+
+  *n_columns = priv->natural_columns->len;
+  return (const int *) priv->natural_columns->data;
+}
+
+/**
+ * st_menu_layout_set_column_widths:
+ * @layout: a #StMenuLayout
+ * @widths: (array length=n_widths) (allow-none): the column widths
+ * @n_widths: the number of columns
+ *
+ * Sets the widths of the columns of @layout, usually the maximum of
+ * st_menu_layout_get_column_widths() over all the items of a menu.
+ * Until this is called, each child gets its natural width.
+ *
+ * This is meant to be called while the menu itself is asked for its
+ * preferred width, so it doesn't queue a relayout.
+ */
+void
+st_menu_layout_set_column_widths (StMenuLayout *layout,
+                                  const int    *widths,
+                                  int           n_widths)
+{
+  StMenuLayoutPrivate *priv;
+
+  g_return_if_fail (ST_IS_MENU_LAYOUT (layout));
+  g_return_if_fail (n_widths == 0 || widths != NULL);
+
+  priv = layout->priv;
+
+  if (priv->column_widths == NULL)
+    priv->column_widths = g_array_sized_new (FALSE, FALSE, sizeof (int), n_widths);
+
+  g_array_set_size (priv->column_widths, 0);
+  g_array_append_vals (priv->column_widths, widths, n_widths);
+}
@@ -0,0 +1,86 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+/*
+ * st-menu-layout.h: Container for the columns of a menu item
+ *
+ * Copyright 2012 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU Lesser General Public License,
+ * version 2.1, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#if !defined(ST_H_INSIDE) && !defined(ST_COMPILATION)
+#error "Only <st/st.h> can be included directly.h"
+#endif
+
+#ifndef __ST_MENU_LAYOUT_H__
+#define __ST_MENU_LAYOUT_H__
+
+#include <st/st-types.h>
+#include <st/st-widget.h>
+
+G_BEGIN_DECLS
+
+#define ST_TYPE_MENU_LAYOUT                   (st_menu_layout_get_type ())
+#define ST_MENU_LAYOUT(obj)                   (G_TYPE_CHECK_INSTANCE_CAST ((obj), ST_TYPE_MENU_LAYOUT, StMenuLayout))
+#define ST_IS_MENU_LAYOUT(obj)                (G_TYPE_CHECK_INSTANCE_TYPE ((obj), ST_TYPE_MENU_LAYOUT))
+#define ST_MENU_LAYOUT_CLASS(klass)           (G_TYPE_CHECK_CLASS_CAST ((klass), ST_TYPE_MENU_LAYOUT, StMenuLayoutClass))
+#define ST_IS_MENU_LAYOUT_CLASS(klass)        (G_TYPE_CHECK_CLASS_TYPE ((klass), ST_TYPE_MENU_LAYOUT))
+#define ST_MENU_LAYOUT_GET_CLASS(obj)         (G_TYPE_INSTANCE_GET_CLASS ((obj), ST_TYPE_MENU_LAYOUT, StMenuLayoutClass))
+
+typedef struct _StMenuLayout                  StMenuLayout;
+typedef struct _StMenuLayoutPrivate           StMenuLayoutPrivate;
+typedef struct _StMenuLayoutClass             StMenuLayoutClass;
+
+/**
+ * StMenuLayout:
+ *
+ * The #StMenuLayout struct contains only private data
+ */
+struct _StMenuLayout
+{
+  /*< private >*/
+  StWidget parent_instance;
+
+  StMenuLayoutPrivate *priv;
+};
+
+/**
+ * StMenuLayoutClass:
+ *
+ * The #StMenuLayoutClass struct contains only private data
+ */
+struct _StMenuLayoutClass
+{
+  /*< private >*/
+  StWidgetClass parent_class;
+};
+
+GType st_menu_layout_get_type (void) G_GNUC_CONST;
+
+StWidget   *st_menu_layout_new               (void);
+void        st_menu_layout_append            (StMenuLayout *layout,
+                                              ClutterActor *actor,
+                                              int           span,
+                                              gboolean      expand,
+                                              StAlign       align);
+void        st_menu_layout_set_dot           (StMenuLayout *layout,
+                                              ClutterActor *dot);
+ClutterActor *st_menu_layout_get_dot         (StMenuLayout *layout);
+const int  *st_menu_layout_get_column_widths (StMenuLayout *layout,
+                                              int          *n_columns);
+void        st_menu_layout_set_column_widths (StMenuLayout *layout,
+                                              const int    *widths,
+                                              int           n_widths);
+
+G_END_DECLS
+
+#endif /* __ST_MENU_LAYOUT_H__ */
@@ -0,0 +1,182 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+/*
+ * st-pipeline-cache.c: Shared materials and shader programs
+ *
+ * Copyright 2012 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Effects and widgets that paint with a custom material or shader look
+ * it up here by name, so it is only set up, compiled and linked once
+ * and all users share the same GL state. Entries are never freed;
+ * Clutter only ever has a single GL context, and the set of names is
+ * fixed.
+ *
+ * Failures are cached as well, so that a shader that doesn't compile
+ * is only warned about once.
+ */
+
+#include "config.h"
+
+#include "st-pipeline-cache.h"
+
+#include <clutter/clutter.h>
+
+static GHashTable *cache = NULL;
+static guint cache_hits = 0;
+static guint cache_misses = 0;
+
+/* Returns %TRUE and sets @handle if @name is in the cache; only a
+ * successfully created entry that is handed out again counts as a hit */
+static gboolean
+lookup_entry (const char *name,
+              CoglHandle *handle)
+{
+  gpointer value;
+
+  if (G_UNLIKELY (cache == NULL))
+    cache = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+  if (!g_hash_table_lookup_extended (cache, name, NULL, &value))
+    return FALSE;
+
+  *handle = value;
+  if (*handle != COGL_INVALID_HANDLE)
+    cache_hits++;
+
+  return TRUE;
+}
+
+static CoglHandle
+add_entry (const char *name,
+           CoglHandle  handle)
+{
+  cache_misses++;
+  g_hash_table_insert (cache, g_strdup (name), handle);
+
+  return handle;
+}
+
+/**
+ * st_pipeline_cache_get_material:
+ * @name: a unique name for the material
+ * @setup: function to set up the material the first time it is needed
+ *
+ * Looks up a template material, creating it with @setup if this is
+ * the first request for @name. Callers should use cogl_material_copy()
+ * on the result and only change what differs between uses, typically
+ * the layer textures, so that Cogl can share the generated GL state
+ * between all of the copies. Call it once per user, not on every
+ * paint, so that the statistics count the times a material is shared.
+ *
+ * Return value: (transfer none): the template material, or
+ *   %COGL_INVALID_HANDLE if @setup failed
+ */
+CoglHandle
+st_pipeline_cache_get_material (const char          *name,
+                                StMaterialSetupFunc  setup)
+{
+  CoglHandle material;
+
+  if (lookup_entry (name, &material))
+    return material;
+
+  material = cogl_material_new ();
+  if (!setup (material))
+    {
+      cogl_handle_unref (material);
+      material = COGL_INVALID_HANDLE;
+    }
+
+  return add_entry (name, material);
+}
+
+static CoglHandle
+create_program (const char *name,
+                const char *fragment_source)
+{
+  CoglHandle shader, program;
+
+  if (!clutter_feature_available (CLUTTER_FEATURE_SHADERS_GLSL))
+    return COGL_INVALID_HANDLE;
+
+  shader = cogl_create_shader (COGL_SHADER_TYPE_FRAGMENT);
+  cogl_shader_source (shader, fragment_source);
+  cogl_shader_compile (shader);
+  if (!cogl_shader_is_compiled (shader))
+    {
+      gchar *log_buf = cogl_shader_get_info_log (shader);
+
+      g_warning (G_STRLOC ": Unable to compile the %s shader: %s",
+                 name, log_buf);
+      g_free (log_buf);
+
+      cogl_handle_unref (shader);
+      return COGL_INVALID_HANDLE;
+    }
+
+  program = cogl_create_program ();
+  cogl_program_attach_shader (program, shader);
+  cogl_program_link (program);
+  cogl_handle_unref (shader);
+
+  return program;
+}
+
+/**
+ * st_pipeline_cache_get_program:
+ * @name: a unique name for the program
+ * @fragment_source: GLSL source of the fragment shader
+ *
+ * Looks up a shader program, compiling and linking it the first time
+ * @name is requested. It is typically set on a template material from
+ * st_pipeline_cache_get_material().
+ *
+ * Since the program is shared, uniforms set on it with
+ * cogl_program_set_uniform_1f() and friends are shared as well. Users
+ * with their own values should set them on their copy of the template
+ * with cogl_pipeline_set_uniform_1f() instead, which doesn't require
+ * flushing the paint before the next user changes them.
+ *
+ * Return value: (transfer none): the program, or %COGL_INVALID_HANDLE
+ *   if shaders are not supported or the shader failed to compile
+ */
+CoglHandle
+st_pipeline_cache_get_program (const char *name,
+                               const char *fragment_source)
+{
+  CoglHandle program;
+
+  if (lookup_entry (name, &program))
+    return program;
+
+  return add_entry (name, create_program (name, fragment_source));
+}
+
+/**
+ * st_pipeline_cache_get_stats:
+ * @hits: (out): number of times an existing material or program was
+ *   handed out again
+ * @misses: (out): number of materials and programs created
+ *
+ * Gets the lookup counts since startup, for the performance log.
+ */
+void
+st_pipeline_cache_get_stats (guint *hits,
+                             guint *misses)
+{
+  *hits = cache_hits;
+  *misses = cache_misses;
+}
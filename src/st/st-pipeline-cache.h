@@ -0,0 +1,44 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+/*
+ * st-pipeline-cache.h: Shared materials and shader programs
+ *
+ * Copyright 2012 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __ST_PIPELINE_CACHE_H__
+#define __ST_PIPELINE_CACHE_H__
+
+#include <glib.h>
+#include <cogl/cogl.h>
+
+G_BEGIN_DECLS
+
+/* Sets up a newly created template material; returns %FALSE if the
+ * material can't be used on this hardware */
+typedef gboolean (*StMaterialSetupFunc) (CoglHandle material);
+
+CoglHandle st_pipeline_cache_get_material (const char           *name,
+                                           StMaterialSetupFunc   setup);
+
+CoglHandle st_pipeline_cache_get_program  (const char           *name,
+                                           const char           *fragment_source);
+
+void       st_pipeline_cache_get_stats    (guint                *hits,
+                                           guint                *misses);
+
+G_END_DECLS
+
+#endif /* __ST_PIPELINE_CACHE_H__ */
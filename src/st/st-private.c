@@ -23,6 +23,7 @@
 #include <string.h>
 
 #include "st-private.h"
+#include "st-pipeline-cache.h"
 
 /**
  * _st_actor_get_preferred_width:
@@ -158,6 +159,17 @@ _st_get_align_factors (StAlign   x_align,
     }
 }
 
+static GQuark
+text_decoration_quark (void)
+{
+  static GQuark quark = 0;
+
+  if (G_UNLIKELY (quark == 0))
+    quark = g_quark_from_static_string ("st-text-decoration");
+
+  return quark;
+}
+
 /**
  * _st_set_text_from_style:
  * @text: Target #ClutterText
@@ -171,41 +183,61 @@ _st_set_text_from_style (ClutterText *text,
                          StThemeNode *theme_node)
 {
 
-  ClutterColor color;
+  ClutterColor color, old_color;
   StTextDecoration decoration;
   PangoAttrList *attribs;
   const PangoFontDescription *font;
+  PangoFontDescription *old_font;
   gchar *font_string;
   StTextAlign align;
+  gpointer old_decoration;
 
+  /* Style changes frequently leave the text properties alone (for
+   * example :hover on a button); avoid invalidating the layout of
+   * the ClutterText when nothing actually changed.
+   */
   st_theme_node_get_foreground_color (theme_node, &color);
-  clutter_text_set_color (text, &color);
+  clutter_text_get_color (text, &old_color);
+  if (!clutter_color_equal (&color, &old_color))
+    clutter_text_set_color (text, &color);
 
   font = st_theme_node_get_font (theme_node);
-  font_string = pango_font_description_to_string (font);
-  clutter_text_set_font_name (text, font_string);
-  g_free (font_string);
-
-  attribs = pango_attr_list_new ();
-
-  decoration = st_theme_node_get_text_decoration (theme_node);
-  if (decoration & ST_TEXT_DECORATION_UNDERLINE)
+  old_font = clutter_text_get_font_description (text);
+  if (old_font == NULL || !pango_font_description_equal (font, old_font))
     {
-      PangoAttribute *underline = pango_attr_underline_new (PANGO_UNDERLINE_SINGLE);
-      pango_attr_list_insert (attribs, underline);
+      font_string = pango_font_description_to_string (font);
+      clutter_text_set_font_name (text, font_string);
+      g_free (font_string);
     }
-  if (decoration & ST_TEXT_DECORATION_LINE_THROUGH)
+
+  decoration = st_theme_node_get_text_decoration (theme_node);
+  /* Stored + 1 so that "no decoration" can be told apart from unset */
+  old_decoration = g_object_get_qdata (G_OBJECT (text), text_decoration_quark ());
+  if (old_decoration != GUINT_TO_POINTER (decoration + 1))
     {
-      PangoAttribute *strikethrough = pango_attr_strikethrough_new (TRUE);
-      pango_attr_list_insert (attribs, strikethrough);
-    }
-  /* Pango doesn't have an equivalent attribute for _OVERLINE, and we deliberately
-   * skip BLINK (for now...)
-   */
+      attribs = pango_attr_list_new ();
+
+      if (decoration & ST_TEXT_DECORATION_UNDERLINE)
+        {
+          PangoAttribute *underline = pango_attr_underline_new (PANGO_UNDERLINE_SINGLE);
+          pango_attr_list_insert (attribs, underline);
+        }
+      if (decoration & ST_TEXT_DECORATION_LINE_THROUGH)
+        {
+          PangoAttribute *strikethrough = pango_attr_strikethrough_new (TRUE);
+          pango_attr_list_insert (attribs, strikethrough);
+        }
+      /* Pango doesn't have an equivalent attribute for _OVERLINE, and we deliberately
+       * skip BLINK (for now...)
+       */
 
-  clutter_text_set_attributes (text, attribs);
+      clutter_text_set_attributes (text, attribs);
 
-  pango_attr_list_unref (attribs);
+      pango_attr_list_unref (attribs);
+
+      g_object_set_qdata (G_OBJECT (text), text_decoration_quark (),
+                          GUINT_TO_POINTER (decoration + 1));
+    }
 
   align = st_theme_node_get_text_align (theme_node);
   if(align == ST_TEXT_ALIGN_JUSTIFY) {
@@ -217,6 +249,25 @@ _st_set_text_from_style (ClutterText *text,
   }
 }
 
+static gboolean
+setup_texture_material (CoglHandle material)
+{
+  static const guint8 white_pixel[] = { 0xff, 0xff, 0xff, 0xff };
+  CoglHandle dummy_texture;
+
+  dummy_texture =
+    cogl_texture_new_from_data (1, 1,
+                                COGL_TEXTURE_NONE,
+                                COGL_PIXEL_FORMAT_RGBA_8888_PRE,
+                                COGL_PIXEL_FORMAT_ANY,
+                                4, white_pixel);
+
+  cogl_material_set_layer (material, 0, dummy_texture);
+  cogl_handle_unref (dummy_texture);
+
+  return TRUE;
+}
+
 /**
  * _st_create_texture_material:
  * @src_texture: The CoglTexture for the material
@@ -227,7 +278,6 @@ _st_set_text_from_style (ClutterText *text,
 CoglHandle
 _st_create_texture_material (CoglHandle src_texture)
 {
-  static CoglHandle texture_material_template = COGL_INVALID_HANDLE;
   CoglHandle material;
 
   g_return_val_if_fail (src_texture != COGL_INVALID_HANDLE,
@@ -237,24 +287,8 @@ _st_create_texture_material (CoglHandle src_texture)
      texture materials. The idea is that only the Cogl texture object
      would be different in the children so it is likely that Cogl will
      be able to share GL programs between all the textures. */
-  if (G_UNLIKELY (texture_material_template == COGL_INVALID_HANDLE))
-    {
-      static const guint8 white_pixel[] = { 0xff, 0xff, 0xff, 0xff };
-      CoglHandle dummy_texture;
-
-      dummy_texture =
-        cogl_texture_new_from_data (1, 1,
-                                    COGL_TEXTURE_NONE,
-                                    COGL_PIXEL_FORMAT_RGBA_8888_PRE,
-                                    COGL_PIXEL_FORMAT_ANY,
-                                    4, white_pixel);
-
-      texture_material_template = cogl_material_new ();
-      cogl_material_set_layer (texture_material_template, 0, dummy_texture);
-      cogl_handle_unref (dummy_texture);
-    }
-
-  material = cogl_material_copy (texture_material_template);
+  material = cogl_material_copy (st_pipeline_cache_get_material ("st-texture",
+                                                                 setup_texture_material));
 
   cogl_material_set_layer (material, 0, src_texture);
 
@@ -401,12 +435,22 @@ blur_pixels (guchar  *pixels_in,
   return pixels_out;
 }
 
+static gboolean
+setup_shadow_material (CoglHandle material)
+{
+  /* We set up the material to blend the shadow texture with the combine
+   * constant, but defer setting the latter until painting, so that we can
+   * take the actor's overall opacity into account. */
+  cogl_material_set_layer_combine (material, 0,
+                                   "RGBA = MODULATE (CONSTANT, TEXTURE[A])",
+                                   NULL);
+  return TRUE;
+}
+
 CoglHandle
 _st_create_shadow_material (StShadow   *shadow_spec,
                             CoglHandle  src_texture)
 {
-  static CoglHandle shadow_material_template = COGL_INVALID_HANDLE;
-
   CoglHandle  material;
   CoglHandle  texture;
   guchar     *pixels_in, *pixels_out;
@@ -441,19 +485,8 @@ _st_create_shadow_material (StShadow   *shadow_spec,
 
   g_free (pixels_out);
 
-  if (G_UNLIKELY (shadow_material_template == COGL_INVALID_HANDLE))
-    {
-      shadow_material_template = cogl_material_new ();
-
-      /* We set up the material to blend the shadow texture with the combine
-       * constant, but defer setting the latter until painting, so that we can
-       * take the actor's overall opacity into account. */
-      cogl_material_set_layer_combine (shadow_material_template, 0,
-                                       "RGBA = MODULATE (CONSTANT, TEXTURE[A])",
-                                       NULL);
-    }
-
-  material = cogl_material_copy (shadow_material_template);
+  material = cogl_material_copy (st_pipeline_cache_get_material ("st-shadow",
+                                                                 setup_shadow_material));
 
   cogl_material_set_layer (material, 0, texture);
 
@@ -18,6 +18,8 @@
  * along with this program. If not, see <http://www.gnu.org/licenses/>.
  */
 
+#define COGL_ENABLE_EXPERIMENTAL_API
+
 
 #define ST_SCROLL_VIEW_FADE_CLASS(klass)        (G_TYPE_CHECK_CLASS_CAST ((klass), ST_TYPE_SCROLL_VIEW_FADE, StScrollViewFadeClass))
 #define ST_IS_SCROLL_VIEW_FADE_CLASS(klass)     (G_TYPE_CHECK_CLASS_TYPE ((klass), ST_TYPE_SCROLL_VIEW_FADE))
@@ -29,6 +31,7 @@
 #include "st-theme-node.h"
 #include "st-scroll-bar.h"
 #include "st-scrollable.h"
+#include "st-pipeline-cache.h"
 
 #include <clutter/clutter.h>
 #include <cogl/cogl.h>
@@ -93,6 +96,31 @@ static const gchar *fade_glsl_shader =
 "  cogl_color_out = color * ratio;\n"
 "}";
 
+enum {
+  UNIFORM_TEX,
+  UNIFORM_HEIGHT,
+  UNIFORM_WIDTH,
+  UNIFORM_FADE_AREA,
+  UNIFORM_OFFSET_TOP,
+  UNIFORM_OFFSET_BOTTOM,
+  UNIFORM_OFFSET_LEFT,
+  UNIFORM_OFFSET_RIGHT,
+
+  N_UNIFORMS
+};
+
+static const char * const uniform_names[N_UNIFORMS + 1] = {
+  "tex",
+  "height",
+  "width",
+  "fade_area",
+  "offset_top",
+  "offset_bottom",
+  "offset_left",
+  "offset_right",
+  NULL
+};
+
 struct _StScrollViewFade
 {
   ClutterOffscreenEffect parent_instance;
@@ -100,23 +128,15 @@ struct _StScrollViewFade
   /* a back pointer to our actor, so that we can query it */
   ClutterActor *actor;
 
-  CoglHandle shader;
-  CoglHandle program;
-
-  gint tex_uniform;
-  gint height_uniform;
-  gint width_uniform;
-  gint fade_area_uniform;
-  gint offset_top_uniform;
-  gint offset_bottom_uniform;
-  gint offset_left_uniform;
-  gint offset_right_uniform;
+  /* A copy of the template shared by all instances, see
+   * st-pipeline-cache.c; it shares the program, but has its own
+   * uniform values */
+  CoglHandle pipeline;
+  gint uniforms[N_UNIFORMS];
 
   StAdjustment *vadjustment;
   StAdjustment *hadjustment;
 
-  guint is_attached : 1;
-
   float vfade_offset;
   float hfade_offset;
 };
@@ -143,7 +163,7 @@ st_scroll_view_fade_pre_paint (ClutterEffect *effect)
   StScrollViewFade *self = ST_SCROLL_VIEW_FADE (effect);
   ClutterEffectClass *parent_class;
 
-  if (self->shader == COGL_INVALID_HANDLE)
+  if (self->pipeline == COGL_INVALID_HANDLE)
     return FALSE;
 
   if (!clutter_actor_meta_get_enabled (CLUTTER_ACTOR_META (effect)))
@@ -152,39 +172,6 @@ st_scroll_view_fade_pre_paint (ClutterEffect *effect)
   if (self->actor == NULL)
     return FALSE;
 
-  if (self->program == COGL_INVALID_HANDLE)
-    self->program = cogl_create_program ();
-
-  if (!self->is_attached)
-    {
-      g_assert (self->shader != COGL_INVALID_HANDLE);
-      g_assert (self->program != COGL_INVALID_HANDLE);
-
-      cogl_program_attach_shader (self->program, self->shader);
-      cogl_program_link (self->program);
-
-      cogl_handle_unref (self->shader);
-
-      self->is_attached = TRUE;
-
-      self->tex_uniform =
-        cogl_program_get_uniform_location (self->program, "tex");
-      self->height_uniform =
-        cogl_program_get_uniform_location (self->program, "height");
-      self->width_uniform =
-        cogl_program_get_uniform_location (self->program, "width");
-      self->fade_area_uniform =
-        cogl_program_get_uniform_location (self->program, "fade_area");
-      self->offset_top_uniform =
-        cogl_program_get_uniform_location (self->program, "offset_top");
-      self->offset_bottom_uniform =
-        cogl_program_get_uniform_location (self->program, "offset_bottom");
-      self->offset_left_uniform =
-        cogl_program_get_uniform_location (self->program, "offset_left");
-      self->offset_right_uniform =
-        cogl_program_get_uniform_location (self->program, "offset_right");
-    }
-
   parent_class = CLUTTER_EFFECT_CLASS (st_scroll_view_fade_parent_class);
   return parent_class->pre_paint (effect);
 }
@@ -205,7 +192,8 @@ st_scroll_view_fade_paint_target (ClutterOffscreenEffect *effect)
 {
   StScrollViewFade *self = ST_SCROLL_VIEW_FADE (effect);
   ClutterOffscreenEffectClass *parent;
-  CoglHandle material;
+  CoglHandle texture;
+  guint8 paint_opacity;
 
   gdouble value, lower, upper, page_size;
   ClutterActor *vscroll = st_scroll_view_get_vscroll_bar (ST_SCROLL_VIEW (self->actor));
@@ -226,8 +214,13 @@ st_scroll_view_fade_paint_target (ClutterOffscreenEffect *effect)
   float fade_area[2][2];
   ClutterVertex verts[4];
 
-  if (self->program == COGL_INVALID_HANDLE)
-    goto out;
+  texture = clutter_offscreen_effect_get_texture (effect);
+  if (self->pipeline == COGL_INVALID_HANDLE || texture == COGL_INVALID_HANDLE)
+    {
+      parent = CLUTTER_OFFSCREEN_EFFECT_CLASS (st_scroll_view_fade_parent_class);
+      parent->paint_target (effect);
+      return;
+    }
 
   clutter_actor_get_paint_box (self->actor, &paint_box);
   clutter_actor_get_abs_allocation_vertices (self->actor, verts);
@@ -263,51 +256,58 @@ st_scroll_view_fade_paint_target (ClutterOffscreenEffect *effect)
 
   st_adjustment_get_values (self->vadjustment, &value, &lower, &upper, NULL, NULL, &page_size);
 
-  if (self->offset_top_uniform > -1) {
+  if (self->uniforms[UNIFORM_OFFSET_TOP] > -1) {
     if (value > lower + 0.1)
-      cogl_program_set_uniform_1f (self->program, self->offset_top_uniform, self->vfade_offset);
+      cogl_pipeline_set_uniform_1f (self->pipeline, self->uniforms[UNIFORM_OFFSET_TOP], self->vfade_offset);
     else
-      cogl_program_set_uniform_1f (self->program, self->offset_top_uniform, 0.0f);
+      cogl_pipeline_set_uniform_1f (self->pipeline, self->uniforms[UNIFORM_OFFSET_TOP], 0.0f);
   }
 
-  if (self->offset_bottom_uniform > -1) {
+  if (self->uniforms[UNIFORM_OFFSET_BOTTOM] > -1) {
     if (value < upper - page_size - 0.1)
-      cogl_program_set_uniform_1f (self->program, self->offset_bottom_uniform, self->vfade_offset);
+      cogl_pipeline_set_uniform_1f (self->pipeline, self->uniforms[UNIFORM_OFFSET_BOTTOM], self->vfade_offset);
     else
-      cogl_program_set_uniform_1f (self->program, self->offset_bottom_uniform, 0.0f);
+      cogl_pipeline_set_uniform_1f (self->pipeline, self->uniforms[UNIFORM_OFFSET_BOTTOM], 0.0f);
   }
 
   st_adjustment_get_values (self->hadjustment, &value, &lower, &upper, NULL, NULL, &page_size);
 
-  if (self->offset_left_uniform > -1) {
+  if (self->uniforms[UNIFORM_OFFSET_LEFT] > -1) {
     if (value > lower + 0.1)
-      cogl_program_set_uniform_1f (self->program, self->offset_left_uniform, self->hfade_offset);
+      cogl_pipeline_set_uniform_1f (self->pipeline, self->uniforms[UNIFORM_OFFSET_LEFT], self->hfade_offset);
     else
-      cogl_program_set_uniform_1f (self->program, self->offset_left_uniform, 0.0f);
+      cogl_pipeline_set_uniform_1f (self->pipeline, self->uniforms[UNIFORM_OFFSET_LEFT], 0.0f);
   }
 
-  if (self->offset_right_uniform > -1) {
+  if (self->uniforms[UNIFORM_OFFSET_RIGHT] > -1) {
     if (value < upper - page_size - 0.1)
-      cogl_program_set_uniform_1f (self->program, self->offset_right_uniform, self->hfade_offset);
+      cogl_pipeline_set_uniform_1f (self->pipeline, self->uniforms[UNIFORM_OFFSET_RIGHT], self->hfade_offset);
     else
-      cogl_program_set_uniform_1f (self->program, self->offset_right_uniform, 0.0f);
+      cogl_pipeline_set_uniform_1f (self->pipeline, self->uniforms[UNIFORM_OFFSET_RIGHT], 0.0f);
   }
 
-  if (self->tex_uniform > -1)
-    cogl_program_set_uniform_1i (self->program, self->tex_uniform, 0);
-  if (self->height_uniform > -1)
-    cogl_program_set_uniform_1f (self->program, self->height_uniform, clutter_actor_get_height (self->actor));
-  if (self->width_uniform > -1)
-    cogl_program_set_uniform_1f (self->program, self->width_uniform, clutter_actor_get_width (self->actor));
-  if (self->fade_area_uniform > -1)
-    cogl_program_set_uniform_matrix (self->program, self->fade_area_uniform, 2, 1, FALSE, (const float *)fade_area);
-
-  material = clutter_offscreen_effect_get_target (effect);
-  cogl_material_set_user_program (material, self->program);
-
-out:
-  parent = CLUTTER_OFFSCREEN_EFFECT_CLASS (st_scroll_view_fade_parent_class);
-  parent->paint_target (effect);
+  if (self->uniforms[UNIFORM_TEX] > -1)
+    cogl_pipeline_set_uniform_1i (self->pipeline, self->uniforms[UNIFORM_TEX], 0);
+  if (self->uniforms[UNIFORM_HEIGHT] > -1)
+    cogl_pipeline_set_uniform_1f (self->pipeline, self->uniforms[UNIFORM_HEIGHT], clutter_actor_get_height (self->actor));
+  if (self->uniforms[UNIFORM_WIDTH] > -1)
+    cogl_pipeline_set_uniform_1f (self->pipeline, self->uniforms[UNIFORM_WIDTH], clutter_actor_get_width (self->actor));
+  if (self->uniforms[UNIFORM_FADE_AREA] > -1)
+    cogl_pipeline_set_uniform_matrix (self->pipeline, self->uniforms[UNIFORM_FADE_AREA], 2, 1, FALSE, (const float *)fade_area);
+
+  /* What ClutterOffscreenEffect would do with its own target material */
+  cogl_material_set_layer (self->pipeline, 0, texture);
+
+  paint_opacity = clutter_actor_get_paint_opacity (self->actor);
+  cogl_material_set_color4ub (self->pipeline,
+                              paint_opacity, paint_opacity,
+                              paint_opacity, paint_opacity);
+
+  cogl_set_source (self->pipeline);
+  cogl_rectangle_with_texture_coords (0, 0,
+                                      cogl_texture_get_width (texture),
+                                      cogl_texture_get_height (texture),
+                                      0.0, 0.0, 1.0, 1.0);
 }
 
 static void
@@ -339,7 +339,7 @@ st_scroll_view_fade_set_actor (ClutterActorMeta *meta,
 
   g_return_if_fail (actor == NULL || ST_IS_SCROLL_VIEW (actor));
 
-  if (self->shader == COGL_INVALID_HANDLE)
+  if (self->pipeline == COGL_INVALID_HANDLE)
     {
       clutter_actor_meta_set_enabled (meta, FALSE);
       return;
@@ -393,14 +393,6 @@ st_scroll_view_fade_dispose (GObject *gobject)
 {
   StScrollViewFade *self = ST_SCROLL_VIEW_FADE (gobject);
 
-  if (self->program != COGL_INVALID_HANDLE)
-    {
-      cogl_handle_unref (self->program);
-
-      self->program = COGL_INVALID_HANDLE;
-      self->shader = COGL_INVALID_HANDLE;
-    }
-
   if (self->vadjustment)
     {
       g_signal_handlers_disconnect_by_func (self->vadjustment,
@@ -419,6 +411,12 @@ st_scroll_view_fade_dispose (GObject *gobject)
 
   self->actor = NULL;
 
+  if (self->pipeline != COGL_INVALID_HANDLE)
+    {
+      cogl_handle_unref (self->pipeline);
+      self->pipeline = COGL_INVALID_HANDLE;
+    }
+
   G_OBJECT_CLASS (st_scroll_view_fade_parent_class)->dispose (gobject);
 }
 
@@ -539,45 +537,39 @@ st_scroll_view_fade_class_init (StScrollViewFadeClass *klass)
 
 }
 
+static gboolean
+setup_fade_material (CoglHandle material)
+{
+  CoglHandle program;
+
+  program = st_pipeline_cache_get_program ("st-scroll-view-fade",
+                                           fade_glsl_shader);
+  if (program == COGL_INVALID_HANDLE)
+    return FALSE;
+
+  cogl_material_set_user_program (material, program);
+
+  return TRUE;
+}
+
 static void
 st_scroll_view_fade_init (StScrollViewFade *self)
 {
-  static CoglHandle shader = COGL_INVALID_HANDLE;
+  CoglHandle template;
+  int i;
 
-  if (shader == COGL_INVALID_HANDLE)
+  template = st_pipeline_cache_get_material ("st-scroll-view-fade",
+                                             setup_fade_material);
+  if (template != COGL_INVALID_HANDLE)
     {
-      if (clutter_feature_available (CLUTTER_FEATURE_SHADERS_GLSL))
-        {
-          shader = cogl_create_shader (COGL_SHADER_TYPE_FRAGMENT);
-          cogl_shader_source (shader, fade_glsl_shader);
-          cogl_shader_compile (shader);
-          if (!cogl_shader_is_compiled (shader))
-            {
-              gchar *log_buf = cogl_shader_get_info_log (shader);
-
-              g_warning (G_STRLOC ": Unable to compile the fade shader: %s",
-                         log_buf);
-              g_free (log_buf);
-
-              cogl_handle_unref (shader);
-              shader = COGL_INVALID_HANDLE;
-          }
-        }
-    }
+      self->pipeline = cogl_material_copy (template);
 
-  self->shader = shader;
-  self->is_attached = FALSE;
-  self->tex_uniform = -1;
-  self->height_uniform = -1;
-  self->width_uniform = -1;
-  self->fade_area_uniform = -1;
-  self->offset_top_uniform = -1;
-  self->offset_bottom_uniform = -1;
+      for (i = 0; i < N_UNIFORMS; i++)
+        self->uniforms[i] = cogl_pipeline_get_uniform_location (self->pipeline,
+                                                                uniform_names[i]);
+    }
   self->vfade_offset = DEFAULT_FADE_OFFSET;
   self->hfade_offset = DEFAULT_FADE_OFFSET;
-
-  if (shader != COGL_INVALID_HANDLE)
-    cogl_handle_ref (self->shader);
 }
 
 ClutterEffect *
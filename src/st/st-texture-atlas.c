@@ -0,0 +1,407 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+/*
+ * st-texture-atlas.c: Shared textures for small images
+ *
+ * Copyright 2012 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* The panel, menus and message tray show lots of small icons; giving
+ * each its own texture means a texture switch, and so a separate draw
+ * call, for every one of them. Instead we copy them into a few large
+ * pages and hand out sub-textures, so that Cogl can batch consecutive
+ * icons from the same page into a single draw.
+ *
+ * Pages are divided into horizontal shelves, each holding a row of
+ * square cells of a single size; icons come in a few standard sizes so
+ * this wastes little space and makes reuse trivial. A cell is freed
+ * when the last reference to its sub-texture goes away, a shelf when
+ * its last cell is freed and a page when its last shelf is. One empty
+ * page is kept around though, so that a window of icons coming and
+ * going (say, a menu being rebuilt) doesn't reallocate and reupload a
+ * whole page every time.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include "st-texture-atlas.h"
+
+#define PAGE_SIZE 512
+
+/* Transparent border around each image, so that linear filtering
+ * doesn't pick up the neighbouring cells */
+#define CELL_PADDING 1
+
+typedef struct _AtlasPage AtlasPage;
+typedef struct _AtlasShelf AtlasShelf;
+
+struct _StTextureAtlas {
+  GList *pages;
+};
+
+struct _AtlasPage {
+  StTextureAtlas *atlas; /* NULL once the atlas is freed */
+  CoglHandle texture;
+  GList *shelves; /* sorted by y */
+  gboolean retired;
+};
+
+struct _AtlasShelf {
+  AtlasPage *page;
+  int y;
+  int cell_size;
+  int n_cells;
+  int n_used;
+  guint8 *used;
+};
+
+typedef struct {
+  AtlasShelf *shelf;
+  int index;
+} AtlasCell;
+
+static CoglUserDataKey cell_key;
+
+static void
+atlas_page_free (AtlasPage *page)
+{
+  if (page->atlas)
+    page->atlas->pages = g_list_remove (page->atlas->pages, page);
+
+  cogl_handle_unref (page->texture);
+  g_slice_free (AtlasPage, page);
+}
+
+static void
+atlas_shelf_free (AtlasShelf *shelf)
+{
+  g_free (shelf->used);
+  g_slice_free (AtlasShelf, shelf);
+}
+
+/* Whether @page, which just became empty, should be kept for reuse */
+static gboolean
+atlas_page_keep_empty (AtlasPage *page)
+{
+  GList *l;
+
+  if (page->atlas == NULL || page->retired)
+    return FALSE;
+
+  for (l = page->atlas->pages; l; l = l->next)
+    {
+      AtlasPage *other = l->data;
+
+      if (other != page && other->shelves == NULL && !other->retired)
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+static void
+atlas_cell_free (void *user_data)
+{
+  AtlasCell *cell = user_data;
+  AtlasShelf *shelf = cell->shelf;
+  AtlasPage *page = shelf->page;
+
+  shelf->used[cell->index] = FALSE;
+  shelf->n_used--;
+  g_slice_free (AtlasCell, cell);
+
+  if (shelf->n_used > 0)
+    return;
+
+  page->shelves = g_list_remove (page->shelves, shelf);
+  atlas_shelf_free (shelf);
+
+  if (page->shelves == NULL && !atlas_page_keep_empty (page))
+    atlas_page_free (page);
+}
+
+static AtlasShelf *
+atlas_page_add_shelf (AtlasPage *page,
+                      int        cell_size)
+{
+  AtlasShelf *shelf;
+  GList *l;
+  int y = 0;
+
+  /* First fit in the gaps left between shelves */
+  for (l = page->shelves; l; l = l->next)
+    {
+      AtlasShelf *next = l->data;
+
+      if (next->y - y >= cell_size)
+        break;
+
+      y = next->y + next->cell_size;
+    }
+
+  if (l == NULL && PAGE_SIZE - y < cell_size)
+    return NULL;
+
+  shelf = g_slice_new0 (AtlasShelf);
+  shelf->page = page;
+  shelf->y = y;
+  shelf->cell_size = cell_size;
+  shelf->n_cells = PAGE_SIZE / cell_size;
+  shelf->used = g_new0 (guint8, shelf->n_cells);
+
+  page->shelves = g_list_insert_before (page->shelves, l, shelf);
+
+  return shelf;
+}
+
+static AtlasPage *
+atlas_add_page (StTextureAtlas *atlas)
+{
+  AtlasPage *page;
+  CoglHandle texture;
+
+  texture = cogl_texture_new_with_size (PAGE_SIZE, PAGE_SIZE,
+                                        COGL_TEXTURE_NO_ATLAS |
+                                        COGL_TEXTURE_NO_SLICING |
+                                        COGL_TEXTURE_NO_AUTO_MIPMAP,
+                                        COGL_PIXEL_FORMAT_RGBA_8888_PRE);
+  if (texture == COGL_INVALID_HANDLE)
+    return NULL;
+
+  page = g_slice_new0 (AtlasPage);
+  page->atlas = atlas;
+  page->texture = texture;
+
+  atlas->pages = g_list_prepend (atlas->pages, page);
+
+  return page;
+}
+
+static AtlasCell *
+atlas_allocate_cell (StTextureAtlas *atlas,
+                     int             cell_size)
+{
+  AtlasShelf *shelf = NULL;
+  AtlasCell *cell;
+  GList *l, *s;
+  int i;
+
+  for (l = atlas->pages; l && shelf == NULL; l = l->next)
+    {
+      AtlasPage *page = l->data;
+
+      if (page->retired)
+        continue;
+
+      for (s = page->shelves; s; s = s->next)
+        {
+          AtlasShelf *candidate = s->data;
+
+          if (candidate->cell_size == cell_size &&
+              candidate->n_used < candidate->n_cells)
+            {
+              shelf = candidate;
+              break;
+            }
+        }
+    }
+
+  for (l = atlas->pages; l && shelf == NULL; l = l->next)
+    {
+      AtlasPage *page = l->data;
+
+      if (!page->retired)
+        shelf = atlas_page_add_shelf (page, cell_size);
+    }
+
+  if (shelf == NULL)
+    {
+      AtlasPage *page = atlas_add_page (atlas);
+
+      if (page == NULL)
+        return NULL;
+
+      shelf = atlas_page_add_shelf (page, cell_size);
+    }
+
+  for (i = 0; i < shelf->n_cells; i++)
+    if (!shelf->used[i])
+      break;
+
+  g_assert (i < shelf->n_cells);
+
+  shelf->used[i] = TRUE;
+  shelf->n_used++;
+
+  cell = g_slice_new (AtlasCell);
+  cell->shelf = shelf;
+  cell->index = i;
+
+  return cell;
+}
+
+StTextureAtlas *
+st_texture_atlas_new (void)
+{
+  return g_new0 (StTextureAtlas, 1);
+}
+
+void
+st_texture_atlas_free (StTextureAtlas *atlas)
+{
+  GList *l, *next;
+
+  /* Pages stay around until the textures using them are gone; nothing
+   * is going to free the empty one */
+  for (l = atlas->pages; l; l = next)
+    {
+      AtlasPage *page = l->data;
+
+      next = l->next;
+      if (page->shelves == NULL)
+        atlas_page_free (page);
+      else
+        page->atlas = NULL;
+    }
+
+  g_list_free (atlas->pages);
+  g_free (atlas);
+}
+
+/**
+ * st_texture_atlas_add_pixbuf:
+ * @atlas: a #StTextureAtlas
+ * @pixbuf: the image to add
+ * @add_padding: whether to center a non-square image in a square texture
+ *
+ * Copies @pixbuf into one of the atlas pages.
+ *
+ * Return value: a sub-texture of the page holding the image, or
+ *   %COGL_INVALID_HANDLE if the image is too large for the atlas.
+ */
+CoglHandle
+st_texture_atlas_add_pixbuf (StTextureAtlas *atlas,
+                             GdkPixbuf      *pixbuf,
+                             gboolean        add_padding)
+{
+  AtlasCell *cell;
+  CoglHandle texture;
+  const guint8 *src_pixels;
+  guint8 *pixels;
+  int width, height, size, cell_size;
+  int src_rowstride, n_channels;
+  int x, y, cell_x, cell_y, offset_x, offset_y;
+
+  width = gdk_pixbuf_get_width (pixbuf);
+  height = gdk_pixbuf_get_height (pixbuf);
+  size = MAX (width, height);
+
+  if (size > ST_TEXTURE_ATLAS_MAX_SIZE ||
+      gdk_pixbuf_get_bits_per_sample (pixbuf) != 8)
+    return COGL_INVALID_HANDLE;
+
+  cell_size = size + 2 * CELL_PADDING;
+  cell = atlas_allocate_cell (atlas, cell_size);
+  if (cell == NULL)
+    return COGL_INVALID_HANDLE;
+
+  cell_x = cell->index * cell_size;
+  cell_y = cell->shelf->y;
+
+  offset_x = CELL_PADDING + (add_padding ? (size - width) / 2 : 0);
+  offset_y = CELL_PADDING + (add_padding ? (size - height) / 2 : 0);
+
+  /* Upload the whole cell including the border, which may still hold
+   * the image of a previous user */
+  pixels = g_malloc0 (cell_size * cell_size * 4);
+  src_pixels = gdk_pixbuf_get_pixels (pixbuf);
+  src_rowstride = gdk_pixbuf_get_rowstride (pixbuf);
+  n_channels = gdk_pixbuf_get_n_channels (pixbuf);
+
+  for (y = 0; y < height; y++)
+    {
+      const guint8 *src = src_pixels + y * src_rowstride;
+      guint8 *dest = pixels + ((y + offset_y) * cell_size + offset_x) * 4;
+
+      if (n_channels == 4)
+        {
+          memcpy (dest, src, width * 4);
+          continue;
+        }
+
+      for (x = 0; x < width; x++)
+        {
+          dest[0] = src[0];
+          dest[1] = src[1];
+          dest[2] = src[2];
+          dest[3] = 0xff;
+          src += n_channels;
+          dest += 4;
+        }
+    }
+
+  cogl_texture_set_region (cell->shelf->page->texture,
+                           0, 0,
+                           cell_x, cell_y,
+                           cell_size, cell_size,
+                           cell_size, cell_size,
+                           COGL_PIXEL_FORMAT_RGBA_8888,
+                           cell_size * 4,
+                           pixels);
+  g_free (pixels);
+
+  if (add_padding)
+    texture = cogl_texture_new_from_sub_texture (cell->shelf->page->texture,
+                                                 cell_x + CELL_PADDING,
+                                                 cell_y + CELL_PADDING,
+                                                 size, size);
+  else
+    texture = cogl_texture_new_from_sub_texture (cell->shelf->page->texture,
+                                                 cell_x + CELL_PADDING,
+                                                 cell_y + CELL_PADDING,
+                                                 width, height);
+
+  cogl_object_set_user_data (texture, &cell_key, cell, atlas_cell_free);
+
+  return texture;
+}
+
+/**
+ * st_texture_atlas_retire_pages:
+ * @atlas: a #StTextureAtlas
+ *
+ * Stops adding images to the existing pages. Used when most of the
+ * images are about to be replaced, for instance on icon theme changes;
+ * the new images are packed into fresh pages while the old ones are
+ * freed as the textures using them go away.
+ */
+void
+st_texture_atlas_retire_pages (StTextureAtlas *atlas)
+{
+  GList *l, *next;
+
+  for (l = atlas->pages; l; l = next)
+    {
+      AtlasPage *page = l->data;
+
+      next = l->next;
+      if (page->shelves == NULL)
+        atlas_page_free (page);
+      else
+        page->retired = TRUE;
+    }
+}
@@ -0,0 +1,45 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+/*
+ * st-texture-atlas.h: Shared textures for small images
+ *
+ * Copyright 2012 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __ST_TEXTURE_ATLAS_H__
+#define __ST_TEXTURE_ATLAS_H__
+
+#include <gdk-pixbuf/gdk-pixbuf.h>
+#include <cogl/cogl.h>
+
+G_BEGIN_DECLS
+
+/* Images larger than this in either dimension are not put in the atlas */
+#define ST_TEXTURE_ATLAS_MAX_SIZE 32
+
+typedef struct _StTextureAtlas StTextureAtlas;
+
+StTextureAtlas *st_texture_atlas_new          (void);
+void            st_texture_atlas_free         (StTextureAtlas *atlas);
+
+CoglHandle      st_texture_atlas_add_pixbuf   (StTextureAtlas *atlas,
+                                               GdkPixbuf      *pixbuf,
+                                               gboolean        add_padding);
+
+void            st_texture_atlas_retire_pages (StTextureAtlas *atlas);
+
+G_END_DECLS
+
+#endif /* __ST_TEXTURE_ATLAS_H__ */
@@ -22,8 +22,10 @@
 #include "config.h"
 
 #include "st-texture-cache.h"
+#include "st-texture-atlas.h"
 #include <gtk/gtk.h>
 #include <string.h>
+#include <unistd.h>
 #include <glib.h>
 
 #define CACHE_PREFIX_ICON "icon:"
@@ -32,6 +34,22 @@
 #define CACHE_PREFIX_RAW_CHECKSUM "raw-checksum:"
 #define CACHE_PREFIX_COMPRESSED_CHECKSUM "compressed-checksum:"
 
+#define N_PRIORITIES (ST_TEXTURE_CACHE_PRIORITY_BACKGROUND + 1)
+
+/* Decoding icons is mostly CPU bound, and a handful of threads is enough
+ * to keep up with anything we put on screen at once */
+#define MAX_DEFAULT_WORKERS 4
+
+/* An image decode waiting for, or running on, one of our worker threads.
+ * This is embedded in the request it belongs to. */
+typedef struct {
+  GSimpleAsyncResult *result;
+  GSimpleAsyncThreadFunc func;
+  GDestroyNotify free_func;
+  StTextureCachePriority priority;
+  gboolean queued;
+} LoadJob;
+
 struct _StTextureCachePrivate
 {
   GtkIconTheme *icon_theme;
@@ -41,10 +59,22 @@ struct _StTextureCachePrivate
 
   /* Presently this is used to de-duplicate requests for GIcons and async URIs. */
   GHashTable *outstanding_requests; /* char * -> AsyncTextureLoadData * */
+
+  /* Shared textures for small cached icons */
+  StTextureAtlas *atlas;
+
+  /* Our own thread pool for decoding images. The jobs themselves are kept
+   * in one queue per priority, protected by load_lock; each item pushed
+   * to the pool just wakes up a worker to take the most urgent job. That
+   * way jobs can be moved between priorities or dropped while pending. */
+  GThreadPool *load_pool;
+  GMutex load_lock;
+  GQueue pending_loads[N_PRIORITIES];
 };
 
 static void st_texture_cache_dispose (GObject *object);
 static void st_texture_cache_finalize (GObject *object);
+static void load_pool_run (gpointer token, gpointer user_data);
 
 enum
 {
@@ -119,6 +149,9 @@ static void
 on_icon_theme_changed (GtkIconTheme   *icon_theme,
                        StTextureCache *cache)
 {
+  /* Nearly all icons will be reloaded, so pack the new ones together
+   * rather than into the holes the old ones leave behind */
+  st_texture_atlas_retire_pages (cache->priv->atlas);
   st_texture_cache_evict_icons (cache);
   g_signal_emit (cache, signals[ICON_THEME_CHANGED], 0);
 }
@@ -126,6 +159,8 @@ on_icon_theme_changed (GtkIconTheme   *icon_theme,
 static void
 st_texture_cache_init (StTextureCache *self)
 {
+  long n_cpus;
+
   self->priv = g_new0 (StTextureCachePrivate, 1);
 
   self->priv->icon_theme = gtk_icon_theme_get_default ();
@@ -136,12 +171,45 @@ st_texture_cache_init (StTextureCache *self)
                                                    g_free, cogl_handle_unref);
   self->priv->outstanding_requests = g_hash_table_new_full (g_str_hash, g_str_equal,
                                                             g_free, NULL);
+
+  self->priv->atlas = st_texture_atlas_new ();
+
+  g_mutex_init (&self->priv->load_lock);
+
+  n_cpus = sysconf (_SC_NPROCESSORS_ONLN);
+  self->priv->load_pool = g_thread_pool_new (load_pool_run, self,
+                                             CLAMP (n_cpus, 1, MAX_DEFAULT_WORKERS),
+                                             FALSE, NULL);
 }
 
 static void
 st_texture_cache_dispose (GObject *object)
 {
   StTextureCache *self = (StTextureCache*)object;
+  int i;
+
+  if (self->priv->load_pool)
+    {
+      /* Wait for the running jobs, then drop the ones not started yet */
+      g_thread_pool_free (self->priv->load_pool, TRUE, TRUE);
+      self->priv->load_pool = NULL;
+
+      for (i = 0; i < N_PRIORITIES; i++)
+        {
+          LoadJob *job;
+
+          while ((job = g_queue_pop_head (&self->priv->pending_loads[i])))
+            {
+              gpointer data = g_async_result_get_user_data (G_ASYNC_RESULT (job->result));
+              GDestroyNotify free_func = job->free_func;
+
+              job->queued = FALSE;
+              g_object_unref (job->result);
+              if (free_func)
+                free_func (data);
+            }
+        }
+    }
 
   if (self->priv->icon_theme)
     {
@@ -159,12 +227,20 @@ st_texture_cache_dispose (GObject *object)
     g_hash_table_destroy (self->priv->outstanding_requests);
   self->priv->outstanding_requests = NULL;
 
+  if (self->priv->atlas)
+    st_texture_atlas_free (self->priv->atlas);
+  self->priv->atlas = NULL;
+
   G_OBJECT_CLASS (st_texture_cache_parent_class)->dispose (object);
 }
 
 static void
 st_texture_cache_finalize (GObject *object)
 {
+  StTextureCache *self = (StTextureCache*)object;
+
+  g_mutex_clear (&self->priv->load_lock);
+
   G_OBJECT_CLASS (st_texture_cache_parent_class)->finalize (object);
 }
 
@@ -303,12 +379,51 @@ typedef struct {
   GtkIconInfo *icon_info;
   StIconColors *colors;
   char *uri;
+
+  LoadJob job;
 } AsyncTextureLoadData;
 
+static GQuark
+texture_request_quark (void)
+{
+  static GQuark quark = 0;
+
+  if (G_UNLIKELY (quark == 0))
+    quark = g_quark_from_static_string ("st-texture-cache-request");
+
+  return quark;
+}
+
+static GQuark
+texture_priority_quark (void)
+{
+  static GQuark quark = 0;
+
+  if (G_UNLIKELY (quark == 0))
+    quark = g_quark_from_static_string ("st-texture-cache-priority");
+
+  return quark;
+}
+
+static void on_request_texture_destroy (ClutterActor         *texture,
+                                        AsyncTextureLoadData *data);
+
+static void
+texture_load_data_release_texture (AsyncTextureLoadData *data,
+                                   ClutterActor         *texture)
+{
+  g_signal_handlers_disconnect_by_func (texture,
+                                        (gpointer) on_request_texture_destroy,
+                                        data);
+  g_object_set_qdata (G_OBJECT (texture), texture_request_quark (), NULL);
+  g_object_unref (texture);
+}
+
 static void
 texture_load_data_destroy (gpointer p)
 {
   AsyncTextureLoadData *data = p;
+  GSList *iter;
 
   if (data->icon_info)
     {
@@ -322,8 +437,154 @@ texture_load_data_destroy (gpointer p)
   if (data->key)
     g_free (data->key);
 
-  if (data->textures)
-    g_slist_free_full (data->textures, (GDestroyNotify) g_object_unref);
+  for (iter = data->textures; iter; iter = iter->next)
+    texture_load_data_release_texture (data, iter->data);
+  g_slist_free (data->textures);
+  data->textures = NULL;
+}
+
+static void
+texture_load_data_free (gpointer p)
+{
+  texture_load_data_destroy (p);
+  g_free (p);
+}
+
+static void
+load_pool_run (gpointer token,
+               gpointer user_data)
+{
+  StTextureCache *cache = user_data;
+  GSimpleAsyncResult *result = NULL;
+  LoadJob *job = NULL;
+  int i;
+
+  g_mutex_lock (&cache->priv->load_lock);
+  for (i = 0; i < N_PRIORITIES && job == NULL; i++)
+    job = g_queue_pop_head (&cache->priv->pending_loads[i]);
+  if (job != NULL)
+    {
+      job->queued = FALSE;
+      result = job->result;
+    }
+  g_mutex_unlock (&cache->priv->load_lock);
+
+  /* The job was cancelled or already taken by another worker */
+  if (job == NULL)
+    return;
+
+  /* The request owning the job may be freed as soon as it completes,
+   * so don't touch the job itself past this point */
+  job->func (result, G_OBJECT (cache), NULL);
+  g_simple_async_result_complete_in_idle (result);
+  g_object_unref (result);
+}
+
+static void
+queue_load_job (StTextureCache         *cache,
+                LoadJob                *job,
+                GSimpleAsyncResult     *result,
+                GSimpleAsyncThreadFunc  func,
+                GDestroyNotify          free_func,
+                StTextureCachePriority  priority)
+{
+  job->result = g_object_ref (result);
+  job->func = func;
+  job->free_func = free_func;
+  job->priority = priority;
+
+  g_mutex_lock (&cache->priv->load_lock);
+  job->queued = TRUE;
+  g_queue_push_tail (&cache->priv->pending_loads[priority], job);
+  g_mutex_unlock (&cache->priv->load_lock);
+
+  g_thread_pool_push (cache->priv->load_pool, GINT_TO_POINTER (1), NULL);
+}
+
+/* Returns %TRUE if the job hadn't started yet and was dropped */
+static gboolean
+cancel_load_job (StTextureCache *cache,
+                 LoadJob        *job)
+{
+  gboolean cancelled = FALSE;
+
+  g_mutex_lock (&cache->priv->load_lock);
+  if (job->queued)
+    {
+      g_queue_remove (&cache->priv->pending_loads[job->priority], job);
+      job->queued = FALSE;
+      cancelled = TRUE;
+    }
+  g_mutex_unlock (&cache->priv->load_lock);
+
+  if (cancelled)
+    g_object_unref (job->result);
+
+  return cancelled;
+}
+
+static void
+requeue_load_job (StTextureCache         *cache,
+                  LoadJob                *job,
+                  StTextureCachePriority  priority)
+{
+  g_mutex_lock (&cache->priv->load_lock);
+  if (job->queued && job->priority != priority)
+    {
+      g_queue_remove (&cache->priv->pending_loads[job->priority], job);
+      g_queue_push_tail (&cache->priv->pending_loads[priority], job);
+    }
+  job->priority = priority;
+  g_mutex_unlock (&cache->priv->load_lock);
+}
+
+static StTextureCachePriority
+get_texture_priority (ClutterActor *texture)
+{
+  /* Unset reads as 0, which is ST_TEXTURE_CACHE_PRIORITY_VISIBLE */
+  return GPOINTER_TO_INT (g_object_get_qdata (G_OBJECT (texture),
+                                              texture_priority_quark ()));
+}
+
+/* A request is as urgent as the most urgent texture waiting on it */
+static StTextureCachePriority
+texture_load_data_get_priority (AsyncTextureLoadData *data)
+{
+  StTextureCachePriority priority = ST_TEXTURE_CACHE_PRIORITY_BACKGROUND;
+  GSList *iter;
+
+  for (iter = data->textures; iter; iter = iter->next)
+    priority = MIN (priority, get_texture_priority (iter->data));
+
+  return priority;
+}
+
+static void
+on_request_texture_destroy (ClutterActor         *texture,
+                            AsyncTextureLoadData *data)
+{
+  StTextureCache *cache = data->cache;
+
+  data->textures = g_slist_remove (data->textures, texture);
+  texture_load_data_release_texture (data, texture);
+
+  if (data->textures != NULL)
+    {
+      requeue_load_job (cache, &data->job,
+                        texture_load_data_get_priority (data));
+      return;
+    }
+
+  /* Nobody is waiting for the image anymore; drop the load if it hasn't
+   * started. A load that is already running is left to finish, so that
+   * at least the result ends up in the cache. */
+  if (!cancel_load_job (cache, &data->job))
+    return;
+
+  if (g_hash_table_lookup (cache->priv->outstanding_requests, data->key) == data)
+    g_hash_table_remove (cache->priv->outstanding_requests, data->key);
+
+  texture_load_data_free (data);
 }
 
 /**
@@ -638,13 +899,22 @@ on_pixbuf_loaded (GObject      *source,
   data = user_data;
   cache = ST_TEXTURE_CACHE (source);
 
-  g_hash_table_remove (cache->priv->outstanding_requests, data->key);
+  /* Uncached requests aren't tracked, and may share their key with one
+   * that is */
+  if (g_hash_table_lookup (cache->priv->outstanding_requests, data->key) == data)
+    g_hash_table_remove (cache->priv->outstanding_requests, data->key);
 
   pixbuf = load_pixbuf_async_finish (cache, result, &error);
   if (pixbuf == NULL)
     goto out;
 
-  texdata = pixbuf_to_cogl_handle (pixbuf, data->enforced_square);
+  /* Only cached icons go into the atlas; they are small and many of
+   * them are usually shown next to each other */
+  if (data->icon_info && data->policy != ST_TEXTURE_CACHE_POLICY_NONE)
+    texdata = st_texture_atlas_add_pixbuf (cache->priv->atlas, pixbuf,
+                                           data->enforced_square);
+  if (texdata == COGL_INVALID_HANDLE)
+    texdata = pixbuf_to_cogl_handle (pixbuf, data->enforced_square);
 
   g_object_unref (pixbuf);
 
@@ -671,8 +941,7 @@ out:
   if (texdata)
     cogl_handle_unref (texdata);
 
-  texture_load_data_destroy (data);
-  g_free (data);
+  texture_load_data_free (data);
 
   g_clear_error (&error);
 }
@@ -683,7 +952,8 @@ load_texture_async (StTextureCache       *cache,
 {
   GSimpleAsyncResult *result;
   result = g_simple_async_result_new (G_OBJECT (cache), on_pixbuf_loaded, data, load_texture_async);
-  g_simple_async_result_run_in_thread (result, load_pixbuf_thread, G_PRIORITY_DEFAULT, NULL);
+  queue_load_job (cache, &data->job, result, load_pixbuf_thread,
+                  texture_load_data_free, texture_load_data_get_priority (data));
   g_object_unref (result);
 }
 
@@ -878,6 +1148,13 @@ ensure_request (StTextureCache        *cache,
 
   /* Regardless of whether there was a pending request, prepend our texture here. */
   (*request)->textures = g_slist_prepend ((*request)->textures, g_object_ref (texture));
+  g_object_set_qdata (G_OBJECT (texture), texture_request_quark (), *request);
+  g_signal_connect (texture, "destroy",
+                    G_CALLBACK (on_request_texture_destroy), *request);
+
+  if (had_pending)
+    requeue_load_job (cache, &pending->job,
+                      texture_load_data_get_priority (pending));
 
   return had_pending;
 }
@@ -1004,6 +1281,8 @@ typedef struct {
   gchar *path;
   gint   grid_width, grid_height;
   ClutterActor *actor;
+
+  LoadJob job;
 } AsyncImageData;
 
 static void
@@ -1115,7 +1394,8 @@ st_texture_cache_load_sliced_image (StTextureCache    *cache,
   result = g_simple_async_result_new (G_OBJECT (cache), on_sliced_image_loaded, data, st_texture_cache_load_sliced_image);
 
   g_object_set_data_full (G_OBJECT (result), "load_sliced_image", data, on_data_destroy);
-  g_simple_async_result_run_in_thread (result, load_sliced_image, G_PRIORITY_DEFAULT, NULL);
+  queue_load_job (cache, &data->job, result, load_sliced_image, NULL,
+                  ST_TEXTURE_CACHE_PRIORITY_VISIBLE);
 
   g_object_unref (result);
 
@@ -1443,6 +1723,186 @@ st_texture_cache_load_file_to_cairo_surface (StTextureCache *cache,
   return surface;
 }
 
+/* A 64-bit hash of image data, following xxHash64. It is several times
+ * faster than a cryptographic checksum, which matters since it runs over
+ * every image a notification sends us; the four independent lanes of the
+ * main loop are easy for the compiler to keep in flight at once.
+ */
+#define XXH_PRIME64_1 G_GUINT64_CONSTANT (0x9E3779B185EBCA87)
+#define XXH_PRIME64_2 G_GUINT64_CONSTANT (0xC2B2AE3D27D4EB4F)
+#define XXH_PRIME64_3 G_GUINT64_CONSTANT (0x165667B19E3779F9)
+#define XXH_PRIME64_4 G_GUINT64_CONSTANT (0x85EBCA77C2B2AE63)
+#define XXH_PRIME64_5 G_GUINT64_CONSTANT (0x27D4EB2F165667C5)
+
+static inline guint64
+xxh_rotl64 (guint64 x,
+            int     r)
+{
+  return (x << r) | (x >> (64 - r));
+}
+
+static inline guint64
+xxh_read64 (const guchar *p)
+{
+  guint64 value;
+
+  memcpy (&value, p, sizeof (value));
+  return GUINT64_FROM_LE (value);
+}
+
+static inline guint32
+xxh_read32 (const guchar *p)
+{
+  guint32 value;
+
+  memcpy (&value, p, sizeof (value));
+  return GUINT32_FROM_LE (value);
+}
+
+static inline guint64
+xxh_round (guint64 acc,
+           guint64 input)
+{
+  acc += input * XXH_PRIME64_2;
+  acc = xxh_rotl64 (acc, 31);
+  return acc * XXH_PRIME64_1;
+}
+
+static inline guint64
+xxh_merge_round (guint64 acc,
+                 guint64 value)
+{
+  acc ^= xxh_round (0, value);
+  return acc * XXH_PRIME64_1 + XXH_PRIME64_4;
+}
+
+static guint64
+hash_pixel_data (const guchar *data,
+                 gsize         len)
+{
+  const guchar *p = data;
+  const guchar *end = data + len;
+  guint64 h;
+
+  if (len >= 32)
+    {
+      const guchar *limit = end - 32;
+      guint64 v1 = XXH_PRIME64_1 + XXH_PRIME64_2;
+      guint64 v2 = XXH_PRIME64_2;
+      guint64 v3 = 0;
+      guint64 v4 = -XXH_PRIME64_1;
+
+      do
+        {
+          v1 = xxh_round (v1, xxh_read64 (p));
+          v2 = xxh_round (v2, xxh_read64 (p + 8));
+          v3 = xxh_round (v3, xxh_read64 (p + 16));
+          v4 = xxh_round (v4, xxh_read64 (p + 24));
+          p += 32;
+        }
+      while (p <= limit);
+
+      h = (xxh_rotl64 (v1, 1) + xxh_rotl64 (v2, 7) +
+           xxh_rotl64 (v3, 12) + xxh_rotl64 (v4, 18));
+      h = xxh_merge_round (h, v1);
+      h = xxh_merge_round (h, v2);
+      h = xxh_merge_round (h, v3);
+      h = xxh_merge_round (h, v4);
+    }
+  else
+    {
+      h = XXH_PRIME64_5;
+    }
+
+  h += len;
+
+  for (; p + 8 <= end; p += 8)
+    {
+      h ^= xxh_round (0, xxh_read64 (p));
+      h = xxh_rotl64 (h, 27) * XXH_PRIME64_1 + XXH_PRIME64_4;
+    }
+
+  if (p + 4 <= end)
+    {
+      h ^= (guint64) xxh_read32 (p) * XXH_PRIME64_1;
+      h = xxh_rotl64 (h, 23) * XXH_PRIME64_2 + XXH_PRIME64_3;
+      p += 4;
+    }
+
+  for (; p < end; p++)
+    {
+      h ^= *p * XXH_PRIME64_5;
+      h = xxh_rotl64 (h, 11) * XXH_PRIME64_1;
+    }
+
+  h ^= h >> 33;
+  h *= XXH_PRIME64_2;
+  h ^= h >> 29;
+  h *= XXH_PRIME64_3;
+  h ^= h >> 32;
+
+  return h;
+}
+
+/* Uploads raw pixel data into the keyed cache unless it is there
+ * already, and returns its key */
+static char *
+ensure_raw (StTextureCache *cache,
+            const guchar   *data,
+            gsize           len,
+            gboolean        has_alpha,
+            int             width,
+            int             height,
+            int             rowstride,
+            int             size)
+{
+  CoglHandle texdata;
+  char *key;
+  int scaled_width, scaled_height;
+  gboolean scale;
+
+  /* Only the scaled down image is cached, so the size is part of the key
+   * when it applies; otherwise all sizes share the original.
+   */
+  scale = compute_pixbuf_scale (width, height, size, size,
+                                &scaled_width, &scaled_height);
+
+  key = g_strdup_printf (CACHE_PREFIX_RAW_CHECKSUM "hash=%016" G_GINT64_MODIFIER "x,"
+                         "width=%d,height=%d,rowstride=%d,alpha=%d,size=%d",
+                         hash_pixel_data (data, len),
+                         width, height, rowstride, has_alpha != FALSE,
+                         scale ? size : -1);
+
+  if (g_hash_table_lookup (cache->priv->keyed_cache, key) != NULL)
+    return key;
+
+  if (scale)
+    {
+      GdkPixbuf *pixbuf, *scaled;
+
+      pixbuf = gdk_pixbuf_new_from_data (data, GDK_COLORSPACE_RGB, has_alpha,
+                                         8, width, height, rowstride,
+                                         NULL, NULL);
+      scaled = gdk_pixbuf_scale_simple (pixbuf, scaled_width, scaled_height,
+                                        GDK_INTERP_BILINEAR);
+      texdata = pixbuf_to_cogl_handle (scaled, FALSE);
+
+      g_object_unref (scaled);
+      g_object_unref (pixbuf);
+    }
+  else
+    {
+      texdata = cogl_texture_new_from_data (width, height, COGL_TEXTURE_NONE,
+                                            has_alpha ? COGL_PIXEL_FORMAT_RGBA_8888 : COGL_PIXEL_FORMAT_RGB_888,
+                                            COGL_PIXEL_FORMAT_ANY,
+                                            rowstride, data);
+    }
+
+  g_hash_table_insert (cache->priv->keyed_cache, g_strdup (key), texdata);
+
+  return key;
+}
+
 /**
  * st_texture_cache_load_from_raw:
  * @cache: a #StTextureCache
@@ -1455,6 +1915,8 @@ st_texture_cache_load_file_to_cairo_surface (StTextureCache *cache,
  * @size: size of icon to return
  *
  * Creates (or retrieves from cache) an icon based on raw pixel data.
+ * Images larger than @size are scaled down before being uploaded, and
+ * only the scaled down copy is kept in the cache.
  *
  * Return value: (transfer none): a new #ClutterActor displaying a
  * pixbuf created from @data and the other parameters.
@@ -1469,38 +1931,179 @@ st_texture_cache_load_from_raw (StTextureCache    *cache,
                                 int                rowstride,
                                 int                size,
                                 GError           **error)
+{
+  ClutterActor *texture;
+  char *key;
+
+  key = ensure_raw (cache, data, len, has_alpha, width, height, rowstride, size);
+  texture = st_texture_cache_load_cached (cache, key, size);
+  g_free (key);
+
+  return texture;
+}
+
+/**
+ * st_texture_cache_load_cached:
+ * @cache: a #StTextureCache
+ * @key: a key returned by st_texture_cache_add_image_data()
+ * @size: size of icon to return
+ *
+ * Creates an icon showing an image that was decoded into the cache
+ * earlier.
+ *
+ * Return value: (transfer none): a new #ClutterActor displaying the
+ * image, or %NULL if nothing is cached under @key
+ **/
+ClutterActor *
+st_texture_cache_load_cached (StTextureCache *cache,
+                              const char     *key,
+                              int             size)
 {
   ClutterTexture *texture;
   CoglHandle texdata;
-  char *key;
-  char *checksum;
+
+  texdata = g_hash_table_lookup (cache->priv->keyed_cache, key);
+  if (texdata == NULL)
+    return NULL;
 
   texture = create_default_texture ();
   clutter_actor_set_size (CLUTTER_ACTOR (texture), size, size);
+  set_texture_cogl_texture (texture, texdata);
 
-  /* In theory, two images of with different width and height could have the same
-   * pixel data and thus hash the same. (Say, a 16x16 and a 8x32 blank image.)
-   * We ignore this for now. If anybody hits this problem they should use
-   * GChecksum directly to compute a checksum including the width and height.
-   */
-  checksum = g_compute_checksum_for_data (G_CHECKSUM_SHA1, data, len);
-  key = g_strdup_printf (CACHE_PREFIX_RAW_CHECKSUM "checksum=%s", checksum);
-  g_free (checksum);
+  return CLUTTER_ACTOR (texture);
+}
 
-  texdata = g_hash_table_lookup (cache->priv->keyed_cache, key);
-  if (texdata == NULL)
+/* Checks that @len bytes hold a @width by @height image with the given
+ * layout; the sizes come from another process, so the arithmetic must
+ * not overflow */
+static gboolean
+image_data_size_is_valid (gint32   width,
+                          gint32   height,
+                          gint32   rowstride,
+                          gint32   bits_per_sample,
+                          gint32   n_channels,
+                          gboolean has_alpha,
+                          gsize    len)
+{
+  gsize row_size, last_row;
+
+  if (width <= 0 || height <= 0 || rowstride <= 0 ||
+      bits_per_sample != 8 ||
+      n_channels != (has_alpha ? 4 : 3))
+    return FALSE;
+
+  if ((gsize) width > G_MAXSIZE / n_channels)
+    return FALSE;
+  row_size = (gsize) width * n_channels;
+  if ((gsize) rowstride < row_size)
+    return FALSE;
+
+  /* The last row doesn't need to be padded out to the rowstride */
+  if ((gsize) (height - 1) > (G_MAXSIZE - row_size) / (gsize) rowstride)
+    return FALSE;
+  last_row = (gsize) rowstride * (height - 1);
+
+  return len >= last_row + row_size;
+}
+
+/**
+ * st_texture_cache_add_image_data:
+ * @cache: a #StTextureCache
+ * @image_data: a #GVariant of type (iiibiiay), as sent in the
+ *   "image-data" hint of desktop notifications
+ * @size: size of the icon the image will be shown at
+ * @error: return location for a #GError
+ *
+ * Decodes @image_data into the cache, so that it can be shown later
+ * with st_texture_cache_load_cached() without keeping @image_data,
+ * which holds the whole uncompressed image, around. The pixel data is
+ * used in place in the serialized message rather than being copied out
+ * to the caller and back.
+ *
+ * Return value: (transfer full): the key of the decoded image, or
+ * %NULL if @image_data isn't a valid image.
+ **/
+char *
+st_texture_cache_add_image_data (StTextureCache  *cache,
+                                 GVariant        *image_data,
+                                 int              size,
+                                 GError         **error)
+{
+  GVariant *pixels;
+  const guchar *data;
+  gsize len;
+  gint32 width, height, rowstride, bits_per_sample, n_channels;
+  gboolean has_alpha;
+  char *key = NULL;
+
+  g_return_val_if_fail (image_data != NULL, NULL);
+
+  if (!g_variant_is_of_type (image_data, G_VARIANT_TYPE ("(iiibiiay)")))
     {
-      texdata = cogl_texture_new_from_data (width, height, COGL_TEXTURE_NONE,
-                                            has_alpha ? COGL_PIXEL_FORMAT_RGBA_8888 : COGL_PIXEL_FORMAT_RGB_888,
-                                            COGL_PIXEL_FORMAT_ANY,
-                                            rowstride, data);
-      g_hash_table_insert (cache->priv->keyed_cache, g_strdup (key), texdata);
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                   "Image data has type %s, expected (iiibiiay)",
+                   g_variant_get_type_string (image_data));
+      return NULL;
+    }
+
+  g_variant_get (image_data, "(iiibii@ay)",
+                 &width, &height, &rowstride, &has_alpha,
+                 &bits_per_sample, &n_channels, &pixels);
+
+  /* Borrows the data from the (possibly serialized) variant */
+  data = g_variant_get_fixed_array (pixels, &len, sizeof (guchar));
+
+  if (!image_data_size_is_valid (width, height, rowstride, bits_per_sample,
+                                 n_channels, has_alpha, len))
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                   "Invalid image data: %dx%d, rowstride %d, %d bits per sample, "
+                   "%d channels, %" G_GSIZE_FORMAT " bytes",
+                   width, height, rowstride, bits_per_sample, n_channels, len);
     }
+  else
+    {
+      key = ensure_raw (cache, data, len, has_alpha,
+                        width, height, rowstride, size);
+    }
+
+  g_variant_unref (pixels);
+
+  return key;
+}
+
+/**
+ * st_texture_cache_load_from_image_data:
+ * @cache: a #StTextureCache
+ * @image_data: a #GVariant of type (iiibiiay), as sent in the
+ *   "image-data" hint of desktop notifications
+ * @size: size of icon to return
+ * @error: return location for a #GError
+ *
+ * Like st_texture_cache_load_from_raw(), but takes the image straight
+ * from the notification's #GVariant, as st_texture_cache_add_image_data()
+ * does.
+ *
+ * Return value: (transfer none): a new #ClutterActor displaying the
+ * image, or %NULL if @image_data isn't a valid image.
+ **/
+ClutterActor *
+st_texture_cache_load_from_image_data (StTextureCache  *cache,
+                                       GVariant        *image_data,
+                                       int              size,
+                                       GError         **error)
+{
+  ClutterActor *actor;
+  char *key;
 
+  key = st_texture_cache_add_image_data (cache, image_data, size, error);
+  if (key == NULL)
+    return NULL;
+
+  actor = st_texture_cache_load_cached (cache, key, size);
   g_free (key);
 
-  set_texture_cogl_texture (texture, texdata);
-  return CLUTTER_ACTOR (texture);
+  return actor;
 }
 
 static StTextureCache *instance = NULL;
@@ -1517,3 +2120,55 @@ st_texture_cache_get_default (void)
     instance = g_object_new (ST_TYPE_TEXTURE_CACHE, NULL);
   return instance;
 }
+
+/**
+ * st_texture_cache_set_max_workers:
+ * @cache: A #StTextureCache
+ * @max_workers: the maximum number of images to decode at the same time
+ *
+ * Sets how many threads the cache uses for asynchronous loads. By
+ * default this is the number of CPUs, up to 4.
+ */
+void
+st_texture_cache_set_max_workers (StTextureCache *cache,
+                                  int             max_workers)
+{
+  g_return_if_fail (ST_IS_TEXTURE_CACHE (cache));
+  g_return_if_fail (max_workers > 0);
+
+  g_thread_pool_set_max_threads (cache->priv->load_pool, max_workers, NULL);
+}
+
+/**
+ * st_texture_cache_set_priority:
+ * @cache: A #StTextureCache
+ * @texture: a texture returned by the cache, for instance from
+ *   st_texture_cache_load_gicon()
+ * @priority: how urgently @texture is needed
+ *
+ * Changes the priority of the asynchronous load filling in @texture,
+ * for instance when it is scrolled into view. Textures start out as
+ * %ST_TEXTURE_CACHE_PRIORITY_VISIBLE. Nothing happens if the texture
+ * is already loaded.
+ *
+ * If a texture is destroyed before its load has started, the load is
+ * dropped.
+ */
+void
+st_texture_cache_set_priority (StTextureCache         *cache,
+                               ClutterActor           *texture,
+                               StTextureCachePriority  priority)
+{
+  AsyncTextureLoadData *data;
+
+  g_return_if_fail (ST_IS_TEXTURE_CACHE (cache));
+  g_return_if_fail (CLUTTER_IS_ACTOR (texture));
+
+  g_object_set_qdata (G_OBJECT (texture), texture_priority_quark (),
+                      GINT_TO_POINTER (priority));
+
+  data = g_object_get_qdata (G_OBJECT (texture), texture_request_quark ());
+  if (data != NULL)
+    requeue_load_job (cache, &data->job,
+                      texture_load_data_get_priority (data));
+}
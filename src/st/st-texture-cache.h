@@ -64,10 +64,34 @@ typedef enum {
   ST_TEXTURE_CACHE_POLICY_FOREVER
 } StTextureCachePolicy;
 
+/**
+ * StTextureCachePriority:
+ * @ST_TEXTURE_CACHE_PRIORITY_VISIBLE: the texture is on screen, or about to be
+ * @ST_TEXTURE_CACHE_PRIORITY_PREFETCH: the texture is likely to be shown soon,
+ *   for instance on a part of a view that is scrolled out
+ * @ST_TEXTURE_CACHE_PRIORITY_BACKGROUND: the texture is only loaded to warm
+ *   up the cache
+ *
+ * How urgently an asynchronously loaded texture is needed. Pending loads
+ * are started in priority order; see st_texture_cache_set_priority().
+ */
+typedef enum {
+  ST_TEXTURE_CACHE_PRIORITY_VISIBLE,
+  ST_TEXTURE_CACHE_PRIORITY_PREFETCH,
+  ST_TEXTURE_CACHE_PRIORITY_BACKGROUND
+} StTextureCachePriority;
+
 GType st_texture_cache_get_type (void) G_GNUC_CONST;
 
 StTextureCache* st_texture_cache_get_default (void);
 
+void st_texture_cache_set_max_workers (StTextureCache         *cache,
+                                       int                     max_workers);
+
+void st_texture_cache_set_priority    (StTextureCache         *cache,
+                                       ClutterActor           *texture,
+                                       StTextureCachePriority  priority);
+
 ClutterActor *
 st_texture_cache_load_sliced_image (StTextureCache    *cache,
                                     const gchar       *path,
@@ -110,6 +134,20 @@ ClutterActor *st_texture_cache_load_from_raw  (StTextureCache    *cache,
                                                int                size,
                                                GError           **error);
 
+ClutterActor *st_texture_cache_load_from_image_data (StTextureCache  *cache,
+                                                     GVariant        *image_data,
+                                                     int              size,
+                                                     GError         **error);
+
+char         *st_texture_cache_add_image_data       (StTextureCache  *cache,
+                                                     GVariant        *image_data,
+                                                     int              size,
+                                                     GError         **error);
+
+ClutterActor *st_texture_cache_load_cached          (StTextureCache  *cache,
+                                                     const char      *key,
+                                                     int              size);
+
 /**
  * StTextureCacheLoader: (skip)
  * @cache: a #StTextureCache
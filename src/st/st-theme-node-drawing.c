@@ -50,6 +50,19 @@ typedef struct {
   guint          border_width_2;
 } StCornerSpec;
 
+/* Corner textures are shared by all theme nodes with the same corner;
+ * an entry lives as long as its texture is used by any node. Each node
+ * gets its own material though, since painting sets the opacity on it
+ * and changing a material that is used by queued primitives makes Cogl
+ * flush its journal. */
+typedef struct {
+  StCornerSpec spec;
+  CoglHandle texture; /* not referenced */
+} StCornerCacheEntry;
+
+static GHashTable *corner_cache = NULL;
+static CoglUserDataKey corner_cache_key;
+
 static void
 elliptical_arc (cairo_t *cr,
                 double   x_center,
@@ -66,8 +79,13 @@ elliptical_arc (cairo_t *cr,
   cairo_restore (cr);
 }
 
+/* The texture only holds the top left corner; the other corners
+ * are drawn from it mirrored, see st_theme_node_paint_borders().
+ * The border widths and colors of the spec are the ones of the
+ * horizontal (1) and vertical (2) side adjacent to the corner.
+ */
 static CoglHandle
-create_corner_material (StCornerSpec *corner)
+create_corner_texture (StCornerSpec *corner)
 {
   CoglHandle texture;
   cairo_t *cr;
@@ -78,17 +96,19 @@ create_corner_material (StCornerSpec *corner)
   guint max_border_width;
 
   max_border_width = MAX(corner->border_width_2, corner->border_width_1);
-  size = 2 * MAX(max_border_width, corner->radius);
+  size = MAX(max_border_width, corner->radius);
   rowstride = size * 4;
   data = g_new0 (guint8, size * rowstride);
 
+  /* Draw the shape for all four corners, scaled so that only the top
+   * left one falls on the surface */
   surface = cairo_image_surface_create_for_data (data,
                                                  CAIRO_FORMAT_ARGB32,
                                                  size, size,
                                                  rowstride);
   cr = cairo_create (surface);
   cairo_set_operator (cr, CAIRO_OPERATOR_SOURCE);
-  cairo_scale (cr, size, size);
+  cairo_scale (cr, 2 * size, 2 * size);
 
   if (max_border_width <= corner->radius)
     {
@@ -178,25 +198,68 @@ create_corner_material (StCornerSpec *corner)
   return texture;
 }
 
-static char *
-corner_to_string (StCornerSpec *corner)
+static guint
+corner_spec_hash (gconstpointer key)
 {
-  return g_strdup_printf ("st-theme-node-corner:%02x%02x%02x%02x,%02x%02x%02x%02x,%02x%02x%02x%02x,%u,%u,%u",
-                          corner->color.red, corner->color.blue, corner->color.green, corner->color.alpha,
-                          corner->border_color_1.red, corner->border_color_1.green, corner->border_color_1.blue, corner->border_color_1.alpha,
-                          corner->border_color_2.red, corner->border_color_2.green, corner->border_color_2.blue, corner->border_color_2.alpha,
-                          corner->radius,
-                          corner->border_width_1,
-                          corner->border_width_2);
+  const StCornerSpec *corner = key;
+
+  return clutter_color_hash (&corner->color) ^
+         (clutter_color_hash (&corner->border_color_1) * 31) ^
+         (clutter_color_hash (&corner->border_color_2) * 961) ^
+         (corner->radius << 16) ^
+         (corner->border_width_1 << 8) ^
+         corner->border_width_2;
+}
+
+static gboolean
+corner_spec_equal (gconstpointer a,
+                   gconstpointer b)
+{
+  const StCornerSpec *corner_a = a;
+  const StCornerSpec *corner_b = b;
+
+  return corner_a->radius == corner_b->radius &&
+         corner_a->border_width_1 == corner_b->border_width_1 &&
+         corner_a->border_width_2 == corner_b->border_width_2 &&
+         clutter_color_equal (&corner_a->color, &corner_b->color) &&
+         clutter_color_equal (&corner_a->border_color_1, &corner_b->border_color_1) &&
+         clutter_color_equal (&corner_a->border_color_2, &corner_b->border_color_2);
+}
+
+static void
+corner_cache_entry_destroy (void *data)
+{
+  StCornerCacheEntry *entry = data;
+
+  g_hash_table_remove (corner_cache, &entry->spec);
+  g_slice_free (StCornerCacheEntry, entry);
 }
 
 static CoglHandle
-load_corner (StTextureCache  *cache,
-             const char      *key,
-             void            *datap,
-             GError         **error)
+lookup_corner_material (StCornerSpec *corner)
 {
-  return create_corner_material ((StCornerSpec *) datap);
+  StCornerCacheEntry *entry;
+  CoglHandle texture, material;
+
+  if (G_UNLIKELY (corner_cache == NULL))
+    corner_cache = g_hash_table_new (corner_spec_hash, corner_spec_equal);
+
+  entry = g_hash_table_lookup (corner_cache, corner);
+  if (entry != NULL)
+    return _st_create_texture_material (entry->texture);
+
+  entry = g_slice_new (StCornerCacheEntry);
+  entry->spec = *corner;
+  entry->texture = texture = create_corner_texture (corner);
+
+  g_hash_table_insert (corner_cache, &entry->spec, entry);
+  cogl_object_set_user_data (texture, &corner_cache_key,
+                             entry, corner_cache_entry_destroy);
+
+  material = _st_create_texture_material (texture);
+  cogl_handle_unref (texture);
+
+  return material;
 }
 
 /* To match the CSS specification, we want the border to look like it was
@@ -337,14 +400,9 @@ static CoglHandle
 st_theme_node_lookup_corner (StThemeNode    *node,
                              StCorner        corner_id)
 {
-  CoglHandle texture, material;
-  char *key;
-  StTextureCache *cache;
   StCornerSpec corner;
   guint radius[4];
 
-  cache = st_texture_cache_get_default ();
-
   st_theme_node_reduce_border_radius (node, radius);
 
   if (radius[corner_id] == 0)
@@ -381,14 +439,7 @@ st_theme_node_lookup_corner (StThemeNode    *node,
       corner.border_color_2.alpha == 0)
     return COGL_INVALID_HANDLE;
 
-  key = corner_to_string (&corner);
-  texture = st_texture_cache_load (cache, key, ST_TEXTURE_CACHE_POLICY_NONE, load_corner, &corner, NULL);
-  material = _st_create_texture_material (texture);
-  cogl_handle_unref (texture);
-
-  g_free (key);
-
-  return material;
+  return lookup_corner_material (&corner);
 }
 
 static void
@@ -1594,25 +1645,27 @@ st_theme_node_paint_borders (StThemeNode           *node,
 
           switch (corner_id)
             {
+              /* The corner textures hold a top left corner, mirror
+               * them for the other corners */
               case ST_CORNER_TOPLEFT:
                 cogl_rectangle_with_texture_coords (0, 0,
                                                     max_width_radius[ST_CORNER_TOPLEFT], max_width_radius[ST_CORNER_TOPLEFT],
-                                                    0, 0, 0.5, 0.5);
+                                                    0, 0, 1, 1);
                 break;
               case ST_CORNER_TOPRIGHT:
                 cogl_rectangle_with_texture_coords (width - max_width_radius[ST_CORNER_TOPRIGHT], 0,
                                                     width, max_width_radius[ST_CORNER_TOPRIGHT],
-                                                    0.5, 0, 1, 0.5);
+                                                    1, 0, 0, 1);
                 break;
               case ST_CORNER_BOTTOMRIGHT:
                 cogl_rectangle_with_texture_coords (width - max_width_radius[ST_CORNER_BOTTOMRIGHT], height - max_width_radius[ST_CORNER_BOTTOMRIGHT],
                                                     width, height,
-                                                    0.5, 0.5, 1, 1);
+                                                    1, 1, 0, 0);
                 break;
               case ST_CORNER_BOTTOMLEFT:
                 cogl_rectangle_with_texture_coords (0, height - max_width_radius[ST_CORNER_BOTTOMLEFT],
                                                     max_width_radius[ST_CORNER_BOTTOMLEFT], height,
-                                                    0, 0.5, 0.5, 1);
+                                                    0, 1, 1, 0);
                 break;
             }
         }
@@ -2003,6 +2056,185 @@ st_theme_node_paint (StThemeNode           *node,
     }
 }
 
+static gboolean
+st_theme_node_is_flat (StThemeNode *node)
+{
+  int corner_id;
+
+  _st_theme_node_ensure_background (node);
+
+  if (node->background_gradient_type != ST_GRADIENT_NONE ||
+      node->background_image != NULL)
+    return FALSE;
+
+  if (st_theme_node_get_border_image (node) != NULL ||
+      st_theme_node_get_box_shadow (node) != NULL ||
+      st_theme_node_get_background_image_shadow (node) != NULL)
+    return FALSE;
+
+  for (corner_id = 0; corner_id < 4; corner_id++)
+    if (st_theme_node_get_border_radius (node, corner_id) > 0)
+      return FALSE;
+
+  return TRUE;
+}
+
+/**
+ * _st_theme_node_can_interpolate:
+ * @node: a #StThemeNode
+ * @other: a different #StThemeNode
+ *
+ * Checks whether @node and @other are painted as plain rectangles of
+ * color with the same geometry, so that a crossfade between them is
+ * the same as painting the rectangles with interpolated colors; see
+ * _st_theme_node_paint_interpolated().
+ *
+ * Return value: %TRUE if the two nodes only differ in their colors
+ */
+gboolean
+_st_theme_node_can_interpolate (StThemeNode *node,
+                                StThemeNode *other)
+{
+  int side_id;
+
+  if (!st_theme_node_is_flat (node) || !st_theme_node_is_flat (other))
+    return FALSE;
+
+  for (side_id = 0; side_id < 4; side_id++)
+    if (st_theme_node_get_border_width (node, side_id) !=
+        st_theme_node_get_border_width (other, side_id))
+      return FALSE;
+
+  return st_theme_node_get_outline_width (node) ==
+         st_theme_node_get_outline_width (other);
+}
+
+/* Mixes two colors the way blending the two premultiplied colors would */
+static void
+interpolate_color (const ClutterColor *from,
+                   const ClutterColor *to,
+                   double              progress,
+                   ClutterColor       *result)
+{
+  double from_alpha = from->alpha * (1 - progress);
+  double to_alpha = to->alpha * progress;
+  double alpha = from_alpha + to_alpha;
+
+  if (alpha <= 0)
+    {
+      result->red = result->green = result->blue = result->alpha = 0;
+      return;
+    }
+
+  result->red = (from->red * from_alpha + to->red * to_alpha) / alpha + 0.5;
+  result->green = (from->green * from_alpha + to->green * to_alpha) / alpha + 0.5;
+  result->blue = (from->blue * from_alpha + to->blue * to_alpha) / alpha + 0.5;
+  result->alpha = alpha + 0.5;
+}
+
+static void
+set_source_color_with_opacity (const ClutterColor *color,
+                               guint8              paint_opacity)
+{
+  cogl_set_source_color4ub (color->red, color->green, color->blue,
+                            paint_opacity * color->alpha / 255);
+}
+
+/**
+ * _st_theme_node_paint_interpolated:
+ * @node: the #StThemeNode to transition from
+ * @other: the #StThemeNode to transition to
+ * @box: the box to paint
+ * @progress: how far along the transition is, from 0 to 1
+ * @paint_opacity: opacity of the painting
+ *
+ * Paints the state of a crossfade from @node to @other without going
+ * through offscreen buffers. Must only be called if
+ * _st_theme_node_can_interpolate() returns %TRUE for the two nodes.
+ */
+void
+_st_theme_node_paint_interpolated (StThemeNode           *node,
+                                   StThemeNode           *other,
+                                   const ClutterActorBox *box,
+                                   double                 progress,
+                                   guint8                 paint_opacity)
+{
+  ClutterColor from, to, border, background, outline;
+  float width, height;
+  int border_width[4];
+  int outline_width;
+  int side_id;
+
+  width = box->x2 - box->x1;
+  height = box->y2 - box->y1;
+
+  for (side_id = 0; side_id < 4; side_id++)
+    border_width[side_id] = st_theme_node_get_border_width (node, side_id);
+
+  /* Flat nodes are drawn as regions of a single color each, so fading
+   * between them fades each region between its two colors */
+  interpolate_color (&node->background_color, &other->background_color,
+                     progress, &background);
+
+  get_arbitrary_border_color (node, &from);
+  over (&from, &node->background_color, &from);
+  get_arbitrary_border_color (other, &to);
+  over (&to, &other->background_color, &to);
+  interpolate_color (&from, &to, progress, &border);
+
+  if (border_width[ST_SIDE_TOP] > 0 ||
+      border_width[ST_SIDE_RIGHT] > 0 ||
+      border_width[ST_SIDE_BOTTOM] > 0 ||
+      border_width[ST_SIDE_LEFT] > 0)
+    {
+      set_source_color_with_opacity (&border, paint_opacity);
+
+      /* NORTH */
+      cogl_rectangle (0, 0, width, border_width[ST_SIDE_TOP]);
+      /* EAST */
+      cogl_rectangle (width - border_width[ST_SIDE_RIGHT], border_width[ST_SIDE_TOP],
+                      width, height - border_width[ST_SIDE_BOTTOM]);
+      /* SOUTH */
+      cogl_rectangle (0, height - border_width[ST_SIDE_BOTTOM], width, height);
+      /* WEST */
+      cogl_rectangle (0, border_width[ST_SIDE_TOP],
+                      border_width[ST_SIDE_LEFT], height - border_width[ST_SIDE_BOTTOM]);
+    }
+
+  if (background.alpha > 0)
+    {
+      set_source_color_with_opacity (&background, paint_opacity);
+      cogl_rectangle (border_width[ST_SIDE_LEFT], border_width[ST_SIDE_TOP],
+                      width - border_width[ST_SIDE_RIGHT],
+                      height - border_width[ST_SIDE_BOTTOM]);
+    }
+
+  outline_width = st_theme_node_get_outline_width (node);
+  if (outline_width > 0)
+    {
+      st_theme_node_get_outline_color (node, &from);
+      over (&from, &node->background_color, &from);
+      st_theme_node_get_outline_color (other, &to);
+      over (&to, &other->background_color, &to);
+      interpolate_color (&from, &to, progress, &outline);
+
+      set_source_color_with_opacity (&outline, paint_opacity);
+
+      /* NORTH */
+      cogl_rectangle (-outline_width, -outline_width,
+                      width + outline_width, 0);
+      /* EAST */
+      cogl_rectangle (width, 0,
+                      width + outline_width, height);
+      /* SOUTH */
+      cogl_rectangle (-outline_width, height,
+                      width + outline_width, height + outline_width);
+      /* WEST */
+      cogl_rectangle (-outline_width, 0,
+                      0, height);
+    }
+}
+
 /**
  * st_theme_node_copy_cached_paint_state:
  * @node: a #StThemeNode
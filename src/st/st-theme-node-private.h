@@ -123,6 +123,14 @@ void _st_theme_node_ensure_geometry (StThemeNode *node);
 void _st_theme_node_init_drawing_state (StThemeNode *node);
 void _st_theme_node_free_drawing_state (StThemeNode *node);
 
+gboolean _st_theme_node_can_interpolate    (StThemeNode           *node,
+                                            StThemeNode           *other);
+void     _st_theme_node_paint_interpolated (StThemeNode           *node,
+                                            StThemeNode           *other,
+                                            const ClutterActorBox *box,
+                                            double                 progress,
+                                            guint8                 paint_opacity);
+
 G_END_DECLS
 
 #endif /* __ST_THEME_NODE_PRIVATE_H__ */
@@ -20,6 +20,8 @@
  */
 
 #include "st-theme-node-transition.h"
+#include "st-theme-node-private.h"
+#include "st-pipeline-cache.h"
 
 enum {
   COMPLETED,
@@ -29,15 +31,34 @@ enum {
 
 #define ST_THEME_NODE_TRANSITION_GET_PRIVATE(obj) (G_TYPE_INSTANCE_GET_PRIVATE ((obj), ST_TYPE_THEME_NODE_TRANSITION, StThemeNodeTransitionPrivate))
 
+/* Offscreen buffers are rounded up to a multiple of this size, so that
+ * widgets of about the same size can share them */
+#define RENDER_TARGET_SIZE_STEP 32
+
+/* Number of unused offscreen buffers kept around; a hover sweep over a
+ * menu only has a few transitions running at any one time */
+#define MAX_POOLED_RENDER_TARGETS 8
+
+typedef struct {
+  CoglHandle texture;
+  CoglHandle offscreen;
+  int width;
+  int height;
+} RenderTarget;
+
+static GSList *render_target_pool = NULL;
+static guint n_pooled_render_targets = 0;
+
 struct _StThemeNodeTransitionPrivate {
   StThemeNode *old_theme_node;
   StThemeNode *new_theme_node;
 
-  CoglHandle old_texture;
-  CoglHandle new_texture;
+  RenderTarget *old_target;
+  RenderTarget *new_target;
 
-  CoglHandle old_offscreen;
-  CoglHandle new_offscreen;
+  /* Part of the render targets covered by offscreen_box */
+  float tex_x2;
+  float tex_y2;
 
   CoglHandle material;
 
@@ -51,6 +72,9 @@ struct _StThemeNodeTransitionPrivate {
   ClutterActorBox offscreen_box;
 
   gboolean needs_setup;
+
+  /* The nodes only differ in color, and are painted directly */
+  gboolean interpolate;
 };
 
 static guint signals[LAST_SIGNAL] = { 0 };
@@ -216,89 +240,166 @@ st_theme_node_transition_get_paint_box (StThemeNodeTransition *transition,
   paint_box->y2 = MAX (old_node_box.y2, new_node_box.y2);
 }
 
-static gboolean
-setup_framebuffers (StThemeNodeTransition *transition,
-                    const ClutterActorBox *allocation)
+static void
+render_target_free (RenderTarget *target)
 {
-  StThemeNodeTransitionPrivate *priv = transition->priv;
-  CoglColor clear_color = { 0, 0, 0, 0 };
-  guint width, height;
+  cogl_handle_unref (target->offscreen);
+  cogl_handle_unref (target->texture);
+  g_slice_free (RenderTarget, target);
+}
 
-  /* template material to avoid unnecessary shader compilation */
-  static CoglHandle material_template = COGL_INVALID_HANDLE;
+static RenderTarget *
+render_target_acquire (int width,
+                       int height)
+{
+  RenderTarget *target;
+  GSList *l;
 
-  width  = priv->offscreen_box.x2 - priv->offscreen_box.x1;
-  height = priv->offscreen_box.y2 - priv->offscreen_box.y1;
+  width = (width + RENDER_TARGET_SIZE_STEP - 1) & ~(RENDER_TARGET_SIZE_STEP - 1);
+  height = (height + RENDER_TARGET_SIZE_STEP - 1) & ~(RENDER_TARGET_SIZE_STEP - 1);
 
-  g_return_val_if_fail (width  > 0, FALSE);
-  g_return_val_if_fail (height > 0, FALSE);
+  for (l = render_target_pool; l; l = l->next)
+    {
+      target = l->data;
 
-  if (priv->old_texture)
-    cogl_handle_unref (priv->old_texture);
-  priv->old_texture = cogl_texture_new_with_size (width, height,
-                                                  COGL_TEXTURE_NO_SLICING,
-                                                  COGL_PIXEL_FORMAT_ANY);
+      if (target->width == width && target->height == height)
+        {
+          render_target_pool = g_slist_delete_link (render_target_pool, l);
+          n_pooled_render_targets--;
+          return target;
+        }
+    }
 
-  if (priv->new_texture)
-    cogl_handle_unref (priv->new_texture);
-  priv->new_texture = cogl_texture_new_with_size (width, height,
-                                                  COGL_TEXTURE_NO_SLICING,
-                                                  COGL_PIXEL_FORMAT_ANY);
+  target = g_slice_new (RenderTarget);
+  target->width = width;
+  target->height = height;
+  target->texture = cogl_texture_new_with_size (width, height,
+                                                COGL_TEXTURE_NO_SLICING,
+                                                COGL_PIXEL_FORMAT_ANY);
+  if (target->texture == COGL_INVALID_HANDLE)
+    {
+      g_slice_free (RenderTarget, target);
+      return NULL;
+    }
 
-  g_return_val_if_fail (priv->old_texture != COGL_INVALID_HANDLE, FALSE);
-  g_return_val_if_fail (priv->new_texture != COGL_INVALID_HANDLE, FALSE);
+  target->offscreen = cogl_offscreen_new_to_texture (target->texture);
+  if (target->offscreen == COGL_INVALID_HANDLE)
+    {
+      cogl_handle_unref (target->texture);
+      g_slice_free (RenderTarget, target);
+      return NULL;
+    }
 
-  if (priv->old_offscreen)
-    cogl_handle_unref (priv->old_offscreen);
-  priv->old_offscreen = cogl_offscreen_new_to_texture (priv->old_texture);
+  return target;
+}
 
-  if (priv->new_offscreen)
-    cogl_handle_unref (priv->new_offscreen);
-  priv->new_offscreen = cogl_offscreen_new_to_texture (priv->new_texture);
+static void
+render_target_release (RenderTarget *target)
+{
+  GSList *last;
 
-  g_return_val_if_fail (priv->old_offscreen != COGL_INVALID_HANDLE, FALSE);
-  g_return_val_if_fail (priv->new_offscreen != COGL_INVALID_HANDLE, FALSE);
+  render_target_pool = g_slist_prepend (render_target_pool, target);
+  n_pooled_render_targets++;
 
-  if (priv->material == NULL)
+  /* Drop the least recently used buffer */
+  if (n_pooled_render_targets > MAX_POOLED_RENDER_TARGETS)
     {
-      if (G_UNLIKELY (material_template == COGL_INVALID_HANDLE))
-        {
-          material_template = cogl_material_new ();
-
-          cogl_material_set_layer_combine (material_template, 0,
-                                           "RGBA = REPLACE (TEXTURE)",
-                                           NULL);
-          cogl_material_set_layer_combine (material_template, 1,
-                                           "RGBA = INTERPOLATE (PREVIOUS, "
-                                                               "TEXTURE, "
-                                                               "CONSTANT[A])",
-                                           NULL);
-          cogl_material_set_layer_combine (material_template, 2,
-                                           "RGBA = MODULATE (PREVIOUS, "
-                                                            "PRIMARY)",
-                                           NULL);
-        }
-      priv->material = cogl_material_copy (material_template);
+      last = g_slist_last (render_target_pool);
+      render_target_free (last->data);
+      render_target_pool = g_slist_delete_link (render_target_pool, last);
+      n_pooled_render_targets--;
     }
+}
 
-  cogl_material_set_layer (priv->material, 0, priv->new_texture);
-  cogl_material_set_layer (priv->material, 1, priv->old_texture);
+static gboolean
+ensure_render_target (RenderTarget **target,
+                      int            width,
+                      int            height)
+{
+  if (*target != NULL &&
+      (*target)->width >= width && (*target)->height >= height &&
+      (*target)->width - width < RENDER_TARGET_SIZE_STEP &&
+      (*target)->height - height < RENDER_TARGET_SIZE_STEP)
+    return TRUE;
 
-  cogl_push_framebuffer (priv->old_offscreen);
-  cogl_clear (&clear_color, COGL_BUFFER_BIT_COLOR);
-  cogl_ortho (priv->offscreen_box.x1, priv->offscreen_box.x2,
-              priv->offscreen_box.y2, priv->offscreen_box.y1,
-              0.0, 1.0);
-  st_theme_node_paint (priv->old_theme_node, allocation, 255);
-  cogl_pop_framebuffer ();
+  if (*target != NULL)
+    render_target_release (*target);
+
+  *target = render_target_acquire (width, height);
 
-  cogl_push_framebuffer (priv->new_offscreen);
+  return *target != NULL;
+}
+
+static void
+paint_to_render_target (StThemeNodeTransition *transition,
+                        RenderTarget          *target,
+                        StThemeNode           *theme_node,
+                        const ClutterActorBox *allocation)
+{
+  StThemeNodeTransitionPrivate *priv = transition->priv;
+  CoglColor clear_color = { 0, 0, 0, 0 };
+
+  /* The target may be larger than the offscreen box; we only use its
+   * top left part, at the same scale */
+  cogl_push_framebuffer (target->offscreen);
   cogl_clear (&clear_color, COGL_BUFFER_BIT_COLOR);
-  cogl_ortho (priv->offscreen_box.x1, priv->offscreen_box.x2,
-              priv->offscreen_box.y2, priv->offscreen_box.y1,
+  cogl_ortho (priv->offscreen_box.x1, priv->offscreen_box.x1 + target->width,
+              priv->offscreen_box.y1 + target->height, priv->offscreen_box.y1,
               0.0, 1.0);
-  st_theme_node_paint (priv->new_theme_node, allocation, 255);
+  st_theme_node_paint (theme_node, allocation, 255);
   cogl_pop_framebuffer ();
+}
+
+static gboolean
+setup_transition_material (CoglHandle material)
+{
+  cogl_material_set_layer_combine (material, 0,
+                                   "RGBA = REPLACE (TEXTURE)",
+                                   NULL);
+  cogl_material_set_layer_combine (material, 1,
+                                   "RGBA = INTERPOLATE (PREVIOUS, "
+                                                       "TEXTURE, "
+                                                       "CONSTANT[A])",
+                                   NULL);
+  cogl_material_set_layer_combine (material, 2,
+                                   "RGBA = MODULATE (PREVIOUS, "
+                                                    "PRIMARY)",
+                                   NULL);
+  return TRUE;
+}
+
+static gboolean
+setup_framebuffers (StThemeNodeTransition *transition,
+                    const ClutterActorBox *allocation)
+{
+  StThemeNodeTransitionPrivate *priv = transition->priv;
+  guint width, height;
+
+  width  = priv->offscreen_box.x2 - priv->offscreen_box.x1;
+  height = priv->offscreen_box.y2 - priv->offscreen_box.y1;
+
+  g_return_val_if_fail (width  > 0, FALSE);
+  g_return_val_if_fail (height > 0, FALSE);
+
+  g_return_val_if_fail (ensure_render_target (&priv->old_target, width, height), FALSE);
+  g_return_val_if_fail (ensure_render_target (&priv->new_target, width, height), FALSE);
+
+  /* Both targets are in the same size bucket */
+  priv->tex_x2 = (float) width / priv->old_target->width;
+  priv->tex_y2 = (float) height / priv->old_target->height;
+
+  /* copy a shared template material to avoid unnecessary shader compilation */
+  if (priv->material == NULL)
+    priv->material = cogl_material_copy (st_pipeline_cache_get_material ("st-theme-node-transition",
+                                                                         setup_transition_material));
+
+  cogl_material_set_layer (priv->material, 0, priv->new_target->texture);
+  cogl_material_set_layer (priv->material, 1, priv->old_target->texture);
+
+  paint_to_render_target (transition, priv->old_target,
+                          priv->old_theme_node, allocation);
+  paint_to_render_target (transition, priv->new_target,
+                          priv->new_theme_node, allocation);
 
   return TRUE;
 }
@@ -311,10 +412,7 @@ st_theme_node_transition_paint (StThemeNodeTransition *transition,
   StThemeNodeTransitionPrivate *priv = transition->priv;
 
   CoglColor constant;
-  float tex_coords[] = {
-    0.0, 0.0, 1.0, 1.0,
-    0.0, 0.0, 1.0, 1.0,
-  };
+  float tex_coords[8];
 
   g_return_if_fail (ST_IS_THEME_NODE (priv->old_theme_node));
   g_return_if_fail (ST_IS_THEME_NODE (priv->new_theme_node));
@@ -326,13 +424,37 @@ st_theme_node_transition_paint (StThemeNodeTransition *transition,
     {
       priv->last_allocation = *allocation;
 
-      calculate_offscreen_box (transition, allocation);
-      priv->needs_setup = !setup_framebuffers (transition, allocation);
+      priv->interpolate = _st_theme_node_can_interpolate (priv->old_theme_node,
+                                                          priv->new_theme_node);
+      if (priv->interpolate)
+        {
+          priv->needs_setup = FALSE;
+        }
+      else
+        {
+          calculate_offscreen_box (transition, allocation);
+          priv->needs_setup = !setup_framebuffers (transition, allocation);
 
-      if (priv->needs_setup) /* setting up framebuffers failed */
-        return;
+          if (priv->needs_setup) /* setting up framebuffers failed */
+            return;
+        }
     }
 
+  if (priv->interpolate)
+    {
+      _st_theme_node_paint_interpolated (priv->old_theme_node,
+                                         priv->new_theme_node,
+                                         allocation,
+                                         clutter_alpha_get_alpha (priv->alpha),
+                                         paint_opacity);
+      return;
+    }
+
+  tex_coords[0] = tex_coords[4] = 0.0;
+  tex_coords[1] = tex_coords[5] = 0.0;
+  tex_coords[2] = tex_coords[6] = priv->tex_x2;
+  tex_coords[3] = tex_coords[7] = priv->tex_y2;
+
   cogl_color_set_from_4f (&constant, 0., 0., 0.,
                           clutter_alpha_get_alpha (priv->alpha));
   cogl_material_set_layer_combine_constant (priv->material, 1, &constant);
@@ -366,28 +488,16 @@ st_theme_node_transition_dispose (GObject *object)
       priv->new_theme_node = NULL;
     }
 
-  if (priv->old_texture)
-    {
-      cogl_handle_unref (priv->old_texture);
-      priv->old_texture = NULL;
-    }
-
-  if (priv->new_texture)
+  if (priv->old_target)
     {
-      cogl_handle_unref (priv->new_texture);
-      priv->new_texture = NULL;
+      render_target_release (priv->old_target);
+      priv->old_target = NULL;
     }
 
-  if (priv->old_offscreen)
+  if (priv->new_target)
     {
-      cogl_handle_unref (priv->old_offscreen);
-      priv->old_offscreen = NULL;
-    }
-
-  if (priv->new_offscreen)
-    {
-      cogl_handle_unref (priv->new_offscreen);
-      priv->new_offscreen = NULL;
+      render_target_release (priv->new_target);
+      priv->new_target = NULL;
     }
 
   if (priv->material)
@@ -429,11 +539,8 @@ st_theme_node_transition_init (StThemeNodeTransition *transition)
   transition->priv->old_theme_node = NULL;
   transition->priv->new_theme_node = NULL;
 
-  transition->priv->old_texture = NULL;
-  transition->priv->new_texture = NULL;
-
-  transition->priv->old_offscreen = NULL;
-  transition->priv->new_offscreen = NULL;
+  transition->priv->old_target = NULL;
+  transition->priv->new_target = NULL;
 
   transition->priv->needs_setup = TRUE;
 
@@ -0,0 +1,285 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+/*
+ * test-atlas-paint.c: benchmark painting icons from the texture atlas
+ *
+ * Copyright 2012 Red Hat, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Paints a grid of small icons into an offscreen framebuffer, once with
+ * a texture per icon and once with sub-textures of StTextureAtlas pages,
+ * and prints the time per frame for both. Nothing is shown on screen,
+ * so it can run under Xvfb. It fails if the two don't paint the same
+ * pixels, for instance because the cell padding is missing.
+ *
+ * Before that, it adds and removes icons of mixed sizes at random and
+ * fails if any icon still in the atlas doesn't read back unchanged,
+ * which catches cells that overlap or are handed out twice.
+ */
+
+#include <string.h>
+
+#include <clutter/clutter.h>
+
+#include "st-texture-atlas.h"
+
+#define ICON_SIZE 24
+#define N_COLUMNS 20
+#define N_ROWS 10
+#define N_ICONS (N_COLUMNS * N_ROWS)
+#define N_FRAMES 200
+
+#define FB_WIDTH (N_COLUMNS * ICON_SIZE)
+#define FB_HEIGHT (N_ROWS * ICON_SIZE)
+
+#define N_CHURN_ICONS 1000
+#define N_CHURN_ROUNDS 5000
+
+static gboolean fail;
+
+static GdkPixbuf *
+create_icon (int i,
+             int size)
+{
+  GdkPixbuf *pixbuf;
+  guint8 *pixels;
+  int rowstride, x, y;
+
+  pixbuf = gdk_pixbuf_new (GDK_COLORSPACE_RGB, TRUE, 8, size, size);
+  pixels = gdk_pixbuf_get_pixels (pixbuf);
+  rowstride = gdk_pixbuf_get_rowstride (pixbuf);
+
+  /* Opaque, with a different color for every icon and a hard edge
+   * all around, so that bleeding from a neighbouring cell shows */
+  for (y = 0; y < size; y++)
+    for (x = 0; x < size; x++)
+      {
+        guint8 *p = pixels + y * rowstride + x * 4;
+        gboolean edge = (x == 0 || y == 0 ||
+                         x == size - 1 || y == size - 1);
+
+        p[0] = edge ? 0xff : (i * 37) & 0xff;
+        p[1] = edge ? 0x00 : (i * 91) & 0xff;
+        p[2] = edge ? 0xff : (i * 13) & 0xff;
+        p[3] = 0xff;
+      }
+
+  return pixbuf;
+}
+
+static gboolean
+icon_matches (CoglHandle  texture,
+              GdkPixbuf  *pixbuf)
+{
+  int width = gdk_pixbuf_get_width (pixbuf);
+  int height = gdk_pixbuf_get_height (pixbuf);
+  int rowstride = gdk_pixbuf_get_rowstride (pixbuf);
+  const guint8 *pixels = gdk_pixbuf_get_pixels (pixbuf);
+  guint8 *data;
+  gboolean matches = TRUE;
+  int y;
+
+  if (cogl_texture_get_width (texture) != width ||
+      cogl_texture_get_height (texture) != height)
+    return FALSE;
+
+  data = g_malloc (width * height * 4);
+  cogl_texture_get_data (texture, COGL_PIXEL_FORMAT_RGBA_8888,
+                         width * 4, data);
+
+  for (y = 0; y < height && matches; y++)
+    matches = memcmp (data + y * width * 4, pixels + y * rowstride,
+                      width * 4) == 0;
+
+  g_free (data);
+
+  return matches;
+}
+
+static void
+check_churn (StTextureAtlas *atlas)
+{
+  static const int sizes[] = { 16, 22, 24, 32 };
+  CoglHandle textures[N_CHURN_ICONS] = { NULL, };
+  GdkPixbuf *pixbufs[N_CHURN_ICONS] = { NULL, };
+  GRand *rand = g_rand_new_with_seed (37);
+  int i, round;
+
+  for (round = 0; round < N_CHURN_ROUNDS; round++)
+    {
+      i = g_rand_int_range (rand, 0, N_CHURN_ICONS);
+
+      if (textures[i])
+        {
+          cogl_handle_unref (textures[i]);
+          g_object_unref (pixbufs[i]);
+          textures[i] = NULL;
+          continue;
+        }
+
+      pixbufs[i] = create_icon (round, sizes[g_rand_int_range (rand, 0, 4)]);
+      textures[i] = st_texture_atlas_add_pixbuf (atlas, pixbufs[i], FALSE);
+      if (textures[i] == COGL_INVALID_HANDLE)
+        {
+          g_print ("Icon %d didn't go into the atlas\n", round);
+          fail = TRUE;
+          g_object_unref (pixbufs[i]);
+        }
+    }
+
+  for (i = 0; i < N_CHURN_ICONS; i++)
+    {
+      if (textures[i] == NULL)
+        continue;
+
+      if (!icon_matches (textures[i], pixbufs[i]) && !fail)
+        {
+          g_print ("An icon changed while others were added and removed\n");
+          fail = TRUE;
+        }
+
+      cogl_handle_unref (textures[i]);
+      g_object_unref (pixbufs[i]);
+    }
+
+  g_rand_free (rand);
+}
+
+static void
+paint_icons (CoglHandle *textures)
+{
+  CoglColor transparent;
+  int i;
+
+  cogl_color_init_from_4ub (&transparent, 0, 0, 0, 0);
+  cogl_clear (&transparent, COGL_BUFFER_BIT_COLOR);
+
+  for (i = 0; i < N_ICONS; i++)
+    {
+      float x = (i % N_COLUMNS) * ICON_SIZE;
+      float y = (i / N_COLUMNS) * ICON_SIZE;
+
+      cogl_set_source_texture (textures[i]);
+      cogl_rectangle (x, y, x + ICON_SIZE, y + ICON_SIZE);
+    }
+}
+
+/* Paints N_FRAMES frames and returns the last one, reading back the
+ * framebuffer after each so that the GPU work is included */
+static guint8 *
+run_benchmark (const char *name,
+               CoglHandle *textures)
+{
+  CoglHandle target, offscreen;
+  GTimer *timer;
+  guint8 *pixels;
+  int i;
+
+  target = cogl_texture_new_with_size (FB_WIDTH, FB_HEIGHT,
+                                       COGL_TEXTURE_NO_SLICING,
+                                       COGL_PIXEL_FORMAT_RGBA_8888_PRE);
+  offscreen = cogl_offscreen_new_to_texture (target);
+
+  cogl_push_framebuffer (offscreen);
+  cogl_ortho (0, FB_WIDTH, FB_HEIGHT, 0, -1, 1);
+
+  pixels = g_malloc (FB_WIDTH * FB_HEIGHT * 4);
+
+  /* Warm up, so that uploads and shader compilation aren't timed */
+  paint_icons (textures);
+  cogl_read_pixels (0, 0, 1, 1, COGL_READ_PIXELS_COLOR_BUFFER,
+                    COGL_PIXEL_FORMAT_RGBA_8888_PRE, pixels);
+
+  timer = g_timer_new ();
+  for (i = 0; i < N_FRAMES; i++)
+    {
+      paint_icons (textures);
+      cogl_read_pixels (0, 0, 1, 1, COGL_READ_PIXELS_COLOR_BUFFER,
+                        COGL_PIXEL_FORMAT_RGBA_8888_PRE, pixels);
+    }
+  g_timer_stop (timer);
+
+  g_print ("%-10s %d icons: %.3f ms per frame\n",
+           name, N_ICONS, 1000 * g_timer_elapsed (timer, NULL) / N_FRAMES);
+
+  cogl_read_pixels (0, 0, FB_WIDTH, FB_HEIGHT, COGL_READ_PIXELS_COLOR_BUFFER,
+                    COGL_PIXEL_FORMAT_RGBA_8888_PRE, pixels);
+
+  cogl_pop_framebuffer ();
+
+  g_timer_destroy (timer);
+  cogl_handle_unref (offscreen);
+  cogl_handle_unref (target);
+
+  return pixels;
+}
+
+int
+main (int argc, char **argv)
+{
+  StTextureAtlas *atlas;
+  CoglHandle separate[N_ICONS], atlased[N_ICONS];
+  guint8 *separate_pixels, *atlas_pixels;
+  int i;
+
+  if (clutter_init (&argc, &argv) != CLUTTER_INIT_SUCCESS)
+    return 1;
+
+  atlas = st_texture_atlas_new ();
+
+  check_churn (atlas);
+
+  for (i = 0; i < N_ICONS; i++)
+    {
+      GdkPixbuf *pixbuf = create_icon (i, ICON_SIZE);
+
+      separate[i] = cogl_texture_new_from_data (ICON_SIZE, ICON_SIZE,
+                                                COGL_TEXTURE_NO_ATLAS,
+                                                COGL_PIXEL_FORMAT_RGBA_8888,
+                                                COGL_PIXEL_FORMAT_ANY,
+                                                gdk_pixbuf_get_rowstride (pixbuf),
+                                                gdk_pixbuf_get_pixels (pixbuf));
+      atlased[i] = st_texture_atlas_add_pixbuf (atlas, pixbuf, FALSE);
+      if (atlased[i] == COGL_INVALID_HANDLE)
+        {
+          g_print ("Icon %d didn't go into the atlas\n", i);
+          return 1;
+        }
+
+      g_object_unref (pixbuf);
+    }
+
+  separate_pixels = run_benchmark ("separate", separate);
+  atlas_pixels = run_benchmark ("atlas", atlased);
+
+  if (memcmp (separate_pixels, atlas_pixels, FB_WIDTH * FB_HEIGHT * 4) != 0)
+    {
+      g_print ("Icons painted from the atlas differ from the originals\n");
+      fail = TRUE;
+    }
+
+  g_free (separate_pixels);
+  g_free (atlas_pixels);
+
+  for (i = 0; i < N_ICONS; i++)
+    {
+      cogl_handle_unref (separate[i]);
+      cogl_handle_unref (atlased[i]);
+    }
+
+  st_texture_atlas_free (atlas);
+
+  return fail ? 1 : 0;
+}
@@ -0,0 +1,213 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+
+#include <string.h>
+
+#include "shell-png-encoder.h"
+
+/* Encodes some images with the threaded PNG writer at each compression
+ * level, decodes the result with cairo (and so libpng) and checks that
+ * we get back exactly what cairo's own PNG writer round-trips to.
+ */
+
+static gboolean fail;
+
+typedef struct {
+  const guchar *data;
+  gsize len;
+  gsize pos;
+} ReadClosure;
+
+static cairo_status_t
+read_from_memory (void          *closure,
+                  unsigned char *data,
+                  unsigned int   length)
+{
+  ReadClosure *read = closure;
+
+  if (read->pos + length > read->len)
+    return CAIRO_STATUS_READ_ERROR;
+
+  memcpy (data, read->data + read->pos, length);
+  read->pos += length;
+
+  return CAIRO_STATUS_SUCCESS;
+}
+
+static cairo_status_t
+write_to_byte_array (void                *closure,
+                     const unsigned char *data,
+                     unsigned int         length)
+{
+  g_byte_array_append (closure, data, length);
+
+  return CAIRO_STATUS_SUCCESS;
+}
+
+static cairo_surface_t *
+decode (const guchar *data,
+        gsize         len)
+{
+  ReadClosure read = { data, len, 0 };
+
+  return cairo_image_surface_create_from_png_stream (read_from_memory, &read);
+}
+
+static cairo_surface_t *
+create_image (cairo_format_t format,
+              int            width,
+              int            height)
+{
+  cairo_surface_t *surface = cairo_image_surface_create (format, width, height);
+  guchar *data = cairo_image_surface_get_data (surface);
+  int stride = cairo_image_surface_get_stride (surface);
+  GRand *rand = g_rand_new_with_seed (42);
+  int x, y;
+
+  /* Flat areas, gradients and noise, like a real screen */
+  for (y = 0; y < height; y++)
+    {
+      guint32 *row = (guint32 *) (data + y * stride);
+
+      for (x = 0; x < width; x++)
+        {
+          guint32 alpha = format == CAIRO_FORMAT_ARGB32 ? (x * 255) / width : 0xff;
+          guint32 r, g, b;
+
+          if (y < height / 3)
+            r = g = b = 0x80;
+          else if (y < 2 * height / 3)
+            {
+              r = (x * 255) / width;
+              g = (y * 255) / height;
+              b = 0x40;
+            }
+          else
+            {
+              r = g_rand_int_range (rand, 0, 256);
+              g = g_rand_int_range (rand, 0, 256);
+              b = g_rand_int_range (rand, 0, 256);
+            }
+
+          /* cairo pixels are premultiplied */
+          r = (r * alpha) / 255;
+          g = (g * alpha) / 255;
+          b = (b * alpha) / 255;
+
+          /* The unused byte of RGB24 pixels isn't always 0xff, for
+           * instance in pixels read back from GL; it must be ignored */
+          if (format == CAIRO_FORMAT_RGB24)
+            alpha = g_rand_int_range (rand, 0, 256);
+
+          row[x] = (alpha << 24) | (r << 16) | (g << 8) | b;
+        }
+    }
+
+  g_rand_free (rand);
+  cairo_surface_mark_dirty (surface);
+
+  return surface;
+}
+
+static gboolean
+surfaces_equal (cairo_surface_t *a,
+                cairo_surface_t *b)
+{
+  int width = cairo_image_surface_get_width (a);
+  int height = cairo_image_surface_get_height (a);
+  int y;
+
+  if (cairo_image_surface_get_width (b) != width ||
+      cairo_image_surface_get_height (b) != height ||
+      cairo_image_surface_get_format (a) != cairo_image_surface_get_format (b))
+    return FALSE;
+
+  for (y = 0; y < height; y++)
+    {
+      if (memcmp (cairo_image_surface_get_data (a) + y * cairo_image_surface_get_stride (a),
+                  cairo_image_surface_get_data (b) + y * cairo_image_surface_get_stride (b),
+                  width * 4) != 0)
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+static void
+test_image (const char     *name,
+            cairo_format_t  format,
+            int             width,
+            int             height)
+{
+  static const int levels[] = { SHELL_PNG_ENCODER_LEVEL_DEFAULT, 0, 1, 9 };
+  cairo_surface_t *image = create_image (format, width, height);
+  cairo_surface_t *expected;
+  GByteArray *reference = g_byte_array_new ();
+  gint64 start;
+  guint i;
+
+  start = g_get_monotonic_time ();
+  cairo_surface_write_to_png_stream (image, write_to_byte_array, reference);
+  g_print ("%s: cairo: %" G_GINT64_FORMAT " ms, %u bytes\n", name,
+           (g_get_monotonic_time () - start) / 1000, reference->len);
+
+  expected = decode (reference->data, reference->len);
+
+  for (i = 0; i < G_N_ELEMENTS (levels); i++)
+    {
+      GOutputStream *stream = g_memory_output_stream_new (NULL, 0, g_realloc, g_free);
+      cairo_surface_t *decoded;
+      GError *error = NULL;
+
+      start = g_get_monotonic_time ();
+      if (!shell_png_encoder_write_surface (image, stream, levels[i], NULL, &error))
+        {
+          g_print ("%s: level %d: writing failed: %s\n", name, levels[i], error->message);
+          g_error_free (error);
+          fail = TRUE;
+          g_object_unref (stream);
+          continue;
+        }
+      g_output_stream_close (stream, NULL, NULL);
+
+      g_print ("%s: level %d: %" G_GINT64_FORMAT " ms, %" G_GSIZE_FORMAT " bytes\n",
+               name, levels[i], (g_get_monotonic_time () - start) / 1000,
+               g_memory_output_stream_get_data_size (G_MEMORY_OUTPUT_STREAM (stream)));
+
+      decoded = decode (g_memory_output_stream_get_data (G_MEMORY_OUTPUT_STREAM (stream)),
+                        g_memory_output_stream_get_data_size (G_MEMORY_OUTPUT_STREAM (stream)));
+
+      if (cairo_surface_status (decoded) != CAIRO_STATUS_SUCCESS)
+        {
+          g_print ("%s: level %d: decoding failed: %s\n", name, levels[i],
+                   cairo_status_to_string (cairo_surface_status (decoded)));
+          fail = TRUE;
+        }
+      else if (!surfaces_equal (decoded, expected))
+        {
+          g_print ("%s: level %d: decoded image differs\n", name, levels[i]);
+          fail = TRUE;
+        }
+
+      cairo_surface_destroy (decoded);
+      g_object_unref (stream);
+    }
+
+  cairo_surface_destroy (expected);
+  g_byte_array_free (reference, TRUE);
+  cairo_surface_destroy (image);
+}
+
+int
+main (int argc, char **argv)
+{
+  g_type_init ();
+
+  test_image ("rgb", CAIRO_FORMAT_RGB24, 1920, 1080);
+  test_image ("argb", CAIRO_FORMAT_ARGB32, 640, 480);
+  /* A single row, and fewer rows than a band */
+  test_image ("tiny", CAIRO_FORMAT_RGB24, 7, 1);
+  test_image ("wide", CAIRO_FORMAT_RGB24, 11520, 3);
+  test_image ("pixel", CAIRO_FORMAT_ARGB32, 1, 1);
+
+  return fail ? 1 : 0;
+}
@@ -5,21 +5,135 @@
 #include <gst/gst.h>
 
 /* Very simple test of the ShellRecorder class; shows some text strings
- * moving around and records it.
+ * moving around and records it. Once the animation is done the stage
+ * stays static for a while, which should need far less data read back
+ * from the stage per second, and should not be repainted except for the
+ * occasional frame the recorder forces to avoid long pauses.
  */
 static ShellRecorder *recorder;
 
+/* Mirrors the defaults in shell-recorder.c */
+#define FRAMERATE 30
+#define MAXIMUM_PAUSE_TIME 1000
+
+#define STATIC_TIME 3000
+
+typedef struct {
+  gint64 time;
+  guint64 bytes_read;
+  guint paints;
+  guint frames_recorded;
+  guint frames_skipped;
+  guint frames_dropped;
+} Counters;
+
+static Counters start_counters;
+static Counters static_counters;
+static guint paints;
+static gboolean fail;
+
+static void
+get_counters (Counters *counters)
+{
+  counters->time = g_get_monotonic_time ();
+  counters->paints = paints;
+  g_object_get (recorder,
+                "bytes-read", &counters->bytes_read,
+                "frames-recorded", &counters->frames_recorded,
+                "frames-skipped", &counters->frames_skipped,
+                "frames-dropped", &counters->frames_dropped,
+                NULL);
+}
+
+static void
+on_stage_paint (ClutterActor *stage)
+{
+  paints++;
+}
+
+static void
+check_counters (const char     *phase,
+                const Counters *start,
+                const Counters *end,
+                guint           max_frames,
+                guint           max_paints)
+{
+  guint recorded = end->frames_recorded - start->frames_recorded;
+  guint skipped = end->frames_skipped - start->frames_skipped;
+  guint dropped = end->frames_dropped - start->frames_dropped;
+  guint n_paints = end->paints - start->paints;
+  gint64 elapsed = MAX (end->time - start->time, 1);
+
+  g_print ("%s: %" G_GUINT64_FORMAT " kB/s, %u paints, %u frames recorded, %u skipped, %u dropped\n",
+           phase, (end->bytes_read - start->bytes_read) * 1000 / elapsed,
+           n_paints, recorded, skipped, dropped);
+
+  /* Every paint while recording is accounted for exactly once */
+  if (recorded + skipped + dropped > n_paints)
+    {
+      g_print ("%s: more frames than paints\n", phase);
+      fail = TRUE;
+    }
+
+  if (recorded > max_frames)
+    {
+      g_print ("%s: expected at most %u frames recorded\n", phase, max_frames);
+      fail = TRUE;
+    }
+
+  if (n_paints > max_paints)
+    {
+      g_print ("%s: expected at most %u paints\n", phase, max_paints);
+      fail = TRUE;
+    }
+}
+
+static gboolean
+quit_timeout (gpointer data)
+{
+  clutter_main_quit ();
+  return FALSE;
+}
+
 static gboolean
 stop_recording_timeout (gpointer data)
 {
+  Counters end_counters;
+  guint max_forced;
+
+  get_counters (&end_counters);
+
+  /* The frame limiter lets frames through at 3/4 of the interval */
+  check_counters ("Animated", &start_counters, &static_counters,
+                  1 + (static_counters.time - start_counters.time) * FRAMERATE * 4 / 3 / 1000000,
+                  G_MAXUINT);
+
+  if (end_counters.frames_recorded == 0)
+    {
+      g_print ("No frames recorded\n");
+      fail = TRUE;
+    }
+
+  /* A static stage should only be painted for the repeated frames
+   * sent after MAXIMUM_PAUSE_TIME, plus the tail of the animation */
+  max_forced = STATIC_TIME / MAXIMUM_PAUSE_TIME + 1;
+  check_counters ("Static", &static_counters, &end_counters,
+                  max_forced + 1, 2 * max_forced + 2);
+
   shell_recorder_close (recorder);
+
+  /* Give the pipeline time to write out the file */
+  g_timeout_add (1000, quit_timeout, NULL);
+
   return FALSE;
 }
 
 static void
 on_animation_completed (ClutterAnimation *animation)
 {
-  g_timeout_add (1000, stop_recording_timeout, NULL);
+  get_counters (&static_counters);
+
+  g_timeout_add (STATIC_TIME, stop_recording_timeout, NULL);
 }
 
 int main (int argc, char **argv)
@@ -38,6 +152,7 @@ int main (int argc, char **argv)
   clutter_color_from_string (&blue, "blue");
   stage = clutter_stage_new ();
   g_signal_connect (stage, "destroy", G_CALLBACK (clutter_main_quit), NULL);
+  g_signal_connect_after (stage, "paint", G_CALLBACK (on_stage_paint), NULL);
 
   text = g_object_new (CLUTTER_TYPE_TEXT,
 		       "text", "Red",
@@ -92,7 +207,8 @@ int main (int argc, char **argv)
   clutter_actor_show (stage);
 
   shell_recorder_record (recorder);
+  get_counters (&start_counters);
   clutter_main ();
 
-  return 0;
+  return fail ? 1 : 0;
 }
@@ -0,0 +1,88 @@
+// -*- mode: js; js-indent-level: 4; indent-tabs-mode: nil -*-
+
+// Test cases for handing simple tweens over to Shell.Animator
+
+const Clutter = imports.gi.Clutter;
+const JsUnit = imports.jsUnit;
+const Mainloop = imports.mainloop;
+const Shell = imports.gi.Shell;
+
+const Environment = imports.ui.environment;
+Environment.init();
+
+const Tweener = imports.ui.tweener;
+Tweener.init();
+
+const animator = Shell.Animator.get_default();
+
+let nativeActor = new Clutter.Actor();
+let tweenerActor = new Clutter.Actor();
+
+let nativeStarted = 0, nativeCompleted = 0, tweenerCompleted = 0;
+let nativeCompleteTime = -1, tweenerCompleteTime = -1;
+let nFrames = 0, maxDifference = 0;
+
+function checkDone() {
+    if (nativeCompleted > 0 && tweenerCompleted > 0)
+        Mainloop.quit('tweener');
+}
+
+Tweener.addTween(nativeActor,
+                 { x: 100,
+                   time: 0.2,
+                   transition: 'linear',
+                   onStart: function() {
+                       nativeStarted++;
+                   },
+                   onComplete: function() {
+                       nativeCompleted++;
+                       nativeCompleteTime = animator.get_frame_time();
+                       checkDone();
+                   } });
+
+JsUnit.assertEquals('simple tween is run by the animator',
+                    1, animator.get_tween_count(nativeActor));
+JsUnit.assertEquals('simple tween is not run by tweener',
+                    0, Tweener.getTweenCount(nativeActor));
+
+// The same animation, but with a per-frame callback, so that it has
+// to go through imports.tweener.tweener
+Tweener.addTween(tweenerActor,
+                 { x: 100,
+                   time: 0.2,
+                   transition: 'linear',
+                   onUpdate: function() {
+                       nFrames++;
+                       maxDifference = Math.max(maxDifference,
+                                                Math.abs(tweenerActor.x - nativeActor.x));
+                   },
+                   onComplete: function() {
+                       tweenerCompleted++;
+                       tweenerCompleteTime = animator.get_frame_time();
+                       checkDone();
+                   } });
+
+JsUnit.assertEquals('tween with onUpdate is not run by the animator',
+                    0, animator.get_tween_count(tweenerActor));
+JsUnit.assertEquals('tween with onUpdate is run by tweener',
+                    1, Tweener.getTweenCount(tweenerActor));
+
+Mainloop.timeout_add(5000, function() {
+    Mainloop.quit('tweener');
+    return false;
+});
+Mainloop.run('tweener');
+
+JsUnit.assertEquals('native tween started once', 1, nativeStarted);
+JsUnit.assertEquals('native tween completed once', 1, nativeCompleted);
+JsUnit.assertEquals('tweener tween completed once', 1, tweenerCompleted);
+JsUnit.assertEquals('native tween ends on its target', 100, nativeActor.x);
+JsUnit.assertEquals('tweener tween ends on its target', 100, tweenerActor.x);
+JsUnit.assertEquals('animator has no tweens left', 0, animator.get_tween_count(nativeActor));
+
+// Both are driven by the animator's frames, so they advance in step
+// and finish on the same frame
+JsUnit.assertTrue('some frames were painted in between', nFrames > 1);
+JsUnit.assertTrue('both tweens advance together', maxDifference < 0.01);
+JsUnit.assertEquals('both tweens complete on the same frame',
+                    nativeCompleteTime, tweenerCompleteTime);
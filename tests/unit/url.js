@@ -39,6 +39,13 @@ const tests = [
     { input: 'This is an ftp://www.gnome.org/ test.',
       output: [ { url: 'ftp://www.gnome.org/', pos: 11 } ] },
 
+    { input: 'This is http://www.gnome.org\u00a0a no-break space test',
+      output: [ { url: 'http://www.gnome.org', pos: 8 } ] },
+    { input: 'Go to\u00a0www.gnome.org',
+      output: [ { url: 'www.gnome.org', pos: 6 } ] },
+    { input: 'http://www.gnome.org\u2028is followed by a line separator',
+      output: [ { url: 'http://www.gnome.org', pos: 0 } ] },
+
     { input: 'Visit http://www.gnome.org/ and http://developer.gnome.org',
       output: [ { url: 'http://www.gnome.org/', pos: 6 },
 		{ url: 'http://developer.gnome.org', pos: 32 } ] },